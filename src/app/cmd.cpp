@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -49,6 +50,7 @@ void Cmd::undo()
   CMD_TRACE("CMD: Undo cmd '%s'\n", typeid(*this).name());
   ASSERT(m_state == State::Executed || m_state == State::Redone);
 
+  unspill();
   onUndo();
   onFireNotifications();
 
@@ -62,6 +64,7 @@ void Cmd::redo()
   CMD_TRACE("CMD: Redo cmd '%s'\n", typeid(*this).name());
   ASSERT(m_state == State::Undone);
 
+  unspill();
   onRedo();
   onFireNotifications();
 
@@ -89,6 +92,27 @@ size_t Cmd::memSize() const
   return onMemSize();
 }
 
+void Cmd::spill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  if (m_spilled)
+    return;
+
+  // Marked as spilled even if onSpill() fails, as part of the data
+  // could be in the file anyway (onUnspill() must check what was
+  // really moved to the file).
+  m_spilled = true;
+  onSpill(file);
+}
+
+void Cmd::unspill()
+{
+  if (!m_spilled)
+    return;
+
+  onUnspill();
+  m_spilled = false;
+}
+
 void Cmd::onExecute()
 {
   // Do nothing
@@ -120,4 +144,14 @@ size_t Cmd::onMemSize() const
   return sizeof(*this);
 }
 
+void Cmd::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  // Do nothing
+}
+
+void Cmd::onUnspill()
+{
+  // Do nothing
+}
+
 } // namespace app
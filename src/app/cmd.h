@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -11,11 +12,13 @@
 #include "base/disable_copying.h"
 #include "undo/undo_command.h"
 
+#include <memory>
 #include <string>
 
 namespace app {
 
 class Context;
+class DocUndoSpillFile;
 
 class Cmd : public undo::UndoCommand {
 public:
@@ -32,6 +35,18 @@ public:
   std::string label() const;
   size_t memSize() const;
 
+  // Moves the undo/redo data of this command (e.g. pixels or
+  // serialized objects) to the given file to release memory. The
+  // data is loaded again automatically when the command is
+  // undone/redone.
+  void spill(const std::shared_ptr<DocUndoSpillFile>& file);
+
+  // Loads the data moved to disk with spill(). It's called
+  // automatically by undo()/redo(), but it can be called before to
+  // know if the data can be loaded (if it throws an exception, the
+  // command is still spilled and nothing was undone/redone).
+  void unspill();
+
   Context* context() const { return m_ctx; }
 
 protected:
@@ -41,9 +56,12 @@ protected:
   virtual void onFireNotifications();
   virtual std::string onLabel() const;
   virtual size_t onMemSize() const;
+  virtual void onSpill(const std::shared_ptr<DocUndoSpillFile>& file);
+  virtual void onUnspill();
 
 private:
   Context* m_ctx;
+  bool m_spilled = false;
 #if _DEBUG
   enum class State { NotExecuted, Executed, Undone, Redone };
   State m_state;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -85,6 +85,30 @@ void AddCel::onRedo()
   m_size = 0;
 }
 
+void AddCel::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  // The stream only has data when the cel is removed
+  if (m_size == 0)
+    return;
+
+  const std::string data = m_stream.str();
+  m_spilledStream.spill(file, data.data(), data.size());
+  m_stream.str(std::string());
+  m_stream.clear();
+  m_size = 0;
+}
+
+void AddCel::onUnspill()
+{
+  if (!m_spilledStream.isSpilled())
+    return;
+
+  const std::string data = m_spilledStream.unspill();
+  m_stream.str(data);
+  m_stream.clear();
+  m_size = data.size();
+}
+
 void AddCel::addCel(Layer* layer, Cel* cel)
 {
   static_cast<LayerImage*>(layer)->addCel(cel);
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +12,7 @@
 #include "app/cmd.h"
 #include "app/cmd/with_cel.h"
 #include "app/cmd/with_layer.h"
+#include "app/doc_undo_spill_file.h"
 
 #include <sstream>
 
@@ -33,6 +35,8 @@ protected:
   void onUndo() override;
   void onRedo() override;
   size_t onMemSize() const override { return sizeof(*this) + m_size; }
+  void onSpill(const std::shared_ptr<DocUndoSpillFile>& file) override;
+  void onUnspill() override;
 
 private:
   void addCel(Layer* layer, Cel* cel);
@@ -40,6 +44,7 @@ private:
 
   size_t m_size;
   std::stringstream m_stream;
+  SpilledData m_spilledStream;
 };
 
 }} // namespace app::cmd
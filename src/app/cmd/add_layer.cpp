@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -62,6 +63,30 @@ void AddLayer::onRedo()
   m_size = 0;
 }
 
+void AddLayer::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  // The stream only has data when the layer is removed
+  if (m_size == 0)
+    return;
+
+  const std::string data = m_stream.str();
+  m_spilledStream.spill(file, data.data(), data.size());
+  m_stream.str(std::string());
+  m_stream.clear();
+  m_size = 0;
+}
+
+void AddLayer::onUnspill()
+{
+  if (!m_spilledStream.isSpilled())
+    return;
+
+  const std::string data = m_spilledStream.unspill();
+  m_stream.str(data);
+  m_stream.clear();
+  m_size = data.size();
+}
+
 void AddLayer::addLayer(Layer* group, Layer* newLayer, Layer* afterThis)
 {
   static_cast<LayerGroup*>(group)->insertLayer(newLayer, afterThis);
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -10,6 +11,7 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_layer.h"
+#include "app/doc_undo_spill_file.h"
 
 #include <sstream>
 
@@ -29,6 +31,8 @@ protected:
   void onUndo() override;
   void onRedo() override;
   size_t onMemSize() const override { return sizeof(*this) + m_size; }
+  void onSpill(const std::shared_ptr<DocUndoSpillFile>& file) override;
+  void onUnspill() override;
 
 private:
   void addLayer(Layer* group, Layer* newLayer, Layer* afterThis);
@@ -39,6 +43,7 @@ private:
   WithLayer m_afterThis;
   size_t m_size;
   std::stringstream m_stream;
+  SpilledData m_spilledStream;
 };
 
 }} // namespace app::cmd
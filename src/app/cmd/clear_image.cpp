@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -14,6 +15,8 @@
 #include "doc/image.h"
 #include "doc/primitives.h"
 
+#include <sstream>
+
 namespace app { namespace cmd {
 
 using namespace doc;
@@ -27,7 +30,7 @@ void ClearImage::onExecute()
   Image* image = this->image();
 
   ASSERT(!m_copy);
-  m_copy.reset(Image::createCopy(image));
+  m_copy = std::make_unique<TiledImage>(image);
   clear_image(image, m_color);
 
   image->incrementVersion();
@@ -37,10 +40,37 @@ void ClearImage::onUndo()
 {
   Image* image = this->image();
 
-  copy_image(image, m_copy.get());
+  m_copy->copyToImage(image);
   m_copy.reset();
 
   image->incrementVersion();
 }
 
+void ClearImage::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  if (!m_copy || !m_copy->hasTilesData())
+    return;
+
+  std::ostringstream os;
+  m_copy->unloadTilesData(os);
+  const std::string data = os.str();
+  try {
+    m_spilledCopy.spill(file, data.data(), data.size());
+  }
+  catch (...) {
+    std::istringstream is(data);
+    m_copy->loadTilesData(is);
+    throw;
+  }
+}
+
+void ClearImage::onUnspill()
+{
+  if (!m_spilledCopy.isSpilled())
+    return;
+
+  std::istringstream is(m_spilledCopy.unspill());
+  m_copy->loadTilesData(is);
+}
+
 }} // namespace app::cmd
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -10,8 +11,11 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_image.h"
+#include "app/doc_undo_spill_file.h"
 #include "doc/color.h"
-#include "doc/image_ref.h"
+#include "doc/tiled_image.h"
+
+#include <memory>
 
 namespace app { namespace cmd {
 using namespace doc;
@@ -25,9 +29,12 @@ protected:
   void onExecute() override;
   void onUndo() override;
   size_t onMemSize() const override { return sizeof(*this) + (m_copy ? m_copy->getMemSize() : 0); }
+  void onSpill(const std::shared_ptr<DocUndoSpillFile>& file) override;
+  void onUnspill() override;
 
 private:
-  ImageRef m_copy;
+  std::unique_ptr<TiledImage> m_copy;
+  SpilledData m_spilledCopy;
   color_t m_color;
 };
 
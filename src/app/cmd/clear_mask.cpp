@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,6 +20,7 @@
 #include "doc/layer_tilemap.h"
 #include "doc/mask.h"
 #include "doc/primitives.h"
+#include "doc/shared_image_copies.h"
 
 namespace app { namespace cmd {
 
@@ -66,7 +67,8 @@ ClearMask::ClearMask(Cel* cel) : WithCel(cel)
   cropBounds.offset(-imageBounds.origin());
   m_cropPos = cropBounds.origin();
 
-  m_copy.reset(crop_image(image, cropBounds, m_bgcolor));
+  ImageRef copy(crop_image(image, cropBounds, m_bgcolor));
+  m_copy = make_shared_image_copy(copy.get());
 }
 
 void ClearMask::onExecute()
@@ -102,6 +104,7 @@ void ClearMask::clear()
                                  mask,
                                  m_bgcolor,
                                  (cel->image()->isTilemap() ? &grid : nullptr));
+  cel->image()->incrementVersion();
 }
 
 void ClearMask::restore()
@@ -111,6 +114,7 @@ void ClearMask::restore()
 
   Cel* cel = this->cel();
   copy_image(cel->image(), m_copy.get(), m_cropPos.x, m_cropPos.y);
+  cel->image()->incrementVersion();
 }
 
 }} // namespace app::cmd
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -14,6 +14,7 @@
 #include "app/cmd/with_image.h"
 #include "app/cmd_sequence.h"
 #include "doc/image_ref.h"
+#include "doc/shared_image_copies.h"
 #include "gfx/rect.h"
 
 #include <memory>
@@ -32,7 +33,7 @@ protected:
   void onRedo() override;
   size_t onMemSize() const override
   {
-    return sizeof(*this) + m_seq.memSize() + (m_copy ? m_copy->getMemSize() : 0);
+    return sizeof(*this) + m_seq.memSize() + get_shared_image_copy_mem_size(m_copy);
   }
 
 private:
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -70,6 +70,24 @@ void CopyRegion::onRedo()
   swap();
 }
 
+void CopyRegion::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  if (m_buffer.empty())
+    return;
+
+  m_spilledBuffer.spill(file, m_buffer.data(), m_buffer.size());
+  base::buffer().swap(m_buffer);
+}
+
+void CopyRegion::onUnspill()
+{
+  if (!m_spilledBuffer.isSpilled())
+    return;
+
+  const std::string data = m_spilledBuffer.unspill();
+  m_buffer.assign(data.begin(), data.end());
+}
+
 void CopyRegion::swap()
 {
   Image* image = this->image();
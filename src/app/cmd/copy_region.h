@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -11,6 +11,7 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_image.h"
+#include "app/doc_undo_spill_file.h"
 #include "base/buffer.h"
 #include "doc/tile.h"
 #include "gfx/point.h"
@@ -41,6 +42,8 @@ protected:
   void onUndo() override;
   void onRedo() override;
   size_t onMemSize() const override { return sizeof(*this) + m_buffer.size(); }
+  void onSpill(const std::shared_ptr<DocUndoSpillFile>& file) override;
+  void onUnspill() override;
 
 private:
   void swap();
@@ -49,6 +52,7 @@ private:
   bool m_alreadyCopied;
   gfx::Region m_region;
   base::buffer m_buffer;
+  SpilledData m_spilledBuffer;
 };
 
 class CopyTileRegion : public CopyRegion {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -20,6 +20,8 @@
 #include "doc/subobjects_io.h"
 #include "doc/tilesets.h"
 
+#include <sstream>
+
 namespace app { namespace cmd {
 
 using namespace doc;
@@ -36,10 +38,11 @@ void ReplaceImage::onExecute()
 {
   // Save old image in m_copy. We cannot keep an ImageRef to this
   // image, because there are other undo branches that could try to
-  // modify/re-add this same image ID
+  // modify/re-add this same image ID. The copy is a sparse image
+  // (empty tiles of huge images don't use memory).
   ImageRef oldImage = sprite()->getImageRef(m_oldImageId);
   ASSERT(oldImage);
-  m_copy.reset(Image::createCopy(oldImage.get()));
+  m_copy = std::make_unique<TiledImage>(oldImage.get());
 
   replaceImage(m_oldImageId, m_newImage);
   m_newImage.reset();
@@ -50,10 +53,11 @@ void ReplaceImage::onUndo()
   ImageRef newImage = sprite()->getImageRef(m_newImageId);
   ASSERT(newImage);
   ASSERT(!sprite()->getImageRef(m_oldImageId));
-  m_copy->setId(m_oldImageId);
+  ImageRef image(m_copy->createImage());
+  image->setId(m_oldImageId);
 
-  replaceImage(m_newImageId, m_copy);
-  m_copy.reset(Image::createCopy(newImage.get()));
+  replaceImage(m_newImageId, image);
+  m_copy = std::make_unique<TiledImage>(newImage.get());
 }
 
 void ReplaceImage::onRedo()
@@ -61,10 +65,38 @@ void ReplaceImage::onRedo()
   ImageRef oldImage = sprite()->getImageRef(m_oldImageId);
   ASSERT(oldImage);
   ASSERT(!sprite()->getImageRef(m_newImageId));
-  m_copy->setId(m_newImageId);
+  ImageRef image(m_copy->createImage());
+  image->setId(m_newImageId);
+
+  replaceImage(m_oldImageId, image);
+  m_copy = std::make_unique<TiledImage>(oldImage.get());
+}
+
+void ReplaceImage::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  if (!m_copy || !m_copy->hasTilesData())
+    return;
+
+  std::ostringstream os;
+  m_copy->unloadTilesData(os);
+  const std::string data = os.str();
+  try {
+    m_spilledCopy.spill(file, data.data(), data.size());
+  }
+  catch (...) {
+    std::istringstream is(data);
+    m_copy->loadTilesData(is);
+    throw;
+  }
+}
+
+void ReplaceImage::onUnspill()
+{
+  if (!m_spilledCopy.isSpilled())
+    return;
 
-  replaceImage(m_oldImageId, m_copy);
-  m_copy.reset(Image::createCopy(oldImage.get()));
+  std::istringstream is(m_spilledCopy.unspill());
+  m_copy->loadTilesData(is);
 }
 
 void ReplaceImage::replaceImage(ObjectId oldId, const ImageRef& newImage)
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -10,9 +11,11 @@
 
 #include "app/cmd.h"
 #include "app/cmd/with_sprite.h"
+#include "app/doc_undo_spill_file.h"
 #include "doc/image_ref.h"
+#include "doc/tiled_image.h"
 
-#include <sstream>
+#include <memory>
 
 namespace app { namespace cmd {
 using namespace doc;
@@ -27,6 +30,8 @@ protected:
   void onUndo() override;
   void onRedo() override;
   size_t onMemSize() const override { return sizeof(*this) + (m_copy ? m_copy->getMemSize() : 0); }
+  void onSpill(const std::shared_ptr<DocUndoSpillFile>& file) override;
+  void onUnspill() override;
 
 private:
   void replaceImage(ObjectId oldId, const ImageRef& newImage);
@@ -38,7 +43,8 @@ private:
   // ReplaceImage() ctor until the ReplaceImage::onExecute() call.
   // Then the reference is not used anymore.
   ImageRef m_newImage;
-  ImageRef m_copy;
+  std::unique_ptr<TiledImage> m_copy;
+  SpilledData m_spilledCopy;
 };
 
 }} // namespace app::cmd
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2023  Igara Studio S.A.
+// Copyright (C) 2023-2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -80,6 +80,21 @@ size_t CmdSequence::onMemSize() const
   return size;
 }
 
+void CmdSequence::onSpill(const std::shared_ptr<DocUndoSpillFile>& file)
+{
+  for (Cmd* cmd : m_cmds)
+    cmd->spill(file);
+}
+
+void CmdSequence::onUnspill()
+{
+  // Load the data of all commands before undoing/redoing the first
+  // one, so we don't leave the sequence half-undone if some data
+  // cannot be loaded
+  for (Cmd* cmd : m_cmds)
+    cmd->unspill();
+}
+
 void CmdSequence::executeAndAdd(Cmd* cmd)
 {
   addAndExecute(context(), cmd);
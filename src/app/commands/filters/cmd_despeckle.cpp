@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -83,7 +83,7 @@ private:
     // If we had a previous filter preview running in the background,
     // we explicitly request it be stopped. Otherwise, changing the
     // size of the filter would cause a race condition on
-    // MedianFilter::m_channel field.
+    // MedianFilter histograms.
     stopPreview();
 
     m_filter.setSize(newSize.w, newSize.h);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -34,6 +34,8 @@
 
 #include "outline.xml.h"
 
+#include <algorithm>
+
 namespace app {
 
 using namespace app::skin;
@@ -45,6 +47,7 @@ struct OutlineParams : public NewParams {
   Param<filters::Target> channels{ this, 0, "channels" };
   Param<filters::OutlineFilter::Place> place{ this, OutlineFilter::Place::Outside, "place" };
   Param<filters::OutlineFilter::Matrix> matrix{ this, OutlineFilter::Matrix::Circle, "matrix" };
+  Param<int> thickness{ this, 1, "thickness" };
   Param<app::Color> color{ this, app::Color(), "color" };
   Param<app::Color> bgColor{ this, app::Color(), "bgColor" };
   Param<filters::TiledMode> tiledMode{ this, filters::TiledMode::NONE, "tiledMode" };
@@ -240,6 +243,8 @@ void OutlineCommand::onExecute(Context* context)
     filter.place(params().place());
   if (params().matrix.isSet())
     filter.matrix(params().matrix());
+  if (params().thickness.isSet())
+    filter.thickness(std::max(1, params().thickness()));
   if (params().color.isSet())
     filter.color(params().color());
   if (params().bgColor.isSet())
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -35,14 +35,20 @@
 #include "doc/image.h"
 #include "doc/layer.h"
 #include "doc/mask.h"
+#include "doc/parallel.h"
 #include "doc/sprite.h"
 #include "filters/filter.h"
 #include "ui/manager.h"
 #include "ui/view.h"
 #include "ui/widget.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <exception>
 #include <set>
 
 namespace app {
@@ -50,6 +56,131 @@ namespace app {
 using namespace std;
 using namespace ui;
 
+namespace {
+
+// Minimum number of rows to split an image in bands
+const int kMinBandHeight = 64;
+
+// The source image of a cel is a copy of the cel image cropped to the
+// sprite bounds (see crop_cel_image()), so the key is the cel image
+// and the cropped area. Tilemaps are rendered in a new image each
+// time, so they are identified by the rendered image.
+filters::SourceImageKey source_image_key(const Cel* cel, const Image* src)
+{
+  const Image* image = cel->image();
+  if (cel->layer()->isTilemap() || !image)
+    return { src->id(), src->version(), src->bounds() };
+
+  return { image->id(),
+           image->version(),
+           gfx::Rect(cel->sprite()->bounds()).offset(-cel->position()) };
+}
+
+} // anonymous namespace
+
+// FilterManager used to apply the filter to a band of rows of one cel
+// from a thread of the pool. Each band has its own row and mask
+// iterator, the rest of the information comes from the
+// FilterManagerImpl (which is not modified while the threads run).
+class FilterManagerImpl::RowsFilterManager : public FilterManager {
+public:
+  RowsFilterManager(FilterManagerImpl* parent,
+                    const Image* src,
+                    const filters::SourceImageKey& srcKey,
+                    Image* dst,
+                    const Target target,
+                    base::task_token& token)
+    : m_parent(parent)
+    , m_pixelFormat(parent->pixelFormat())
+    , m_bounds(parent->m_bounds)
+    , m_mask(parent->m_mask)
+    , m_src(src)
+    , m_srcKey(srcKey)
+    , m_dst(dst)
+    , m_target(target)
+    , m_token(token)
+  {
+  }
+
+  // Applies the filter to rows in the [row0, row1) range, "rowsDone"
+  // is incremented for each processed row.
+  void applyToRows(const int row0, const int row1, std::atomic<int>& rowsDone)
+  {
+    m_firstRow = row0;
+    for (m_row = row0; m_row < row1 && !m_token.canceled(); ++m_row) {
+      if (m_mask && m_mask->bitmap()) {
+        int x = m_bounds.x - m_mask->bounds().x;
+        int y = m_bounds.y - m_mask->bounds().y + m_row;
+        if ((x >= m_bounds.w) || (y >= m_bounds.h))
+          break;
+
+        m_maskBits = m_mask->bitmap()->lockBits<BitmapTraits>(
+          Image::ReadLock,
+          gfx::Rect(x, y, m_bounds.w - x, m_bounds.h - y));
+
+        m_maskIterator = m_maskBits.begin();
+      }
+
+      switch (m_pixelFormat) {
+        case IMAGE_RGB:       m_parent->m_filter->applyToRgba(this); break;
+        case IMAGE_GRAYSCALE: m_parent->m_filter->applyToGrayscale(this); break;
+        case IMAGE_INDEXED:   m_parent->m_filter->applyToIndexed(this); break;
+      }
+      ++rowsDone;
+    }
+    m_maskBits.unlock();
+  }
+
+  // FilterManager implementation
+  doc::PixelFormat pixelFormat() const override { return m_pixelFormat; }
+  const void* getSourceAddress() override
+  {
+    return m_src->getPixelAddress(m_bounds.x, m_bounds.y + m_row);
+  }
+  void* getDestinationAddress() override
+  {
+    return m_dst->getPixelAddress(m_bounds.x, m_bounds.y + m_row);
+  }
+  int getWidth() override { return m_bounds.w; }
+  Target getTarget() override { return m_target; }
+  FilterIndexedData* getIndexedData() override { return m_parent; }
+  bool skipPixel() override
+  {
+    bool skip = false;
+
+    if ((m_mask) && (m_mask->bitmap())) {
+      if (!*m_maskIterator)
+        skip = true;
+
+      ++m_maskIterator;
+    }
+
+    return skip;
+  }
+  const doc::Image* getSourceImage() override { return m_src; }
+  filters::SourceImageKey getSourceImageKey() override { return m_srcKey; }
+  int x() const override { return m_bounds.x; }
+  int y() const override { return m_bounds.y + m_row; }
+  bool isFirstRow() const override { return m_row == m_firstRow; }
+  bool isMaskActive() const override { return m_parent->isMaskActive(); }
+  base::task_token& taskToken() const override { return m_token; }
+
+private:
+  FilterManagerImpl* m_parent;
+  doc::PixelFormat m_pixelFormat;
+  gfx::Rect m_bounds;
+  doc::Mask* m_mask;
+  const Image* m_src;
+  filters::SourceImageKey m_srcKey;
+  Image* m_dst;
+  Target m_target;
+  base::task_token& m_token;
+  int m_firstRow = 0;
+  int m_row = 0;
+  doc::ImageBits<doc::BitmapTraits> m_maskBits;
+  doc::ImageBits<doc::BitmapTraits>::iterator m_maskIterator;
+};
+
 FilterManagerImpl::FilterManagerImpl(Context* context, Filter* filter)
   : m_reader(context)
   , m_site(*const_cast<Site*>(m_reader.site()))
@@ -215,33 +346,7 @@ void FilterManagerImpl::apply()
   }
 
   if (!cancelled) {
-    gfx::Rect output;
-    if (algorithm::shrink_bounds2(m_src.get(), m_dst.get(), m_bounds, output)) {
-      if (m_cel->layer()->isTilemap()) {
-        modify_tilemap_cel_region(*m_tx,
-                                  m_cel,
-                                  nullptr,
-                                  gfx::Region(output),
-                                  m_site.tilesetMode(),
-                                  [this](const doc::ImageRef& origTile,
-                                         const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
-                                    return ImageRef(crop_image(m_dst.get(),
-                                                               tileBoundsInCanvas.x,
-                                                               tileBoundsInCanvas.y,
-                                                               tileBoundsInCanvas.w,
-                                                               tileBoundsInCanvas.h,
-                                                               m_dst->maskColor()));
-                                  });
-      }
-      else if (m_cel->layer()->isBackground()) {
-        (*m_tx)(new cmd::CopyRegion(m_cel->image(), m_dst.get(), gfx::Region(output), position()));
-      }
-      else {
-        // Patch "m_cel"
-        (*m_tx)(new cmd::PatchCel(m_cel, m_dst.get(), gfx::Region(output), position()));
-      }
-    }
-
+    patchCel(m_cel, m_src.get(), m_dst.get());
     result = CommandResult(CommandResult::kOk);
   }
   else {
@@ -252,6 +357,36 @@ void FilterManagerImpl::apply()
   m_reader.context()->setCommandResult(result);
 }
 
+void FilterManagerImpl::patchCel(Cel* cel, const Image* src, const Image* dst)
+{
+  gfx::Rect output;
+  if (algorithm::shrink_bounds2(src, dst, m_bounds, output)) {
+    if (cel->layer()->isTilemap()) {
+      modify_tilemap_cel_region(*m_tx,
+                                cel,
+                                nullptr,
+                                gfx::Region(output),
+                                m_site.tilesetMode(),
+                                [dst](const doc::ImageRef& origTile,
+                                      const gfx::Rect& tileBoundsInCanvas) -> doc::ImageRef {
+                                  return ImageRef(crop_image(dst,
+                                                             tileBoundsInCanvas.x,
+                                                             tileBoundsInCanvas.y,
+                                                             tileBoundsInCanvas.w,
+                                                             tileBoundsInCanvas.h,
+                                                             dst->maskColor()));
+                                });
+    }
+    else if (cel->layer()->isBackground()) {
+      (*m_tx)(new cmd::CopyRegion(cel->image(), dst, gfx::Region(output), position()));
+    }
+    else {
+      // Patch "cel"
+      (*m_tx)(new cmd::PatchCel(cel, dst, gfx::Region(output), position()));
+    }
+  }
+}
+
 void FilterManagerImpl::applyToTarget()
 {
   applyToPaletteIfNeeded();
@@ -301,28 +436,184 @@ void FilterManagerImpl::applyToTarget()
     (*m_tx)(new cmd::SetPalette(m_site.sprite(), m_site.frame(), &newPalette));
   }
 
-  // For each target image
-  for (auto it = cels.begin(); it != cels.end() && !cancelled; ++it) {
-    Image* image = (*it)->image();
-
+  if (canApplyInParallel()) {
     // Avoid applying the filter two times to the same image
-    if (visited.find(image->id()) == visited.end()) {
-      visited.insert(image->id());
-      applyToCel(*it);
+    CelList uniqueCels;
+    for (Cel* cel : cels) {
+      if (visited.insert(cel->image()->id()).second)
+        uniqueCels.push_back(cel);
     }
 
-    // Is there a delegate to know if the process was cancelled by the user?
-    if (m_progressDelegate)
-      cancelled = m_progressDelegate->isCancelled();
+    if (!uniqueCels.empty()) {
+      cancelled = !applyToCelsInParallel(uniqueCels);
+      m_reader.context()->setCommandResult(
+        CommandResult(cancelled ? CommandResult::kCanceled : CommandResult::kOk));
+    }
+  }
+  else {
+    // For each target image
+    for (auto it = cels.begin(); it != cels.end() && !cancelled; ++it) {
+      Image* image = (*it)->image();
+
+      // Avoid applying the filter two times to the same image
+      if (visited.find(image->id()) == visited.end()) {
+        visited.insert(image->id());
+        applyToCel(*it);
+      }
+
+      // Is there a delegate to know if the process was cancelled by the user?
+      if (m_progressDelegate)
+        cancelled = m_progressDelegate->isCancelled();
 
-    // Make progress
-    m_progressBase += m_progressWidth;
+      // Make progress
+      m_progressBase += m_progressWidth;
+    }
   }
 
   // Reset m_oldPalette to avoid restoring the color palette
   m_oldPalette.reset(nullptr);
 }
 
+bool FilterManagerImpl::canApplyInParallel() const
+{
+  // Indexed images use the RgbMap, which is not thread-safe (it
+  // generates its entries lazily when we map colors).
+  return (m_filter->isThreadSafe() && doc::parallel_threads() > 1 &&
+          m_site.sprite()->pixelFormat() != IMAGE_INDEXED);
+}
+
+bool FilterManagerImpl::applyToCelsInParallel(const CelList& cels)
+{
+  struct CelJob {
+    Cel* cel;
+    ImageRef src;
+    filters::SourceImageKey srcKey;
+    ImageRef dst;
+    std::vector<doc::ParallelJobs::JobPtr> bands;
+  };
+
+  Doc* doc = m_site.document();
+  if (!updateBounds(doc->isMaskVisible() ? doc->mask() : nullptr))
+    throw InvalidAreaException();
+
+  // The palette was already modified in applyToTarget(), so we don't
+  // call applyToPaletteIfNeeded() for each cel.
+  begin();
+
+  const int threads = doc::parallel_threads();
+  const int bands = std::clamp(m_bounds.h / kMinBandHeight, 1, threads);
+  const int bandHeight = (m_bounds.h + bands - 1) / bands;
+  const int totalRows = int(cels.size()) * m_bounds.h;
+  const std::size_t maxCelsInMemory = 2 * threads;
+
+  base::task_token token;
+  std::atomic<int> rowsDone(0);
+  std::deque<std::unique_ptr<CelJob>> jobs;
+  auto nextCel = cels.begin();
+  bool cancelled = false;
+  std::exception_ptr error;
+
+  // Waits the bands of the given cel (or returns false if they are
+  // still running after some milliseconds)
+  auto waitBands = [](doc::ParallelJobs& parallelJobs, CelJob* job) {
+    for (const auto& band : job->bands) {
+      if (!parallelJobs.waitFor(band, std::chrono::milliseconds(100)))
+        return false;
+    }
+    return true;
+  };
+
+  {
+    // Destroyed before "jobs" to wait all the threads (they could be
+    // still running if the process was cancelled)
+    doc::ParallelJobs parallelJobs;
+
+    try {
+      while (!jobs.empty() || (nextCel != cels.end() && !cancelled && !error)) {
+        // Start to apply the filter to the next cels (limiting the
+        // number of images in memory)
+        while (nextCel != cels.end() && jobs.size() < maxCelsInMemory && !cancelled && !error) {
+          auto job = std::make_unique<CelJob>();
+          job->cel = *nextCel++;
+          job->src = crop_cel_image(job->cel, 0);
+          job->srcKey = source_image_key(job->cel, job->src.get());
+          job->dst.reset(Image::createCopy(job->src.get()));
+
+          // The alpha channel of the background layer can't be modified
+          Target target = m_targetOrig;
+          if (job->cel->layer()->isBackground())
+            target &= ~TARGET_ALPHA_CHANNEL;
+
+          CelJob* jobPtr = job.get();
+          jobs.push_back(std::move(job));
+
+          for (int row0 = 0; row0 < m_bounds.h; row0 += bandHeight) {
+            const int row1 = std::min(row0 + bandHeight, m_bounds.h);
+            jobPtr->bands.push_back(
+              parallelJobs.start([this, jobPtr, target, row0, row1, &token, &rowsDone] {
+                RowsFilterManager rowsMgr(this,
+                                          jobPtr->src.get(),
+                                          jobPtr->srcKey,
+                                          jobPtr->dst.get(),
+                                          target,
+                                          token);
+                rowsMgr.applyToRows(row0, row1, rowsDone);
+              }));
+          }
+        }
+
+        // Wait the first cel (to keep the order of the undo commands)
+        // while we report the progress to the delegate
+        CelJob* job = jobs.front().get();
+        bool done;
+        try {
+          done = waitBands(parallelJobs, job);
+        }
+        catch (...) {
+          if (!error) {
+            error = std::current_exception();
+            token.cancel();
+          }
+          // Wait the rest of bands of this cel before deleting it
+          for (const auto& band : job->bands) {
+            try {
+              parallelJobs.wait(band);
+            }
+            catch (...) {
+            }
+          }
+          done = true;
+        }
+
+        if (m_progressDelegate) {
+          m_progressDelegate->reportProgress(float(rowsDone) / float(totalRows));
+
+          if (!cancelled && m_progressDelegate->isCancelled()) {
+            cancelled = true;
+            token.cancel();
+          }
+        }
+
+        if (done) {
+          if (!cancelled && !error)
+            patchCel(job->cel, job->src.get(), job->dst.get());
+          jobs.pop_front();
+        }
+      }
+    }
+    catch (...) {
+      error = std::current_exception();
+      token.cancel();
+    }
+  }
+  end();
+
+  if (error)
+    std::rethrow_exception(error);
+
+  return !cancelled;
+}
+
 void FilterManagerImpl::initTransaction()
 {
   ASSERT(!m_tx);
@@ -449,6 +740,7 @@ void FilterManagerImpl::init(Cel* cel)
 
   m_cel = cel;
   m_src = crop_cel_image(cel, 0);
+  m_srcKey = source_image_key(cel, m_src.get());
   m_dst.reset(Image::createCopy(m_src.get()));
 
   m_row = -1;
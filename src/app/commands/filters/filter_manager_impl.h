@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -117,6 +117,7 @@ public:
   FilterIndexedData* getIndexedData() override { return this; }
   bool skipPixel() override;
   const doc::Image* getSourceImage() override { return m_src.get(); }
+  filters::SourceImageKey getSourceImageKey() override { return m_srcKey; }
   int x() const override { return m_bounds.x; }
   int y() const override { return m_bounds.y + m_row; }
   bool isFirstRow() const override { return m_row == 0; }
@@ -130,11 +131,26 @@ public:
   doc::PalettePicks getPalettePicks() override;
 
 private:
+  class RowsFilterManager;
+
   void init(doc::Cel* cel);
   void apply();
   void applyToCel(doc::Cel* cel);
   bool updateBounds(doc::Mask* mask);
 
+  // Returns true if we can apply the filter to several cels/rows at
+  // the same time in a pool of threads.
+  bool canApplyInParallel() const;
+
+  // Applies the filter to the given cels using the threads of a pool
+  // (several cels at the same time, and bands of rows of each cel).
+  // Returns false if the process was cancelled.
+  bool applyToCelsInParallel(const std::vector<doc::Cel*>& cels);
+
+  // Adds the commands to modify the given cel with the "dst" image
+  // (the result of the filter over "src").
+  void patchCel(doc::Cel* cel, const doc::Image* src, const doc::Image* dst);
+
   // Returns true if the palette was changed (true when the filter
   // modifies the palette).
   bool paletteHasChanged();
@@ -149,6 +165,7 @@ private:
   Filter* m_filter;
   doc::Cel* m_cel;
   doc::ImageRef m_src;
+  filters::SourceImageKey m_srcKey;
   doc::ImageRef m_dst;
   int m_row;
   int m_nextRowToFlush;
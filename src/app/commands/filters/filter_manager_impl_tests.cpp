@@ -0,0 +1,192 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/commands/filters/cels_target.h"
+#include "app/commands/filters/filter_manager_impl.h"
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/test_context.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "filters/invert_color_filter.h"
+#include "filters/outline_filter.h"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+using namespace filters;
+
+namespace {
+
+// Same filters but applied with the serial implementation
+class SerialInvertColorFilter : public InvertColorFilter {
+public:
+  bool isThreadSafe() const { return false; }
+};
+
+class SerialOutlineFilter : public OutlineFilter {
+public:
+  bool isThreadSafe() const { return false; }
+};
+
+class FilterManagerImplTest : public ::testing::Test {
+public:
+  // Sprite with a background and a transparent layer, several
+  // frames (taller than one band of rows), and a linked cel.
+  FilterManagerImplTest() : doc(ctx.documents().add(97, 150)), sprite(doc->sprite())
+  {
+    std::mt19937 rng(1);
+    auto randomImage = [this, &rng](const bool opaque) {
+      ImageRef image(Image::create(sprite->spec()));
+      for (int y = 0; y < image->height(); ++y)
+        for (int x = 0; x < image->width(); ++x)
+          put_pixel(image.get(),
+                    x,
+                    y,
+                    !opaque && (rng() % 4) == 0 ?
+                      0 :
+                      rgba(rng() % 256, rng() % 256, rng() % 256, 255));
+      return image;
+    };
+
+    sprite->setTotalFrames(5);
+
+    auto bg = static_cast<LayerImage*>(sprite->root()->firstLayer());
+    bg->setBackground(true);
+    copy_image(bg->cel(0)->image(), randomImage(true).get());
+    for (frame_t frame = 1; frame < sprite->totalFrames(); ++frame)
+      bg->addCel(new Cel(frame, randomImage(true)));
+
+    auto layer = new LayerImage(sprite);
+    sprite->root()->addLayer(layer);
+    for (frame_t frame = 0; frame < sprite->totalFrames(); ++frame) {
+      if (frame == 3)
+        layer->addCel(new Cel(frame, layer->cel(1)->dataRef()));
+      else
+        layer->addCel(new Cel(frame, randomImage(false)));
+    }
+
+    for (Cel* cel : sprite->uniqueCels())
+      originalImages.emplace_back(Image::createCopy(cel->image()));
+  }
+
+  ~FilterManagerImplTest() { doc->close(); }
+
+  // Applies the filter to all cels as the FilterWorker does.
+  void applyFilter(Filter* filter)
+  {
+    FilterManagerImpl filterMgr(&ctx, filter);
+    filterMgr.setTarget(TARGET_ALL_CHANNELS);
+    filterMgr.setCelsTarget(CelsTarget::All);
+    filterMgr.initTransaction();
+    filterMgr.applyToTarget();
+    filterMgr.commitTransaction();
+  }
+
+  std::vector<ImageRef> copyImages() const
+  {
+    std::vector<ImageRef> images;
+    for (Cel* cel : sprite->uniqueCels())
+      images.emplace_back(Image::createCopy(cel->image()));
+    return images;
+  }
+
+  void expectImages(const std::vector<ImageRef>& images) const
+  {
+    auto it = images.begin();
+    for (Cel* cel : sprite->uniqueCels()) {
+      ASSERT_TRUE(it != images.end());
+      EXPECT_EQ(0, count_diff_between_images(it->get(), cel->image()))
+        << "Layer " << cel->layer()->name() << " frame " << cel->frame();
+      ++it;
+    }
+    EXPECT_TRUE(it == images.end());
+  }
+
+  // Applies the serial filter, then it undoes it and applies the
+  // parallel filter. Both must give the same pixels and undo
+  // information.
+  void testSerialAndParallel(Filter* serialFilter, Filter* parallelFilter)
+  {
+    DocUndo* undo = doc->undoHistory();
+
+    applyFilter(serialFilter);
+    const std::vector<ImageRef> serialImages = copyImages();
+    const std::string serialLabel = undo->nextUndoLabel();
+    const size_t serialUndoSize = undo->totalUndoSize();
+
+    undo->undo();
+    expectImages(originalImages);
+
+    applyFilter(parallelFilter);
+    expectImages(serialImages);
+    EXPECT_EQ(serialLabel, undo->nextUndoLabel());
+    EXPECT_EQ(serialUndoSize, undo->totalUndoSize());
+    EXPECT_FALSE(undo->canRedo());
+
+    undo->undo();
+    expectImages(originalImages);
+    undo->redo();
+    expectImages(serialImages);
+    undo->undo();
+  }
+
+  TestContextT<Context> ctx;
+  std::unique_ptr<Doc> doc;
+  Sprite* sprite;
+  std::vector<ImageRef> originalImages;
+};
+
+void setup_outline(OutlineFilter& filter)
+{
+  filter.place(OutlineFilter::Place::Outside);
+  filter.matrix(OutlineFilter::Matrix::Circle);
+  filter.color(rgba(255, 0, 0, 255));
+  filter.bgColor(0);
+  filter.thickness(3);
+}
+
+} // anonymous namespace
+
+TEST_F(FilterManagerImplTest, InvertColorParallelEqualsSerial)
+{
+  SerialInvertColorFilter serialFilter;
+  InvertColorFilter parallelFilter;
+  testSerialAndParallel(&serialFilter, &parallelFilter);
+}
+
+TEST_F(FilterManagerImplTest, OutlineParallelEqualsSerial)
+{
+  SerialOutlineFilter serialFilter;
+  OutlineFilter parallelFilter;
+  setup_outline(serialFilter);
+  setup_outline(parallelFilter);
+  testSerialAndParallel(&serialFilter, &parallelFilter);
+}
+
+TEST_F(FilterManagerImplTest, ParallelWithMask)
+{
+  Mask mask;
+  mask.add(gfx::Rect(5, 10, 60, 100));
+  mask.add(gfx::Rect(40, 70, 50, 70));
+  doc->setMask(&mask);
+
+  SerialOutlineFilter serialFilter;
+  OutlineFilter parallelFilter;
+  setup_outline(serialFilter);
+  setup_outline(parallelFilter);
+  testSerialAndParallel(&serialFilter, &parallelFilter);
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -70,6 +70,10 @@ private:
 // Applies filters in two threads: a background worker thread to
 // modify the sprite, and the main thread to monitoring the progress
 // (and given to the user the possibility to cancel the process).
+//
+// If the filter is thread-safe, the background thread distributes
+// the cels (and bands of rows of each cel) between the threads of a
+// pool (see FilterManagerImpl::applyToCelsInParallel()).
 
 class FilterWorker : public FilterManagerImpl::IProgressDelegate {
 public:
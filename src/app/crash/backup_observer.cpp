@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -30,6 +30,7 @@
 #include "base/chrono.h"
 #include "base/remove_from_container.h"
 #include "base/thread.h"
+#include "doc/cancel_io.h"
 #include "ui/app_state.h"
 #include "ui/system.h"
 
@@ -55,6 +56,25 @@ public:
   }
 };
 
+// Stops writing the backup of a document when the application is
+// closed or when the document is removed.
+class CancelDocBackup : public doc::CancelIO {
+public:
+  CancelDocBackup(const std::atomic<bool>& done, const std::atomic<Doc*>& removingDoc, Doc* doc)
+    : m_done(done)
+    , m_removingDoc(removingDoc)
+    , m_doc(doc)
+  {
+  }
+
+  bool isCanceled() override { return (m_done || m_removingDoc == m_doc); }
+
+private:
+  const std::atomic<bool>& m_done;
+  const std::atomic<Doc*>& m_removingDoc;
+  Doc* m_doc;
+};
+
 } // namespace
 
 BackupObserver::BackupObserver(RecoveryConfig* config, Session* session, Context* ctx)
@@ -93,7 +113,11 @@ void BackupObserver::onRemoveDocument(Doc* doc)
 {
   RECO_TRACE("RECO: Remove document %p\n", doc);
   {
+    // Stop the backup of this document if it's being written in the
+    // backgroundThread() (which keeps m_mutex locked)
+    m_removingDoc = doc;
     std::unique_lock<std::mutex> lock(m_mutex);
+    m_removingDoc = nullptr;
     base::remove_from_container(m_documents, doc);
   }
   if (doc->needsBackup() &&
@@ -186,10 +210,11 @@ bool BackupObserver::saveDocData(Doc* doc)
     if (!doc->needsBackup())
       return true;
 
+    CancelDocBackup cancel(m_done, m_removingDoc, doc);
     if (doc->inhibitBackup()) {
       RECO_TRACE("RECO: Document '%d' backup is temporarily inhibited\n", doc->id());
     }
-    else if (!m_session->saveDocumentChanges(doc)) {
+    else if (!m_session->saveDocumentChanges(doc, &cancel)) {
       RECO_TRACE("RECO: Document '%d' backup was canceled by UI\n", doc->id());
     }
     else {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2020  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -49,6 +49,10 @@ private:
   std::vector<Doc*> m_closedDocs;
   std::atomic<bool> m_done;
 
+  // Document that is being removed from the context, to cancel its
+  // backup (if it's being saved) before we lock m_mutex.
+  std::atomic<Doc*> m_removingDoc = nullptr;
+
   std::mutex m_mutex;
 
   // Used to wakeup the backgroundThread() when we have to stop the
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -39,6 +39,10 @@ DataRecovery::DataRecovery(Context* ctx)
 {
   auto& pref = Preferences::instance();
   m_config.dataRecoveryPeriod = pref.general.dataRecoveryPeriod();
+  m_config.incrementalBackups = pref.general.dataRecoveryIncremental();
+  m_config.deltaLogCompactionRatio = pref.general.dataRecoveryCompactionRatio();
+  m_config.maxBytesPerCycle = 1024 * 1024 * pref.general.dataRecoveryMaxMbPerCycle();
+  m_config.maxMSecsPerCycle = pref.general.dataRecoveryMaxMsecsPerCycle();
   if (pref.general.keepEditedSpriteData())
     m_config.keepEditedSpriteDataFor = pref.general.keepEditedSpriteDataFor();
   else
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2024  Igara Studio S.A.
+// Copyright (C) 2024-2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -14,10 +14,23 @@
 #include <algorithm>
 #include <functional>
 #include <map>
+#include <string>
 
 namespace app { namespace crash {
 
-const uint32_t MAGIC_NUMBER = 0x454E4946; // 'FINE' in ASCII
+const uint32_t MAGIC_NUMBER = 0x454E4946;       // 'FINE' in ASCII
+const uint32_t DELTA_MAGIC_NUMBER = 0x41544C44; // 'DLTA' in ASCII
+
+// Size of the tiles saved in the log of deltas of each image
+const int DELTA_TILE_SIZE = 64;
+
+// Filename of the log of deltas (modified tiles) saved after the
+// "img-ID.VER" file. It doesn't contain a '.' so it's not
+// confused with an object version.
+inline std::string delta_log_filename(doc::ObjectId id, doc::ObjectVersion ver)
+{
+  return "imgdelta-" + std::to_string(id) + "-" + std::to_string(ver);
+}
 
 class ObjVersions {
 public:
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -31,6 +31,7 @@
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/palette_io.h"
+#include "doc/primitives.h"
 #include "doc/serial_format.h"
 #include "doc/slice.h"
 #include "doc/slice_io.h"
@@ -48,6 +49,8 @@
 
 #include <fstream>
 #include <map>
+#include <utility>
+#include <vector>
 
 namespace app { namespace crash {
 
@@ -65,6 +68,47 @@ bool check_magic_number(const std::string& fn)
   return (read32(s) == MAGIC_NUMBER);
 }
 
+// Applies the modified tiles saved in the log of deltas of the
+// given image version (only cycles that were completely saved).
+void apply_image_deltas(const std::string& dir,
+                        Image* img,
+                        const ObjectId id,
+                        const ObjectVersion ver)
+{
+  const std::string fn = base::join_path(dir, delta_log_filename(id, ver));
+  if (!base::is_file(fn))
+    return;
+
+  std::ifstream s(FSTREAM_PATH(fn), std::ifstream::binary);
+  try {
+    while (s && read32(s) == DELTA_MAGIC_NUMBER) {
+      read32(s); // Image version
+      const uint32_t ntiles = read32(s);
+
+      std::vector<std::pair<gfx::Point, ImageRef>> tiles;
+      for (uint32_t i = 0; i < ntiles && s; ++i) {
+        const int x = read16(s);
+        const int y = read16(s);
+        ImageRef tile(read_image(s, false));
+        if (!tile)
+          break;
+        tiles.push_back(std::make_pair(gfx::Point(x, y), tile));
+      }
+
+      if (!s || tiles.size() != ntiles || read32(s) != MAGIC_NUMBER)
+        break;
+
+      for (const auto& tile : tiles)
+        copy_image(img, tile.second.get(), tile.first.x, tile.first.y);
+
+      RECO_TRACE("RECO: %d tiles restored for img #%d v%d\n", int(ntiles), id, ver);
+    }
+  }
+  catch (const std::exception& ex) {
+    RECO_TRACE("RECO: Error reading deltas of img #%d v%d: %s\n", id, ver, ex.what());
+  }
+}
+
 class Reader : public SubObjectsIO {
 public:
   Reader(const std::string& dir, base::task_token* t)
@@ -178,6 +222,8 @@ private:
 
       std::ifstream s(FSTREAM_PATH(base::join_path(m_dir, fn)), std::ifstream::binary);
       T obj = nullptr;
+      m_loadingId = id;
+      m_loadingVer = ver;
       if (read32(s) == MAGIC_NUMBER)
         obj = (this->*readMember)(s);
 
@@ -508,7 +554,13 @@ private:
 
   CelData* readCelData(std::ifstream& s) { return read_celdata(s, this, false, m_serial); }
 
-  Image* readImage(std::ifstream& s) { return read_image(s, false); }
+  Image* readImage(std::ifstream& s)
+  {
+    Image* img = read_image(s, false);
+    if (img)
+      apply_image_deltas(m_dir, img, m_loadingId, m_loadingVer);
+    return img;
+  }
 
   Palette* readPalette(std::ifstream& s) { return read_palette(s); }
 
@@ -580,6 +632,9 @@ private:
   ObjectVersion m_docId;
   ObjVersionsMap m_objVersions;
   ObjVersions* m_docVersions;
+  // Object being loaded in loadObject() (used to find its deltas)
+  ObjectId m_loadingId = 0;
+  ObjectVersion m_loadingVer = 0;
   DocumentInfo* m_loadInfo;
   std::vector<std::pair<ObjectId, ObjectId>> m_celsToLoad;
   std::map<ObjectId, ImageRef> m_images;
@@ -643,6 +698,17 @@ Doc* read_document_with_raw_images(const std::string& dir, RawImagesAs as, base:
       img.reset(read_image(s, false));
 
     if (img) {
+      // Restore the tiles saved after this version of the image
+      // (the filename is "img-ID.VER")
+      const auto i = fn.find('-');
+      const auto j = fn.find('.');
+      if (i != std::string::npos && j != std::string::npos && i < j) {
+        const ObjectId id = base::convert_to<int>(fn.substr(i + 1, j - i - 1));
+        const ObjectVersion ver = base::convert_to<int>(fn.substr(j + 1));
+        if (id && ver)
+          apply_image_deltas(dir, img.get(), id, ver);
+      }
+
       lay->addCel(new Cel(frame, img));
     }
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -15,6 +15,20 @@ namespace app { namespace crash {
 struct RecoveryConfig {
   double dataRecoveryPeriod;
   int keepEditedSpriteDataFor;
+
+  // Save only the modified tiles of images (in a log of deltas for
+  // each image) instead of the whole modified image.
+  bool incrementalBackups = true;
+
+  // The whole image is saved again (and its log of deltas discarded)
+  // when the log is bigger than this ratio of the image file size.
+  double deltaLogCompactionRatio = 1.0;
+
+  // Maximum number of bytes/milliseconds used to save a document in
+  // each backup cycle (0 = no limit). The rest of the document is
+  // saved in the next cycle.
+  int maxBytesPerCycle = 0;
+  int maxMSecsPerCycle = 0;
 };
 
 }} // namespace app::crash
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2024  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -240,15 +240,30 @@ void Session::removeFromDisk()
 class CustomWeakDocReader : public WeakDocReader,
                             public doc::CancelIO {
 public:
-  explicit CustomWeakDocReader(Doc* doc) : WeakDocReader(doc) {}
+  CustomWeakDocReader(Doc* doc, doc::CancelIO* cancel) : WeakDocReader(doc), m_cancel(cancel) {}
+
+  void unlock()
+  {
+    weakUnlock();
+    m_unlocked = true;
+  }
 
   // CancelIO impl
-  bool isCanceled() override { return !isLocked(); }
+  bool isCanceled() override
+  {
+    // While the document is locked, other thread can cancel the
+    // backup locking the document (e.g. to modify it).
+    return ((!m_unlocked && !isLocked()) || (m_cancel && m_cancel->isCanceled()));
+  }
+
+private:
+  doc::CancelIO* m_cancel;
+  bool m_unlocked = false;
 };
 
-bool Session::saveDocumentChanges(Doc* doc)
+bool Session::saveDocumentChanges(Doc* doc, doc::CancelIO* cancel)
 {
-  CustomWeakDocReader reader(doc);
+  CustomWeakDocReader reader(doc, cancel);
   if (!reader.isLocked())
     return false;
 
@@ -270,8 +285,9 @@ bool Session::saveDocumentChanges(Doc* doc)
     }
   }
 
-  // Save document information
-  return write_document(dir, doc, &reader);
+  // Save document information (the document is unlocked before
+  // writing images, so the user can keep editing it)
+  return write_document(dir, doc, &reader, m_config, [&reader] { reader.unlock(); });
 }
 
 void Session::removeDocument(Doc* doc)
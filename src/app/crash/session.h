@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -20,6 +20,10 @@
 #include <string>
 #include <vector>
 
+namespace doc {
+class CancelIO;
+}
+
 namespace app {
 class Doc;
 namespace crash {
@@ -58,7 +62,9 @@ public:
   void close();
   void removeFromDisk();
 
-  bool saveDocumentChanges(Doc* doc);
+  // Saves the modified objects of the document. The "cancel" object
+  // can be used to stop it (e.g. when the application is closed).
+  bool saveDocumentChanges(Doc* doc, doc::CancelIO* cancel);
   void removeDocument(Doc* doc);
 
   Doc* restoreBackupDoc(const BackupPtr& backup, base::task_token* t);
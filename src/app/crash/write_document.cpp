@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,7 +13,9 @@
 
 #include "app/crash/internals.h"
 #include "app/crash/log.h"
+#include "app/crash/recovery_config.h"
 #include "app/doc.h"
+#include "base/chrono.h"
 #include "base/convert_to.h"
 #include "base/fs.h"
 #include "base/fstream_path.h"
@@ -30,6 +32,7 @@
 #include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/palette_io.h"
+#include "doc/primitives.h"
 #include "doc/serial_format.h"
 #include "doc/slice.h"
 #include "doc/slice_io.h"
@@ -43,8 +46,14 @@
 #include "doc/user_data_io.h"
 #include "fixmath/fixmath.h"
 
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
 
 namespace app { namespace crash {
 
@@ -54,21 +63,85 @@ using namespace doc;
 
 namespace {
 
-static std::map<ObjectId, ObjVersionsMap> g_docVersions;
-static std::map<ObjectId, base::paths> g_deleteFiles;
+// Information about the last full version of an image saved in the
+// backup and the modified tiles saved after it in its log of deltas.
+struct ImageDeltaLog {
+  ObjectVersion baseVersion = 0;  // Version of the "img-ID.VER" file
+  ObjectVersion savedVersion = 0; // Last version saved in the log
+  PixelFormat pixelFormat = IMAGE_RGB;
+  gfx::Size size;
+  std::vector<uint64_t> tileHashes;
+  std::streamoff baseSize = 0; // Size of the "img-ID.VER" file
+  std::streamoff logSize = 0;  // Size of the log (only complete cycles)
+};
+
+typedef std::map<ObjectId, ImageDeltaLog> ImageDeltaLogs;
+
+// Information about the objects of a document saved in its backup.
+struct DocBackup {
+  ObjVersionsMap objVersions;
+  base::paths deleteFiles;
+  ImageDeltaLogs imageDeltaLogs;
+  ObjectId resumeId = 0; // Object where the last incomplete cycle stopped
+
+  // Locked while the document backup is being written (documents are
+  // written without locking them, and the files are written without
+  // locking g_mutex).
+  std::mutex mutex;
+
+  // True when the document internals were deleted (e.g. the document
+  // was closed) to stop writing its backup.
+  std::atomic<bool> deleted = false;
+};
+
+typedef std::shared_ptr<DocBackup> DocBackupPtr;
+
+static std::map<ObjectId, DocBackupPtr> g_docBackups;
 
-class Writer {
+// Protects the map above, so documents can be closed (and their
+// internals deleted) while their backups are being written.
+static std::mutex g_mutex;
+
+DocBackupPtr get_doc_backup(const ObjectId docId)
+{
+  const std::lock_guard lock(g_mutex);
+  DocBackupPtr& docBackup = g_docBackups[docId];
+  if (!docBackup)
+    docBackup = std::make_shared<DocBackup>();
+  return docBackup;
+}
+
+class Writer : public doc::CancelIO {
 public:
-  Writer(const std::string& dir, Doc* doc, doc::CancelIO* cancel)
+  Writer(const std::string& dir,
+         Doc* doc,
+         DocBackup& docBackup,
+         doc::CancelIO* cancel,
+         const RecoveryConfig* config)
     : m_dir(dir)
     , m_doc(doc)
-    , m_objVersions(g_docVersions[doc->id()])
-    , m_deleteFiles(g_deleteFiles[doc->id()])
+    , m_docBackup(docBackup)
+    , m_objVersions(docBackup.objVersions)
+    , m_deleteFiles(docBackup.deleteFiles)
+    , m_imageDeltaLogs(docBackup.imageDeltaLogs)
     , m_cancel(cancel)
+    , m_config(config)
+    , m_writtenBytes(0)
   {
   }
 
-  bool saveDocument()
+  // CancelIO impl
+  bool isCanceled() override
+  {
+    return (m_docBackup.deleted || (m_cancel && m_cancel->isCanceled()));
+  }
+
+  // Collects the objects that must be saved (the document must be
+  // locked). Small objects are serialized in memory, and images are
+  // kept as snapshots that share their pixels with the document
+  // images, so they can be written later without locking the
+  // document.
+  bool collectObjects()
   {
     Sprite* spr = m_doc->sprite();
 
@@ -76,7 +149,7 @@ public:
     // objects (e.g. cels, layers, etc.)
 
     for (Palette* pal : spr->getPalettes())
-      if (!saveObject("pal", pal, &Writer::writePalette))
+      if (!collectObject("pal", pal, &Writer::writePalette))
         return false;
 
     if (spr->hasTilesets()) {
@@ -84,18 +157,18 @@ public:
         // The tileset can be nullptr if it was erased (as we keep
         // empty spaces in the Tilesets array)
         if (tset) {
-          if (!saveObject("tset", tset, &Writer::writeTileset))
+          if (!collectObject("tset", tset, &Writer::writeTileset))
             return false;
         }
       }
     }
 
     for (Tag* frtag : spr->tags())
-      if (!saveObject("frtag", frtag, &Writer::writeFrameTag))
+      if (!collectObject("frtag", frtag, &Writer::writeFrameTag))
         return false;
 
     for (Slice* slice : spr->slices())
-      if (!saveObject("slice", slice, &Writer::writeSlice))
+      if (!collectObject("slice", slice, &Writer::writeSlice))
         return false;
 
     // Get all layers (visible, hidden, subchildren, etc.)
@@ -110,10 +183,10 @@ public:
         if (cel->link()) // Skip link
           continue;
 
-        if (!saveObject("img", cel->image(), &Writer::writeImage))
+        if (!collectImage(cel->imageRef()))
           return false;
 
-        if (!saveObject("celdata", cel->data(), &Writer::writeCelData))
+        if (!collectObject("celdata", cel->data(), &Writer::writeCelData))
           return false;
       }
     }
@@ -124,30 +197,287 @@ public:
       lay->getCels(cels);
 
       for (Cel* cel : cels)
-        if (!saveObject("cel", cel, &Writer::writeCel))
+        if (!collectObject("cel", cel, &Writer::writeCel))
           return false;
     }
 
     // Save all layers (top level, groups, children, etc.)
     for (Layer* lay : layers)
-      if (!saveObject("lay", lay, &Writer::writeLayerStructure))
+      if (!collectObject("lay", lay, &Writer::writeLayerStructure))
         return false;
 
-    if (!saveObject("spr", spr, &Writer::writeSprite))
+    if (!collectObject("spr", spr, &Writer::writeSprite))
       return false;
 
-    if (!saveObject("doc", m_doc, &Writer::writeDocumentFile))
+    if (!collectObject("doc", m_doc, &Writer::writeDocumentFile))
       return false;
 
+    return true;
+  }
+
+  // Writes the collected objects in files (it doesn't access the
+  // document, so it can be unlocked).
+  //
+  // Objects are written in the order they were collected, so an
+  // object is never saved before the objects it uses (e.g. a cel
+  // before its image). If the previous cycle ran out of budget, the
+  // section where it stopped is started from the object that wasn't
+  // saved (wrapping around inside the same section), so all images
+  // are saved eventually even if some of them are modified between
+  // each cycle.
+  bool writeObjects()
+  {
+    const ObjectId resumeId = m_docBackup.resumeId;
+    m_docBackup.resumeId = 0;
+
+    const int n = int(m_pending.size());
+    for (int begin = 0, end = 0; begin < n; begin = end) {
+      int first = begin;
+      for (end = begin; end < n && isSameSection(m_pending[begin], m_pending[end]); ++end) {
+        if (m_pending[end].id == resumeId)
+          first = end;
+      }
+
+      for (int i = 0; i < end - begin; ++i) {
+        PendingObject& obj = m_pending[begin + (first - begin + i) % (end - begin)];
+        if (!(obj.image ? saveImage(obj) : saveObject(obj))) {
+          if (!isCanceled())
+            m_docBackup.resumeId = obj.id;
+          releaseSnapshots();
+          return false;
+        }
+
+        // Release the snapshot as soon as it's saved, so the document
+        // doesn't need to copy the pixels of the original image the
+        // next time it's modified.
+        obj.image.reset();
+      }
+    }
+
     // Delete old files after all files are correctly saved.
     deleteOldVersions();
     return true;
   }
 
 private:
-  bool isCanceled() const { return (m_cancel && m_cancel->isCanceled()); }
+  // Object collected while the document is locked.
+  struct PendingObject {
+    const char* prefix;
+    ObjectId id;
+    ObjectVersion version;
+    std::string data; // Serialized object (for all objects except images)
+    ImageRef image;   // Snapshot of the image pixels
+  };
+
+  // Releases the snapshots of images that were not saved in this
+  // cycle (they will be collected again in the next one).
+  void releaseSnapshots()
+  {
+    for (PendingObject& obj : m_pending)
+      obj.image.reset();
+  }
+
+  // Returns true if both objects are in the same section of the
+  // collected objects (images are in the same section of the cel
+  // data that uses them).
+  static bool isSameSection(const PendingObject& a, const PendingObject& b)
+  {
+    auto section = [](const char* prefix) {
+      return (std::strcmp(prefix, "img") == 0 ? "celdata" : prefix);
+    };
+    return std::strcmp(section(a.prefix), section(b.prefix)) == 0;
+  }
+
+  // Returns true if we've already used all the I/O or time available
+  // for this backup cycle (at least one object is always saved, so
+  // big objects are saved anyway).
+  bool isBudgetExceeded() const
+  {
+    if (!m_config || m_writtenBytes == 0)
+      return false;
+
+    return ((m_config->maxBytesPerCycle > 0 && m_writtenBytes >= m_config->maxBytesPerCycle) ||
+            (m_config->maxMSecsPerCycle > 0 &&
+             1000.0 * m_chrono.elapsed() >= m_config->maxMSecsPerCycle));
+  }
+
+  template<typename T>
+  bool collectObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ostream&, T*))
+  {
+    if (isCanceled())
+      return false;
+
+    if (!obj->version())
+      obj->incrementVersion();
+
+    ObjVersions& versions = m_objVersions[obj->id()];
+    if (versions.newer() == obj->version())
+      return true;
+
+    std::ostringstream s(std::ios::binary);
+    if (!(this->*writeMember)(s, obj))
+      return false;
+
+    m_pending.push_back(PendingObject{ prefix, obj->id(), obj->version(), s.str(), nullptr });
+    return true;
+  }
+
+  bool collectImage(const ImageRef& img)
+  {
+    if (isCanceled())
+      return false;
+
+    if (!img->version())
+      img->incrementVersion();
+
+    // Skip images already saved (completely or in the log of deltas)
+    ObjVersions& versions = m_objVersions[img->id()];
+    if (versions.newer() == img->version())
+      return true;
+    if (m_config && m_config->incrementalBackups) {
+      auto it = m_imageDeltaLogs.find(img->id());
+      if (it != m_imageDeltaLogs.end() && it->second.savedVersion == img->version())
+        return true;
+    }
+
+    m_pending.push_back(
+      PendingObject{ "img", img->id(), img->version(), {}, m_doc->createImageSnapshot(img) });
+    return true;
+  }
+
+  bool saveImage(const PendingObject& img)
+  {
+    if (!m_config || !m_config->incrementalBackups)
+      return saveObject(img);
+
+    ObjVersions& versions = m_objVersions[img.id];
+    ImageDeltaLog& log = m_imageDeltaLogs[img.id];
+
+    // Save only the modified tiles in the log of the last saved image
+    if (log.baseVersion && log.baseVersion == versions.newer() &&
+        log.pixelFormat == img.image->pixelFormat() && log.size == img.image->size() &&
+        log.logSize <= m_config->deltaLogCompactionRatio * log.baseSize) {
+      if (log.savedVersion == img.version)
+        return true;
+
+      return saveImageDelta(img, log);
+    }
+
+    // Save the whole image
+    const ObjectVersion olderVer = versions.older();
+    m_lastFileSize = 0;
+    if (!saveObject(img))
+      return false;
+
+    if (log.baseVersion != versions.newer()) {
+      // The log of the removed older version is not needed anymore
+      if (olderVer && olderVer != versions.older()) {
+        const std::string oldLogFn = base::join_path(m_dir, delta_log_filename(img.id, olderVer));
+        if (base::is_file(oldLogFn))
+          m_deleteFiles.push_back(oldLogFn);
+      }
+
+      log.baseVersion = versions.newer();
+      log.savedVersion = versions.newer();
+      log.pixelFormat = img.image->pixelFormat();
+      log.size = img.image->size();
+      log.baseSize = m_lastFileSize;
+      log.logSize = 0;
+      calculateTileHashes(img.image.get(), log.tileHashes);
+    }
+    return true;
+  }
 
-  bool writeDocumentFile(std::ofstream& s, Doc* doc)
+  // Appends the tiles of the image that were modified since the last
+  // backup to its log of deltas. Each cycle is saved as:
+  //
+  //   DELTA_MAGIC_NUMBER, image version, number of tiles,
+  //   (x, y, tile image) for each tile, MAGIC_NUMBER
+  //
+  // The reader ignores the last cycle if it doesn't end with the
+  // MAGIC_NUMBER (e.g. the program crashed in the middle of it).
+  bool saveImageDelta(const PendingObject& img, ImageDeltaLog& log)
+  {
+    if (isCanceled() || isBudgetExceeded())
+      return false;
+
+    std::vector<uint64_t> hashes;
+    calculateTileHashes(img.image.get(), hashes);
+
+    std::vector<gfx::Rect> tiles;
+    forEachTile(img.image.get(), [&tiles, &hashes, &log](const int i, const gfx::Rect& tileBounds) {
+      if (hashes[i] != log.tileHashes[i])
+        tiles.push_back(tileBounds);
+    });
+
+    if (!tiles.empty()) {
+      const std::string fn = base::join_path(m_dir, delta_log_filename(img.id, log.baseVersion));
+
+      // Overwrite the last incomplete cycle (if any)
+      std::fstream s;
+      if (log.logSize > 0) {
+        s.open(FSTREAM_PATH(fn), std::fstream::in | std::fstream::out | std::fstream::binary);
+        s.seekp(log.logSize);
+      }
+      else {
+        s.open(FSTREAM_PATH(fn), std::fstream::out | std::fstream::trunc | std::fstream::binary);
+      }
+      if (!s)
+        return false;
+
+      write32(s, DELTA_MAGIC_NUMBER);
+      write32(s, img.version);
+      write32(s, tiles.size());
+      for (const gfx::Rect& tileBounds : tiles) {
+        write16(s, tileBounds.x);
+        write16(s, tileBounds.y);
+
+        ImageRef tile(crop_image(img.image.get(), tileBounds, 0));
+        if (!write_image(s, tile.get(), this))
+          return false;
+      }
+
+      // The magic number is written at the end to indicate that the
+      // whole cycle was saved correctly.
+      s.flush();
+      write32(s, MAGIC_NUMBER);
+      s.flush();
+      if (!s)
+        return false;
+
+      const std::streamoff logSize = s.tellp();
+      m_writtenBytes += logSize - log.logSize;
+      log.logSize = logSize;
+
+      RECO_TRACE(" - Saved %d tiles of img #%d v%d\n", int(tiles.size()), img.id, img.version);
+    }
+
+    log.savedVersion = img.version;
+    log.tileHashes = std::move(hashes);
+    return true;
+  }
+
+  template<typename Func>
+  static void forEachTile(const Image* img, Func&& func)
+  {
+    int i = 0;
+    for (int y = 0; y < img->height(); y += DELTA_TILE_SIZE) {
+      for (int x = 0; x < img->width(); x += DELTA_TILE_SIZE, ++i)
+        func(i, gfx::Rect(x, y, DELTA_TILE_SIZE, DELTA_TILE_SIZE) & img->bounds());
+    }
+  }
+
+  // A 64-bit hash is used to detect modified tiles because the
+  // 32-bit calculate_image_hash() could miss some changes.
+  static void calculateTileHashes(const Image* img, std::vector<uint64_t>& hashes)
+  {
+    hashes.clear();
+    forEachTile(img, [img, &hashes](const int, const gfx::Rect& tileBounds) {
+      hashes.push_back(calculate_image_hash64(img, tileBounds));
+    });
+  }
+
+  bool writeDocumentFile(std::ostream& s, Doc* doc)
   {
     write32(s, doc->sprite()->id());
     write_string(s, doc->filename());
@@ -155,7 +485,7 @@ private:
     return true;
   }
 
-  bool writeSprite(std::ofstream& s, Sprite* spr)
+  bool writeSprite(std::ostream& s, Sprite* spr)
   {
     // Header
     write8(s, int(spr->colorMode()));
@@ -210,7 +540,7 @@ private:
     return true;
   }
 
-  bool writeGridBounds(std::ofstream& s, const gfx::Rect& grid)
+  bool writeGridBounds(std::ostream& s, const gfx::Rect& grid)
   {
     write16(s, (int16_t)grid.x);
     write16(s, (int16_t)grid.y);
@@ -219,7 +549,7 @@ private:
     return true;
   }
 
-  bool writeColorSpace(std::ofstream& s, const gfx::ColorSpaceRef& colorSpace)
+  bool writeColorSpace(std::ostream& s, const gfx::ColorSpaceRef& colorSpace)
   {
     write16(s, colorSpace->type());
     write16(s, colorSpace->flags());
@@ -234,7 +564,7 @@ private:
     return true;
   }
 
-  void writeAllLayersID(std::ofstream& s, ObjectId parentId, const LayerGroup* group)
+  void writeAllLayersID(std::ostream& s, ObjectId parentId, const LayerGroup* group)
   {
     for (const Layer* lay : group->layers()) {
       write32(s, lay->id());
@@ -245,7 +575,7 @@ private:
     }
   }
 
-  bool writeLayerStructure(std::ofstream& s, Layer* lay)
+  bool writeLayerStructure(std::ostream& s, Layer* lay)
   {
     write32(s, static_cast<int>(lay->flags())); // Flags
     write16(s, static_cast<int>(lay->type()));  // Type
@@ -285,74 +615,84 @@ private:
     return true;
   }
 
-  bool writeCel(std::ofstream& s, Cel* cel)
+  bool writeCel(std::ostream& s, Cel* cel)
   {
     write_cel(s, cel);
     return true;
   }
 
-  bool writeCelData(std::ofstream& s, CelData* celdata)
+  bool writeCelData(std::ostream& s, CelData* celdata)
   {
     write_celdata(s, celdata);
     return true;
   }
 
-  bool writeImage(std::ofstream& s, Image* img) { return write_image(s, img, m_cancel); }
-
-  bool writePalette(std::ofstream& s, Palette* pal)
+  bool writePalette(std::ostream& s, Palette* pal)
   {
     write_palette(s, pal);
     return true;
   }
 
-  bool writeTileset(std::ofstream& s, Tileset* tileset)
+  bool writeTileset(std::ostream& s, Tileset* tileset)
   {
     write_tileset(s, tileset);
     return true;
   }
 
-  bool writeFrameTag(std::ofstream& s, Tag* frameTag)
+  bool writeFrameTag(std::ostream& s, Tag* frameTag)
   {
     write_tag(s, frameTag);
     return true;
   }
 
-  bool writeSlice(std::ofstream& s, Slice* slice)
+  bool writeSlice(std::ostream& s, Slice* slice)
   {
     write_slice(s, slice);
     return true;
   }
 
-  template<typename T>
-  bool saveObject(const char* prefix, T* obj, bool (Writer::*writeMember)(std::ofstream&, T*))
+  bool saveObject(const PendingObject& obj)
   {
     if (isCanceled())
       return false;
 
-    if (!obj->version())
-      obj->incrementVersion();
-
-    ObjVersions& versions = m_objVersions[obj->id()];
-    if (versions.newer() == obj->version())
+    ObjVersions& versions = m_objVersions[obj.id];
+    if (versions.newer() == obj.version)
       return true;
 
-    std::string fn = prefix;
+    // The rest of the document will be saved in the next cycle
+    if (isBudgetExceeded()) {
+      RECO_TRACE(" - Backup budget exceeded (%d bytes)\n", int(m_writtenBytes));
+      return false;
+    }
+
+    std::string fn = obj.prefix;
     fn.push_back('-');
-    fn += base::convert_to<std::string>(obj->id());
+    fn += base::convert_to<std::string>(obj.id);
 
     std::string fullfn = base::join_path(m_dir, fn);
     std::string oldfn = fullfn + "." + base::convert_to<std::string>(versions.older());
-    fullfn += "." + base::convert_to<std::string>(obj->version());
+    fullfn += "." + base::convert_to<std::string>(obj.version);
 
     std::ofstream s(FSTREAM_PATH(fullfn), std::ofstream::binary);
-    write32(s, 0);                     // Leave a room for the magic number
-    if (!(this->*writeMember)(s, obj)) // Write the object
-      return false;
+    write32(s, 0); // Leave a room for the magic number
+    if (obj.image) {
+      // The snapshot is a different image object, so we save it with
+      // the ID of the original image.
+      if (!write_image(s, obj.image.get(), obj.id, this))
+        return false;
+    }
+    else {
+      s.write(obj.data.data(), obj.data.size());
+    }
 
     // Flush all data. In this way we ensure that the magic number is
     // the last thing being written in the file.
     s.flush();
 
+    m_lastFileSize = s.tellp();
+    m_writtenBytes += m_lastFileSize;
+
     // Write the magic number
     s.seekp(0);
     write32(s, MAGIC_NUMBER);
@@ -362,9 +702,9 @@ private:
       m_deleteFiles.push_back(oldfn);
 
     // Rotate versions and add the latest one
-    versions.rotateRevisions(obj->version());
+    versions.rotateRevisions(obj.version);
 
-    RECO_TRACE(" - Saved %s #%d v%d\n", prefix, obj->id(), obj->version());
+    RECO_TRACE(" - Saved %s #%d v%d\n", obj.prefix, obj.id, obj.version);
     return true;
   }
 
@@ -386,9 +726,16 @@ private:
 
   std::string m_dir;
   Doc* m_doc;
+  DocBackup& m_docBackup;
   ObjVersionsMap& m_objVersions;
   base::paths& m_deleteFiles;
+  ImageDeltaLogs& m_imageDeltaLogs;
   doc::CancelIO* m_cancel;
+  const RecoveryConfig* m_config;
+  base::Chrono m_chrono;
+  std::streamoff m_writtenBytes;
+  std::streamoff m_lastFileSize = 0;
+  std::vector<PendingObject> m_pending;
 };
 
 } // anonymous namespace
@@ -396,27 +743,39 @@ private:
 //////////////////////////////////////////////////////////////////////
 // Public API
 
-bool write_document(const std::string& dir, Doc* doc, doc::CancelIO* cancel)
+bool write_document(const std::string& dir,
+                    Doc* doc,
+                    doc::CancelIO* cancel,
+                    const RecoveryConfig* config,
+                    const std::function<void()>& unlock)
 {
-  Writer writer(dir, doc, cancel);
-  return writer.saveDocument();
+  const DocBackupPtr docBackup = get_doc_backup(doc->id());
+  const std::lock_guard lock(docBackup->mutex);
+
+  Writer writer(dir, doc, *docBackup, cancel, config);
+  if (!writer.collectObjects())
+    return false;
+
+  // Images are written from snapshots, so we don't need the document
+  // anymore.
+  if (unlock)
+    unlock();
+  return writer.writeObjects();
 }
 
 void delete_document_internals(Doc* doc)
 {
   ASSERT(doc);
+  const std::lock_guard lock(g_mutex);
 
-  // The document could not be inside g_documentObjects in case it was
+  // The document could not be inside g_docBackups in case it was
   // never saved by the backup process.
-  {
-    auto it = g_docVersions.find(doc->id());
-    if (it != g_docVersions.end())
-      g_docVersions.erase(it);
-  }
-  {
-    auto it = g_deleteFiles.find(doc->id());
-    if (it != g_deleteFiles.end())
-      g_deleteFiles.erase(it);
+  auto it = g_docBackups.find(doc->id());
+  if (it != g_docBackups.end()) {
+    // If the backup is being written, it's stopped as soon as
+    // possible (without waiting it here).
+    it->second->deleted = true;
+    g_docBackups.erase(it);
   }
 }
 
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -8,6 +9,7 @@
 #define APP_CRASH_WRITE_DOCUMENT_H_INCLUDED
 #pragma once
 
+#include <functional>
 #include <string>
 
 namespace doc {
@@ -19,7 +21,21 @@ class Doc;
 
 namespace crash {
 
-bool write_document(const std::string& dir, Doc* doc, doc::CancelIO* cancel);
+struct RecoveryConfig;
+
+// Saves the modified objects of the document in the given
+// directory. If "unlock" is specified, it's called when the document
+// doesn't need to be locked anymore: modified objects are collected
+// first (images as snapshots that share pixels with the document, see
+// Doc::createImageSnapshot()), and then they are compressed and
+// written to disk without the lock. "cancel" is checked until the
+// last file is written (and the writing is stopped too if the
+// document internals are deleted with delete_document_internals()).
+bool write_document(const std::string& dir,
+                    Doc* doc,
+                    doc::CancelIO* cancel,
+                    const RecoveryConfig* config = nullptr,
+                    const std::function<void()>& unlock = nullptr);
 void delete_document_internals(Doc* doc);
 
 } // namespace crash
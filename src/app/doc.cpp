@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -37,6 +37,7 @@
 #include "os/window.h"
 #include "ui/system.h"
 
+#include <algorithm>
 #include <limits>
 #include <map>
 
@@ -112,6 +113,8 @@ Doc::LockResult Doc::writeLock(int timeout)
 {
   auto res = m_rwLock.lock(base::RWLock::WriteLock, timeout);
   DOC_TRACE("DOC: writeLock", this, (int)res);
+  if (res != LockResult::Fail)
+    unshareImageSnapshots();
   return res;
 }
 
@@ -119,6 +122,8 @@ Doc::LockResult Doc::upgradeToWrite(int timeout)
 {
   auto res = m_rwLock.upgradeToWrite(timeout);
   DOC_TRACE("DOC: upgradeToWrite", this, (int)res);
+  if (res != LockResult::Fail)
+    unshareImageSnapshots();
   return res;
 }
 
@@ -148,6 +153,38 @@ void Doc::weakUnlock()
   m_rwLock.weakUnlock();
 }
 
+doc::ImageRef Doc::createImageSnapshot(const doc::ImageRef& image)
+{
+  ImageRef snapshot(Image::createSnapshot(image.get()));
+
+  const std::lock_guard lock(m_snapshotsMutex);
+
+  // Forget the snapshots that were already released
+  m_snapshots.erase(std::remove_if(m_snapshots.begin(),
+                                   m_snapshots.end(),
+                                   [](const ImageSnapshot& s) { return s.snapshot.expired(); }),
+                    m_snapshots.end());
+
+  m_snapshots.push_back(ImageSnapshot{ image, snapshot });
+  return snapshot;
+}
+
+// Called when the document is locked for writing, so we can copy the
+// pixels of the images that are still shared with snapshots before
+// they are modified. Snapshots that were already released (or
+// images that were deleted) don't need a copy.
+void Doc::unshareImageSnapshots()
+{
+  const std::lock_guard lock(m_snapshotsMutex);
+  for (const ImageSnapshot& s : m_snapshots) {
+    if (s.snapshot.expired())
+      continue;
+    if (ImageRef image = s.image.lock())
+      image->unshareBuffer();
+  }
+  m_snapshots.clear();
+}
+
 void Doc::setTransaction(Transaction* transaction)
 {
   if (transaction) {
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -19,6 +19,7 @@
 #include "doc/color.h"
 #include "doc/document.h"
 #include "doc/frame.h"
+#include "doc/image_ref.h"
 #include "doc/mask_boundaries.h"
 #include "doc/pixel_format.h"
 #include "gfx/rect.h"
@@ -27,7 +28,9 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 
 namespace doc {
 class Cel;
@@ -88,6 +91,15 @@ public:
   bool weakLock(std::atomic<base::RWLock::WeakLock>* weak_lock_flag);
   void weakUnlock();
 
+  // Returns a read-only copy of an image of this document that shares
+  // its pixels (see doc::Image::createSnapshot()), so it can be read
+  // from a background thread after the document is unlocked. The
+  // next time the document is locked for writing, the pixels of the
+  // original image are copied if the snapshot still exists
+  // (copy-on-write), so the caller should release the snapshot as
+  // soon as possible.
+  doc::ImageRef createImageSnapshot(const doc::ImageRef& image);
+
   // Sets active/running transaction.
   void setTransaction(Transaction* transaction);
   Transaction* transaction() { return m_transaction; }
@@ -256,6 +268,7 @@ protected:
 private:
   void removeFromContext();
   void updateOSColorSpace(bool appWideSignal);
+  void unshareImageSnapshots();
 
   // The document is in the collection of documents of this context.
   Context* m_ctx;
@@ -266,6 +279,17 @@ private:
   // Read-Write locks.
   base::RWLock m_rwLock;
 
+  // Images that can share their pixels with snapshots created with
+  // createImageSnapshot() (it's used from reader threads). Only weak
+  // references are kept, so each snapshot is released as soon as the
+  // reader doesn't need it.
+  struct ImageSnapshot {
+    std::weak_ptr<doc::Image> image;
+    std::weak_ptr<doc::Image> snapshot;
+  };
+  std::mutex m_snapshotsMutex;
+  std::vector<ImageSnapshot> m_snapshots;
+
   // Undo and redo information about the document.
   std::unique_ptr<DocUndo> m_undo;
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -29,9 +29,9 @@
 #include "doc/algorithm/shrink_bounds.h"
 #include "doc/cel.h"
 #include "doc/image.h"
-#include "doc/images_map.h"
 #include "doc/layer.h"
 #include "doc/palette.h"
+#include "doc/parallel.h"
 #include "doc/primitives.h"
 #include "doc/selected_frames.h"
 #include "doc/selected_layers.h"
@@ -49,10 +49,12 @@
 #include <algorithm>
 #include <cstdio>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <memory>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #define DX_TRACE(...) // TRACEARGS
@@ -83,6 +85,29 @@ std::ostream& operator<<(std::ostream& os, const doc::UserData& data)
   return os;
 }
 
+// Maximum number of samples rendered at the same time to look for
+// duplicates (all the unique ones are kept in memory anyway).
+constexpr int kMaxSamplesPerChunk = 256;
+
+// Calls func(i, sampleBuf) for each i in [0, n) from the caller
+// thread and the threads of the pool. Each thread has its own
+// sampleBuf to render samples.
+void for_each_index_in_parallel(
+  const int n,
+  base::task_token& token,
+  const std::function<void(int, doc::ImageBufferPtr&)>& func)
+{
+  const int threads = std::min(n, doc::parallel_threads());
+  std::vector<doc::ImageBufferPtr> sampleBufs(std::max(threads, 1));
+  for (auto& sampleBuf : sampleBufs)
+    sampleBuf = std::make_shared<doc::ImageBuffer>();
+
+  doc::parallel_for(n, threads, [&token, &func, &sampleBufs](const int i, const int worker) {
+    if (!token.canceled())
+      func(i, sampleBufs[worker]);
+  });
+}
+
 } // anonymous namespace
 
 namespace app {
@@ -229,7 +254,10 @@ public:
   void setLinked() { m_isLinked = true; }
   void setDuplicated() { m_isDuplicated = true; }
 
-  ImageRef createRender(ImageBufferPtr& imageBuf)
+  // If "showSelLayers" is false, the caller is responsible of
+  // showing only the selected layers (e.g. when several samples are
+  // rendered in parallel).
+  ImageRef createRender(ImageBufferPtr& imageBuf, const bool showSelLayers = true) const
   {
     ASSERT(m_sprite);
 
@@ -242,14 +270,18 @@ public:
       Image::create(m_sprite->pixelFormat(), m_trimmedBounds.w, m_trimmedBounds.h, imageBuf));
     render->setMaskColor(m_sprite->transparentColor());
     clear_image(render.get(), m_sprite->transparentColor());
-    renderSample(render.get(), 0, 0, false);
+    renderSample(render.get(), 0, 0, false, showSelLayers);
     return render;
   }
 
-  void renderSample(doc::Image* dst, int x, int y, bool extrude) const
+  void renderSample(doc::Image* dst,
+                    int x,
+                    int y,
+                    bool extrude,
+                    const bool showSelLayers = true) const
   {
     RestoreVisibleLayers layersVisibility;
-    if (m_selLayers)
+    if (m_selLayers && showSelLayers)
       layersVisibility.showSelectedLayers(m_sprite, *m_selLayers);
 
     render::Render render;
@@ -341,6 +373,98 @@ private:
   List m_samples;
 };
 
+// static
+void DocExporter::forEachSampleInParallel(
+  const std::vector<const Sample*>& list,
+  base::task_token& token,
+  const std::function<void(int, doc::ImageBufferPtr&)>& func)
+{
+  // Samples are processed in groups of consecutive samples that
+  // show the same layers, so we can change the visibility of layers
+  // only once for each group (and from this thread only).
+  for (int begin = 0, n = int(list.size()); begin < n && !token.canceled();) {
+    const Sample* first = list[begin];
+    int end = begin + 1;
+    while (end < n && list[end]->sprite() == first->sprite() &&
+           list[end]->selectedLayers() == first->selectedLayers()) {
+      ++end;
+    }
+
+    RestoreVisibleLayers layersVisibility;
+    if (first->selectedLayers())
+      layersVisibility.showSelectedLayers(first->sprite(), *first->selectedLayers());
+
+    for_each_index_in_parallel(end - begin,
+                               token,
+                               [begin, &func](int i, doc::ImageBufferPtr& sampleBuf) {
+                                 func(begin + i, sampleBuf);
+                               });
+    begin = end;
+  }
+}
+
+// static
+void DocExporter::findDuplicatedSamples(const Samples& samples,
+                                        const std::function<bool(const Sample&)>& filter,
+                                        std::vector<int>& originals,
+                                        base::task_token& token)
+{
+  originals.assign(samples.size(), -1);
+
+  std::vector<const Sample*> list;
+  std::vector<int> indexes;
+  for (int i = 0; i < samples.size(); ++i) {
+    const Sample& sample = samples[i];
+    if (!sample.isEmpty() && filter(sample)) {
+      list.push_back(&sample);
+      indexes.push_back(i);
+    }
+  }
+
+  // Unique images found so far (and the index of their samples)
+  // indexed by hash.
+  std::unordered_multimap<uint32_t, std::pair<ImageRef, int>> uniques;
+
+  // Images are rendered and hashed in parallel (in chunks to limit
+  // the memory usage), and then compared in order so the result is
+  // always the same (the first sample of each group of duplicates
+  // is the original one).
+  const int n = int(list.size());
+  std::vector<ImageRef> renders;
+  std::vector<uint32_t> hashes;
+  for (int begin = 0; begin < n && !token.canceled(); begin += kMaxSamplesPerChunk) {
+    const int end = std::min(n, begin + kMaxSamplesPerChunk);
+    const std::vector<const Sample*> chunk(list.begin() + begin, list.begin() + end);
+
+    renders.assign(chunk.size(), ImageRef());
+    hashes.assign(chunk.size(), 0);
+    forEachSampleInParallel(chunk, token, [&](int i, doc::ImageBufferPtr&) {
+      // We have to use one ImageBuffer for each image because we're
+      // going to keep the unique images to compare the next ones.
+      doc::ImageBufferPtr imageBuf = std::make_shared<doc::ImageBuffer>();
+      ImageRef render = chunk[i]->createRender(imageBuf, false);
+      hashes[i] = calculate_image_hash(render.get(), render->bounds());
+      renders[i] = render;
+    });
+    if (token.canceled())
+      return;
+
+    for (int i = 0; i < int(chunk.size()); ++i) {
+      const int k = indexes[begin + i];
+      const auto range = uniques.equal_range(hashes[i]);
+      auto it = range.first;
+      for (; it != range.second; ++it) {
+        if (is_same_image(it->second.first.get(), renders[i].get())) {
+          originals[k] = it->second.second;
+          break;
+        }
+      }
+      if (it == range.second)
+        uniques.emplace(hashes[i], std::make_pair(renders[i], k));
+    }
+  }
+}
+
 class DocExporter::LayoutSamples {
 public:
   virtual ~LayoutSamples() {}
@@ -384,7 +508,13 @@ public:
     const Layer* oldLayer = nullptr;
     const Tag* oldTag = nullptr;
 
-    doc::ImagesMap duplicates;
+    std::vector<int> originals;
+    findDuplicatedSamples(
+      samples,
+      [this](const Sample& sample) { return m_mergeDups || sample.isLinked(); },
+      originals,
+      token);
+
     gfx::Point framePt(borderPadding, borderPadding);
     gfx::Size rowSize(0, 0);
 
@@ -409,21 +539,11 @@ public:
         continue;
       }
 
-      if (m_mergeDups || sample.isLinked()) {
-        doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
-        doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-        auto it = duplicates.find(sampleRender);
-        if (it != duplicates.end()) {
-          const uint32_t j = it->second;
-
-          sample.setDuplicated();
-          sample.setSharedBounds(samples[j].sharedBounds());
-          ++i;
-          continue;
-        }
-        else {
-          duplicates[sampleRender] = i;
-        }
+      if (originals[i] >= 0) {
+        sample.setDuplicated();
+        sample.setSharedBounds(samples[originals[i]].sharedBounds());
+        ++i;
+        continue;
       }
 
       const Sprite* sprite = sample.sprite();
@@ -523,7 +643,13 @@ public:
                      base::task_token& token) override
   {
     gfx::PackingRects pr(borderPadding, shapePadding);
-    doc::ImagesMap duplicates;
+
+    std::vector<int> originals;
+    findDuplicatedSamples(
+      samples,
+      [](const Sample&) { return true; },
+      originals,
+      token);
 
     uint32_t i = 0;
     for (auto& sample : samples) {
@@ -537,19 +663,11 @@ public:
         continue;
       }
 
-      // We have to use one ImageBuffer for each image because we're
-      // going to store all images in the "duplicates" map.
-      doc::ImageBufferPtr sampleBuf = std::make_shared<doc::ImageBuffer>();
-      doc::ImageRef sampleRender(sample.createRender(sampleBuf));
-      auto it = duplicates.find(sampleRender);
-      if (it != duplicates.end()) {
-        const uint32_t j = it->second;
-
+      if (originals[i] >= 0) {
         sample.setDuplicated();
-        sample.setSharedBounds(samples[j].sharedBounds());
+        sample.setSharedBounds(samples[originals[i]].sharedBounds());
       }
       else {
-        duplicates[sampleRender] = i;
         pr.add(sample.requiredSize());
       }
       ++i;
@@ -861,6 +979,34 @@ void DocExporter::captureSamples(Samples& samples, base::task_token& token)
 {
   DX_TRACE("DX: Capture samples");
 
+  // Possible samples to add. We collect all of them first so we can
+  // render and trim them in parallel, and then we add them in order.
+  struct Candidate {
+    const Item* item;
+    Sample sample;
+    Cel* cel;
+    Cel* link;
+    gfx::Rect spriteBounds;
+    // Result of shrinkSampleBounds() if it was already calculated
+    bool hasFrameBounds = false;
+    bool notEmpty = false;
+    gfx::Rect frameBounds;
+
+    Candidate(const Item* item,
+              const Sample& sample,
+              Cel* cel,
+              Cel* link,
+              const gfx::Rect& spriteBounds)
+      : item(item)
+      , sample(sample)
+      , cel(cel)
+      , link(link)
+      , spriteBounds(spriteBounds)
+    {
+    }
+  };
+  std::vector<Candidate> candidates;
+
   for (auto& item : m_documents) {
     if (token.canceled())
       return;
@@ -953,7 +1099,6 @@ void DocExporter::captureSamples(Samples& samples, base::task_token& token)
                     m_extrude);
       Cel* cel = nullptr;
       Cel* link = nullptr;
-      bool done = false;
 
       if (layer && layer->isImage()) {
         cel = layer->cel(frame);
@@ -961,124 +1106,180 @@ void DocExporter::captureSamples(Samples& samples, base::task_token& token)
           link = cel->link();
       }
 
-      // Re-use linked samples
-      bool alreadyTrimmed = false;
-      if (link && m_mergeDuplicates && !item.isOneImageOnly()) {
-        for (const Sample& other : samples) {
-          if (token.canceled())
-            return;
-
-          if (other.sprite() == sprite && other.layer() == layer &&
-              other.frame() == link->frame()) {
-            ASSERT(!other.isLinked());
-
-            sample.setLinked();
-            sample.setTrimmedBounds(other.trimmedBounds());
-            sample.setSharedBounds(other.sharedBounds());
-            alreadyTrimmed = true;
-            done = true;
-            break;
-          }
+      candidates.emplace_back(&item, sample, cel, link, spriteBounds);
+    }
+  }
+
+  // Render samples to trim them/ignore empty ones in parallel. Linked
+  // cels will re-use the bounds of other samples, so we skip them
+  // (if they cannot be re-used, they are calculated below).
+  if (m_ignoreEmptyCels || m_trimCels) {
+    std::vector<const Sample*> list;
+    std::vector<Candidate*> pending;
+    for (Candidate& c : candidates) {
+      const Layer* layer = c.sample.layer();
+      if (c.item->isOneImageOnly() || (c.link && m_mergeDuplicates) ||
+          (layer && layer->isImage() && !c.cel && m_ignoreEmptyCels)) {
+        continue;
+      }
+      list.push_back(&c.sample);
+      pending.push_back(&c);
+    }
+
+    forEachSampleInParallel(list, token, [this, &pending](int i, ImageBufferPtr& sampleBuf) {
+      Candidate& c = *pending[i];
+      c.notEmpty = shrinkSampleBounds(c.sample, c.spriteBounds, sampleBuf, false, c.frameBounds);
+      c.hasFrameBounds = true;
+    });
+  }
+
+  for (Candidate& c : candidates) {
+    if (token.canceled())
+      return;
+
+    const Item& item = *c.item;
+    Sample& sample = c.sample;
+    Sprite* sprite = sample.sprite();
+    Layer* layer = sample.layer();
+    const Tag* tag = item.tag;
+    const gfx::Rect& spriteBounds = c.spriteBounds;
+    Cel* cel = c.cel;
+    Cel* link = c.link;
+    bool done = false;
+
+    // Re-use linked samples
+    bool alreadyTrimmed = false;
+    if (link && m_mergeDuplicates && !item.isOneImageOnly()) {
+      for (const Sample& other : samples) {
+        if (token.canceled())
+          return;
+
+        if (other.sprite() == sprite && other.layer() == layer &&
+            other.frame() == link->frame()) {
+          ASSERT(!other.isLinked());
+
+          sample.setLinked();
+          sample.setTrimmedBounds(other.trimmedBounds());
+          sample.setSharedBounds(other.sharedBounds());
+          alreadyTrimmed = true;
+          done = true;
+          break;
         }
-        // "done" variable can be false here, e.g. when we export a
-        // frame tag and the first linked cel is outside the tag range.
-        ASSERT(done || (!done && tag));
       }
+      // "done" variable can be false here, e.g. when we export a
+      // frame tag and the first linked cel is outside the tag range.
+      ASSERT(done || (!done && tag));
+    }
 
-      if (!done && (m_ignoreEmptyCels || m_trimCels) && !item.isOneImageOnly()) {
-        // Ignore empty cels
-        if (layer && layer->isImage() && !cel && m_ignoreEmptyCels)
-          continue;
+    if (!done && (m_ignoreEmptyCels || m_trimCels) && !item.isOneImageOnly()) {
+      // Ignore empty cels
+      if (layer && layer->isImage() && !cel && m_ignoreEmptyCels)
+        continue;
 
-        ImageRef sampleRender(sample.createRender(m_sampleBuf));
+      if (!c.hasFrameBounds)
+        c.notEmpty = shrinkSampleBounds(sample, spriteBounds, m_sampleBuf, true, c.frameBounds);
 
-        gfx::Rect frameBounds;
-        doc::color_t refColor = 0;
+      gfx::Rect frameBounds = c.frameBounds;
+      if (!c.notEmpty) {
+        // If shrink_bounds() returns false, it's because the whole
+        // image is transparent (equal to the mask color).
 
-        if (m_trimCels) {
-          if ((layer && layer->isBackground()) ||
-              (!layer && sprite->backgroundLayer() && sprite->backgroundLayer()->isVisible())) {
-            refColor = get_pixel(sampleRender.get(), 0, 0);
-          }
-          else {
-            refColor = sprite->transparentColor();
-          }
-        }
-        else if (m_ignoreEmptyCels)
-          refColor = sprite->transparentColor();
-
-        if (!algorithm::shrink_bounds(sampleRender.get(),
-                                      refColor,
-                                      nullptr,        // layer
-                                      spriteBounds,   // startBounds
-                                      frameBounds)) { // output bounds
-          // If shrink_bounds() returns false, it's because the whole
-          // image is transparent (equal to the mask color).
-
-          // Should we ignore this empty frame? (i.e. don't include
-          // the frame in the sprite sheet)
-          if (m_ignoreEmptyCels)
-            continue;
+        // Should we ignore this empty frame? (i.e. don't include
+        // the frame in the sprite sheet)
+        if (m_ignoreEmptyCels)
+          continue;
 
-          // Create an entry with Size(1, 1) for this completely
-          // trimmed frame anyway so we conserve the frame information
-          // (position and duration of the frame in the JSON data, and
-          // the relative position of the frame in frame tags).
-          sample.setTrimmedBounds(frameBounds = gfx::Rect(0, 0, 1, 1));
-        }
+        // Create an entry with Size(1, 1) for this completely
+        // trimmed frame anyway so we conserve the frame information
+        // (position and duration of the frame in the JSON data, and
+        // the relative position of the frame in frame tags).
+        sample.setTrimmedBounds(frameBounds = gfx::Rect(0, 0, 1, 1));
+      }
 
-        if (m_trimCels) {
-          // TODO merge this code with the code in DocApi::trimSprite()
-          if (m_trimByGrid) {
-            const gfx::Rect& gridBounds = doc->sprite()->gridBounds();
-            gfx::Point posTopLeft =
-              snap_to_grid(gridBounds, frameBounds.origin(), PreferSnapTo::FloorGrid);
-            gfx::Point posBottomRight =
-              snap_to_grid(gridBounds, frameBounds.point2(), PreferSnapTo::CeilGrid);
-            frameBounds = gfx::Rect(posTopLeft, posBottomRight);
-          }
-          sample.setTrimmedBounds(frameBounds);
-          alreadyTrimmed = true;
+      if (m_trimCels) {
+        // TODO merge this code with the code in DocApi::trimSprite()
+        if (m_trimByGrid) {
+          const gfx::Rect& gridBounds = sprite->gridBounds();
+          gfx::Point posTopLeft =
+            snap_to_grid(gridBounds, frameBounds.origin(), PreferSnapTo::FloorGrid);
+          gfx::Point posBottomRight =
+            snap_to_grid(gridBounds, frameBounds.point2(), PreferSnapTo::CeilGrid);
+          frameBounds = gfx::Rect(posTopLeft, posBottomRight);
         }
+        sample.setTrimmedBounds(frameBounds);
+        alreadyTrimmed = true;
       }
-      // If "Ignore Empty" is checked and the item is a tile...
-      else if (m_ignoreEmptyCels && item.isOneImageOnly()) {
-        // Skip empty tile
-        if (is_empty_image(item.image.get()))
-          continue;
-      }
+    }
+    // If "Ignore Empty" is checked and the item is a tile...
+    else if (m_ignoreEmptyCels && item.isOneImageOnly()) {
+      // Skip empty tile
+      if (is_empty_image(item.image.get()))
+        continue;
+    }
 
-      if (!alreadyTrimmed && m_trimSprite)
-        sample.setTrimmedBounds(spriteBounds);
+    if (!alreadyTrimmed && m_trimSprite)
+      sample.setTrimmedBounds(spriteBounds);
 
-      if (item.splitGrid) {
-        const gfx::Rect& gridBounds = sprite->gridBounds();
-        gfx::Point initPos(0, 0), pos;
-        initPos = pos = snap_to_grid(gridBounds, initPos, PreferSnapTo::BoxOrigin);
+    if (item.splitGrid) {
+      const gfx::Rect& gridBounds = sprite->gridBounds();
+      gfx::Point initPos(0, 0), pos;
+      initPos = pos = snap_to_grid(gridBounds, initPos, PreferSnapTo::BoxOrigin);
 
-        for (; pos.y + gridBounds.h <= spriteBounds.h; pos.y += gridBounds.h) {
-          for (pos.x = initPos.x; pos.x + gridBounds.w <= spriteBounds.w; pos.x += gridBounds.w) {
-            const gfx::Rect cellBounds(pos, gridBounds.size());
-            sample.setTrimmedBounds(cellBounds);
-            sample.setSharedBounds(std::make_shared<gfx::Rect>(sample.inTextureBounds()));
-            samples.addSample(sample);
-          }
+      for (; pos.y + gridBounds.h <= spriteBounds.h; pos.y += gridBounds.h) {
+        for (pos.x = initPos.x; pos.x + gridBounds.w <= spriteBounds.w; pos.x += gridBounds.w) {
+          const gfx::Rect cellBounds(pos, gridBounds.size());
+          sample.setTrimmedBounds(cellBounds);
+          sample.setSharedBounds(std::make_shared<gfx::Rect>(sample.inTextureBounds()));
+          samples.addSample(sample);
         }
       }
-      else {
-        samples.addSample(sample);
-      }
+    }
+    else {
+      samples.addSample(sample);
+    }
 
-      DX_TRACE("DX:   - Sample:",
-               sample.document()->filename(),
-               "Layer:",
-               sample.layer() ? sample.layer()->name() : "-",
-               "TrimmedBounds:",
-               sample.trimmedBounds(),
-               "InTextureBounds:",
-               sample.inTextureBounds());
+    DX_TRACE("DX:   - Sample:",
+             sample.document()->filename(),
+             "Layer:",
+             sample.layer() ? sample.layer()->name() : "-",
+             "TrimmedBounds:",
+             sample.trimmedBounds(),
+             "InTextureBounds:",
+             sample.inTextureBounds());
+  }
+}
+
+// Returns false if the whole sample is transparent (equal to the
+// mask color), in other case "frameBounds" will contain the bounds
+// of the visible content.
+bool DocExporter::shrinkSampleBounds(const Sample& sample,
+                                     const gfx::Rect& spriteBounds,
+                                     doc::ImageBufferPtr& sampleBuf,
+                                     const bool showSelLayers,
+                                     gfx::Rect& frameBounds) const
+{
+  const Sprite* sprite = sample.sprite();
+  const Layer* layer = sample.layer();
+  ImageRef sampleRender(sample.createRender(sampleBuf, showSelLayers));
+
+  doc::color_t refColor = 0;
+  if (m_trimCels) {
+    if ((layer && layer->isBackground()) ||
+        (!layer && sprite->backgroundLayer() && sprite->backgroundLayer()->isVisible())) {
+      refColor = get_pixel(sampleRender.get(), 0, 0);
+    }
+    else {
+      refColor = sprite->transparentColor();
     }
   }
+  else if (m_ignoreEmptyCels)
+    refColor = sprite->transparentColor();
+
+  return algorithm::shrink_bounds(sampleRender.get(),
+                                  refColor,
+                                  nullptr,      // layer
+                                  spriteBounds, // startBounds
+                                  frameBounds); // output bounds
 }
 
 void DocExporter::layoutSamples(Samples& samples, base::task_token& token)
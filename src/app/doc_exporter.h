@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,6 +21,7 @@
 #include "gfx/fwd.h"
 #include "gfx/rect.h"
 
+#include <functional>
 #include <iosfwd>
 #include <memory>
 #include <string>
@@ -108,6 +109,11 @@ private:
                    const doc::SelectedFrames* selFrames,
                    const bool splitGrid);
   void captureSamples(Samples& samples, base::task_token& token);
+  bool shrinkSampleBounds(const Sample& sample,
+                          const gfx::Rect& spriteBounds,
+                          doc::ImageBufferPtr& sampleBuf,
+                          const bool showSelLayers,
+                          gfx::Rect& frameBounds) const;
   void layoutSamples(Samples& samples, base::task_token& token);
   gfx::Size calculateSheetSize(const Samples& samples, base::task_token& token) const;
   Doc* createEmptyTexture(const Samples& samples, base::task_token& token) const;
@@ -118,6 +124,23 @@ private:
   void trimTexture(const Samples& samples, doc::Sprite* texture) const;
   void createDataFile(const Samples& samples, std::ostream& os, doc::Sprite* texture);
 
+  // Calls func(i, sampleBuf) for each sample in "list" using several
+  // threads. The visibility of layers is changed from the caller
+  // thread only, so "func" must render the sample with
+  // showSelLayers=false.
+  static void forEachSampleInParallel(
+    const std::vector<const Sample*>& list,
+    base::task_token& token,
+    const std::function<void(int, doc::ImageBufferPtr&)>& func);
+
+  // Fills "originals" with the index of the first sample with the
+  // same image of each sample (or -1 if it's the first one), for
+  // non-empty samples where filter(sample) is true.
+  static void findDuplicatedSamples(const Samples& samples,
+                                    const std::function<bool(const Sample&)>& filter,
+                                    std::vector<int>& originals,
+                                    base::task_token& token);
+
   class Item {
   public:
     Doc* doc = nullptr;
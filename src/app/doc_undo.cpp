@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,7 +17,9 @@
 #include "app/console.h"
 #include "app/context.h"
 #include "app/doc_undo_observer.h"
+#include "app/doc_undo_spill_file.h"
 #include "app/pref/preferences.h"
+#include "base/log.h"
 #include "base/mem_utils.h"
 #include "base/scoped_value.h"
 #include "undo/undo_history.h"
@@ -75,6 +77,11 @@ void DocUndo::add(CmdTransaction* cmd)
                  base::get_pretty_memory_size(m_totalUndoSize).c_str(),
                  base::get_pretty_memory_size(undoLimitSize).c_str());
 
+      // Old undo states are moved to the disk (compressed), and only
+      // if that is not enough we start deleting them.
+      if (App::instance()->preferences().undo.spillToDisk())
+        spillOldStates(undoLimitSize);
+
       while (m_undoHistory.firstState() && m_totalUndoSize > undoLimitSize) {
         if (!m_undoHistory.deleteFirstState())
           break;
@@ -103,7 +110,8 @@ void DocUndo::undo()
   {
     const undo::UndoState* state = nextUndo();
     ASSERT(state);
-    const Cmd* cmd = STATE_CMD(state);
+    Cmd* cmd = STATE_CMD(state);
+    unspillCmd(cmd);
     m_totalUndoSize -= cmd->memSize();
     m_undoHistory.undo();
     m_totalUndoSize += cmd->memSize();
@@ -125,7 +133,8 @@ void DocUndo::redo()
   {
     const undo::UndoState* state = nextRedo();
     ASSERT(state);
-    const Cmd* cmd = STATE_CMD(state);
+    Cmd* cmd = STATE_CMD(state);
+    unspillCmd(cmd);
     m_totalUndoSize -= cmd->memSize();
     m_undoHistory.redo();
     m_totalUndoSize += cmd->memSize();
@@ -274,6 +283,28 @@ void DocUndo::moveToState(const undo::UndoState* state)
   ASSERT(!m_undoing);
   base::ScopedValue undoing(m_undoing, true);
 
+  // Load the data of all the states that will be undone/redone (when
+  // the given state is in the current branch) before undoing the
+  // first one, so we don't stop in the middle if some data cannot be
+  // loaded.
+  {
+    const undo::UndoState* s = currentState();
+    while (s && s != state)
+      s = s->prev();
+    if (s == state) {
+      for (s = currentState(); s != state; s = s->prev())
+        unspillCmd(STATE_CMD(s));
+    }
+    else {
+      for (s = nextRedo(); s && s != state; s = s->next())
+        ;
+      if (s) {
+        for (s = nextRedo(); s != state->next(); s = s->next())
+          unspillCmd(STATE_CMD(s));
+      }
+    }
+  }
+
   m_undoHistory.moveTo(state);
 
   // After onCurrentUndoStateChange don't use the "state" argument, it
@@ -307,6 +338,52 @@ const undo::UndoState* DocUndo::nextRedo() const
     return m_undoHistory.firstState();
 }
 
+bool DocUndo::spillOldStates(const size_t undoLimitSize)
+{
+  try {
+    if (!m_spillFile)
+      m_spillFile = std::make_shared<DocUndoSpillFile>();
+
+    // The current state (and the newer ones) are kept in memory as
+    // they are the first ones to be undone/redone.
+    for (const undo::UndoState* state = firstState();
+         state && state != currentState() && m_totalUndoSize > undoLimitSize;
+         state = state->next()) {
+      Cmd* cmd = STATE_CMD(state);
+      const size_t oldSize = cmd->memSize();
+      try {
+        cmd->spill(m_spillFile);
+      }
+      catch (...) {
+        m_totalUndoSize = m_totalUndoSize - oldSize + cmd->memSize();
+        throw;
+      }
+      m_totalUndoSize = m_totalUndoSize - oldSize + cmd->memSize();
+    }
+
+    UNDO_TRACE("UNDO: Undo data in disk %s\n",
+               base::get_pretty_memory_size(m_spillFile->usedSize()).c_str());
+    return true;
+  }
+  catch (const std::exception& ex) {
+    LOG(ERROR, "UNDO: Cannot move undo data to disk: %s\n", ex.what());
+    return false;
+  }
+}
+
+void DocUndo::unspillCmd(Cmd* cmd)
+{
+  const size_t oldSize = cmd->memSize();
+  try {
+    cmd->unspill();
+  }
+  catch (...) {
+    m_totalUndoSize = m_totalUndoSize - oldSize + cmd->memSize();
+    throw;
+  }
+  m_totalUndoSize = m_totalUndoSize - oldSize + cmd->memSize();
+}
+
 void DocUndo::onDeleteUndoState(undo::UndoState* state)
 {
   ASSERT(state);
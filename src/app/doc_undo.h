@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "undo/undo_history.h"
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
 namespace app {
@@ -26,6 +27,7 @@ class Cmd;
 class CmdTransaction;
 class Context;
 class DocUndoObserver;
+class DocUndoSpillFile;
 
 // Exception thrown when we want to modify the sprite (add new
 // app::Cmd objects) when we are undoing/redoing/moving throw the
@@ -100,10 +102,23 @@ public:
 
   void moveToState(const undo::UndoState* state);
 
+  // Moves the data of the oldest undo states to the spill file until
+  // the total undo size is less than the given limit. Returns false
+  // if the data cannot be moved to the disk. It's called
+  // automatically when a new state is added and the undo limit is
+  // reached.
+  bool spillOldStates(size_t undoLimitSize);
+
+  const std::shared_ptr<DocUndoSpillFile>& spillFile() const { return m_spillFile; }
+
 private:
   const undo::UndoState* nextUndo() const;
   const undo::UndoState* nextRedo() const;
 
+  // Loads the data of the given command from the spill file before
+  // undoing/redoing it (if it fails, nothing is undone/redone).
+  void unspillCmd(Cmd* cmd);
+
   // undo::UndoHistoryDelegate impl
   void onDeleteUndoState(undo::UndoState* state) override;
 
@@ -112,6 +127,10 @@ private:
   Context* m_ctx = nullptr;
   size_t m_totalUndoSize = 0;
 
+  // Temporary file where the data of old undo states is moved when
+  // we reach the undo size limit (instead of deleting those states)
+  std::shared_ptr<DocUndoSpillFile> m_spillFile;
+
   // True when we are undoing/redoing. Used to avoid adding new undo
   // information when we are moving through the undo history.
   bool m_undoing = false;
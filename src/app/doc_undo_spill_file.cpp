@@ -0,0 +1,195 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/doc_undo_spill_file.h"
+
+#include "base/debug.h"
+#include "base/exception.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/process.h"
+#include "fmt/format.h"
+#include "ver/info.h"
+
+#include "zlib.h"
+
+#include <atomic>
+#include <limits>
+
+namespace app {
+
+DocUndoSpillFile::DocUndoSpillFile()
+{
+}
+
+DocUndoSpillFile::~DocUndoSpillFile()
+{
+  if (m_file.is_open()) {
+    m_file.close();
+    try {
+      base::delete_file(m_filename);
+    }
+    catch (...) {
+      // Ignore errors deleting the temporary file
+    }
+  }
+}
+
+DocUndoSpillFile::Block DocUndoSpillFile::write(const void* data, const size_t size)
+{
+  if (size > std::numeric_limits<uint32_t>::max() / 2)
+    throw base::Exception("Undo data too big to be moved to disk");
+
+  open();
+
+  uLongf compressedSize = compressBound(uLong(size));
+  std::string compressed(compressedSize, 0);
+  if (compress2((Bytef*)compressed.data(),
+                &compressedSize,
+                (const Bytef*)data,
+                uLong(size),
+                Z_BEST_SPEED) != Z_OK) {
+    throw base::Exception("Error compressing undo data");
+  }
+
+  Block block;
+  block.size = uint32_t(compressedSize);
+  block.origSize = uint32_t(size);
+  block.offset = allocate(block.size);
+  m_usedSize += block.size;
+
+  m_file.clear();
+  m_file.seekp(std::streamoff(block.offset));
+  m_file.write(compressed.data(), block.size);
+  m_file.flush();
+  if (!m_file) {
+    free(block);
+    throw base::Exception("Error writing undo data in %s", m_filename.c_str());
+  }
+  return block;
+}
+
+std::string DocUndoSpillFile::read(const Block& block)
+{
+  std::string compressed(block.size, 0);
+  m_file.clear();
+  m_file.seekg(std::streamoff(block.offset));
+  m_file.read(compressed.data(), block.size);
+  if (!m_file)
+    throw base::Exception("Error reading undo data from %s", m_filename.c_str());
+
+  std::string data(block.origSize, 0);
+  uLongf size = block.origSize;
+  if (uncompress((Bytef*)data.data(), &size, (const Bytef*)compressed.data(), block.size) !=
+        Z_OK ||
+      size != block.origSize) {
+    throw base::Exception("Error uncompressing undo data");
+  }
+  return data;
+}
+
+void DocUndoSpillFile::free(const Block& block)
+{
+  if (block.size == 0)
+    return;
+
+  ASSERT(m_usedSize >= block.size);
+  m_usedSize -= block.size;
+
+  uint64_t offset = block.offset;
+  uint64_t size = block.size;
+
+  // Join with the next free range
+  auto next = m_freeRanges.find(offset + size);
+  if (next != m_freeRanges.end()) {
+    size += next->second;
+    m_freeRanges.erase(next);
+  }
+
+  // Join with the previous free range
+  auto prev = m_freeRanges.lower_bound(offset);
+  if (prev != m_freeRanges.begin()) {
+    --prev;
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+      m_freeRanges.erase(prev);
+    }
+  }
+
+  // The free space at the end of the file is just discarded
+  if (offset + size == m_fileSize)
+    m_fileSize = offset;
+  else
+    m_freeRanges[offset] = size;
+}
+
+void DocUndoSpillFile::open()
+{
+  if (m_file.is_open())
+    return;
+
+  static std::atomic<int> counter(0);
+  m_filename = base::join_path(base::get_temp_path(),
+                               fmt::format("{}-undo-{}-{}.tmp",
+                                           get_app_name(),
+                                           base::get_current_process_id(),
+                                           ++counter));
+
+  m_file.open(FSTREAM_PATH(m_filename),
+              std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!m_file.is_open())
+    throw base::Exception("Cannot create the undo file %s", m_filename.c_str());
+}
+
+uint64_t DocUndoSpillFile::allocate(const uint64_t size)
+{
+  // First fit in a free range
+  for (auto it = m_freeRanges.begin(); it != m_freeRanges.end(); ++it) {
+    if (it->second >= size) {
+      const uint64_t offset = it->first;
+      const uint64_t rest = it->second - size;
+      m_freeRanges.erase(it);
+      if (rest > 0)
+        m_freeRanges[offset + size] = rest;
+      return offset;
+    }
+  }
+
+  const uint64_t offset = m_fileSize;
+  m_fileSize += size;
+  return offset;
+}
+
+SpilledData::~SpilledData()
+{
+  if (m_file)
+    m_file->free(m_block);
+}
+
+void SpilledData::spill(const std::shared_ptr<DocUndoSpillFile>& file,
+                        const void* data,
+                        const size_t size)
+{
+  ASSERT(!m_file);
+  m_block = file->write(data, size);
+  m_file = file;
+}
+
+std::string SpilledData::unspill()
+{
+  ASSERT(m_file);
+  std::string data = m_file->read(m_block);
+  m_file->free(m_block);
+  m_file.reset();
+  return data;
+}
+
+} // namespace app
@@ -0,0 +1,91 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_DOC_UNDO_SPILL_FILE_H_INCLUDED
+#define APP_DOC_UNDO_SPILL_FILE_H_INCLUDED
+#pragma once
+
+#include "base/disable_copying.h"
+#include "base/ints.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace app {
+
+// Temporary file where DocUndo moves the data of old undo states
+// (compressed) to release memory. The data is read again from the
+// file when the user undoes/redoes those states. The file is deleted
+// when this object is destroyed.
+class DocUndoSpillFile {
+public:
+  // Location of a block of compressed data in the file.
+  struct Block {
+    uint64_t offset = 0;
+    uint32_t size = 0;     // Compressed size (bytes used in the file)
+    uint32_t origSize = 0; // Uncompressed size
+  };
+
+  DocUndoSpillFile();
+  ~DocUndoSpillFile();
+
+  // Compresses the given data and writes it in the file. Throws an
+  // exception if the data cannot be saved.
+  Block write(const void* data, size_t size);
+
+  // Reads and uncompresses the data of the given block.
+  std::string read(const Block& block);
+
+  // Marks the space used by the given block as free (it can be
+  // reused by new blocks).
+  void free(const Block& block);
+
+  const std::string& filename() const { return m_filename; }
+
+  // Bytes used by blocks in the file.
+  uint64_t usedSize() const { return m_usedSize; }
+
+private:
+  void open();
+  uint64_t allocate(uint64_t size);
+
+  std::string m_filename;
+  std::fstream m_file;
+  uint64_t m_fileSize = 0;
+  uint64_t m_usedSize = 0;
+
+  // Free ranges of the file (offset -> size)
+  std::map<uint64_t, uint64_t> m_freeRanges;
+
+  DISABLE_COPYING(DocUndoSpillFile);
+};
+
+// Data of an undo command moved to a DocUndoSpillFile.
+class SpilledData {
+public:
+  SpilledData() {}
+  ~SpilledData();
+
+  bool isSpilled() const { return m_file != nullptr; }
+
+  // Moves the given data to the file.
+  void spill(const std::shared_ptr<DocUndoSpillFile>& file, const void* data, size_t size);
+
+  // Reads the data from the file and releases its space in the file.
+  std::string unspill();
+
+private:
+  std::shared_ptr<DocUndoSpillFile> m_file;
+  DocUndoSpillFile::Block m_block;
+
+  DISABLE_COPYING(SpilledData);
+};
+
+} // namespace app
+
+#endif
@@ -0,0 +1,76 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/doc_undo_spill_file.h"
+#include "base/fs.h"
+
+#include <memory>
+#include <string>
+
+using namespace app;
+
+static std::string make_data(const int size, const int seed)
+{
+  std::string data(size, 0);
+  for (int i = 0; i < size; ++i)
+    data[i] = char((i / 7 + seed) & 0xff);
+  return data;
+}
+
+TEST(DocUndoSpillFile, WriteRead)
+{
+  std::string filename;
+  {
+    DocUndoSpillFile file;
+    const std::string a = make_data(1000, 1);
+    const std::string b = make_data(5000, 2);
+
+    auto blockA = file.write(a.data(), a.size());
+    auto blockB = file.write(b.data(), b.size());
+    filename = file.filename();
+    EXPECT_TRUE(base::is_file(filename));
+
+    EXPECT_EQ(a, file.read(blockA));
+    EXPECT_EQ(b, file.read(blockB));
+    EXPECT_EQ(blockA.size + blockB.size, file.usedSize());
+
+    // The space of "a" is reused for "c" (which is smaller)
+    file.free(blockA);
+    const std::string c = make_data(100, 3);
+    auto blockC = file.write(c.data(), c.size());
+    EXPECT_EQ(blockA.offset, blockC.offset);
+    EXPECT_EQ(c, file.read(blockC));
+    EXPECT_EQ(b, file.read(blockB));
+
+    file.free(blockB);
+    file.free(blockC);
+    EXPECT_EQ(0, file.usedSize());
+  }
+  // The file is deleted
+  EXPECT_FALSE(base::is_file(filename));
+}
+
+TEST(DocUndoSpillFile, SpilledData)
+{
+  auto file = std::make_shared<DocUndoSpillFile>();
+  const std::string a = make_data(4096, 4);
+  {
+    SpilledData data;
+    EXPECT_FALSE(data.isSpilled());
+    data.spill(file, a.data(), a.size());
+    EXPECT_TRUE(data.isSpilled());
+    EXPECT_LT(0, file->usedSize());
+    EXPECT_EQ(a, data.unspill());
+    EXPECT_FALSE(data.isSpilled());
+    EXPECT_EQ(0, file->usedSize());
+
+    data.spill(file, a.data(), a.size());
+  }
+  // Data released when SpilledData is destroyed
+  EXPECT_EQ(0, file->usedSize());
+}
@@ -0,0 +1,181 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/cmd/add_cel.h"
+#include "app/cmd/clear_image.h"
+#include "app/cmd/copy_region.h"
+#include "app/cmd/replace_image.h"
+#include "app/context.h"
+#include "app/doc.h"
+#include "app/doc_undo.h"
+#include "app/doc_undo_spill_file.h"
+#include "app/test_context.h"
+#include "app/tx.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/layer.h"
+#include "doc/primitives.h"
+
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace app;
+using namespace doc;
+
+namespace {
+
+class DocUndoSpillTest : public ::testing::Test {
+public:
+  DocUndoSpillTest()
+    : doc(ctx.documents().add(64, 64))
+    , sprite(doc->sprite())
+    , layer1(static_cast<LayerImage*>(sprite->root()->firstLayer()))
+    , layer2(new LayerImage(sprite))
+    , history(doc->undoHistory())
+  {
+    sprite->root()->addLayer(layer2);
+    copy_image(layer1->cel(0)->image(), randomImage().get());
+    snapshots.push_back(snapshot());
+  }
+
+  ~DocUndoSpillTest() { doc->close(); }
+
+  ImageRef randomImage()
+  {
+    ImageRef image(Image::create(sprite->spec()));
+    for (int y = 0; y < image->height(); ++y)
+      for (int x = 0; x < image->width(); ++x)
+        put_pixel(image.get(), x, y, rgba(rng() % 256, rng() % 256, rng() % 256, 255));
+    return image;
+  }
+
+  // Copy of the images of both layers in the first frame
+  std::vector<ImageRef> snapshot() const
+  {
+    std::vector<ImageRef> images;
+    for (const LayerImage* layer : { layer1, layer2 }) {
+      const Cel* cel = layer->cel(0);
+      images.emplace_back(cel ? Image::createCopy(cel->image()) : nullptr);
+    }
+    return images;
+  }
+
+  void expectSnapshot(const int i) const
+  {
+    const std::vector<ImageRef> images = snapshot();
+    for (int j = 0; j < int(images.size()); ++j) {
+      const ImageRef& expected = snapshots[i][j];
+      ASSERT_EQ(expected == nullptr, images[j] == nullptr) << "State " << i << " layer " << j;
+      if (expected)
+        EXPECT_EQ(0, count_diff_between_images(expected.get(), images[j].get()))
+          << "State " << i << " layer " << j;
+    }
+  }
+
+  void execute(Cmd* cmd)
+  {
+    Tx tx(sprite, "Test");
+    tx(cmd);
+    tx.commit();
+    snapshots.push_back(snapshot());
+  }
+
+  // Executes commands of all types that can move their data to disk
+  void executeCmds()
+  {
+    execute(new cmd::AddCel(layer2, new Cel(0, randomImage())));
+    execute(new cmd::ClearImage(layer1->cel(0)->image(), rgba(255, 0, 0, 255)));
+    execute(new cmd::CopyRegion(layer1->cel(0)->image(),
+                                randomImage().get(),
+                                gfx::Region(gfx::Rect(5, 7, 40, 30)),
+                                gfx::Point(0, 0)));
+    execute(new cmd::ReplaceImage(sprite, layer1->cel(0)->imageRef(), randomImage()));
+    execute(new cmd::ClearImage(layer2->cel(0)->image(), rgba(0, 0, 255, 255)));
+  }
+
+  std::mt19937 rng{ 1 };
+  TestContextT<Context> ctx;
+  std::unique_ptr<Doc> doc;
+  Sprite* sprite;
+  LayerImage* layer1;
+  LayerImage* layer2;
+  DocUndo* history;
+  std::vector<std::vector<ImageRef>> snapshots;
+};
+
+} // anonymous namespace
+
+TEST_F(DocUndoSpillTest, SpillUndoRedo)
+{
+  executeCmds();
+  const int n = int(snapshots.size()) - 1;
+
+  const size_t undoSize = history->totalUndoSize();
+  EXPECT_TRUE(history->spillOldStates(0));
+  EXPECT_LT(history->totalUndoSize(), undoSize);
+  ASSERT_TRUE(history->spillFile());
+  EXPECT_LT(0, history->spillFile()->usedSize());
+
+  for (int i = n - 1; i >= 0; --i) {
+    history->undo();
+    expectSnapshot(i);
+  }
+  EXPECT_FALSE(history->canUndo());
+  EXPECT_EQ(0, history->spillFile()->usedSize());
+
+  for (int i = 1; i <= n; ++i) {
+    history->redo();
+    expectSnapshot(i);
+  }
+
+  // Spill again and jump directly to the first state
+  EXPECT_TRUE(history->spillOldStates(0));
+  history->moveToState(history->firstState());
+  expectSnapshot(1);
+  history->moveToState(history->lastState());
+  expectSnapshot(n);
+}
+
+TEST_F(DocUndoSpillTest, CannotUnspill)
+{
+  executeCmds();
+  const int n = int(snapshots.size()) - 1;
+
+  EXPECT_TRUE(history->spillOldStates(0));
+
+  // Corrupt the spill file
+  {
+    const std::string filename = history->spillFile()->filename();
+    const std::string zeros(size_t(history->spillFile()->usedSize()), 0);
+    std::fstream f(filename, std::ios::in | std::ios::out | std::ios::binary);
+    f.write(zeros.data(), zeros.size());
+  }
+
+  // The last state is still in memory
+  history->undo();
+  expectSnapshot(n - 1);
+
+  // Nothing is undone if the data cannot be loaded
+  const undo::UndoState* state = history->currentState();
+  const size_t undoSize = history->totalUndoSize();
+  EXPECT_ANY_THROW(history->undo());
+  expectSnapshot(n - 1);
+  EXPECT_EQ(state, history->currentState());
+  EXPECT_EQ(undoSize, history->totalUndoSize());
+
+  EXPECT_ANY_THROW(history->moveToState(history->firstState()));
+  expectSnapshot(n - 1);
+  EXPECT_EQ(state, history->currentState());
+
+  // We can still redo the last state
+  history->redo();
+  expectSnapshot(n);
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -14,6 +14,7 @@
 #include "app/file/file.h"
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
+#include "base/buffer.h"
 #include "base/cfile.h"
 #include "base/exception.h"
 #include "base/file_handle.h"
@@ -24,15 +25,20 @@
 #include "dio/decode_delegate.h"
 #include "dio/file_interface.h"
 #include "doc/doc.h"
+#include "doc/parallel.h"
 #include "fixmath/fixmath.h"
 #include "fmt/format.h"
 #include "ui/alert.h"
 #include "ver/info.h"
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <deque>
+#include <memory>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 
 #define ASEFILE_TRACE(...) // TRACE(__VA_ARGS__)
 
@@ -124,6 +130,39 @@ public:
   }
 };
 
+// Compresses cel images in other threads (in the same order they
+// are added, which should be the same order they are written), so
+// the thread writing the file only needs to wait for the compressed
+// data and write it.
+class CelImagesCompressor {
+public:
+  CelImagesCompressor(const int compressionLevel);
+  ~CelImagesCompressor();
+
+  void addImage(const Image* image);
+  void writeCompressedImage(FILE* f, const Image* image);
+
+private:
+  struct Job {
+    const Image* image;
+    base::buffer data;
+    doc::ParallelJobs::JobPtr job;
+
+    Job(const Image* image) : image(image) {}
+  };
+
+  void startJobs(const int until);
+
+  int m_compressionLevel;
+  int m_threads;
+  std::vector<std::unique_ptr<Job>> m_jobs;
+  std::unordered_map<ObjectId, int> m_index;
+  int m_started;
+  // Destroyed first to wait jobs that are still running (e.g. if we
+  // stopped saving the file in the middle of the process)
+  doc::ParallelJobs m_parallelJobs;
+};
+
 } // anonymous namespace
 
 static void ase_file_prepare_header(FILE* f,
@@ -147,6 +186,7 @@ static layer_t ase_file_write_cels(FILE* f,
                                    FileOp* fop,
                                    dio::AsepriteFrameHeader* frame_header,
                                    const dio::AsepriteExternalFiles& ext_files,
+                                   CelImagesCompressor& compressor,
                                    const Sprite* sprite,
                                    const Layer* layer,
                                    layer_t layer_index,
@@ -175,6 +215,7 @@ static void ase_file_write_layer_chunk(FILE* f,
                                        int child_level);
 static void ase_file_write_cel_chunk(FILE* f,
                                      dio::AsepriteFrameHeader* frame_header,
+                                     CelImagesCompressor& compressor,
                                      const Cel* cel,
                                      const LayerImage* layer,
                                      const layer_t layer_index,
@@ -365,6 +406,17 @@ bool AseFormat::onSave(FileOp* fop)
     }
   }
 
+  // Compress all cel images in background threads while we write
+  // the file (linked cels inside the ROI don't need their images)
+  CelImagesCompressor compressor(fop->config().aseCompressionLevel);
+  for (frame_t frame : fop->roi().framesSequence()) {
+    for (const Cel* cel : sprite->cels(frame)) {
+      const Cel* link = cel->link();
+      if (cel->image() && (!link || link->frame() < fop->roi().fromFrame()))
+        compressor.addImage(cel->image());
+    }
+  }
+
   // Write frames
   int outputFrame = 0;
   dio::AsepriteExternalFiles ext_files;
@@ -444,7 +496,15 @@ bool AseFormat::onSave(FileOp* fop)
     }
 
     // Write cel chunks
-    ase_file_write_cels(f, fop, &frame_header, ext_files, sprite, sprite->root(), 0, frame);
+    ase_file_write_cels(f,
+                        fop,
+                        &frame_header,
+                        ext_files,
+                        compressor,
+                        sprite,
+                        sprite->root(),
+                        0,
+                        frame);
 
     // Write the frame header
     ase_file_write_frame_header(f, &frame_header);
@@ -597,6 +657,7 @@ static layer_t ase_file_write_cels(FILE* f,
                                    FileOp* fop,
                                    dio::AsepriteFrameHeader* frame_header,
                                    const dio::AsepriteExternalFiles& ext_files,
+                                   CelImagesCompressor& compressor,
                                    const Sprite* sprite,
                                    const Layer* layer,
                                    layer_t layer_index,
@@ -607,6 +668,7 @@ static layer_t ase_file_write_cels(FILE* f,
     if (cel) {
       ase_file_write_cel_chunk(f,
                                frame_header,
+                               compressor,
                                cel,
                                static_cast<const LayerImage*>(layer),
                                layer_index,
@@ -628,7 +690,15 @@ static layer_t ase_file_write_cels(FILE* f,
   if (layer->isGroup()) {
     for (const Layer* child : static_cast<const LayerGroup*>(layer)->layers()) {
       layer_index =
-        ase_file_write_cels(f, fop, frame_header, ext_files, sprite, child, layer_index, frame);
+        ase_file_write_cels(f,
+                            fop,
+                            frame_header,
+                            ext_files,
+                            compressor,
+                            sprite,
+                            child,
+                            layer_index,
+                            frame);
     }
   }
 
@@ -885,7 +955,9 @@ static void write_raw_image(FILE* f, ScanlinesGen* gen, PixelFormat pixelFormat)
 //////////////////////////////////////////////////////////////////////
 
 template<typename ImageTraits>
-static void write_compressed_image_templ(FILE* f, ScanlinesGen* gen, base::buffer* compressedOutput)
+static void compress_image_templ(const ScanlinesGen* gen,
+                                 const int compressionLevel,
+                                 base::buffer& output)
 {
   PixelIO<ImageTraits> pixel_io;
   z_stream zstream;
@@ -894,14 +966,19 @@ static void write_compressed_image_templ(FILE* f, ScanlinesGen* gen, base::buffe
   zstream.zalloc = (alloc_func)0;
   zstream.zfree = (free_func)0;
   zstream.opaque = (voidpf)0;
-  err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+  err = deflateInit(&zstream, compressionLevel);
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in deflateInit().", err);
 
+  const gfx::Size imgSize = gen->getImageSize();
   std::vector<uint8_t> scanline(gen->getScanlineSize());
-  std::vector<uint8_t> compressed(4096);
 
-  const gfx::Size imgSize = gen->getImageSize();
+  // Compress directly in the output buffer (which is big enough for
+  // the worst case), so we don't need intermediate copies.
+  output.resize(deflateBound(&zstream, uLong(scanline.size()) * imgSize.h));
+  zstream.next_out = (Bytef*)output.data();
+  zstream.avail_out = output.size();
+
   for (y = 0; y < imgSize.h; ++y) {
     typename ImageTraits::address_t address =
       (typename ImageTraits::address_t)gen->getScanlineAddress(y);
@@ -913,66 +990,138 @@ static void write_compressed_image_templ(FILE* f, ScanlinesGen* gen, base::buffe
     int flush = (y == imgSize.h - 1 ? Z_FINISH : Z_NO_FLUSH);
 
     do {
-      zstream.next_out = (Bytef*)&compressed[0];
-      zstream.avail_out = compressed.size();
+      if (zstream.avail_out == 0) {
+        output.resize(output.size() + 4096);
+        zstream.next_out = (Bytef*)output.data() + zstream.total_out;
+        zstream.avail_out = output.size() - zstream.total_out;
+      }
 
       // Compress
       err = deflate(&zstream, flush);
-      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR)
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+        deflateEnd(&zstream);
         throw base::Exception("ZLib error %d in deflate().", err);
-
-      int output_bytes = compressed.size() - zstream.avail_out;
-      if (output_bytes > 0) {
-        if ((fwrite(&compressed[0], 1, output_bytes, f) != (size_t)output_bytes) || ferror(f))
-          throw base::Exception("Error writing compressed image pixels.\n");
-
-        // Save the whole compressed buffer to re-use in following
-        // save options (so we don't have to re-compress the whole
-        // tileset)
-        if (compressedOutput) {
-          std::size_t n = compressedOutput->size();
-          compressedOutput->resize(n + output_bytes);
-          std::copy(compressed.begin(),
-                    compressed.begin() + output_bytes,
-                    compressedOutput->begin() + n);
-        }
       }
     } while (zstream.avail_out == 0);
   }
 
+  output.resize(zstream.total_out);
+
   err = deflateEnd(&zstream);
   if (err != Z_OK)
     throw base::Exception("ZLib error %d in deflateEnd().", err);
 }
 
-static void write_compressed_image(FILE* f,
-                                   ScanlinesGen* gen,
-                                   PixelFormat pixelFormat,
-                                   base::buffer* compressedOutput = nullptr)
+static void compress_image(const ScanlinesGen* gen,
+                           PixelFormat pixelFormat,
+                           const int compressionLevel,
+                           base::buffer& output)
 {
   switch (pixelFormat) {
-    case IMAGE_RGB: write_compressed_image_templ<RgbTraits>(f, gen, compressedOutput); break;
+    case IMAGE_RGB: compress_image_templ<RgbTraits>(gen, compressionLevel, output); break;
 
     case IMAGE_GRAYSCALE:
-      write_compressed_image_templ<GrayscaleTraits>(f, gen, compressedOutput);
+      compress_image_templ<GrayscaleTraits>(gen, compressionLevel, output);
       break;
 
     case IMAGE_INDEXED:
-      write_compressed_image_templ<IndexedTraits>(f, gen, compressedOutput);
+      compress_image_templ<IndexedTraits>(gen, compressionLevel, output);
       break;
 
     case IMAGE_TILEMAP:
-      write_compressed_image_templ<TilemapTraits>(f, gen, compressedOutput);
+      compress_image_templ<TilemapTraits>(gen, compressionLevel, output);
       break;
   }
 }
 
+static void write_compressed_data(FILE* f, const base::buffer& data)
+{
+  if (!data.empty() &&
+      ((fwrite(data.data(), 1, data.size(), f) != data.size()) || ferror(f))) {
+    throw base::Exception("Error writing compressed image pixels.\n");
+  }
+}
+
+static void write_compressed_image(FILE* f,
+                                   ScanlinesGen* gen,
+                                   PixelFormat pixelFormat,
+                                   const int compressionLevel,
+                                   base::buffer* compressedOutput = nullptr)
+{
+  base::buffer data;
+  compress_image(gen, pixelFormat, compressionLevel, data);
+  write_compressed_data(f, data);
+
+  // Save the whole compressed buffer to re-use in following save
+  // operations (so we don't have to re-compress the whole tileset)
+  if (compressedOutput)
+    *compressedOutput = std::move(data);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Cel Images Compressor
+//////////////////////////////////////////////////////////////////////
+
+CelImagesCompressor::CelImagesCompressor(const int compressionLevel)
+  : m_compressionLevel(compressionLevel)
+  , m_threads(doc::parallel_threads())
+  , m_started(0)
+{
+}
+
+CelImagesCompressor::~CelImagesCompressor() = default;
+
+void CelImagesCompressor::addImage(const Image* image)
+{
+  // With only one thread we compress each image when it's written.
+  if (m_threads < 2 || m_index.find(image->id()) != m_index.end())
+    return;
+
+  m_index[image->id()] = int(m_jobs.size());
+  m_jobs.push_back(std::make_unique<Job>(image));
+}
+
+void CelImagesCompressor::writeCompressedImage(FILE* f, const Image* image)
+{
+  auto it = m_index.find(image->id());
+  if (it == m_index.end()) {
+    ImageScanlines scan(image);
+    write_compressed_image(f, &scan, image->pixelFormat(), m_compressionLevel);
+    return;
+  }
+
+  // Each job is used only once
+  const int i = it->second;
+  m_index.erase(it);
+
+  // Start compressing the next images while we wait this one
+  startJobs(i + 2 * m_threads);
+
+  Job* job = m_jobs[i].get();
+  m_parallelJobs.wait(job->job);
+
+  write_compressed_data(f, job->data);
+  job->data = base::buffer();
+}
+
+void CelImagesCompressor::startJobs(const int until)
+{
+  for (; m_started < std::min(until, int(m_jobs.size())); ++m_started) {
+    Job* job = m_jobs[m_started].get();
+    job->job = m_parallelJobs.start([this, job] {
+      ImageScanlines scan(job->image);
+      compress_image(&scan, job->image->pixelFormat(), m_compressionLevel, job->data);
+    });
+  }
+}
+
 //////////////////////////////////////////////////////////////////////
 // Cel Chunk
 //////////////////////////////////////////////////////////////////////
 
 static void ase_file_write_cel_chunk(FILE* f,
                                      dio::AsepriteFrameHeader* frame_header,
+                                     CelImagesCompressor& compressor,
                                      const Cel* cel,
                                      const LayerImage* layer,
                                      const layer_t layer_index,
@@ -1042,8 +1191,7 @@ static void ase_file_write_cel_chunk(FILE* f,
         fputw(image->width(), f);
         fputw(image->height(), f);
 
-        ImageScanlines scan(image);
-        write_compressed_image(f, &scan, image->pixelFormat());
+        compressor.writeCompressedImage(f, image);
       }
       else {
         // Width and height
@@ -1067,8 +1215,7 @@ static void ase_file_write_cel_chunk(FILE* f,
       fputl(tile_f_dflip, f);
       ase_file_write_padding(f, 10);
 
-      ImageScanlines scan(image);
-      write_compressed_image(f, &scan, IMAGE_TILEMAP);
+      compressor.writeCompressedImage(f, image);
     }
   }
 }
@@ -1511,7 +1658,11 @@ static void ase_file_write_tileset_chunk(FILE* f,
       if (fop->config().cacheCompressedTilesets)
         compressedDataPtr = &compressedData;
 
-      write_compressed_image(f, &gen, tileset->sprite()->pixelFormat(), compressedDataPtr);
+      write_compressed_image(f,
+                             &gen,
+                             tileset->sprite()->pixelFormat(),
+                             fop->config().aseCompressionLevel,
+                             compressedDataPtr);
 
       // As we've just compressed the tileset, we can cache this same
       // data (so saving the file again will not need recompressing).
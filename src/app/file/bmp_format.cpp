@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -63,7 +63,7 @@ class BmpFormat : public FileFormat {
   {
     return FILE_SUPPORT_LOAD | FILE_SUPPORT_SAVE | FILE_SUPPORT_RGB | FILE_SUPPORT_RGBA |
            FILE_SUPPORT_GRAY | FILE_SUPPORT_INDEXED | FILE_SUPPORT_SEQUENCES |
-           FILE_ENCODE_ABSTRACT_IMAGE;
+           FILE_ENCODE_ABSTRACT_IMAGE | FILE_PARALLEL_SEQUENCES;
   }
 
   bool onLoad(FileOp* fop) override;
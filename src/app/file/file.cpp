@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -36,6 +36,7 @@
 #include "dio/detect_format.h"
 #include "doc/algorithm/resize_image.h"
 #include "doc/doc.h"
+#include "doc/parallel.h"
 #include "fmt/format.h"
 #include "render/quantization.h"
 #include "render/render.h"
@@ -50,6 +51,7 @@
 #include <algorithm>
 #include <cstdarg>
 #include <cstring>
+#include <deque>
 
 namespace app {
 
@@ -94,11 +96,14 @@ public:
         m_tmpScaledImage.reset(doc::Image::create(m_spec));
       }
 
+      // The nearest neighbor method doesn't need a RgbMap (and we
+      // cannot use the sprite one, as this function can be called
+      // from several threads when saving a sequence of files).
       doc::algorithm::resize_image(image.get(),
                                    m_tmpScaledImage.get(),
                                    doc::algorithm::RESIZE_METHOD_NEAREST_NEIGHBOR,
                                    palette(frame),
-                                   m_sprite->rgbMap(frame),
+                                   nullptr,
                                    image->maskColor());
     }
   }
@@ -118,10 +123,17 @@ public:
 
   const doc::Palette* palette(doc::frame_t frame) const override
   {
+    if (m_framePalette)
+      return m_framePalette;
+
     ASSERT(m_sprite);
     return m_sprite->palette(frame);
   }
 
+  // Palette of the only frame to be saved (used by SequenceJobs so
+  // the worker thread doesn't access the sprite palettes).
+  void setFramePalette(const doc::Palette* palette) { m_framePalette = palette; }
+
   doc::PalettesList palettes() const override
   {
     ASSERT(m_sprite);
@@ -151,6 +163,7 @@ public:
     render::Render render;
     render.setNewBlend(m_newBlend);
     render.setBgOptions(render::BgOptions::MakeNone());
+    render.setThreads(0); // Use all CPU cores to render big frames
     render.renderSprite((needResize ? m_tmpUnscaledRender.get() : dst),
                         m_sprite,
                         frame,
@@ -166,6 +179,8 @@ public:
     }
   }
 
+  const gfx::PointF& scale() const { return m_scale; }
+
   void setScale(const gfx::PointF& scale)
   {
     m_scale = scale;
@@ -184,6 +199,252 @@ private:
   doc::ImageRef m_tmpScaledImage = nullptr;
   mutable doc::ImageRef m_tmpUnscaledRender = nullptr;
   gfx::PointF m_scale = gfx::PointF(1.0, 1.0);
+  const doc::Palette* m_framePalette = nullptr;
+};
+
+// Each file of the sequence is loaded/saved in a worker thread with
+// its own FileOp (its own filename, image, palette, etc.). The
+// results are collected in the same order of the sequence from the
+// thread that calls FileOp::operate(), so the sprite is assembled
+// (and errors are reported) as if the files were processed one by
+// one.
+//
+// To save files, each job owns the rendered image and a copy of the
+// palette of its frame. The document is shared but it's locked for
+// reading by the caller of FileOp::operate() (e.g. SaveFileJob), so
+// the thread that renders the frames and the workers that encode
+// them can only read it (the encoders just read some properties of
+// the sprite like the transparent color or the color space).
+class FileOp::SequenceJobs {
+public:
+  static bool canBeUsed(const FileOp* fop)
+  {
+    return (fop->m_format->support(FILE_PARALLEL_SEQUENCES) &&
+            fop->m_seq.filename_list.size() > 1 && doc::parallel_threads() >= 2);
+  }
+
+  SequenceJobs(FileOp* fop) : m_fop(fop), m_threads(doc::parallel_threads()) {}
+
+  // Loads the given file of the sequence, and starts loading the
+  // next files in the meantime. The result is moved to m_fop as if
+  // m_format->load(m_fop) was called for this file.
+  bool load(const frame_t frame)
+  {
+    const int n = int(m_fop->m_seq.filename_list.size());
+    for (m_next = std::max<int>(m_next, frame); m_next < n && !isFull(); ++m_next)
+      startLoad(m_next);
+
+    std::unique_ptr<Job> job = waitNextJob();
+    ASSERT(job->index == frame);
+
+    FileOp* fop = job->fop.get();
+    Sprite* sprite = m_fop->m_document->sprite();
+    const Sprite* fileSprite = fop->m_document->sprite();
+
+    if (fop->hasError())
+      m_fop->setError("%s", fop->error().c_str());
+
+    m_fop->m_seq.image = fop->m_seq.image;
+    m_fop->m_seq.last_cel = fop->m_seq.last_cel;
+    m_fop->m_seq.frame = fop->m_seq.frame;
+    fop->m_seq.last_cel = nullptr;
+
+    if (fop->m_seq.has_alpha)
+      m_fop->m_seq.has_alpha = true;
+
+    // Apply the changes made by the decoder to the palette of the
+    // sequence, as if this file was loaded after the previous ones
+    // (e.g. RGB files don't touch the palette of the sequence).
+    for (const SeqPaletteChange& change : fop->m_seq.palette_changes)
+      change.apply(m_fop->m_seq.palette);
+
+    if (fop->m_formatOptions)
+      m_fop->setLoadedFormatOptions(fop->m_formatOptions);
+    if (fop->hasEmbeddedColorProfile())
+      m_fop->setEmbeddedColorProfile();
+    if (fop->hasEmbeddedGridBounds())
+      m_fop->setEmbeddedGridBounds();
+
+    // Changes to the sprite made by the decoder
+    if (fileSprite->transparentColor() != job->initialSpec.maskColor())
+      sprite->setTransparentColor(fileSprite->transparentColor());
+    if (fileSprite->colorSpace() != job->initialSpec.colorSpace() &&
+        sprite->colorSpace()->type() == gfx::ColorSpace::None) {
+      sprite->setColorSpace(fileSprite->colorSpace());
+      m_fop->m_document->notifyColorSpaceChanged();
+    }
+
+    fileDone(job.get());
+    return job->result;
+  }
+
+  bool isFull() const { return int(m_jobs.size()) >= 2 * m_threads; }
+
+  // Starts saving the current m_seq.image/palette/filename of m_fop
+  // in a worker thread. m_fop->m_seq.image is moved to the job.
+  void startSave(const frame_t frame, const int index, const gfx::Rect& bounds)
+  {
+    std::unique_ptr<Job> job = createJob(index, m_fop->m_seq.progress_offset);
+    FileOp* fop = job->fop.get();
+    fop->m_document = m_fop->m_document;
+    fop->m_roi = m_fop->m_roi;
+    fop->m_filename = m_fop->m_filename;
+    fop->m_formatOptions = m_fop->m_formatOptions;
+    fop->m_seq.image = std::move(m_fop->m_seq.image);
+    fop->m_seq.palette = new Palette(*m_fop->m_seq.palette);
+    fop->m_seq.frame = frame;
+
+    // The abstract image is created here (instead of in the worker
+    // thread) to use the palette of this job.
+    if (m_fop->m_format->support(FILE_ENCODE_ABSTRACT_IMAGE)) {
+      if (m_fop->m_abstractImage)
+        fop->setOnTheFlyScale(m_fop->m_abstractImage->scale());
+      else
+        fop->makeAbstractImage();
+      fop->m_abstractImage->setSpecSize(m_fop->m_roi.fileCanvasSize(), bounds.size());
+      fop->m_abstractImage->setFramePalette(fop->m_seq.palette);
+    }
+
+    start(std::move(job));
+  }
+
+  // Waits the oldest file that is being saved. Returns false if it
+  // couldn't be saved (the error is reported in m_fop).
+  bool finishSave()
+  {
+    std::unique_ptr<Job> job = waitNextJob();
+    FileOp* fop = job->fop.get();
+
+    if (fop->hasError())
+      m_fop->setError("%s", fop->error().c_str());
+
+    if (!job->result) {
+      m_fop->setError("Error saving frame %d in the file \"%s\"\n",
+                      job->index + 1,
+                      fop->m_filename.c_str());
+      m_failed = true;
+      return false;
+    }
+
+    fileDone(job.get());
+    return true;
+  }
+
+  void finishAllSaves()
+  {
+    while (!m_failed && !m_jobs.empty())
+      finishSave();
+  }
+
+private:
+  struct Job {
+    std::unique_ptr<FileOp> fop;
+    int index;             // Index of the file in the sequence
+    double progressOffset; // Progress of the sequence before this file
+    // Initial state of the sprite (to load files)
+    doc::ImageSpec initialSpec;
+    bool result = false;
+    doc::ParallelJobs::JobPtr job;
+
+    Job(FileOp* fop, const int index, const double progressOffset)
+      : fop(fop)
+      , index(index)
+      , progressOffset(progressOffset)
+      , initialSpec(doc::ColorMode::RGB, 1, 1)
+    {
+    }
+
+    ~Job()
+    {
+      // Delete the document/cel created to load the file
+      if (fop->m_type == FileOpLoad) {
+        delete fop->m_seq.last_cel;
+        delete fop->releaseDocument();
+      }
+      else {
+        fop->m_document = nullptr;
+      }
+    }
+  };
+
+  std::unique_ptr<Job> createJob(const int index, const double progressOffset)
+  {
+    auto* fop = new FileOp(m_fop->m_type, m_fop->m_context, &m_fop->m_config);
+    fop->m_format = m_fop->m_format;
+    fop->m_parent = m_fop;
+    return std::make_unique<Job>(fop, index, progressOffset);
+  }
+
+  void startLoad(const int index)
+  {
+    std::unique_ptr<Job> job = createJob(index, index * m_fop->m_seq.progress_fraction);
+    FileOp* fop = job->fop.get();
+    fop->m_filename = m_fop->m_seq.filename_list[index];
+    fop->m_oneframe = m_fop->m_oneframe;
+    fop->m_reducedSizeHint = m_fop->m_reducedSizeHint;
+    fop->m_seq.flags = m_fop->m_seq.flags;
+    fop->m_seq.frame = index;
+    fop->m_seq.has_alpha = false;
+
+    // The file is decoded in its own sprite with the same color mode,
+    // transparent color, and color space of the sequence sprite (so
+    // sequenceImageToLoad() can check the color mode of the file and
+    // we can see what the decoder changes).
+    job->initialSpec = m_fop->m_document->sprite()->spec();
+    job->initialSpec.setSize(1, 1);
+    fop->createDocument(new Sprite(job->initialSpec, 256));
+
+    // The palette of the sequence can be modified by the previous
+    // files, so the changes to this copy are recorded and applied
+    // in load() (see sequenceChangePalette()).
+    fop->m_seq.palette = new Palette(*m_fop->m_seq.palette);
+
+    start(std::move(job));
+  }
+
+  void start(std::unique_ptr<Job>&& job)
+  {
+    Job* ptr = job.get();
+    m_jobs.push_back(std::move(job));
+    ptr->job = m_parallelJobs.start([ptr] {
+      FileOp* fop = ptr->fop.get();
+      if (fop->m_type == FileOpLoad)
+        ptr->result = fop->m_format->load(fop);
+#ifdef ENABLE_SAVE
+      else
+        ptr->result = fop->m_format->save(fop);
+#endif
+    });
+  }
+
+  std::unique_ptr<Job> waitNextJob()
+  {
+    ASSERT(!m_jobs.empty());
+    std::unique_ptr<Job> job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+    m_parallelJobs.wait(job->job);
+    return job;
+  }
+
+  // The progress of each file is not reported to m_fop, we report
+  // the progress of the whole sequence when each file is done.
+  void fileDone(const Job* job)
+  {
+    const std::lock_guard lock(m_fop->m_mutex);
+    m_fop->m_progress = job->progressOffset + m_fop->m_seq.progress_fraction;
+    if (m_fop->m_progressInterface)
+      m_fop->m_progressInterface->ackFileOpProgress(m_fop->m_progress);
+  }
+
+  FileOp* m_fop;
+  const int m_threads;
+  int m_next = 0;
+  bool m_failed = false;
+  std::deque<std::unique_ptr<Job>> m_jobs;
+  // Declared after m_jobs so we wait jobs that are still running
+  // (e.g. if we stopped loading or saving the sequence after an
+  // error) before deleting them.
+  doc::ParallelJobs m_parallelJobs;
 };
 
 base::paths get_readable_extensions()
@@ -814,12 +1075,24 @@ void FileOp::operate(IFileOpProgress* progress)
       m_seq.progress_offset = 0.0f;
       m_seq.progress_fraction = 1.0f / (double)frames;
 
+      std::unique_ptr<SequenceJobs> jobs;
+      if (SequenceJobs::canBeUsed(this))
+        jobs = std::make_unique<SequenceJobs>(this);
+
       auto it = m_seq.filename_list.begin(), end = m_seq.filename_list.end();
       for (; it != end; ++it) {
         m_filename = it->c_str();
 
-        // Call the "load" procedure to read the first bitmap.
-        bool loadres = m_format->load(this);
+        bool loadres;
+        // The first file creates the document, the next ones can be
+        // loaded in parallel.
+        if (jobs && old_image) {
+          loadres = jobs->load(frame);
+        }
+        else {
+          // Call the "load" procedure to read the first bitmap.
+          loadres = m_format->load(this);
+        }
         if (!loadres) {
           setError("Error loading frame %d from file \"%s\"\n", frame + 1, m_filename.c_str());
         }
@@ -945,9 +1218,15 @@ void FileOp::operate(IFileOpProgress* progress)
       m_seq.progress_offset = 0.0f;
       m_seq.progress_fraction = 1.0f / (double)sprite->totalFrames();
 
+      // Frames are rendered here and saved in worker threads
+      std::unique_ptr<SequenceJobs> jobs;
+      if (SequenceJobs::canBeUsed(this))
+        jobs = std::make_unique<SequenceJobs>(this);
+
       // For each frame in the sprite.
       render::Render render;
       render.setNewBlend(m_config.newBlend);
+      render.setThreads(0);
 
       frame_t outputFrame = 0;
       for (frame_t frame : m_roi.framesSequence()) {
@@ -955,6 +1234,13 @@ void FileOp::operate(IFileOpProgress* progress)
         if (bounds.isEmpty())
           continue; // Skip frame because there is no slice key
 
+        // The previous image is being saved in a worker thread
+        if (!m_seq.image) {
+          m_seq.image.reset(Image::create(sprite->pixelFormat(),
+                                          m_roi.fileCanvasSize().w,
+                                          m_roi.fileCanvasSize().h));
+        }
+
         if (m_abstractImage) {
           m_abstractImage->setSpecSize(m_roi.fileCanvasSize(), bounds.size());
         }
@@ -979,8 +1265,15 @@ void FileOp::operate(IFileOpProgress* progress)
           // Make directories
           makeDirectories();
 
+          if (jobs) {
+            // Limit the number of rendered images waiting to be saved
+            if (jobs->isFull() && !jobs->finishSave())
+              break;
+
+            jobs->startSave(frame, outputFrame, bounds);
+          }
           // Call the "save" procedure... did it fail?
-          if (!m_format->save(this)) {
+          else if (!m_format->save(this)) {
             setError("Error saving frame %d in the file \"%s\"\n",
                      outputFrame + 1,
                      m_filename.c_str());
@@ -992,6 +1285,9 @@ void FileOp::operate(IFileOpProgress* progress)
         ++outputFrame;
       }
 
+      if (jobs)
+        jobs->finishAllSaves();
+
       m_filename = *m_seq.filename_list.begin();
 
       // Destroy the image
@@ -1218,7 +1514,7 @@ void FileOp::setLoadedFormatOptions(const FormatOptionsPtr& opts)
 
 void FileOp::sequenceSetNColors(int ncolors)
 {
-  m_seq.palette->resize(ncolors);
+  sequenceChangePalette({ SeqPaletteChange::SetNColors, ncolors, 0 });
 }
 
 int FileOp::sequenceGetNColors() const
@@ -1228,7 +1524,7 @@ int FileOp::sequenceGetNColors() const
 
 void FileOp::sequenceSetColor(int index, int r, int g, int b)
 {
-  m_seq.palette->setEntry(index, rgba(r, g, b, 255));
+  sequenceChangePalette({ SeqPaletteChange::SetColor, index, rgba(r, g, b, 255) });
 }
 
 void FileOp::sequenceGetColor(int index, int* r, int* g, int* b) const
@@ -1248,12 +1544,7 @@ void FileOp::sequenceGetColor(int index, int* r, int* g, int* b) const
 
 void FileOp::sequenceSetAlpha(int index, int a)
 {
-  int c = m_seq.palette->getEntry(index);
-  int r = rgba_getr(c);
-  int g = rgba_getg(c);
-  int b = rgba_getb(c);
-
-  m_seq.palette->setEntry(index, rgba(r, g, b, a));
+  sequenceChangePalette({ SeqPaletteChange::SetAlpha, index, color_t(a) });
 }
 
 void FileOp::sequenceGetAlpha(int index, int* a) const
@@ -1265,6 +1556,24 @@ void FileOp::sequenceGetAlpha(int index, int* a) const
     *a = 0;
 }
 
+void FileOp::sequenceChangePalette(const SeqPaletteChange& change)
+{
+  change.apply(m_seq.palette);
+
+  // This file is loaded by SequenceJobs in a worker thread
+  if (m_parent)
+    m_seq.palette_changes.push_back(change);
+}
+
+void FileOp::SeqPaletteChange::apply(Palette* palette) const
+{
+  switch (type) {
+    case SetNColors: palette->resize(value); break;
+    case SetColor:   palette->setEntry(value, color); break;
+    case SetAlpha:   palette->setEntry(value, rgba_seta(palette->getEntry(value), color)); break;
+  }
+}
+
 ImageRef FileOp::sequenceImageToLoad(const PixelFormat pixelFormat, const int w, const int h)
 {
   Sprite* sprite;
@@ -1420,6 +1729,9 @@ bool FileOp::isDone() const
 
 bool FileOp::isStop() const
 {
+  if (m_parent && m_parent->isStop())
+    return true;
+
   bool stop;
   {
     std::scoped_lock lock(m_mutex);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -25,6 +25,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 // Flags for FileOp::createLoadDocumentOperation()
 #define FILE_LOAD_SEQUENCE_NONE         0x00000001
@@ -164,6 +165,13 @@ public:
 
   bool isSequence() const { return !m_seq.filename_list.empty(); }
   bool isOneFrame() const { return m_oneframe; }
+
+  // Maximum width/height needed by the caller (e.g. to generate a
+  // thumbnail). Formats that can decode a reduced version of the
+  // image (e.g. JPEG) can use it to load the file faster. Zero means
+  // that the original size is needed.
+  int reducedSizeHint() const { return m_reducedSizeHint; }
+  void setReducedSizeHint(int size) { m_reducedSizeHint = size; }
   bool preserveColorProfile() const { return m_config.preserveColorProfile; }
   const FileFormat* fileFormat() const { return m_format; }
 
@@ -301,6 +309,7 @@ private:
                                       // GIF/FLI/ASE).
   bool m_createPaletteFromRgba;
   bool m_ignoreEmpty;
+  int m_reducedSizeHint = 0;
 
   // True if the file contained a color profile when it was loaded.
   bool m_embeddedColorProfile;
@@ -313,6 +322,17 @@ private:
   // Options
   FormatOptionsPtr m_formatOptions;
 
+  // Change made by a decoder to the palette of the sequence through
+  // sequenceSetNColors/Color/Alpha().
+  struct SeqPaletteChange {
+    enum Type { SetNColors, SetColor, SetAlpha };
+    Type type;
+    int value;     // Number of colors (SetNColors) or palette index
+    color_t color; // New color (SetColor) or alpha (SetAlpha)
+
+    void apply(Palette* palette) const;
+  };
+
   // Data for sequences.
   struct {
     base::paths filename_list; // All file names to load/save.
@@ -327,6 +347,9 @@ private:
     LayerImage* layer;
     Cel* last_cel;
     int duration;
+    // Changes to the palette when a file is loaded in a worker thread
+    // (to apply them to the palette of the sequence in order).
+    std::vector<SeqPaletteChange> palette_changes;
     // Flags after the user choose what to do with the sequence.
     int flags;
   } m_seq;
@@ -334,7 +357,16 @@ private:
   class FileAbstractImageImpl;
   std::unique_ptr<FileAbstractImageImpl> m_abstractImage;
 
+  // Used to load/save each file of a sequence in worker threads
+  // with one FileOp for each file.
+  class SequenceJobs;
+
+  // FileOp that created this one to load/save just one file of its
+  // sequence (used to know if the operation was stopped).
+  const FileOp* m_parent = nullptr;
+
   void prepareForSequence();
+  void sequenceChangePalette(const SeqPaletteChange& change);
   void makeAbstractImage();
   void makeDirectories();
 };
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2024  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -12,6 +12,8 @@
 
 #include "app/color_spaces.h"
 
+#include <algorithm>
+
 namespace app {
 
 void FileOpConfig::fillFromPreferences()
@@ -27,6 +29,7 @@ void FileOpConfig::fillFromPreferences()
   rgbMapAlgorithm = pref.quantization.rgbmapAlgorithm();
   fitCriteria = pref.quantization.fitCriteria();
   cacheCompressedTilesets = pref.tileset.cacheCompressedTilesets();
+  aseCompressionLevel = std::clamp(pref.saveFile.aseCompressionLevel(), -1, 9);
 }
 
 } // namespace app
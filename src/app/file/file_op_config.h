@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2024  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -47,6 +47,11 @@ struct FileOpConfig {
   // compressed data that was loaded as-is).
   bool cacheCompressedTilesets = true;
 
+  // zlib compression level used for cels and tilesets in .aseprite
+  // files, from 0 (no compression) to 9 (best compression), or -1
+  // to use the zlib default (Z_DEFAULT_COMPRESSION).
+  int aseCompressionLevel = -1;
+
   void fillFromPreferences();
 };
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -21,6 +21,8 @@
 #include <cstdlib>
 #include <fstream>
 #include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 using namespace app;
@@ -363,3 +365,163 @@ TEST(File, CustomProperties)
     }
   }
 }
+
+TEST(File, SaveLoadManyCels)
+{
+  // Saves enough cels to keep all the threads of the cel images
+  // compressor busy, including linked cels and empty images
+  app::Context ctx;
+  const int w = 97, h = 61;
+  const frame_t nframes = 64;
+  std::string fn = "test_cels.ase";
+
+  std::vector<ImageRef> images;
+  {
+    std::unique_ptr<Doc> doc(ctx.documents().add(w, h, doc::ColorMode::RGB, 256));
+    doc->setFilename(fn);
+
+    Sprite* sprite = doc->sprite();
+    sprite->setTotalFrames(nframes);
+
+    LayerImage* layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+    ASSERT_TRUE(layer != nullptr);
+    {
+      Cel* cel = layer->cel(frame_t(0));
+      layer->removeCel(cel);
+      delete cel;
+    }
+
+    std::srand(nframes);
+    for (frame_t frame = 0; frame < nframes; ++frame) {
+      if (frame % 7 == 6) {
+        layer->addCel(Cel::MakeLink(frame, layer->cel(frame - 1)));
+        images.push_back(images.back());
+        continue;
+      }
+
+      ImageRef image(Image::create(IMAGE_RGB, w, h));
+      clear_image(image.get(), 0);
+      if (frame % 5 != 4) {
+        for (int y = 0; y < h; ++y) {
+          for (int x = 0; x < w; ++x) {
+            if ((std::rand() & 3) == 0)
+              put_pixel_fast<RgbTraits>(image.get(),
+                                        x,
+                                        y,
+                                        rgba(std::rand() % 256, x + frame, y, 255));
+          }
+        }
+      }
+      layer->addCel(new Cel(frame, image));
+      images.push_back(image);
+    }
+
+    save_document(&ctx, doc.get());
+    doc->close();
+  }
+
+  {
+    std::unique_ptr<Doc> doc(load_document(&ctx, fn));
+    ASSERT_EQ(nframes, doc->sprite()->totalFrames());
+
+    Layer* layer = doc->sprite()->root()->firstLayer();
+    ASSERT_TRUE(layer != nullptr);
+    for (frame_t frame = 0; frame < nframes; ++frame) {
+      const Cel* cel = layer->cel(frame);
+      ASSERT_TRUE(cel != nullptr);
+      EXPECT_EQ(frame % 7 == 6, cel->link() != nullptr);
+      EXPECT_TRUE(is_same_image(images[frame].get(), cel->image())) << "frame " << frame;
+    }
+    doc->close();
+  }
+}
+
+TEST(File, SaveLoadSequenceWithPaletteChange)
+{
+  // Saves/loads a sequence of png files (in worker threads) where the
+  // palette of the sprite changes in the middle of the sequence
+  app::Context ctx;
+  const int w = 31, h = 17;
+  const frame_t nframes = 8;
+  const frame_t paletteFrame = 5;
+  std::string fn;
+
+  std::vector<ImageRef> images;
+  std::vector<std::unique_ptr<Palette>> palettes;
+  {
+    std::unique_ptr<Doc> doc(ctx.documents().add(w, h, doc::ColorMode::INDEXED, 32));
+    Sprite* sprite = doc->sprite();
+    sprite->setTotalFrames(nframes);
+
+    LayerImage* layer = static_cast<LayerImage*>(sprite->root()->firstLayer());
+    ASSERT_TRUE(layer != nullptr);
+    layer->setBackground(true);
+
+    std::srand(nframes);
+    for (const frame_t frame : { frame_t(0), paletteFrame }) {
+      Palette palette(frame, frame == 0 ? 32 : 16);
+      for (int i = 0; i < palette.size(); ++i)
+        palette.setEntry(i, rgba(std::rand() % 256, std::rand() % 256, std::rand() % 256, 255));
+      sprite->setPalette(&palette, false);
+    }
+
+    for (frame_t frame = 0; frame < nframes; ++frame) {
+      ImageRef image(Image::create(IMAGE_INDEXED, w, h));
+      for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+          put_pixel_fast<IndexedTraits>(image.get(), x, y, std::rand() % 16);
+
+      if (frame == 0)
+        copy_image(layer->cel(frame)->image(), image.get());
+      else
+        layer->addCel(new Cel(frame, image));
+
+      images.push_back(image);
+      palettes.emplace_back(new Palette(*sprite->palette(frame)));
+    }
+
+    std::unique_ptr<FileOp> fop(FileOp::createSaveDocumentOperation(
+      &ctx,
+      FileOpROI(doc.get(), sprite->bounds(), "", "", FramesSequence(), false),
+      "test_seq.png",
+      "",
+      false));
+    ASSERT_TRUE(fop != nullptr);
+    fop->operate();
+    fop->done();
+    ASSERT_FALSE(fop->hasError()) << fop->error();
+    ASSERT_EQ(nframes, int(fop->filenames().size()));
+    fn = fop->filenames().front();
+
+    doc->close();
+  }
+
+  {
+    std::unique_ptr<FileOp> fop(
+      FileOp::createLoadDocumentOperation(&ctx, fn, FILE_LOAD_SEQUENCE_YES));
+    ASSERT_TRUE(fop != nullptr);
+    fop->operate();
+    fop->done();
+    fop->postLoad();
+    ASSERT_FALSE(fop->hasError()) << fop->error();
+
+    std::unique_ptr<Doc> doc(fop->releaseDocument());
+    ASSERT_TRUE(doc != nullptr);
+    ASSERT_EQ(nframes, doc->sprite()->totalFrames());
+
+    Layer* layer = doc->sprite()->root()->firstLayer();
+    ASSERT_TRUE(layer != nullptr);
+    for (frame_t frame = 0; frame < nframes; ++frame) {
+      const Palette* palette = doc->sprite()->palette(frame);
+      ASSERT_EQ(palettes[frame]->size(), palette->size()) << "frame " << frame;
+      for (int i = 0; i < palette->size(); ++i)
+        EXPECT_EQ(palettes[frame]->getEntry(i), palette->getEntry(i))
+          << "frame " << frame << " entry " << i;
+
+      const Cel* cel = layer->cel(frame);
+      ASSERT_TRUE(cel != nullptr);
+      EXPECT_TRUE(is_same_image(images[frame].get(), cel->image())) << "frame " << frame;
+    }
+    doc->close();
+  }
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -17,6 +17,7 @@
 #include "app/file/file_format.h"
 #include "app/file/format_options.h"
 #include "app/file/gif_format.h"
+#include "app/file/gif_lzw.h"
 #include "app/file/gif_options.h"
 #include "app/modules/gui.h"
 #include "app/pref/preferences.h"
@@ -25,6 +26,7 @@
 #include "base/fs.h"
 #include "doc/doc.h"
 #include "doc/octree_map.h"
+#include "doc/parallel.h"
 #include "gfx/clip.h"
 #include "render/dithering.h"
 #include "render/ordered_dither.h"
@@ -35,6 +37,9 @@
 #include "gif_options.xml.h"
 
 #include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
 
 #include <gif_lib.h>
 
@@ -930,6 +935,25 @@ class GifEncoder {
 public:
   typedef int gifframe_t;
 
+private:
+  // A frame to be quantized and compressed in a worker thread
+  struct FrameJob {
+    gifframe_t gifFrame = 0;
+    frame_t frame = 0;
+    gfx::Rect frameBounds;
+    DisposalMethod disposal = DisposalMethod::NONE;
+    bool fixDuration = false;
+    std::unique_ptr<Image> deltaImage;
+
+    // Results
+    std::unique_ptr<Palette> localPalette; // nullptr to use the global colormap
+    int transparentIndex = -1;
+    int codeSize = 0;  // LZW minimum code size
+    base::buffer data; // LZW data sub-blocks
+    doc::ParallelJobs::JobPtr job;
+  };
+
+public:
   GifEncoder(FileOp* fop, GifFileType* gifFile)
     : m_fop(fop)
     , m_gifFile(gifFile)
@@ -942,6 +966,7 @@ public:
     , m_globalColormap(nullptr)
     , m_globalColormapPalette(*m_sprite->palette(0))
     , m_preservePaletteOrder(false)
+    , m_threads(doc::parallel_threads())
   {
     const auto gifOptions = std::static_pointer_cast<GifOptions>(fop->formatOptions());
 
@@ -1067,6 +1092,14 @@ public:
 
   ~GifEncoder()
   {
+    // Wait jobs that are still running (e.g. if there was an error
+    // writing the file).
+    try {
+      m_parallelJobs.waitAll();
+    }
+    catch (...) {
+    }
+
     if (m_globalColormap)
       GifFreeMapObject(m_globalColormap);
   }
@@ -1120,15 +1153,27 @@ public:
 
       calculateDeltaImageFrameBoundsDisposal(gifFrame, frameBounds, disposal);
 
-      writeImage(gifFrame,
-                 frame,
-                 frameBounds,
-                 disposal,
-                 // Only the last frame in the animation needs the fix
-                 (fix_last_frame_duration && gifFrame == nframes - 1));
-
-      m_fop->setProgress(double(gifFrame + 1) / double(nframes));
+      // The rest of the work for this frame (quantization and LZW
+      // compression) doesn't depend on other frames, so it's done in
+      // a worker thread while we render and compare the next frames.
+      auto job = std::make_unique<FrameJob>();
+      job->gifFrame = gifFrame;
+      job->frame = frame;
+      job->frameBounds = frameBounds;
+      job->disposal = disposal;
+      // Only the last frame in the animation needs the fix
+      job->fixDuration = (fix_last_frame_duration && gifFrame == nframes - 1);
+      job->deltaImage = std::move(m_deltaImage);
+      startFrameJob(std::move(job));
+
+      // Write the frames that are ready (in order), and don't keep
+      // too many frames in memory.
+      while (!m_jobs.empty() && (int(m_jobs.size()) > 2 * m_threads || isNextFrameJobDone()))
+        writeNextFrameJob();
     }
+
+    while (!m_jobs.empty())
+      writeNextFrameJob();
     return true;
   }
 
@@ -1186,51 +1231,40 @@ private:
           y1 = m_spriteBounds.h - 1;
         }
 
-        int i = 0;
-        int x, y;
-        const LockImageBits<RgbTraits> bits1(m_previousImage);
-        LockImageBits<RgbTraits> bits2(m_currentImage);
-        const LockImageBits<RgbTraits> bits3(m_nextImage);
         m_deltaImage.reset(
           Image::create(PixelFormat::IMAGE_RGB, m_spriteBounds.w, m_spriteBounds.h));
         clear_image(m_deltaImage.get(), 0);
-        LockImageBits<RgbTraits> deltaBits(m_deltaImage.get());
-        typename LockImageBits<RgbTraits>::iterator deltaIt;
-        typename LockImageBits<RgbTraits>::iterator it2, end2;
-        typename LockImageBits<RgbTraits>::const_iterator it1, it3, end1, deltaEnd;
 
         bool previousImageMatchsCurrent = true;
-        for (it1 = bits1.begin(),
-            end1 = bits1.end(),
-            it2 = bits2.begin(),
-            end2 = bits2.end(),
-            it3 = bits3.begin(),
-            deltaIt = deltaBits.begin();
-             it1 != end1 && it2 != end2;
-             ++it1, ++it2, ++it3, ++deltaIt, ++i) {
-          x = i % m_spriteBounds.w;
-          y = i / m_spriteBounds.w;
-          // While we are checking color differences,
-          // we enlarge the frameBounds where the color differences take place
-          if ((rgba_geta(*it2) != 0 && *it1 != *it2) || rgba_geta(*it3) == 0) {
-            previousImageMatchsCurrent = false;
-            *it2 = (rgba_geta(*it2) ? *it2 : 0);
-            *deltaIt = *it2;
-            if (x < x1)
-              x1 = x;
-            if (x > x2)
-              x2 = x;
-            if (y < y1)
-              y1 = y;
-            if (y > y2)
-              y2 = y;
-          }
-
-          // We need to change disposal mode DO_NOT_DISPOSE to RESTORE_BGCOLOR only
-          // if we found a "pixel clearing" in the next Image. RESTORE_BGCOLOR is
-          // our way to clear pixels.
-          if (rgba_geta(*it2) != 0 && rgba_geta(*it3) == 0) {
-            disposal = DisposalMethod::RESTORE_BGCOLOR;
+        for (int y = 0; y < m_spriteBounds.h; ++y) {
+          auto it1 = get_pixel_address_fast<RgbTraits>(m_previousImage, 0, y);
+          auto it2 = get_pixel_address_fast<RgbTraits>(m_currentImage, 0, y);
+          auto it3 = get_pixel_address_fast<RgbTraits>(m_nextImage, 0, y);
+          auto deltaIt = get_pixel_address_fast<RgbTraits>(m_deltaImage.get(), 0, y);
+
+          for (int x = 0; x < m_spriteBounds.w; ++x, ++it1, ++it2, ++it3, ++deltaIt) {
+            // While we are checking color differences,
+            // we enlarge the frameBounds where the color differences take place
+            if ((rgba_geta(*it2) != 0 && *it1 != *it2) || rgba_geta(*it3) == 0) {
+              previousImageMatchsCurrent = false;
+              *it2 = (rgba_geta(*it2) ? *it2 : 0);
+              *deltaIt = *it2;
+              if (x < x1)
+                x1 = x;
+              if (x > x2)
+                x2 = x;
+              if (y < y1)
+                y1 = y;
+              if (y > y2)
+                y2 = y;
+            }
+
+            // We need to change disposal mode DO_NOT_DISPOSE to RESTORE_BGCOLOR only
+            // if we found a "pixel clearing" in the next Image. RESTORE_BGCOLOR is
+            // our way to clear pixels.
+            if (rgba_geta(*it2) != 0 && rgba_geta(*it3) == 0) {
+              disposal = DisposalMethod::RESTORE_BGCOLOR;
+            }
           }
         }
         if (previousImageMatchsCurrent)
@@ -1241,7 +1275,7 @@ private:
       else
         disposal = DisposalMethod::RESTORE_BGCOLOR;
 
-      // We need to conditionate the deltaImage to the next step: 'writeImage()'
+      // We need to conditionate the deltaImage to the next step: 'processFrameJob()'
       // To do it, we need to crop deltaImage in frameBounds.
       // If disposal method changed to RESTORE_BGCOLOR deltaImage we need to reproduce ALL the
       // colors of m_currentImage contained in frameBounds (so, we will overwrite delta image with a
@@ -1360,43 +1394,41 @@ private:
     return frameBounds;
   }
 
-  void writeImage(const gifframe_t gifFrame,
-                  const frame_t frame,
-                  const gfx::Rect& frameBounds,
-                  const DisposalMethod disposal,
-                  const bool fixDuration)
+  // Quantizes the delta image of the frame and compresses its pixels.
+  // This is called from a worker thread, so it cannot modify the
+  // state of the encoder.
+  void processFrameJob(FrameJob& job) const
   {
+    const gfx::Rect& frameBounds = job.frameBounds;
+    int transparentIndex = m_transparentIndex;
     Palette framePalette;
     if (m_globalColormap)
       framePalette = m_globalColormapPalette;
     else
-      framePalette = calculatePalette();
+      framePalette = calculatePalette(job.deltaImage.get(), transparentIndex);
 
     OctreeMap octree;
-    octree.regenerateMap(&framePalette, m_transparentIndex);
-    ImageRef frameImage(
-      Image::create(IMAGE_INDEXED, frameBounds.w, frameBounds.h, m_frameImageBuf));
+    octree.regenerateMap(&framePalette, transparentIndex);
+    std::vector<uint8_t> indexes(size_t(frameBounds.w) * frameBounds.h);
 
     // Every frame might use a small portion of the global palette,
     // to optimize the gif file size, we will analize which colors
     // will be used in each processed frame.
     PalettePicks usedColors(framePalette.size());
 
-    int localTransparent = m_transparentIndex;
-    ColorMapObject* colormap = m_globalColormap;
+    int localTransparent = transparentIndex;
+    int colormapBitsPerPixel = (m_globalColormap ? m_globalColormap->BitsPerPixel : 0);
     Remap remap(256);
 
     if (!m_preservePaletteOrder) {
-      const LockImageBits<RgbTraits> srcBits(m_deltaImage.get());
-      LockImageBits<IndexedTraits> dstBits(frameImage.get());
-
+      const LockImageBits<RgbTraits> srcBits(job.deltaImage.get());
       auto srcIt = srcBits.begin();
-      auto dstIt = dstBits.begin();
+      auto dstIt = indexes.begin();
 
       for (int y = 0; y < frameBounds.h; ++y) {
         for (int x = 0; x < frameBounds.w; ++x, ++srcIt, ++dstIt) {
           ASSERT(srcIt != srcBits.end());
-          ASSERT(dstIt != dstBits.end());
+          ASSERT(dstIt != indexes.end());
 
           color_t color = *srcIt;
           int i;
@@ -1406,13 +1438,13 @@ private:
                                             rgba_getg(color),
                                             rgba_getb(color),
                                             255,
-                                            m_transparentIndex);
+                                            transparentIndex);
             if (i < 0)
               i = octree.mapColor(color | rgba_a_mask); // alpha=255
           }
           else {
-            if (m_transparentIndex >= 0)
-              i = m_transparentIndex;
+            if (transparentIndex >= 0)
+              i = transparentIndex;
             else
               i = m_bgIndex;
           }
@@ -1435,7 +1467,7 @@ private:
       for (int i = 0; i < remap.size(); ++i)
         remap.map(i, i);
 
-      if (!colormap) {
+      if (!m_globalColormap) {
         Palette reducedPalette(0, usedNColors);
 
         for (int i = 0, j = 0; i < framePalette.size(); ++i) {
@@ -1446,72 +1478,126 @@ private:
           }
         }
 
-        colormap = createColorMap(&reducedPalette);
+        // The colormap is created in the main thread (it converts
+        // colors to sRGB).
+        job.localPalette = std::make_unique<Palette>(reducedPalette);
+        colormapBitsPerPixel = GifBitSize(colorMapSize(&reducedPalette));
         if (localTransparent >= 0)
           localTransparent = remap[localTransparent];
       }
 
-      if (localTransparent >= 0 && m_transparentIndex != localTransparent)
-        remap.map(m_transparentIndex, localTransparent);
+      if (localTransparent >= 0 && transparentIndex != localTransparent)
+        remap.map(transparentIndex, localTransparent);
     }
     else {
-      frameImage.reset(Image::createCopy(m_deltaImage.get()));
-      for (int i = 0; i < colormap->ColorCount; ++i)
+      const LockImageBits<IndexedTraits> srcBits(job.deltaImage.get());
+      std::copy(srcBits.begin(), srcBits.end(), indexes.begin());
+      for (int i = 0; i < m_globalColormap->ColorCount; ++i)
         remap.map(i, i);
     }
 
+    // Final pixels in the order they are written in the file
+    std::vector<uint8_t> pixels(indexes.size());
+    auto pixelIt = pixels.begin();
+    auto writeRow = [&](const int y) {
+      const uint8_t* addr = &indexes[size_t(y) * frameBounds.w];
+      for (int i = 0; i < frameBounds.w; ++i, ++addr, ++pixelIt)
+        *pixelIt = remap[*addr];
+    };
+    if (m_interlaced) {
+      // Need to perform 4 passes on the images.
+      for (int i = 0; i < 4; ++i)
+        for (int y = interlaced_offset[i]; y < frameBounds.h; y += interlaced_jumps[i])
+          writeRow(y);
+    }
+    else {
+      for (int y = 0; y < frameBounds.h; ++y)
+        writeRow(y);
+    }
+
+    job.transparentIndex = localTransparent;
+    job.codeSize = std::max(2, colormapBitsPerPixel);
+    gif_lzw_encode(pixels.data(), pixels.size(), job.codeSize, job.data);
+    job.deltaImage.reset();
+  }
+
+  void writeFrameJob(FrameJob& job)
+  {
+    const gifframe_t gifFrame = job.gifFrame;
+    ColorMapObject* colormap = m_globalColormap;
+    if (job.localPalette)
+      colormap = createColorMap(job.localPalette.get());
+
     // Write extension record.
-    writeExtension(gifFrame, frame, localTransparent, disposal, fixDuration);
+    writeExtension(gifFrame, job.frame, job.transparentIndex, job.disposal, job.fixDuration);
 
     // Write the image record.
     if (EGifPutImageDesc(m_gifFile,
-                         frameBounds.x,
-                         frameBounds.y,
-                         frameBounds.w,
-                         frameBounds.h,
+                         job.frameBounds.x,
+                         job.frameBounds.y,
+                         job.frameBounds.w,
+                         job.frameBounds.h,
                          m_interlaced ? 1 : 0,
                          (colormap != m_globalColormap ? colormap : nullptr)) == GIF_ERROR) {
       throw Exception("Error writing GIF frame %d.\n", gifFrame);
     }
 
-    std::vector<uint8_t> scanline(frameBounds.w);
+    // Write the image data (pixels) already compressed, giflib uses
+    // this same LZW minimum code size.
+    ASSERT(job.codeSize == std::max(2, colormap->BitsPerPixel));
+    ASSERT(!job.data.empty());
+    for (size_t i = 0; i < job.data.size(); i += job.data[i] + 1) {
+      if ((i == 0 ? EGifPutCode(m_gifFile, job.codeSize, &job.data[i]) :
+                    EGifPutCodeNext(m_gifFile, &job.data[i])) == GIF_ERROR)
+        throw Exception("Error writing GIF image data for frame %d.\n", gifFrame);
+    }
+    if (EGifPutCodeNext(m_gifFile, nullptr) == GIF_ERROR)
+      throw Exception("Error writing GIF image data for frame %d.\n", gifFrame);
 
-    // Write the image data (pixels).
-    if (m_interlaced) {
-      // Need to perform 4 passes on the images.
-      for (int i = 0; i < 4; ++i)
-        for (int y = interlaced_offset[i]; y < frameBounds.h; y += interlaced_jumps[i]) {
-          IndexedTraits::address_t addr = (IndexedTraits::address_t)frameImage->getPixelAddress(0,
-                                                                                                y);
+    if (colormap != m_globalColormap)
+      GifFreeMapObject(colormap);
+  }
 
-          for (int i = 0; i < frameBounds.w; ++i, ++addr)
-            scanline[i] = remap[*addr];
+  void startFrameJob(std::unique_ptr<FrameJob>&& job)
+  {
+    FrameJob* ptr = job.get();
+    m_jobs.push_back(std::move(job));
 
-          if (EGifPutLine(m_gifFile, &scanline[0], frameBounds.w) == GIF_ERROR)
-            throw Exception("Error writing GIF image scanlines for frame %d.\n", gifFrame);
-        }
-    }
-    else {
-      // Write all image scanlines (not interlaced in this case).
-      for (int y = 0; y < frameBounds.h; ++y) {
-        IndexedTraits::address_t addr = (IndexedTraits::address_t)frameImage->getPixelAddress(0, y);
+    // With only one thread we process each frame when it's written.
+    if (m_threads < 2)
+      return;
 
-        for (int i = 0; i < frameBounds.w; ++i, ++addr)
-          scanline[i] = remap[*addr];
+    ptr->job = m_parallelJobs.start([this, ptr] { processFrameJob(*ptr); });
+  }
 
-        if (EGifPutLine(m_gifFile, &scanline[0], frameBounds.w) == GIF_ERROR)
-          throw Exception("Error writing GIF image scanlines for frame %d.\n", gifFrame);
-      }
+  bool isNextFrameJobDone()
+  {
+    if (m_threads < 2)
+      return true;
+
+    return m_parallelJobs.isDone(m_jobs.front()->job);
+  }
+
+  void writeNextFrameJob()
+  {
+    std::unique_ptr<FrameJob> job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+
+    if (m_threads < 2) {
+      processFrameJob(*job);
+    }
+    else {
+      m_parallelJobs.wait(job->job);
     }
 
-    if (colormap && colormap != m_globalColormap)
-      GifFreeMapObject(colormap);
+    writeFrameJob(*job);
+    m_fop->setProgress(double(job->gifFrame + 1) / double(totalFrames()));
   }
 
-  Palette calculatePalette()
+  static Palette calculatePalette(const Image* deltaImage, int& transparentIndex)
   {
     OctreeMap octree;
-    const LockImageBits<RgbTraits> imageBits(m_deltaImage.get());
+    const LockImageBits<RgbTraits> imageBits(deltaImage);
     auto it = imageBits.begin(), end = imageBits.end();
     bool maskColorFounded = false;
     for (; it != end; ++it) {
@@ -1527,7 +1613,7 @@ private:
       // If there is a mask color, the OctreeMap::makePalette adds it
       // by default at entry == 0.
       octree.makePalette(&palette, 256, 8);
-      m_transparentIndex = 0;
+      transparentIndex = 0;
       return palette;
     }
     else {
@@ -1537,7 +1623,7 @@ private:
       Palette paletteWithoutMask(0, palette.size() - 1);
       for (int i = 0; i < paletteWithoutMask.size(); i++)
         paletteWithoutMask.setEntry(i, palette.entry(i + 1));
-      m_transparentIndex = -1;
+      transparentIndex = -1;
       return paletteWithoutMask;
     }
   }
@@ -1552,9 +1638,15 @@ private:
   }
 
 private:
+  // Number of entries of the colormap created for the given palette
+  static int colorMapSize(const Palette* palette)
+  {
+    return 1 << GifBitSizeLimited(palette->size());
+  }
+
   ColorMapObject* createColorMap(const Palette* palette)
   {
-    int n = 1 << GifBitSizeLimited(palette->size());
+    int n = colorMapSize(palette);
     ColorMapObject* colormap = GifMakeMapObject(n, nullptr);
 
     // Color space conversions
@@ -1596,12 +1688,17 @@ private:
   bool m_preservePaletteOrder;
   gfx::Rect m_lastFrameBounds;
   DisposalMethod m_lastDisposal;
-  ImageBufferPtr m_frameImageBuf;
   ImageRef m_images[3];
   Image* m_previousImage;
   Image* m_currentImage;
   Image* m_nextImage;
   std::unique_ptr<Image> m_deltaImage;
+
+  // Frames being processed in worker threads, in the order they must
+  // be written in the file.
+  std::deque<std::unique_ptr<FrameJob>> m_jobs;
+  int m_threads;
+  doc::ParallelJobs m_parallelJobs;
 };
 
 bool GifFormat::onSave(FileOp* fop)
@@ -0,0 +1,169 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/file/gif_lzw.h"
+
+#include "base/debug.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace app {
+
+namespace {
+
+const int kMaxCodeSize = 12;
+const int kMaxCodes = (1 << kMaxCodeSize);
+
+// Size of the hash table of strings (a power of 2 bigger than
+// kMaxCodes to keep few collisions)
+const int kHashBits = 13;
+const int kHashSize = (1 << kHashBits);
+
+// Writes codes of variable size (LSB first) in data sub-blocks.
+class CodeWriter {
+public:
+  CodeWriter(base::buffer& output) : m_output(output), m_blockStart(0), m_bits(0), m_nbits(0)
+  {
+    m_output.clear();
+  }
+
+  void put(const int code, const int size)
+  {
+    m_bits |= (uint32_t(code) << m_nbits);
+    m_nbits += size;
+    while (m_nbits >= 8) {
+      putByte(m_bits & 0xff);
+      m_bits >>= 8;
+      m_nbits -= 8;
+    }
+  }
+
+  void flush()
+  {
+    if (m_nbits > 0)
+      putByte(m_bits & 0xff);
+    m_bits = 0;
+    m_nbits = 0;
+  }
+
+private:
+  void putByte(const uint8_t byte)
+  {
+    // Start a new sub-block
+    if (m_output.empty() || m_output[m_blockStart] == 255) {
+      m_blockStart = m_output.size();
+      m_output.push_back(0);
+    }
+    m_output.push_back(byte);
+    ++m_output[m_blockStart];
+  }
+
+  base::buffer& m_output;
+  size_t m_blockStart;
+  uint32_t m_bits;
+  int m_nbits;
+};
+
+// Table of strings, each string is a (prefix code, next pixel) key.
+class StringTable {
+public:
+  StringTable() : m_keys(kHashSize), m_codes(kHashSize) { clear(); }
+
+  void clear() { std::fill(m_keys.begin(), m_keys.end(), -1); }
+
+  // Returns the slot where the key is, or where it can be added.
+  int find(const int key) const
+  {
+    int i = (uint32_t(key) * 2654435761u) >> (32 - kHashBits);
+    while (m_keys[i] >= 0 && m_keys[i] != key)
+      i = (i + 1) & (kHashSize - 1);
+    return i;
+  }
+
+  bool contains(const int slot) const { return m_keys[slot] >= 0; }
+  int code(const int slot) const { return m_codes[slot]; }
+
+  void add(const int slot, const int key, const int code)
+  {
+    m_keys[slot] = key;
+    m_codes[slot] = code;
+  }
+
+private:
+  std::vector<int> m_keys;
+  std::vector<uint16_t> m_codes;
+};
+
+} // anonymous namespace
+
+void gif_lzw_encode(const uint8_t* pixels,
+                    const size_t npixels,
+                    const int minCodeSize,
+                    base::buffer& output)
+{
+  ASSERT(minCodeSize >= 2 && minCodeSize <= 8);
+
+  const int clearCode = (1 << minCodeSize);
+  const int endCode = clearCode + 1;
+  int codeSize = minCodeSize + 1;
+  int nextCode = clearCode + 2;
+
+  CodeWriter writer(output);
+  StringTable table;
+
+  writer.put(clearCode, codeSize);
+
+  if (npixels > 0) {
+    int prefix = pixels[0];
+    ASSERT(prefix < clearCode);
+
+    for (size_t i = 1; i < npixels; ++i) {
+      const int pixel = pixels[i];
+      ASSERT(pixel < clearCode);
+
+      const int key = (prefix << 8) | pixel;
+      const int slot = table.find(key);
+      if (table.contains(slot)) {
+        prefix = table.code(slot);
+        continue;
+      }
+
+      writer.put(prefix, codeSize);
+      table.add(slot, key, nextCode++);
+      prefix = pixel;
+
+      // The decoder adds this string when it reads the next code, and
+      // it needs one more bit to read it when the new code doesn't
+      // fit in the current code size.
+      if (nextCode - 1 == (1 << codeSize) && codeSize < kMaxCodeSize)
+        ++codeSize;
+
+      // Start again when the table is full
+      if (nextCode == kMaxCodes) {
+        writer.put(clearCode, codeSize);
+        table.clear();
+        codeSize = minCodeSize + 1;
+        nextCode = clearCode + 2;
+      }
+    }
+
+    writer.put(prefix, codeSize);
+
+    // The decoder adds a string after reading the last code too.
+    if (nextCode == (1 << codeSize) && codeSize < kMaxCodeSize)
+      ++codeSize;
+  }
+
+  writer.put(endCode, codeSize);
+  writer.flush();
+}
+
+} // namespace app
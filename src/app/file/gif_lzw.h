@@ -0,0 +1,33 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_FILE_GIF_LZW_H_INCLUDED
+#define APP_FILE_GIF_LZW_H_INCLUDED
+#pragma once
+
+#include "base/buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace app {
+
+// Compresses the given pixels (palette indexes lower than
+// 2^minCodeSize) with the LZW variant used in GIF files, so we can
+// compress GIF frames in parallel and write the result later with
+// EGifPutCode()/EGifPutCodeNext().
+//
+// The output is a sequence of data sub-blocks (each one prefixed by
+// its length, from 1 to 255 bytes) without the initial LZW minimum
+// code size byte and without the block terminator.
+void gif_lzw_encode(const uint8_t* pixels,
+                    const size_t npixels,
+                    const int minCodeSize,
+                    base::buffer& output);
+
+} // namespace app
+
+#endif
@@ -0,0 +1,215 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#include "tests/app_test.h"
+
+#include "app/file/gif_lzw.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <gif_lib.h>
+
+using namespace app;
+
+// Simple GIF LZW decoder to check the output of gif_lzw_encode()
+static std::vector<uint8_t> decode(const base::buffer& blocks, const int minCodeSize)
+{
+  // Join sub-blocks
+  std::vector<uint8_t> data;
+  for (size_t i = 0; i < blocks.size(); i += blocks[i] + 1) {
+    EXPECT_GT(blocks[i], 0);
+    EXPECT_LE(i + 1 + blocks[i], blocks.size());
+    data.insert(data.end(), blocks.begin() + i + 1, blocks.begin() + i + 1 + blocks[i]);
+  }
+
+  const int clearCode = (1 << minCodeSize);
+  const int endCode = clearCode + 1;
+  std::vector<int> prefixes(4096, -1);
+  std::vector<uint8_t> suffixes(4096, 0);
+  for (int i = 0; i < clearCode; ++i)
+    suffixes[i] = i;
+
+  auto string = [&](int code) {
+    std::vector<uint8_t> s;
+    for (; code >= 0; code = prefixes[code])
+      s.insert(s.begin(), suffixes[code]);
+    return s;
+  };
+
+  std::vector<uint8_t> pixels;
+  int codeSize = minCodeSize + 1;
+  int nextCode = clearCode + 2;
+  int prev = -1;
+  size_t bitPos = 0;
+  while (bitPos + codeSize <= data.size() * 8) {
+    int code = 0;
+    for (int i = 0; i < codeSize; ++i, ++bitPos)
+      code |= ((data[bitPos / 8] >> (bitPos % 8)) & 1) << i;
+
+    if (code == clearCode) {
+      codeSize = minCodeSize + 1;
+      nextCode = clearCode + 2;
+      prev = -1;
+      continue;
+    }
+    if (code == endCode)
+      return pixels;
+
+    std::vector<uint8_t> s;
+    if (prev < 0) {
+      s = string(code);
+    }
+    else {
+      EXPECT_LE(code, nextCode);
+      if (code < nextCode) {
+        s = string(code);
+      }
+      else {
+        s = string(prev);
+        s.push_back(s[0]);
+      }
+      if (nextCode < 4096) {
+        prefixes[nextCode] = prev;
+        suffixes[nextCode] = s[0];
+        ++nextCode;
+        if (nextCode == (1 << codeSize) && codeSize < 12)
+          ++codeSize;
+      }
+    }
+    pixels.insert(pixels.end(), s.begin(), s.end());
+    prev = code;
+  }
+
+  ADD_FAILURE() << "End of information code not found";
+  return pixels;
+}
+
+struct MemoryInput {
+  const std::vector<uint8_t>& data;
+  size_t pos = 0;
+};
+
+static int read_memory_input(GifFileType* gif, GifByteType* buf, int size)
+{
+  auto input = static_cast<MemoryInput*>(gif->UserData);
+  size = int(std::min<size_t>(size, input->data.size() - input->pos));
+  std::copy(input->data.begin() + input->pos, input->data.begin() + input->pos + size, buf);
+  input->pos += size;
+  return size;
+}
+
+// Decodes the output of gif_lzw_encode() with giflib (the decoder
+// used to load GIF files) in a minimal GIF file with one image
+static std::vector<uint8_t> decode_with_giflib(const base::buffer& blocks,
+                                               const int minCodeSize,
+                                               const int w,
+                                               const int h)
+{
+  const uint8_t wl = (w & 0xff), wh = (w >> 8), hl = (h & 0xff), hh = (h >> 8);
+  std::vector<uint8_t> file = {
+    'G', 'I', 'F', '8', '9', 'a', wl, wh, hl, hh, 0, 0, 0, // Screen without color map
+    0x2C, 0, 0, 0, 0, wl, wh, hl, hh, 0,                   // Image descriptor
+    uint8_t(minCodeSize)
+  };
+  file.insert(file.end(), blocks.begin(), blocks.end());
+  file.push_back(0);    // Block terminator
+  file.push_back(0x3B); // Trailer
+
+  MemoryInput input{ file };
+#if GIFLIB_MAJOR >= 5
+  int errCode = 0;
+  GifFileType* gif = DGifOpen(&input, read_memory_input, &errCode);
+#else
+  GifFileType* gif = DGifOpen(&input, read_memory_input);
+#endif
+  EXPECT_TRUE(gif != nullptr);
+  if (!gif)
+    return {};
+
+  std::vector<uint8_t> pixels(size_t(w) * h, 0);
+  GifRecordType type;
+  EXPECT_NE(GIF_ERROR, DGifGetRecordType(gif, &type));
+  EXPECT_EQ(IMAGE_DESC_RECORD_TYPE, type);
+  EXPECT_NE(GIF_ERROR, DGifGetImageDesc(gif));
+  for (int y = 0; y < h; ++y)
+    EXPECT_NE(GIF_ERROR, DGifGetLine(gif, &pixels[size_t(y) * w], w)) << "Row " << y;
+  EXPECT_NE(GIF_ERROR, DGifGetRecordType(gif, &type));
+  EXPECT_EQ(TERMINATE_RECORD_TYPE, type);
+
+#if GIFLIB_MAJOR >= 5
+  DGifCloseFile(gif, &errCode);
+#else
+  DGifCloseFile(gif);
+#endif
+  return pixels;
+}
+
+TEST(GifLzw, EncodeDecode)
+{
+  std::srand(1);
+
+  for (int minCodeSize = 2; minCodeSize <= 8; ++minCodeSize) {
+    for (size_t npixels : { 1, 2, 3, 100, 5000, 100000 }) {
+      // Random pixels with runs of the same index (to create long
+      // strings in the table)
+      std::vector<uint8_t> pixels(npixels);
+      for (size_t i = 0; i < npixels; ++i) {
+        if (i > 0 && (std::rand() % 4) != 0)
+          pixels[i] = pixels[i - 1];
+        else
+          pixels[i] = std::rand() % (1 << minCodeSize);
+      }
+
+      base::buffer output;
+      gif_lzw_encode(pixels.data(), npixels, minCodeSize, output);
+      EXPECT_EQ(pixels, decode(output, minCodeSize))
+        << "minCodeSize=" << minCodeSize << " npixels=" << npixels;
+    }
+  }
+}
+
+TEST(GifLzw, SameIndex)
+{
+  // A long run of the same index creates strings of increasing length
+  std::vector<uint8_t> pixels(1000000, 3);
+  base::buffer output;
+  gif_lzw_encode(pixels.data(), pixels.size(), 2, output);
+  EXPECT_EQ(pixels, decode(output, 2));
+  EXPECT_LT(output.size(), 3000);
+}
+
+TEST(GifLzw, DecodeWithGiflib)
+{
+  std::srand(2);
+
+  for (int minCodeSize = 2; minCodeSize <= 8; ++minCodeSize) {
+    for (const auto& [w, h] : std::vector<std::pair<int, int>>{
+           { 1, 1 }, { 3, 1 }, { 17, 13 }, { 320, 240 }, { 1000, 300 } }) {
+      const size_t npixels = size_t(w) * h;
+      std::vector<uint8_t> pixels(npixels);
+      for (size_t i = 0; i < npixels; ++i) {
+        if (i > 0 && (std::rand() % 4) != 0)
+          pixels[i] = pixels[i - 1];
+        else
+          pixels[i] = std::rand() % (1 << minCodeSize);
+      }
+
+      base::buffer output;
+      gif_lzw_encode(pixels.data(), npixels, minCodeSize, output);
+      EXPECT_EQ(pixels, decode_with_giflib(output, minCodeSize, w, h))
+        << "minCodeSize=" << minCodeSize << " size=" << w << "x" << h;
+    }
+  }
+
+  // Long run of the same index
+  std::vector<uint8_t> pixels(1000 * 1000, 1);
+  base::buffer output;
+  gif_lzw_encode(pixels.data(), pixels.size(), 2, output);
+  EXPECT_EQ(pixels, decode_with_giflib(output, 2, 1000, 1000));
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2022-2023  Igara Studio S.A.
+// Copyright (C) 2022-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -20,6 +20,15 @@ using namespace doc;
 SimpleRenderer::SimpleRenderer()
 {
   m_properties.outputsUnpremultiplied = true;
+
+  // Keep the layers below the active layer composited, so painting
+  // in one layer of a sprite with a lot of layers doesn't need to
+  // blend all the layers below it again (the layers above are still
+  // blended over the result).
+  m_render.setLayerStackCache(std::make_shared<render::LayerStackCache>());
+
+  // Tiles are flipped/scaled only once for each zoom level.
+  m_render.setTileCache(std::make_shared<render::TileCache>());
 }
 
 void SimpleRenderer::setRefLayersVisiblity(const bool visible)
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -22,6 +22,7 @@
 #include "app/modules/palettes.h"
 #include "app/pref/preferences.h"
 #include "app/script/api_version.h"
+#include "app/script/deferred_image_writes.h"
 #include "app/script/docobj.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
@@ -158,9 +159,15 @@ int App_transaction(lua_State* L)
       ContextWriter writer(ctx);
       Tx tx(writer, label);
 
+      // Images modified by the function are added to the
+      // transaction at the end (one cmd for each image).
+      DeferredImageWrites writes(writer.document(), tx);
+
       lua_pushvalue(L, -1);
-      if (lua_pcall(L, 0, LUA_MULTRET, 0) == LUA_OK)
+      if (lua_pcall(L, 0, LUA_MULTRET, 0) == LUA_OK) {
+        writes.commit();
         tx.commit();
+      }
       else
         return lua_error(L); // pcall already put an error object on the stack
       nresults = lua_gettop(L) - top;
@@ -0,0 +1,170 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/script/deferred_image_writes.h"
+
+#include "app/cmd/copy_region.h"
+#include "app/doc.h"
+#include "app/transaction.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+#include "gfx/region.h"
+
+namespace app { namespace script {
+
+namespace {
+
+// Active DeferredImageWrites (the innermost app.transaction())
+DeferredImageWrites* g_active = nullptr; // TODO non-thread safe
+
+} // anonymous namespace
+
+DeferredImageWrites::DeferredImageWrites(Doc* doc, Transaction& transaction)
+  : m_doc(doc)
+  , m_transaction(&transaction)
+  , m_prev(g_active)
+  , m_nested(g_active && g_active->m_doc == doc)
+{
+  if (m_nested)
+    return;
+
+  g_active = this;
+
+  // Add the pending modifications before any other Cmd, so undoing
+  // the Cmd doesn't restore pixels modified after it.
+  m_transaction->setBeforeExecuteFunc([this] { flush(); });
+}
+
+DeferredImageWrites::~DeferredImageWrites()
+{
+  if (m_nested)
+    return;
+
+  rollback();
+
+  m_transaction->setBeforeExecuteFunc(nullptr);
+  g_active = m_prev;
+}
+
+void DeferredImageWrites::commit()
+{
+  if (!m_nested)
+    flush();
+}
+
+// static
+DeferredImageWrites* DeferredImageWrites::get(const doc::Cel* cel)
+{
+  if (g_active && cel && cel->document() == g_active->m_doc)
+    return g_active;
+  return nullptr;
+}
+
+// static
+DeferredImageWrites* DeferredImageWrites::get(const doc::Tileset* tileset)
+{
+  if (g_active && tileset && tileset->sprite() &&
+      tileset->sprite()->document() == g_active->m_doc)
+    return g_active;
+  return nullptr;
+}
+
+void DeferredImageWrites::willModify(doc::Image* image, const gfx::Rect& bounds)
+{
+  const gfx::Rect rc = (bounds & image->bounds());
+  if (rc.isEmpty())
+    return;
+
+  ModifiedImage& mod = m_images[image->id()];
+  if (!mod.original)
+    mod.original.reset(doc::Image::createCopy(image));
+
+  mod.bounds |= rc;
+}
+
+void DeferredImageWrites::tileModified(doc::Tileset* tileset, doc::tile_index ti)
+{
+  m_tiles.insert(std::make_pair(tileset->id(), ti));
+}
+
+// static
+void DeferredImageWrites::willModifyCelImage(const doc::Cel* cel,
+                                             doc::Image* image,
+                                             const gfx::Rect& bounds)
+{
+  if (auto writes = get(cel))
+    writes->willModify(image, bounds);
+}
+
+// static
+void DeferredImageWrites::notifyTileChange(doc::Tileset* tileset, doc::tile_index ti)
+{
+  if (auto writes = get(tileset)) {
+    writes->tileModified(tileset, ti);
+  }
+  else {
+    tileset->incrementVersion();
+    tileset->notifyTileContentChange(ti);
+  }
+}
+
+void DeferredImageWrites::flush()
+{
+  // Move the pending modifications, so new Cmds executed here don't
+  // call flush() again.
+  auto images = std::move(m_images);
+  auto tiles = std::move(m_tiles);
+  m_images.clear();
+  m_tiles.clear();
+
+  for (auto& [imageId, mod] : images) {
+    doc::Image* image = doc::get<doc::Image>(imageId);
+    if (!image || mod.bounds.isEmpty())
+      continue;
+
+    // The image was already modified, the CopyRegion saves the
+    // original pixels to undo the modification.
+    m_transaction->execute(new cmd::CopyRegion(image,
+                                               mod.original.get(),
+                                               gfx::Region(mod.bounds),
+                                               gfx::Point(0, 0),
+                                               true));
+  }
+
+  for (const auto& [tilesetId, ti] : tiles) {
+    if (auto* tileset = doc::get<doc::Tileset>(tilesetId)) {
+      tileset->incrementVersion();
+      tileset->notifyTileContentChange(ti);
+    }
+  }
+}
+
+void DeferredImageWrites::rollback()
+{
+  for (auto& [imageId, mod] : m_images) {
+    if (doc::Image* image = doc::get<doc::Image>(imageId)) {
+      image->copy(mod.original.get(), gfx::Clip(mod.bounds));
+      image->incrementVersion();
+    }
+  }
+  m_images.clear();
+
+  for (const auto& [tilesetId, ti] : m_tiles) {
+    if (auto* tileset = doc::get<doc::Tileset>(tilesetId)) {
+      tileset->incrementVersion();
+      tileset->notifyTileContentChange(ti);
+    }
+  }
+  m_tiles.clear();
+}
+
+}} // namespace app::script
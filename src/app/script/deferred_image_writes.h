@@ -0,0 +1,96 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef APP_SCRIPT_DEFERRED_IMAGE_WRITES_H_INCLUDED
+#define APP_SCRIPT_DEFERRED_IMAGE_WRITES_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
+#include "doc/tile.h"
+#include "gfx/rect.h"
+
+#include <map>
+#include <set>
+#include <utility>
+
+namespace doc {
+class Cel;
+class Image;
+class Tileset;
+} // namespace doc
+
+namespace app {
+class Doc;
+class Transaction;
+
+namespace script {
+
+// Modifications of images from scripts inside an app.transaction().
+//
+// Instead of adding one cmd::CopyRegion for each
+// Image:drawPixel()/drawImage()/putPixels()/etc. call, cel images
+// are modified directly, and one cmd::CopyRegion is added for each
+// modified image when the transaction is committed (or before any
+// other Cmd is executed in the same transaction, to keep the order
+// of the undo history). In the same way tilesets are notified only
+// once for each modified tile.
+class DeferredImageWrites {
+public:
+  DeferredImageWrites(Doc* doc, Transaction& transaction);
+  ~DeferredImageWrites();
+
+  // Adds the pending modifications to the transaction. If this is
+  // not called, the modified images are restored in the destructor.
+  void commit();
+
+  // Returns the active DeferredImageWrites for images of the given
+  // cel/tileset, or nullptr if the image must be modified with its
+  // own transaction (e.g. when we are not inside an
+  // app.transaction()).
+  static DeferredImageWrites* get(const doc::Cel* cel);
+  static DeferredImageWrites* get(const doc::Tileset* tileset);
+
+  // Must be called before modifying the given area of the image.
+  void willModify(doc::Image* image, const gfx::Rect& bounds);
+
+  // Must be called after modifying a tile of the given tileset.
+  void tileModified(doc::Tileset* tileset, doc::tile_index ti);
+
+  // Helpers to modify images directly (without a Cmd) from scripts:
+  // willModifyCelImage() must be called before modifying the image of
+  // the given cel (it does nothing if we are not inside an
+  // app.transaction()), and notifyTileChange() after modifying a
+  // tile (it notifies the tileset now or at the end of the
+  // app.transaction()).
+  static void willModifyCelImage(const doc::Cel* cel, doc::Image* image, const gfx::Rect& bounds);
+  static void notifyTileChange(doc::Tileset* tileset, doc::tile_index ti);
+
+private:
+  struct ModifiedImage {
+    doc::ImageRef original;
+    // Only the bounds are kept (instead of a gfx::Region) because
+    // scripts can modify pixel by pixel.
+    gfx::Rect bounds;
+  };
+
+  void flush();
+  void rollback();
+
+  Doc* m_doc;
+  Transaction* m_transaction;
+  DeferredImageWrites* m_prev;
+  // True if this is inside other app.transaction() of the same
+  // document (the outer one handles the modifications).
+  bool m_nested;
+  std::map<doc::ObjectId, ModifiedImage> m_images;
+  std::set<std::pair<doc::ObjectId, doc::tile_index>> m_tiles;
+};
+
+} // namespace script
+} // namespace app
+
+#endif
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -178,6 +178,7 @@ void register_events_class(lua_State* L);
 void register_frame_class(lua_State* L);
 void register_frames_class(lua_State* L);
 void register_grid_class(lua_State* L);
+void register_image_buffer_view_class(lua_State* L);
 void register_image_class(lua_State* L);
 void register_image_iterator_class(lua_State* L);
 void register_image_spec_class(lua_State* L);
@@ -478,6 +479,7 @@ Engine::Engine() : L(luaL_newstate()), m_delegate(nullptr), m_printLastResult(fa
   register_frame_class(L);
   register_frames_class(L);
   register_grid_class(L);
+  register_image_buffer_view_class(L);
   register_image_class(L);
   register_image_iterator_class(L);
   register_image_spec_class(L);
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -141,6 +141,12 @@ private:
 void push_app_events(lua_State* L);
 void push_app_theme(lua_State* L, int uiscale = 1);
 int push_image_iterator_function(lua_State* L, const doc::Image* image, int extraArgIndex);
+void push_image_buffer_view(lua_State* L,
+                            int imageIndex,
+                            doc::Cel* cel,
+                            doc::Tileset* tileset,
+                            doc::tile_index ti,
+                            const gfx::Rect& bounds);
 void push_brush(lua_State* L, const doc::BrushRef& brush);
 void push_cel_image(lua_State* L, doc::Cel* cel);
 void push_cel_images(lua_State* L, const doc::ObjectIds& cels);
@@ -0,0 +1,349 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "app/script/deferred_image_writes.h"
+#include "app/script/docobj.h"
+#include "app/script/engine.h"
+#include "app/script/luacpp.h"
+#include "doc/cel.h"
+#include "doc/image.h"
+#include "doc/tileset.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace app { namespace script {
+
+namespace {
+
+// View of the pixels of an image (or a rectangle of it) to access
+// its bytes directly from scripts without copying them to Lua
+// strings.
+//
+// Bytes are addressed as if the rows of the view were contiguous (0
+// is the first byte of the view, rowStride is the first byte of the
+// second row, etc.). The Image userdata is kept as the uservalue of
+// the view, so it isn't collected while the view is alive.
+struct ImageBufferView {
+  doc::ObjectId imageId;
+  doc::ObjectId celId;
+  doc::ObjectId tilesetId;
+  doc::tile_index ti;
+  gfx::Rect bounds; // In image coordinates
+  int bpp;
+
+  ImageBufferView(const doc::Image* image,
+                  const doc::Cel* cel,
+                  const doc::Tileset* tileset,
+                  const doc::tile_index ti,
+                  const gfx::Rect& bounds)
+    : imageId(image->id())
+    , celId(cel ? cel->id() : doc::NullId)
+    , tilesetId(tileset ? tileset->id() : doc::NullId)
+    , ti(ti)
+    , bounds(bounds)
+    , bpp(image->bytesPerPixel())
+  {
+  }
+
+  // Creates a view of a rectangle of the given view
+  ImageBufferView(const ImageBufferView& view, const gfx::Rect& bounds)
+    : imageId(view.imageId)
+    , celId(view.celId)
+    , tilesetId(view.tilesetId)
+    , ti(view.ti)
+    , bounds(bounds)
+    , bpp(view.bpp)
+  {
+  }
+
+  int rowStride() const { return bounds.w * bpp; }
+  size_t size() const { return size_t(rowStride()) * bounds.h; }
+
+  doc::Image* image(lua_State* L) const { return check_docobj(L, doc::get<doc::Image>(imageId)); }
+
+  uint8_t* rowAddress(const doc::Image* image, const int y) const
+  {
+    return image->getPixelAddress(bounds.x, bounds.y + y);
+  }
+
+  // Returns the address of "size" bytes in the given offset, throwing
+  // a Lua error if they are outside the view or in two different rows.
+  uint8_t* byteAddress(lua_State* L, const doc::Image* image, const lua_Integer offset, int size)
+  {
+    const int stride = rowStride();
+    if (offset < 0 || offset + size > lua_Integer(this->size()) ||
+        (offset % stride) + size > stride) {
+      luaL_error(L, "offset %d outside the image buffer view", int(offset));
+      return nullptr;
+    }
+    return rowAddress(image, int(offset / stride)) + (offset % stride);
+  }
+
+  uint8_t* pixelAddress(lua_State* L, const doc::Image* image, const int x, const int y)
+  {
+    if (x < 0 || y < 0 || x >= bounds.w || y >= bounds.h) {
+      luaL_error(L, "pixel (%d, %d) outside the image buffer view", x, y);
+      return nullptr;
+    }
+    return rowAddress(image, y) + x * bpp;
+  }
+
+  // Must be called before modifying the given area (in image
+  // coordinates) of the image, and modified() after that.
+  void willModify(lua_State* L, doc::Image* image, const gfx::Rect& rc)
+  {
+    if (celId)
+      DeferredImageWrites::willModifyCelImage(check_docobj(L, doc::get<doc::Cel>(celId)),
+                                              image,
+                                              rc);
+  }
+
+  void modified(lua_State* L, doc::Image* image)
+  {
+    image->incrementVersion();
+    if (tilesetId)
+      DeferredImageWrites::notifyTileChange(check_docobj(L, doc::get<doc::Tileset>(tilesetId)),
+                                            ti);
+  }
+};
+
+template<typename T>
+int ImageBufferView_get(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  const doc::Image* image = view->image(L);
+  T value;
+  std::memcpy(&value, view->byteAddress(L, image, luaL_checkinteger(L, 2), sizeof(T)), sizeof(T));
+  lua_pushinteger(L, value);
+  return 1;
+}
+
+template<typename T>
+int ImageBufferView_set(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  doc::Image* image = view->image(L);
+  const lua_Integer offset = luaL_checkinteger(L, 2);
+  const T value = T(luaL_checkinteger(L, 3));
+  uint8_t* address = view->byteAddress(L, image, offset, sizeof(T));
+
+  const int y = int(offset / view->rowStride());
+  view->willModify(L, image, gfx::Rect(view->bounds.x, view->bounds.y + y, view->bounds.w, 1));
+  std::memcpy(address, &value, sizeof(T));
+  view->modified(L, image);
+  return 0;
+}
+
+int ImageBufferView_gc(lua_State* L)
+{
+  get_obj<ImageBufferView>(L, 1)->~ImageBufferView();
+  return 0;
+}
+
+int ImageBufferView_len(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  lua_pushinteger(L, view->size());
+  return 1;
+}
+
+int ImageBufferView_getPixel(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  const doc::Image* image = view->image(L);
+  const uint8_t* address =
+    view->pixelAddress(L, image, luaL_checkinteger(L, 2), luaL_checkinteger(L, 3));
+  switch (view->bpp) {
+    case 1: lua_pushinteger(L, *address); break;
+    case 2: lua_pushinteger(L, *(const uint16_t*)address); break;
+    case 4: lua_pushinteger(L, *(const uint32_t*)address); break;
+    default: return 0;
+  }
+  return 1;
+}
+
+int ImageBufferView_setPixel(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  doc::Image* image = view->image(L);
+  const int x = luaL_checkinteger(L, 2);
+  const int y = luaL_checkinteger(L, 3);
+  const lua_Integer value = luaL_checkinteger(L, 4);
+  uint8_t* address = view->pixelAddress(L, image, x, y);
+
+  view->willModify(L, image, gfx::Rect(view->bounds.x + x, view->bounds.y + y, 1, 1));
+  switch (view->bpp) {
+    case 1: *address = uint8_t(value); break;
+    case 2: *(uint16_t*)address = uint16_t(value); break;
+    case 4: *(uint32_t*)address = uint32_t(value); break;
+  }
+  view->modified(L, image);
+  return 0;
+}
+
+int ImageBufferView_slice(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+
+  // The rectangle is relative to this view
+  gfx::Rect bounds = convert_args_into_rect(L, 2);
+  bounds.offset(view->bounds.origin());
+  bounds &= view->bounds;
+
+  push_new<ImageBufferView>(L, *view, bounds);
+
+  // Keep a reference to the same Image userdata
+  lua_getuservalue(L, 1);
+  lua_setuservalue(L, -2);
+  return 1;
+}
+
+int ImageBufferView_getBytes(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  const doc::Image* image = view->image(L);
+  const int stride = view->rowStride();
+
+  luaL_Buffer b;
+  char* dst = luaL_buffinitsize(L, &b, view->size());
+  for (int y = 0; y < view->bounds.h; ++y, dst += stride)
+    std::memcpy(dst, view->rowAddress(image, y), stride);
+  luaL_pushresultsize(&b, view->size());
+  return 1;
+}
+
+int ImageBufferView_setBytes(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  doc::Image* image = view->image(L);
+  const int stride = view->rowStride();
+  size_t bytes_size;
+  const char* bytes = luaL_checklstring(L, 2, &bytes_size);
+
+  if (bytes_size != view->size()) {
+    return luaL_error(L,
+                      "Data size does not match: given %d, needed %d.",
+                      int(bytes_size),
+                      int(view->size()));
+  }
+
+  view->willModify(L, image, view->bounds);
+  for (int y = 0; y < view->bounds.h; ++y, bytes += stride)
+    std::memcpy(view->rowAddress(image, y), bytes, stride);
+  view->modified(L, image);
+  return 0;
+}
+
+int ImageBufferView_isEqual(lua_State* L)
+{
+  auto a = get_obj<ImageBufferView>(L, 1);
+  auto b = get_obj<ImageBufferView>(L, 2);
+  const doc::Image* imageA = a->image(L);
+  const doc::Image* imageB = b->image(L);
+
+  bool result = (a->bpp == b->bpp && a->bounds.size() == b->bounds.size());
+  const int stride = a->rowStride();
+  for (int y = 0; result && y < a->bounds.h; ++y)
+    result = (std::memcmp(a->rowAddress(imageA, y), b->rowAddress(imageB, y), stride) == 0);
+
+  lua_pushboolean(L, result);
+  return 1;
+}
+
+int ImageBufferView_get_width(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  lua_pushinteger(L, view->bounds.w);
+  return 1;
+}
+
+int ImageBufferView_get_height(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  lua_pushinteger(L, view->bounds.h);
+  return 1;
+}
+
+int ImageBufferView_get_bounds(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  push_obj(L, view->bounds);
+  return 1;
+}
+
+int ImageBufferView_get_bytesPerPixel(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  lua_pushinteger(L, view->bpp);
+  return 1;
+}
+
+int ImageBufferView_get_rowStride(lua_State* L)
+{
+  auto view = get_obj<ImageBufferView>(L, 1);
+  lua_pushinteger(L, view->rowStride());
+  return 1;
+}
+
+const luaL_Reg ImageBufferView_methods[] = {
+  { "getPixel", ImageBufferView_getPixel      },
+  { "setPixel", ImageBufferView_setPixel      },
+  { "getU8",    ImageBufferView_get<uint8_t>  },
+  { "getU16",   ImageBufferView_get<uint16_t> },
+  { "getU32",   ImageBufferView_get<uint32_t> },
+  { "setU8",    ImageBufferView_set<uint8_t>  },
+  { "setU16",   ImageBufferView_set<uint16_t> },
+  { "setU32",   ImageBufferView_set<uint32_t> },
+  { "slice",    ImageBufferView_slice         },
+  { "getBytes", ImageBufferView_getBytes      },
+  { "setBytes", ImageBufferView_setBytes      },
+  { "isEqual",  ImageBufferView_isEqual       },
+  { "__len",    ImageBufferView_len           },
+  { "__gc",     ImageBufferView_gc            },
+  { nullptr,    nullptr                       }
+};
+
+const Property ImageBufferView_properties[] = {
+  { "width",         ImageBufferView_get_width,         nullptr },
+  { "height",        ImageBufferView_get_height,        nullptr },
+  { "bounds",        ImageBufferView_get_bounds,        nullptr },
+  { "bytesPerPixel", ImageBufferView_get_bytesPerPixel, nullptr },
+  { "rowStride",     ImageBufferView_get_rowStride,     nullptr },
+  { nullptr,         nullptr,                           nullptr }
+};
+
+} // anonymous namespace
+
+DEF_MTNAME(ImageBufferView);
+
+void register_image_buffer_view_class(lua_State* L)
+{
+  REG_CLASS(L, ImageBufferView);
+  REG_CLASS_PROPERTIES(L, ImageBufferView);
+}
+
+void push_image_buffer_view(lua_State* L,
+                            int imageIndex,
+                            doc::Cel* cel,
+                            doc::Tileset* tileset,
+                            doc::tile_index ti,
+                            const gfx::Rect& bounds)
+{
+  imageIndex = lua_absindex(L, imageIndex);
+  const doc::Image* image = get_image_from_arg(L, imageIndex);
+  push_new<ImageBufferView>(L, image, cel, tileset, ti, bounds & image->bounds());
+
+  // Keep the Image userdata alive while the view exists
+  lua_pushvalue(L, imageIndex);
+  lua_setuservalue(L, -2);
+}
+
+}} // namespace app::script
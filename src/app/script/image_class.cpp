@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2024  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2015-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -18,6 +18,7 @@
 #include "app/file/file.h"
 #include "app/modules/palettes.h"
 #include "app/script/blend_mode.h"
+#include "app/script/deferred_image_writes.h"
 #include "app/script/docobj.h"
 #include "app/script/engine.h"
 #include "app/script/luacpp.h"
@@ -34,13 +35,16 @@
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/image_ref.h"
+#include "doc/image_traits.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
+#include "doc/tileset.h"
 #include "render/render.h"
 
 #include <algorithm>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 namespace app { namespace script {
 
@@ -99,6 +103,82 @@ void render_sprite(Image* dst, const Sprite* sprite, const frame_t frame, const
   render.renderSprite(dst, sprite, frame, gfx::Clip(x, y, 0, 0, sprite->width(), sprite->height()));
 }
 
+// Notifies the tileset that the tile of the given image was modified
+// (or defers the notification to the end of the app.transaction()).
+void notify_tile_change(lua_State* L, ImageObj* obj)
+{
+  if (doc::Tileset* ts = obj->tileset(L))
+    DeferredImageWrites::notifyTileChange(ts, obj->ti);
+}
+
+// Must be called before modifying the given area of a cel image
+// directly (without undo information), so the modification is added
+// to the active app.transaction() (if there is one).
+void will_modify_cel_image(lua_State* L, ImageObj* obj, doc::Image* img, const gfx::Rect& bounds)
+{
+  if (auto cel = obj->cel(L))
+    DeferredImageWrites::willModifyCelImage(cel, img, bounds);
+}
+
+// Modifies the given area of the image calling func(image). If it's
+// a cel image, the modification is added to the active
+// app.transaction() or to a new transaction.
+template<typename Func>
+void modify_image(lua_State* L, ImageObj* obj, const gfx::Rect& bounds, Func&& func)
+{
+  doc::Image* img = obj->image(L);
+  const gfx::Rect rc = (bounds & img->bounds());
+  if (rc.isEmpty())
+    return;
+
+  doc::Cel* cel = obj->cel(L);
+  if (cel && !DeferredImageWrites::get(cel)) {
+    // The CopyRegion saves the original pixels before func() is
+    // called, so if func() fails, the rollback restores them.
+    Tx tx(cel->sprite());
+    ImageRef original(doc::crop_image(img, rc, 0));
+    tx(new cmd::CopyRegion(img,
+                           original.get(),
+                           gfx::Region(original->bounds()),
+                           rc.origin(),
+                           true));
+    func(img);
+    img->incrementVersion();
+    tx.commit();
+  }
+  else {
+    will_modify_cel_image(L, obj, img, rc);
+    func(img);
+    img->incrementVersion();
+  }
+
+  notify_tile_change(L, obj);
+}
+
+template<typename ImageTraits>
+void read_pixels_from_table(lua_State* L, int index, doc::Image* img)
+{
+  lua_Integer n = 1;
+  for (int y = 0; y < img->height(); ++y) {
+    auto it = (typename ImageTraits::address_t)img->getPixelAddress(0, y);
+    for (int x = 0; x < img->width(); ++x, ++it, ++n) {
+      lua_rawgeti(L, index, n);
+      *it = (typename ImageTraits::pixel_t)lua_tointeger(L, -1);
+      lua_pop(L, 1);
+    }
+  }
+}
+
+doc::color_t get_color_arg(lua_State* L, int index, const doc::Image* img)
+{
+  if (lua_isnone(L, index))
+    return img->maskColor();
+  else if (lua_isinteger(L, index))
+    return lua_tointeger(L, index);
+  else
+    return convert_args_into_pixel_color(L, index, img->pixelFormat());
+}
+
 int Image_clone(lua_State* L);
 
 int Image_new(lua_State* L)
@@ -218,7 +298,6 @@ int Image_clear(lua_State* L)
 {
   auto obj = get_obj<ImageObj>(L, 1);
   auto img = obj->image(L);
-  doc::color_t color;
   gfx::Rect rc;
   int i = 2;
 
@@ -230,14 +309,31 @@ int Image_clear(lua_State* L)
     rc = img->bounds(); // Clear the whole image
   }
 
-  if (lua_isnone(L, i))
-    color = img->maskColor();
-  else if (lua_isinteger(L, i))
-    color = lua_tointeger(L, i);
-  else
-    color = convert_args_into_pixel_color(L, i, img->pixelFormat());
+  const doc::color_t color = get_color_arg(L, i, img);
 
+  will_modify_cel_image(L, obj, img, rc);
   doc::fill_rect(img, rc, color); // Clips the rectangle to the image bounds
+  img->incrementVersion();
+  notify_tile_change(L, obj);
+  return 0;
+}
+
+int Image_fill(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const doc::Image* img = obj->image(L);
+  gfx::Rect rc = img->bounds();
+  int i = 2;
+
+  if (auto rcPtr = may_get_obj<gfx::Rect>(L, i)) {
+    rc = *rcPtr;
+    ++i;
+  }
+
+  const doc::color_t color = get_color_arg(L, i, img);
+
+  // Unlike Image:clear(), this is undoable for cel images
+  modify_image(L, obj, rc, [&rc, color](doc::Image* dst) { doc::fill_rect(dst, rc, color); });
   return 0;
 }
 
@@ -252,15 +348,72 @@ int Image_drawPixel(lua_State* L)
     color = lua_tointeger(L, 4);
   else
     color = convert_args_into_pixel_color(L, 4, img->pixelFormat());
+
+  if (obj->celId)
+    will_modify_cel_image(L, obj, img, gfx::Rect(x, y, 1, 1));
   doc::put_pixel(img, x, y, color);
+  img->incrementVersion();
 
   // Rehash tileset
-  if (obj->tilesetId) {
-    if (doc::Tileset* ts = obj->tileset(L)) {
-      ts->incrementVersion();
-      ts->notifyTileContentChange(obj->ti);
+  if (obj->tilesetId)
+    notify_tile_change(L, obj);
+  return 0;
+}
+
+int Image_putPixels(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const doc::Image* img = obj->image(L);
+  gfx::Rect rc = img->bounds();
+  int i = 2;
+
+  if (auto rcPtr = may_get_obj<gfx::Rect>(L, i)) {
+    rc = *rcPtr;
+    ++i;
+  }
+  if (rc.isEmpty())
+    return 0;
+
+  // Read all pixels (in the image format) before modifying the image
+  ImageRef pixels(doc::Image::create(img->pixelFormat(), rc.w, rc.h));
+
+  if (lua_type(L, i) == LUA_TSTRING) {
+    const size_t rowBytes = size_t(rc.w) * img->bytesPerPixel();
+    size_t bytes_size, bytes_needed = rowBytes * rc.h;
+    const char* bytes = lua_tolstring(L, i, &bytes_size);
+    if (bytes_size != bytes_needed) {
+      return luaL_error(L,
+                        "Data size does not match: given %d, needed %d.",
+                        int(bytes_size),
+                        int(bytes_needed));
+    }
+    for (int y = 0; y < rc.h; ++y, bytes += rowBytes)
+      std::memcpy(pixels->getPixelAddress(0, y), bytes, rowBytes);
+  }
+  else if (lua_istable(L, i)) {
+    const lua_Integer given = luaL_len(L, i);
+    const lua_Integer needed = lua_Integer(rc.w) * rc.h;
+    if (given != needed) {
+      return luaL_error(L,
+                        "Number of pixels does not match: given %d, needed %d.",
+                        int(given),
+                        int(needed));
+    }
+    switch (img->pixelFormat()) {
+      case IMAGE_RGB:       read_pixels_from_table<RgbTraits>(L, i, pixels.get()); break;
+      case IMAGE_GRAYSCALE: read_pixels_from_table<GrayscaleTraits>(L, i, pixels.get()); break;
+      case IMAGE_INDEXED:   read_pixels_from_table<IndexedTraits>(L, i, pixels.get()); break;
+      case IMAGE_TILEMAP:   read_pixels_from_table<TilemapTraits>(L, i, pixels.get()); break;
+      default:              return luaL_error(L, "unsupported image format");
     }
   }
+  else {
+    return luaL_error(L, "expected a table or a string with pixels");
+  }
+
+  modify_image(L, obj, rc, [&rc, &pixels](doc::Image* dst) {
+    dst->copy(pixels.get(), gfx::Clip(rc.origin(), pixels->bounds()));
+  });
   return 0;
 }
 
@@ -296,7 +449,8 @@ int Image_drawImage(lua_State* L)
   Image* dst = obj->image(L);
   const Image* src = sprite->image(L);
 
-  if (auto cel = obj->cel(L)) {
+  auto cel = obj->cel(L);
+  if (cel && !DeferredImageWrites::get(cel)) {
     gfx::Rect bounds(src->size());
 
     // Create the ImageBuffer only when it doesn't exist so we can
@@ -322,18 +476,101 @@ int Image_drawImage(lua_State* L)
     tx.commit();
   }
   // If the destination image is not related to a sprite, we just draw
-  // the source image without undo information.
+  // the source image without undo information. Inside an
+  // app.transaction() we draw directly in the cel image too (the
+  // undo information is added at the end of the transaction).
   else {
-    doc::blend_image(dst,
-                     src,
-                     gfx::Clip(pos, src->bounds()),
-                     get_current_palette(),
-                     opacity,
-                     blendMode);
+    ImageRef srcCopy;
+    if (src == dst) {
+      srcCopy.reset(Image::createCopy(src));
+      src = srcCopy.get();
+    }
+    const doc::Palette* palette = (cel ? cel->sprite()->palette(0) : get_current_palette());
+    modify_image(L, obj, gfx::Rect(pos, src->size()), [&](doc::Image* image) {
+      doc::blend_image(image, src, gfx::Clip(pos, src->bounds()), palette, opacity, blendMode);
+    });
   }
   return 0;
 }
 
+int Image_drawImages(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const doc::Image* dst = obj->image(L);
+  luaL_checktype(L, 2, LUA_TTABLE);
+
+  // This can be:
+  //
+  //   image:drawImages{ { image=image1, position=Point(x, y) },
+  //                     { image=image2, position={x, y}, opacity=128,
+  //                       blendMode=BlendMode.MULTIPLY }, ... }
+  //
+  // All images are drawn with just one undoable modification.
+
+  struct Item {
+    const doc::Image* image = nullptr;
+    gfx::Point pos;
+    int opacity = 255;
+    doc::BlendMode blendMode = doc::BlendMode::NORMAL;
+  };
+  std::vector<Item> items;
+  std::vector<ImageRef> copies;
+  gfx::Rect bounds;
+
+  const lua_Integer n = luaL_len(L, 2);
+  items.reserve(n);
+  for (lua_Integer k = 1; k <= n; ++k) {
+    lua_geti(L, 2, k);
+    if (!lua_istable(L, -1))
+      return luaL_error(L, "expected a table in drawImages() list item %d", int(k));
+
+    Item item;
+    lua_getfield(L, -1, "image");
+    item.image = get_obj<ImageObj>(L, -1)->image(L);
+    lua_pop(L, 1);
+
+    int type = lua_getfield(L, -1, "position");
+    if (type != LUA_TNIL)
+      item.pos = convert_args_into_point(L, -1);
+    lua_pop(L, 1);
+
+    type = lua_getfield(L, -1, "opacity");
+    if (type != LUA_TNIL)
+      item.opacity = std::clamp(int(lua_tointeger(L, -1)), 0, 255);
+    lua_pop(L, 1);
+
+    type = lua_getfield(L, -1, "blendMode");
+    if (type != LUA_TNIL) {
+      item.blendMode = base::convert_to<doc::BlendMode>(
+        app::script::BlendMode(lua_tointeger(L, -1)));
+    }
+    lua_pop(L, 2); // Pop the "blendMode" field and the list item
+
+    // The image is drawn in itself
+    if (item.image == dst) {
+      copies.emplace_back(Image::createCopy(dst));
+      item.image = copies.back().get();
+    }
+
+    bounds |= gfx::Rect(item.pos, item.image->size());
+    items.push_back(item);
+  }
+
+  auto cel = obj->cel(L);
+  const doc::Palette* palette = (cel ? cel->sprite()->palette(0) : get_current_palette());
+  modify_image(L, obj, bounds, [&items, palette](doc::Image* image) {
+    for (const Item& item : items) {
+      doc::blend_image(image,
+                       item.image,
+                       gfx::Clip(item.pos, item.image->bounds()),
+                       palette,
+                       item.opacity,
+                       item.blendMode);
+    }
+  });
+  return 0;
+}
+
 int Image_drawSprite(lua_State* L)
 {
   auto obj = get_obj<ImageObj>(L, 1);
@@ -373,6 +610,18 @@ int Image_pixels(lua_State* L)
   return 1;
 }
 
+int Image_view(lua_State* L)
+{
+  auto obj = get_obj<ImageObj>(L, 1);
+  const doc::Image* img = obj->image(L);
+  gfx::Rect bounds = img->bounds();
+  if (!lua_isnone(L, 2))
+    bounds &= convert_args_into_rect(L, 2);
+
+  push_image_buffer_view(L, 1, obj->cel(L), obj->tileset(L), obj->ti, bounds);
+  return 1;
+}
+
 int Image_getPixel(lua_State* L)
 {
   const auto obj = get_obj<ImageObj>(L, 1);
@@ -660,12 +909,16 @@ int Image_get_bytes(lua_State* L)
 
 int Image_set_bytes(lua_State* L)
 {
-  const auto img = get_obj<ImageObj>(L, 1)->image(L);
+  auto obj = get_obj<ImageObj>(L, 1);
+  const auto img = obj->image(L);
   size_t bytes_size, bytes_needed = img->rowBytes() * img->height();
   const char* bytes = lua_tolstring(L, 2, &bytes_size);
 
   if (bytes_size == bytes_needed) {
+    will_modify_cel_image(L, obj, img, img->bounds());
     std::memcpy(img->getPixelAddress(0, 0), bytes, bytes_size);
+    img->incrementVersion();
+    notify_tile_change(L, obj);
   }
   else {
     lua_pushfstring(L, "Data size does not match: given %d, needed %d.", bytes_size, bytes_needed);
@@ -723,11 +976,15 @@ const luaL_Reg Image_methods[] = {
   { "getPixel",     Image_getPixel     },
   { "drawPixel",    Image_drawPixel    },
   { "putPixel",     Image_drawPixel    },
+  { "putPixels",    Image_putPixels    },
+  { "fill",         Image_fill         },
   { "drawImage",    Image_drawImage    },
   { "putImage",     Image_drawImage    }, // TODO putImage is deprecated
+  { "drawImages",   Image_drawImages   },
   { "drawSprite",   Image_drawSprite   },
   { "putSprite",    Image_drawSprite   }, // TODO putSprite is deprecated
   { "pixels",       Image_pixels       },
+  { "view",         Image_view         },
   { "isEqual",      Image_isEqual      },
   { "isEmpty",      Image_isEmpty      },
   { "isPlain",      Image_isPlain      },
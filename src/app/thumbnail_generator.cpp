@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -16,13 +16,22 @@
 #include "app/doc.h"
 #include "app/file/file.h"
 #include "app/file_system.h"
+#include "app/resource_finder.h"
 #include "app/util/conversion_to_surface.h"
+#include "base/fs.h"
+#include "base/fstream_path.h"
+#include "base/serialization.h"
 #include "base/thread.h"
+#include "base/time.h"
 #include "doc/algorithm/rotate.h"
 #include "doc/image.h"
+#include "doc/image_io.h"
 #include "doc/palette.h"
+#include "doc/palette_io.h"
 #include "doc/primitives.h"
 #include "doc/sprite.h"
+#include "doc/string_io.h"
+#include "fmt/format.h"
 #include "os/system.h"
 #include "render/projection.h"
 #include "render/render.h"
@@ -30,6 +39,8 @@
 
 #include <algorithm>
 #include <atomic>
+#include <fstream>
+#include <functional>
 #include <memory>
 #include <thread>
 
@@ -38,10 +49,133 @@
 
 namespace app {
 
+namespace {
+
+// Maximum number of items waiting for a worker. When the user
+// scrolls a folder with thousands of files, the least recently
+// requested items (which are not visible anymore) are discarded.
+const int kMaxRemainingItems = 128;
+
+// Thumbnails cached on disk are identified by the path, modification
+// time, and size of the file, so they're re-generated when the file
+// changes.
+const uint32_t kThumbnailCacheMagic = 0x42485441; // "ATHB"
+
+// Maximum size of the thumbnails folder. When it's exceeded, the
+// least recently used thumbnails are removed.
+const std::size_t kMaxCacheSize = 64 * 1024 * 1024;
+
+std::string thumbnail_cache_key(const std::string& filename)
+{
+  const base::Time t = base::get_modification_time(filename);
+  return fmt::format("{}|{:04}{:02}{:02}{:02}{:02}{:02}|{}|{}",
+                     filename,
+                     t.year,
+                     t.month,
+                     t.day,
+                     t.hour,
+                     t.minute,
+                     t.second,
+                     base::file_size(filename),
+                     MAX_THUMBNAIL_SIZE);
+}
+
+// The cache filename depends only on the path of the file, so the
+// thumbnail of a modified file replaces the old one.
+std::string thumbnail_cache_filename(const std::string& cacheDir, const std::string& filename)
+{
+  return base::join_path(cacheDir,
+                         fmt::format("{:016x}.thumb", std::hash<std::string>()(filename)));
+}
+
+// Returns the path of the file from the cache key (the key contains
+// the filename and 3 more fields separated by '|').
+std::string filename_from_thumbnail_cache_key(const std::string& key)
+{
+  std::size_t i = key.size();
+  for (int field = 0; field < 3; ++field) {
+    if (i == 0 || (i = key.rfind('|', i - 1)) == std::string::npos)
+      return std::string();
+  }
+  return key.substr(0, i);
+}
+
+// Returns false if the cached thumbnail is invalid or if it's stale,
+// i.e. the original file was removed or modified.
+bool is_valid_cached_thumbnail(const std::string& fn)
+{
+  using namespace base::serialization::little_endian;
+
+  std::string key;
+  try {
+    std::ifstream s(FSTREAM_PATH(fn), std::ifstream::binary);
+    if (read32(s) != kThumbnailCacheMagic)
+      return false;
+    key = doc::read_string(s);
+  }
+  catch (const std::exception&) {
+    return false;
+  }
+
+  const std::string filename = filename_from_thumbnail_cache_key(key);
+  return (!filename.empty() && base::is_file(filename) && thumbnail_cache_key(filename) == key);
+}
+
+bool read_cached_thumbnail(const std::string& fn,
+                           const std::string& key,
+                           std::unique_ptr<Image>& image,
+                           std::unique_ptr<Palette>& palette)
+{
+  using namespace base::serialization::little_endian;
+
+  if (!base::is_file(fn))
+    return false;
+
+  try {
+    std::ifstream s(FSTREAM_PATH(fn), std::ifstream::binary);
+    if (read32(s) != kThumbnailCacheMagic || doc::read_string(s) != key)
+      return false;
+
+    image.reset(doc::read_image(s, false));
+    palette.reset(doc::read_palette(s));
+    return (image && palette);
+  }
+  catch (const std::exception& ex) {
+    THUMB_TRACE("Error reading cached thumbnail %s: %s\n", fn.c_str(), ex.what());
+    return false;
+  }
+}
+
+void write_cached_thumbnail(const std::string& fn,
+                            const std::string& key,
+                            const Image* image,
+                            const Palette* palette)
+{
+  using namespace base::serialization::little_endian;
+
+  try {
+    const std::string dir = base::get_file_path(fn);
+    if (!base::is_directory(dir))
+      base::make_all_directories(dir);
+
+    std::ofstream s(FSTREAM_PATH(fn), std::ofstream::binary);
+    write32(s, kThumbnailCacheMagic);
+    doc::write_string(s, key);
+    doc::write_image(s, image);
+    doc::write_palette(s, palette);
+  }
+  catch (const std::exception& ex) {
+    THUMB_TRACE("Error writing cached thumbnail %s: %s\n", fn.c_str(), ex.what());
+  }
+}
+
+} // anonymous namespace
+
 class ThumbnailGenerator::Worker {
 public:
-  Worker(base::concurrent_queue<ThumbnailGenerator::Item>& queue)
-    : m_queue(queue)
+  Worker(ThumbnailGenerator& generator, const std::string& cacheDir)
+    : m_generator(generator)
+    , m_cacheDir(cacheDir)
     , m_fop(nullptr)
     , m_isDone(false)
     , m_thread([this] { loadBgThread(); })
@@ -90,8 +224,27 @@ private:
 
       THUMB_TRACE("FOP loading thumbnail: %s\n", m_item.fileitem->fileName().c_str());
 
+      std::unique_ptr<Image> thumbnailImage;
+      std::unique_ptr<Palette> palette;
+
+      // Try to use the thumbnail cached on disk
+      std::string cacheKey, cacheFn;
+      if (!m_cacheDir.empty()) {
+        cacheKey = thumbnail_cache_key(m_fop->filename());
+        cacheFn = thumbnail_cache_filename(m_cacheDir, m_fop->filename());
+        if (read_cached_thumbnail(cacheFn, cacheKey, thumbnailImage, palette)) {
+          THUMB_TRACE("Using cached thumbnail: %s\n", cacheFn.c_str());
+          m_generator.cacheFileUsed(cacheFn, false);
+        }
+        else {
+          thumbnailImage.reset();
+          palette.reset();
+        }
+      }
+
       // Load the file
-      m_fop->operate(nullptr);
+      if (!thumbnailImage)
+        m_fop->operate(nullptr);
 
       // Don't call post-load because postLoad() needs user interaction.
       // m_fop->postLoad();
@@ -100,9 +253,7 @@ private:
       const Sprite* sprite =
         (m_fop->document() && m_fop->document()->sprite() ? m_fop->document()->sprite() : nullptr);
 
-      std::unique_ptr<Image> thumbnailImage;
-      std::unique_ptr<Palette> palette;
-      if (!m_fop->isStop() && sprite) {
+      if (!thumbnailImage && !m_fop->isStop() && sprite) {
         // The palette to convert the Image
         palette.reset(new Palette(*sprite->palette(frame_t(0))));
 
@@ -144,6 +295,11 @@ private:
                                           cs,
                                           gfx::ColorSpace::MakeSRGB());
         }
+
+        if (!cacheFn.empty()) {
+          write_cached_thumbnail(cacheFn, cacheKey, thumbnailImage.get(), palette.get());
+          m_generator.cacheFileUsed(cacheFn, true);
+        }
       }
 
       // Close file
@@ -207,22 +363,30 @@ private:
   {
     base::this_thread::set_name("thumbnails");
 
-    while (!m_queue.empty()) {
-      bool success = true;
-      while (success) {
-        {
-          const std::lock_guard lock(m_mutex); // To access m_item
-          success = m_queue.try_pop(m_item);
-        }
-        if (success)
-          loadItem();
+    bool trimmed = m_cacheDir.empty();
+    while (true) {
+      bool success;
+      {
+        const std::lock_guard lock(m_mutex); // To access m_item
+        success = m_generator.popItem(m_item);
+      }
+      if (success) {
+        loadItem();
+        continue;
       }
-      base::this_thread::yield();
+
+      // Remove old thumbnails from the disk cache when there is
+      // nothing else to do (and then check for new items again)
+      if (trimmed)
+        break;
+      m_generator.trimCache();
+      trimmed = true;
     }
     m_isDone = true;
   }
 
-  base::concurrent_queue<Item>& m_queue;
+  ThumbnailGenerator& m_generator;
+  std::string m_cacheDir;
   app::ThumbnailGenerator::Item m_item;
   FileOp* m_fop;
   mutable std::mutex m_mutex;
@@ -249,6 +413,18 @@ ThumbnailGenerator::ThumbnailGenerator()
   if (n < 1)
     n = 1;
   m_maxWorkers = n;
+
+  ResourceFinder rf;
+  rf.includeUserDir(base::join_path("thumbnails", ".").c_str());
+  m_cacheDir = rf.getFirstOrCreateDefault();
+}
+
+ThumbnailGenerator::~ThumbnailGenerator()
+{
+  // Workers are joined when m_workers is destroyed, here we avoid
+  // loading the remaining items (and trimming the cache).
+  m_exiting = true;
+  stopAllWorkers();
 }
 
 bool ThumbnailGenerator::checkWorkers()
@@ -276,8 +452,18 @@ void ThumbnailGenerator::generateThumbnail(IFileItem* fileitem)
 
   if (fileitem->getThumbnailProgress() > 0.0) {
     if (fileitem->getThumbnailProgress() == 0.00001) {
-      m_remainingItems.prioritize(
-        [fileitem](const Item& item) { return (item.fileitem == fileitem); });
+      // Move the item to the front of the queue (it's visible now)
+      {
+        const std::lock_guard lock(m_remainingItemsAccess);
+        auto it = std::find_if(m_remainingItems.begin(),
+                               m_remainingItems.end(),
+                               [fileitem](const Item& item) { return (item.fileitem == fileitem); });
+        if (it != m_remainingItems.end() && it != m_remainingItems.begin()) {
+          Item item = *it;
+          m_remainingItems.erase(it);
+          m_remainingItems.push_front(item);
+        }
+      }
 
       // If there is no more workers running, we have to start a new
       // one to process the m_remainingItems queue. How is it possible
@@ -312,25 +498,47 @@ void ThumbnailGenerator::generateThumbnail(IFileItem* fileitem)
     return;
   }
 
-  m_remainingItems.push(Item(fileitem, fop.get()));
-  fop.release();
+  // Formats that can decode a reduced version of the image (e.g. JPEG)
+  // will load the file faster.
+  fop->setReducedSizeHint(MAX_THUMBNAIL_SIZE);
+
+  std::vector<Item> discardedItems;
+  {
+    const std::lock_guard lock(m_remainingItemsAccess);
+    m_remainingItems.push_front(Item(fileitem, fop.get()));
+    fop.release();
+
+    while (m_remainingItems.size() > kMaxRemainingItems) {
+      discardedItems.push_back(m_remainingItems.back());
+      m_remainingItems.pop_back();
+    }
+  }
+
+  // Reset the progress of discarded items so they are queued again
+  // when they are visible again.
+  for (Item& item : discardedItems) {
+    item.fileitem->setThumbnailProgress(0.0);
+    delete item.fop;
+  }
 
   startWorker();
 }
 
 void ThumbnailGenerator::stopAllWorkers()
 {
-  Item item;
-  while (!m_remainingItems.empty()) {
-    while (m_remainingItems.try_pop(item)) {
-      if (!item.fileitem->getThumbnail()) {
-        // Reset progress to 0.0 because the FileOp wasn't used and we
-        // will need to create it again if we require this FileItem
-        // thumbnail again.
-        item.fileitem->setThumbnailProgress(0.0);
-      }
-      delete item.fop;
+  std::deque<Item> items;
+  {
+    const std::lock_guard lock(m_remainingItemsAccess);
+    std::swap(items, m_remainingItems);
+  }
+  for (Item& item : items) {
+    if (!item.fileitem->getThumbnail()) {
+      // Reset progress to 0.0 because the FileOp wasn't used and we
+      // will need to create it again if we require this FileItem
+      // thumbnail again.
+      item.fileitem->setThumbnailProgress(0.0);
     }
+    delete item.fop;
   }
 
   const std::lock_guard lock(m_workersAccess);
@@ -342,8 +550,103 @@ void ThumbnailGenerator::startWorker()
 {
   const std::lock_guard lock(m_workersAccess);
   if (m_workers.size() < m_maxWorkers) {
-    m_workers.push_back(std::make_unique<Worker>(m_remainingItems));
+    m_workers.push_back(std::make_unique<Worker>(*this, m_cacheDir));
   }
 }
 
+void ThumbnailGenerator::cacheFileUsed(const std::string& fn, const bool written)
+{
+  const std::lock_guard lock(m_cacheAccess);
+  m_usedCacheFiles.insert(fn);
+  if (written && base::is_file(fn))
+    m_cacheBytesWritten += base::file_size(fn);
+}
+
+void ThumbnailGenerator::trimCache()
+{
+  std::set<std::string> usedFiles;
+  {
+    const std::lock_guard lock(m_cacheAccess);
+
+    // Trim the cache one time per session, and then each time we've
+    // written a quarter of the maximum size.
+    if (m_trimmingCache || (m_cacheTrimmed && m_cacheBytesWritten < kMaxCacheSize / 4))
+      return;
+
+    m_trimmingCache = true;
+    m_cacheBytesWritten = 0;
+    usedFiles = m_usedCacheFiles;
+  }
+
+  struct Entry {
+    std::string fn;
+    bool used; // Used in this session
+    base::Time time;
+    std::size_t size;
+  };
+  std::vector<Entry> entries;
+  std::size_t totalSize = 0;
+
+  for (const auto& name : base::list_files(m_cacheDir, base::ItemType::Files)) {
+    if (m_exiting)
+      break;
+    if (base::get_file_extension(name) != "thumb")
+      continue;
+
+    const std::string fn = base::join_path(m_cacheDir, name);
+    const bool used = (usedFiles.find(fn) != usedFiles.end());
+    try {
+      if (!used && !is_valid_cached_thumbnail(fn)) {
+        THUMB_TRACE("Removing stale thumbnail %s\n", fn.c_str());
+        base::delete_file(fn);
+        continue;
+      }
+
+      Entry entry{ fn, used, base::get_modification_time(fn), base::file_size(fn) };
+      totalSize += entry.size;
+      entries.push_back(std::move(entry));
+    }
+    catch (const std::exception& ex) {
+      THUMB_TRACE("Error checking cached thumbnail %s: %s\n", fn.c_str(), ex.what());
+    }
+  }
+
+  // Remove the least recently used thumbnails (the ones that weren't
+  // used in this session, and then the oldest ones)
+  if (totalSize > kMaxCacheSize) {
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+      if (a.used != b.used)
+        return !a.used;
+      return a.time < b.time;
+    });
+
+    for (const Entry& entry : entries) {
+      if (totalSize <= kMaxCacheSize || m_exiting)
+        break;
+      try {
+        base::delete_file(entry.fn);
+        totalSize -= entry.size;
+      }
+      catch (const std::exception& ex) {
+        THUMB_TRACE("Error removing cached thumbnail %s: %s\n", entry.fn.c_str(), ex.what());
+      }
+    }
+  }
+
+  const std::lock_guard lock(m_cacheAccess);
+  m_cacheTrimmed = true;
+  m_trimmingCache = false;
+}
+
+bool ThumbnailGenerator::popItem(Item& item)
+{
+  const std::lock_guard lock(m_remainingItemsAccess);
+  if (m_remainingItems.empty())
+    return false;
+
+  item = m_remainingItems.front();
+  m_remainingItems.pop_front();
+  return true;
+}
+
 } // namespace app
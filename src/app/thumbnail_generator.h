@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -9,10 +9,12 @@
 #define APP_THUMBNAIL_GENERATOR_H_INCLUDED
 #pragma once
 
-#include "base/concurrent_queue.h"
-
+#include <atomic>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace base {
@@ -27,6 +29,8 @@ class ThumbnailGenerator {
   ThumbnailGenerator();
 
 public:
+  ~ThumbnailGenerator();
+
   static ThumbnailGenerator* instance();
 
   // Generate a thumbnail for the given file-item.  It must be called
@@ -59,10 +63,39 @@ private:
     Item(IFileItem* fileitem, FileOp* fop) : fileitem(fileitem), fop(fop) {}
   };
 
+  // Returns the next item to generate a thumbnail (the most recently
+  // requested one). Called from worker threads.
+  bool popItem(Item& item);
+
+  // Called from worker threads when a thumbnail of the disk cache was
+  // used or written.
+  void cacheFileUsed(const std::string& fn, bool written);
+
+  // Removes stale thumbnails (of files that were modified or removed)
+  // from the disk cache, and the least recently used ones when the
+  // cache is too big. Called from worker threads.
+  void trimCache();
+
+  // Items waiting for a worker, the most recently requested items
+  // (the visible ones in the file list) are at the front.
+  std::deque<Item> m_remainingItems;
+  std::mutex m_remainingItemsAccess;
+
+  // Directory where thumbnails are cached on disk.
+  std::string m_cacheDir;
+
+  // Cache files used in this session, and bytes written in the cache
+  // since the last time it was trimmed.
+  std::set<std::string> m_usedCacheFiles;
+  std::size_t m_cacheBytesWritten = 0;
+  bool m_cacheTrimmed = false;
+  bool m_trimmingCache = false;
+  std::mutex m_cacheAccess;
+  std::atomic<bool> m_exiting = false;
+
   int m_maxWorkers;
   WorkerList m_workers;
   std::mutex m_workersAccess;
-  base::concurrent_queue<Item> m_remainingItems;
 };
 
 } // namespace app
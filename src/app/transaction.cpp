@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -151,6 +151,22 @@ void Transaction::execute(Cmd* cmd)
     throw CannotModifyWhenUndoingException();
   }
 
+  // The function is disabled while it's running because it can
+  // execute new Cmds too.
+  if (m_beforeExecute) {
+    std::function<void()> func;
+    std::swap(func, m_beforeExecute);
+    try {
+      func();
+    }
+    catch (...) {
+      delete cmd;
+      std::swap(func, m_beforeExecute);
+      throw;
+    }
+    std::swap(func, m_beforeExecute);
+  }
+
   try {
     // We have to add the "cmd" to the sequence (CmdTransaction) and
     // then execute it. This is because the execution can generate
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -13,6 +13,7 @@
 #include "app/doc_observer.h"
 #include "base/exception.h"
 
+#include <functional>
 #include <string>
 
 namespace app {
@@ -96,6 +97,11 @@ public:
 
   CmdTransaction* cmds() { return m_cmds; }
 
+  // Function called before executing each new Cmd. It can be used to
+  // add pending changes as Cmds before the new one (e.g. images
+  // modified directly by scripts, see DeferredImageWrites).
+  void setBeforeExecuteFunc(std::function<void()>&& func) { m_beforeExecute = std::move(func); }
+
 private:
   // List of changes during the execution of this transaction
   enum class Changes {
@@ -119,6 +125,7 @@ private:
   DocUndo* m_undo;
   CmdTransaction* m_cmds;
   Changes m_changes;
+  std::function<void()> m_beforeExecute;
 };
 
 } // namespace app
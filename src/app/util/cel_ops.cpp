@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2024  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This program is distributed under the terms of
@@ -145,6 +145,45 @@ private:
   doc::algorithm::FlipType m_flipType;
 };
 
+// Returns true if "tileImage" has the same pixels that "tile" shows
+// in the tilemap with the given flags (i.e. the tile wasn't modified).
+template<typename ImageTraits>
+bool is_same_tile_templ(const Image* tileImage, const Image* tile, const doc::tile_flags flags)
+{
+  const int w = tileImage->width();
+  const int h = tileImage->height();
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      int u = (flags & doc::tile_f_xflip ? w - 1 - x : x);
+      int v = (flags & doc::tile_f_yflip ? h - 1 - y : y);
+      if (flags & doc::tile_f_dflip)
+        std::swap(u, v);
+      if (!ImageTraits::same_color(get_pixel_fast<ImageTraits>(tileImage, x, y),
+                                   get_pixel_fast<ImageTraits>(tile, u, v)))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool is_same_tile(const Image* tileImage, const Image* tile, const doc::tile_flags flags)
+{
+  if (flags == 0)
+    return is_same_image(tileImage, tile);
+
+  if (tileImage->pixelFormat() != tile->pixelFormat() ||
+      tileImage->size() != tile->size() ||
+      ((flags & doc::tile_f_dflip) && tile->width() != tile->height()))
+    return false;
+
+  switch (tileImage->pixelFormat()) {
+    case IMAGE_RGB:       return is_same_tile_templ<RgbTraits>(tileImage, tile, flags);
+    case IMAGE_GRAYSCALE: return is_same_tile_templ<GrayscaleTraits>(tileImage, tile, flags);
+    case IMAGE_INDEXED:   return is_same_tile_templ<IndexedTraits>(tileImage, tile, flags);
+  }
+  return false;
+}
+
 // This is a terrible way to find tiles, i.e. flipping several times
 // the image, instead of searching for flipped hashes. In the future
 // we could try to improve it.
@@ -683,6 +722,12 @@ void modify_tilemap_cel_region(CmdSequence* cmds,
 
       preprocess_transparent_pixels(tileImage.get());
 
+      // Only tiles with modified pixels are searched in the tileset
+      // (the region can include several tiles that weren't touched).
+      const doc::tile_flags tf = (t != doc::notile ? doc::tile_getf(t) : 0);
+      if (is_same_tile(tileImage.get(), existentTileImage.get(), tf))
+        continue;
+
       doc::tile_index tileIndex;
       doc::tile_flags tileFlag = 0;
 
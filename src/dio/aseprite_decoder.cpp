@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -21,17 +21,175 @@
 #include "dio/file_interface.h"
 #include "dio/pixel_io.h"
 #include "doc/doc.h"
+#include "doc/parallel.h"
 #include "doc/util.h"
 #include "fixmath/fixmath.h"
 #include "fmt/format.h"
 #include "gfx/color_space.h"
 #include "zlib.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <deque>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace dio {
 
+//////////////////////////////////////////////////////////////////////
+// Images Inflater
+//////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Inflates the given compressed data (already read from the file)
+// directly into the image scanlines.
+template<typename ImageTraits>
+void inflate_image_templ(const uint8_t* data, const size_t size, doc::Image* image)
+{
+  PixelIO<ImageTraits> pixel_io;
+  z_stream zstream;
+  zstream.zalloc = (alloc_func)0;
+  zstream.zfree = (free_func)0;
+  zstream.opaque = (voidpf)0;
+  zstream.next_in = (Bytef*)data;
+  zstream.avail_in = size;
+
+  int err = inflateInit(&zstream);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in inflateInit().", err);
+
+  const int width = image->width();
+  std::vector<uint8_t> scanline(image->widthBytes());
+
+  for (int y = 0; y < image->height(); ++y) {
+    zstream.next_out = (Bytef*)&scanline[0];
+    zstream.avail_out = scanline.size();
+
+    do {
+      err = inflate(&zstream, Z_NO_FLUSH);
+      if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+        inflateEnd(&zstream);
+        throw base::Exception("ZLib error %d in inflate().", err);
+      }
+    } while (zstream.avail_out != 0 && err == Z_OK);
+
+    // The scanline is not completed (not enough compressed data)
+    if (zstream.avail_out != 0)
+      break;
+
+    pixel_io.read_scanline((typename ImageTraits::address_t)image->getPixelAddress(0, y),
+                           width,
+                           &scanline[0]);
+  }
+
+  err = inflateEnd(&zstream);
+  if (err != Z_OK)
+    throw base::Exception("ZLib error %d in inflateEnd().", err);
+}
+
+void inflate_image(const uint8_t* data, const size_t size, doc::Image* image)
+{
+  switch (image->pixelFormat()) {
+    case doc::IMAGE_RGB: inflate_image_templ<doc::RgbTraits>(data, size, image); break;
+
+    case doc::IMAGE_GRAYSCALE:
+      inflate_image_templ<doc::GrayscaleTraits>(data, size, image);
+      break;
+
+    case doc::IMAGE_INDEXED: inflate_image_templ<doc::IndexedTraits>(data, size, image); break;
+
+    case doc::IMAGE_TILEMAP: inflate_image_templ<doc::TilemapTraits>(data, size, image); break;
+  }
+}
+
+} // anonymous namespace
+
+// Inflates cel images in the threads of a pool while the decoder
+// continues reading the next chunks of the file.
+class AsepriteDecoder::ImagesInflater {
+public:
+  ImagesInflater() : m_threads(doc::parallel_threads()) {}
+
+  // Reads the compressed data of the given image (from the current
+  // file position to chunk_end) and inflates it in other thread.
+  void inflateImage(FileInterface* f,
+                    DecodeDelegate* delegate,
+                    const doc::ImageRef& image,
+                    const size_t chunk_end)
+  {
+    auto job = std::make_shared<Job>();
+    job->image = image;
+
+    const size_t pos = f->tell();
+    if (chunk_end > pos) {
+      // A broken chunk size shouldn't make us allocate more memory
+      // than the required one to compress the whole image.
+      const size_t size =
+        std::min<size_t>(chunk_end - pos,
+                         compressBound(uLong(image->widthBytes()) * image->height()));
+
+      job->data.resize(size);
+      const size_t bytes_read = f->readBytes(&job->data[0], size);
+      if (bytes_read != size) {
+        delegate->error(fmt::format("Error reading {} bytes of compressed data", size));
+        job->data.resize(bytes_read);
+      }
+    }
+    if (job->data.empty())
+      return;
+
+    if (m_threads < 2) {
+      try {
+        inflate_image(job->data.data(), job->data.size(), image.get());
+      }
+      catch (const std::exception& e) {
+        delegate->error(e.what());
+      }
+      return;
+    }
+
+    // Limit the compressed data waiting in memory
+    while (!m_jobs.empty() && int(m_jobs.size()) >= 4 * m_threads) {
+      waitJob(delegate, m_jobs.front());
+      m_jobs.pop_front();
+    }
+
+    m_jobs.push_back(m_parallelJobs.start(
+      [job] { inflate_image(job->data.data(), job->data.size(), job->image.get()); }));
+  }
+
+  // Waits all the images to be inflated (e.g. before copying their
+  // pixels), and reports the errors found to the delegate.
+  void waitAll(DecodeDelegate* delegate)
+  {
+    for (const auto& job : m_jobs)
+      waitJob(delegate, job);
+    m_jobs.clear();
+  }
+
+private:
+  struct Job {
+    doc::ImageRef image;
+    std::vector<uint8_t> data;
+  };
+
+  void waitJob(DecodeDelegate* delegate, const doc::ParallelJobs::JobPtr& job)
+  {
+    try {
+      m_parallelJobs.wait(job);
+    }
+    catch (const std::exception& e) {
+      delegate->error(e.what());
+    }
+  }
+
+  int m_threads;
+  std::deque<doc::ParallelJobs::JobPtr> m_jobs;
+  doc::ParallelJobs m_parallelJobs;
+};
+
 bool AsepriteDecoder::decode()
 {
   bool ignore_old_color_chunks = false;
@@ -87,6 +245,9 @@ bool AsepriteDecoder::decode()
   int current_level = -1;
   AsepriteExternalFiles extFiles;
 
+  ImagesInflater inflater;
+  m_inflater = &inflater;
+
   // Just one frame?
   doc::frame_t nframes = sprite->totalFrames();
   if (nframes > 1 && delegate()->decodeOneFrame())
@@ -300,6 +461,9 @@ bool AsepriteDecoder::decode()
       break;
   }
 
+  inflater.waitAll(delegate());
+  m_inflater = nullptr;
+
   delegate()->onSprite(sprite.release());
   return true;
 }
@@ -876,6 +1040,9 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
           cel.reset(doc::Cel::MakeLink(frame, link));
         }
         else {
+          // We need the pixels of the linked cel to copy them
+          m_inflater->waitAll(delegate());
+
           cel.reset(doc::Cel::MakeCopy(frame, link));
           cel->setPosition(x, y);
           cel->setOpacity(opacity);
@@ -896,7 +1063,7 @@ doc::Cel* AsepriteDecoder::readCelChunk(doc::Sprite* sprite,
 
       if (w > 0 && h > 0) {
         doc::ImageRef image(doc::Image::create(pixelFormat, w, h));
-        read_compressed_image(f(), delegate(), image.get(), header, chunk_end);
+        m_inflater->inflateImage(f(), delegate(), image, chunk_end);
 
         cel = std::make_unique<doc::Cel>(frame, image);
         cel->setPosition(x, y);
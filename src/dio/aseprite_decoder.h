@@ -1,5 +1,5 @@
 // Aseprite Document IO Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -42,6 +42,8 @@ public:
   bool decode() override;
 
 private:
+  class ImagesInflater;
+
   bool readHeader(AsepriteHeader* header);
   void readFrameHeader(AsepriteFrameHeader* frame_header);
   void readPadding(const int bytes);
@@ -78,6 +80,10 @@ private:
 
   doc::LayerList m_allLayers;
   std::vector<uint32_t> m_tilesetFlags;
+
+  // Inflates compressed cels in background threads (it's valid only
+  // inside decode()).
+  ImagesInflater* m_inflater = nullptr;
 };
 
 } // namespace dio
@@ -0,0 +1,63 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/algorithm/modify_selection.h"
+
+#include "doc/image.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <benchmark/benchmark.h>
+
+using namespace doc;
+using namespace doc::algorithm;
+
+void BM_ModifySelection(benchmark::State& state)
+{
+  const auto modifier = (SelectionModifier)state.range(0);
+  const auto brush = (BrushType)state.range(1);
+  const int radius = state.range(2);
+  const int size = 1024;
+
+  // Selection with an ellipse and a hole in the middle
+  Mask src;
+  src.replace(gfx::Rect(0, 0, size, size));
+  clear_image(src.bitmap(), 0);
+  fill_ellipse(src.bitmap(), 16, 16, size - 17, size - 17, 0, 0, 1);
+  fill_rect(src.bitmap(), size / 3, size / 3, 2 * size / 3, 2 * size / 3, 0);
+
+  Mask dst;
+  dst.replace(gfx::Rect(src.bounds()).enlarge(radius));
+  while (state.KeepRunning()) {
+    clear_image(dst.bitmap(), 0);
+    modify_selection(modifier, &src, &dst, radius, brush);
+  }
+}
+
+#define DEFARGS(MODIFIER, BRUSH)                                                                   \
+  ->Args({ int(MODIFIER), BRUSH, 1 })                                                              \
+    ->Args({ int(MODIFIER), BRUSH, 2 })                                                            \
+    ->Args({ int(MODIFIER), BRUSH, 4 })                                                            \
+    ->Args({ int(MODIFIER), BRUSH, 8 })                                                            \
+    ->Args({ int(MODIFIER), BRUSH, 16 })                                                           \
+    ->Args({ int(MODIFIER), BRUSH, 32 })                                                           \
+    ->Args({ int(MODIFIER), BRUSH, 64 })                                                           \
+    ->Args({ int(MODIFIER), BRUSH, 100 })                                                          \
+    ->Args({ int(MODIFIER), BRUSH, 200 })
+
+BENCHMARK(BM_ModifySelection)
+DEFARGS(SelectionModifier::Border, kCircleBrushType)
+DEFARGS(SelectionModifier::Border, kSquareBrushType)
+DEFARGS(SelectionModifier::Expand, kCircleBrushType)
+DEFARGS(SelectionModifier::Expand, kSquareBrushType)
+DEFARGS(SelectionModifier::Contract, kCircleBrushType)
+DEFARGS(SelectionModifier::Contract, kSquareBrushType)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
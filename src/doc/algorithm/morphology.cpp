@@ -0,0 +1,203 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/algorithm/morphology.h"
+
+#include "doc/image_impl.h"
+#include "doc/image_ref.h"
+#include "doc/primitives.h"
+#include "doc/primitives_fast.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace doc { namespace algorithm {
+
+namespace {
+
+// Bigger than any distance inside an image
+constexpr int kFar = std::numeric_limits<int>::max() / 4;
+
+inline bool get_bitmap_pixel(const uint8_t* row, const int x)
+{
+  return (row[x >> 3] & (1 << (x & 7))) != 0;
+}
+
+// Returns the height of the structuring element for each horizontal
+// distance from its center, i.e. height[d] (with 0 <= d <= radius)
+// is the maximum |dy| of the element rows that reach the column at
+// distance d. The circle is the same ellipse that fill_ellipse()
+// draws in the (2r+1)x(2r+1) kernel of a circle brush, which is
+// symmetric and its rows get narrower from the center to the top
+// and bottom.
+std::vector<int> get_element_heights(const int radius, const BrushType brush)
+{
+  std::vector<int> heights(radius + 1, radius);
+  if (brush != kCircleBrushType || radius == 0)
+    return heights;
+
+  const int size = 2 * radius + 1;
+  ImageRef kernel(Image::create(IMAGE_BITMAP, size, size));
+  clear_image(kernel.get(), 0);
+  fill_ellipse(kernel.get(), 0, 0, size - 1, size - 1, 0, 0, 1);
+
+  // Half width of the kernel row at distance dy from the center
+  // (from the top half of the kernel)
+  int d = 0;
+  for (int dy = radius; dy >= 0; --dy) {
+    const uint8_t* row = kernel->getPixelAddress(0, radius - dy);
+    int halfWidth = 0;
+    while (halfWidth < radius && get_bitmap_pixel(row, radius - halfWidth - 1))
+      ++halfWidth;
+    for (; d <= halfWidth; ++d)
+      heights[d] = dy;
+  }
+  ASSERT(d == radius + 1);
+  return heights;
+}
+
+// Calls func(x, y, hit) for each pixel of the src bounds expanded by
+// "border" pixels (x/y are in src coordinates), where "hit" is true
+// if there is a "feature" pixel inside the structuring element
+// centered in that pixel. Feature pixels are the ones equal to
+// "featureValue" (pixels outside src are unset).
+template<typename Func>
+void for_each_pixel(const Image* src,
+                    const bool featureValue,
+                    const int border,
+                    const int radius,
+                    const BrushType brush,
+                    Func&& func)
+{
+  const int srcW = src->width();
+  const int srcH = src->height();
+  const int w = srcW + 2 * border;
+  const int h = srcH + 2 * border;
+  if (w <= 0 || h <= 0)
+    return;
+
+  // First pass: horizontal distance from each pixel to the nearest
+  // feature pixel of its row. Distances are stored by columns for the
+  // second pass.
+  std::vector<int> dist(size_t(w) * h);
+  std::vector<int> row(w);
+  for (int y = 0; y < h; ++y) {
+    const int sy = y - border;
+    const uint8_t* srcRow = (sy >= 0 && sy < srcH ? src->getPixelAddress(0, sy) : nullptr);
+
+    int last = -kFar;
+    for (int x = 0; x < w; ++x) {
+      const int sx = x - border;
+      const bool value = (srcRow && sx >= 0 && sx < srcW ? get_bitmap_pixel(srcRow, sx) : false);
+      if (value == featureValue)
+        last = x;
+      row[x] = x - last;
+    }
+
+    int next = w + kFar;
+    for (int x = w - 1; x >= 0; --x) {
+      if (row[x] == 0)
+        next = x;
+      else
+        row[x] = std::min(row[x], next - x);
+      dist[size_t(x) * h + y] = row[x];
+    }
+  }
+
+  // Second pass: a row "q" of a column with a feature pixel at
+  // horizontal distance d <= radius hits all the pixels of the
+  // column from q-heights[d] to q+heights[d]. We count the
+  // intervals that start/end in each row to know which pixels are
+  // covered by any of them.
+  const std::vector<int> heights = get_element_heights(radius, brush);
+  std::vector<int> delta(h + 1);
+
+  for (int x = 0; x < w; ++x) {
+    const int* col = &dist[size_t(x) * h];
+
+    std::fill(delta.begin(), delta.end(), 0);
+    for (int q = 0; q < h; ++q) {
+      if (col[q] <= radius) {
+        const int dy = heights[col[q]];
+        ++delta[std::max(0, q - dy)];
+        --delta[std::min(h, q + dy + 1)];
+      }
+    }
+
+    for (int y = 0, covered = 0; y < h; ++y) {
+      covered += delta[y];
+      func(x - border, y - border, covered > 0);
+    }
+  }
+}
+
+} // anonymous namespace
+
+void morphology(const MorphologyOp op,
+                const Image* src,
+                Image* dst,
+                const gfx::Point& dstPos,
+                const int radius,
+                const BrushType brush)
+{
+  ASSERT(src->pixelFormat() == IMAGE_BITMAP);
+  ASSERT(dst->pixelFormat() == IMAGE_BITMAP);
+  ASSERT(radius >= 0);
+
+  const gfx::Rect srcBounds = src->bounds();
+  const gfx::Rect dstBounds = dst->bounds();
+
+  auto srcPixel = [src, &srcBounds](const int x, const int y) -> bool {
+    return (srcBounds.contains(x, y) && get_pixel_fast<BitmapTraits>(src, x, y));
+  };
+  auto put = [dst, &dstBounds, &dstPos](const int x, const int y) {
+    const int u = x + dstPos.x;
+    const int v = y + dstPos.y;
+    if (dstBounds.contains(u, v))
+      put_pixel_fast<BitmapTraits>(dst, u, v, 1);
+  };
+
+  switch (op) {
+    case MorphologyOp::Dilate:
+      for_each_pixel(src, true, radius, radius, brush, [&](int x, int y, bool hit) {
+        if (hit)
+          put(x, y);
+      });
+      break;
+
+    case MorphologyOp::OuterBorder:
+      for_each_pixel(src, true, radius, radius, brush, [&](int x, int y, bool hit) {
+        if (hit && !srcPixel(x, y))
+          put(x, y);
+      });
+      break;
+
+    // For these operations features are the unset pixels. The
+    // nearest unset pixel outside src is always in a border of 1
+    // pixel around it.
+    case MorphologyOp::Erode:
+      for_each_pixel(src, false, 1, radius, brush, [&](int x, int y, bool hit) {
+        if (!hit && srcPixel(x, y))
+          put(x, y);
+      });
+      break;
+
+    case MorphologyOp::InnerBorder:
+      for_each_pixel(src, false, 1, radius, brush, [&](int x, int y, bool hit) {
+        if (hit && srcPixel(x, y))
+          put(x, y);
+      });
+      break;
+  }
+}
+
+}} // namespace doc::algorithm
@@ -0,0 +1,49 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_ALGORITHM_MORPHOLOGY_H_INCLUDED
+#define DOC_ALGORITHM_MORPHOLOGY_H_INCLUDED
+#pragma once
+
+#include "doc/brush_type.h"
+#include "gfx/point.h"
+
+namespace doc {
+class Image;
+namespace algorithm {
+
+enum class MorphologyOp {
+  Dilate,      // Pixels that have a src pixel inside their structuring element
+  Erode,       // src pixels with their whole structuring element inside src
+  InnerBorder, // src pixels that are not in Erode(src)
+  OuterBorder, // Pixels that are in Dilate(src) but not in src
+};
+
+// Applies a morphological operation to the "src" bitmap (IMAGE_BITMAP)
+// using a circle (kCircleBrushType) or square (any other brush type)
+// structuring element of the given radius, and paints the resulting
+// pixels (with 1) in the "dst" bitmap, where "dstPos" is the
+// position of the src origin in dst. Pixels outside src are unset.
+//
+// A circle of radius r contains the same pixels as a circle brush of
+// size 2r+1 (the ellipse drawn with fill_ellipse(), a radius of 1 is
+// a 4-connected neighborhood), and a square of radius r contains
+// (2r+1)x(2r+1) pixels.
+//
+// It's computed with a distance transform by rows and a pass by
+// columns, so the time is proportional to the number of pixels and
+// doesn't depend on the radius.
+void morphology(const MorphologyOp op,
+                const Image* src,
+                Image* dst,
+                const gfx::Point& dstPos,
+                const int radius,
+                const BrushType brush);
+
+} // namespace algorithm
+} // namespace doc
+
+#endif
@@ -0,0 +1,198 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#include "gtest/gtest.h"
+
+#include "doc/algorithm/modify_selection.h"
+#include "doc/algorithm/morphology.h"
+#include "doc/image.h"
+#include "doc/image_ref.h"
+#include "doc/mask.h"
+#include "doc/primitives.h"
+
+#include <cstdlib>
+
+using namespace doc;
+using namespace doc::algorithm;
+using namespace gfx;
+
+namespace {
+
+// Same kernel used by the old modify_selection() implementation
+ImageRef make_kernel(const int radius, const BrushType brush)
+{
+  const int size = 2 * radius + 1;
+  ImageRef kernel(Image::create(IMAGE_BITMAP, size, size));
+  clear_image(kernel.get(), 0);
+  if (brush == kCircleBrushType)
+    fill_ellipse(kernel.get(), 0, 0, size - 1, size - 1, 0, 0, 1);
+  else
+    fill_rect(kernel.get(), 0, 0, size - 1, size - 1, 1);
+  return kernel;
+}
+
+// Brute-force version of morphology()
+void slow_morphology(const MorphologyOp op,
+                     const Image* src,
+                     Image* dst,
+                     const Point& dstPos,
+                     const int radius,
+                     const BrushType brush)
+{
+  auto srcPixel = [src](int x, int y) {
+    return (src->bounds().contains(x, y) && src->getPixel(x, y) != 0);
+  };
+  const ImageRef kernel = make_kernel(radius, brush);
+
+  for (int y = -radius; y < src->height() + radius; ++y) {
+    for (int x = -radius; x < src->width() + radius; ++x) {
+      bool set = false, unset = false;
+      for (int dy = -radius; dy <= radius; ++dy) {
+        for (int dx = -radius; dx <= radius; ++dx) {
+          if (!kernel->getPixel(dx + radius, dy + radius))
+            continue;
+          if (srcPixel(x + dx, y + dy))
+            set = true;
+          else
+            unset = true;
+        }
+      }
+
+      const bool c = srcPixel(x, y);
+      bool result = false;
+      switch (op) {
+        case MorphologyOp::Dilate:      result = set; break;
+        case MorphologyOp::Erode:       result = (c && !unset); break;
+        case MorphologyOp::InnerBorder: result = (c && unset); break;
+        case MorphologyOp::OuterBorder: result = (!c && set); break;
+      }
+      if (result && dst->bounds().contains(x + dstPos.x, y + dstPos.y))
+        dst->putPixel(x + dstPos.x, y + dstPos.y, 1);
+    }
+  }
+}
+
+::testing::AssertionResult equal_bitmaps(const Image* expected, const Image* actual)
+{
+  for (int y = 0; y < expected->height(); ++y) {
+    for (int x = 0; x < expected->width(); ++x) {
+      if (expected->getPixel(x, y) != actual->getPixel(x, y)) {
+        return ::testing::AssertionFailure()
+               << "Expected=" << expected->getPixel(x, y) << " Actual=" << actual->getPixel(x, y)
+               << " x=" << x << " y=" << y;
+      }
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+} // anonymous namespace
+
+TEST(Morphology, CompareWithBruteForce)
+{
+  std::srand(1);
+
+  for (int i = 0; i < 8; ++i) {
+    const int w = 1 + std::rand() % 24;
+    const int h = 1 + std::rand() % 24;
+    ImageRef src(Image::create(IMAGE_BITMAP, w, h));
+    for (int y = 0; y < h; ++y)
+      for (int x = 0; x < w; ++x)
+        src->putPixel(x, y, (std::rand() % 4) == 0 ? 1 : 0);
+
+    for (int radius = 0; radius <= 7; ++radius) {
+      for (BrushType brush : { kCircleBrushType, kSquareBrushType }) {
+        for (MorphologyOp op : { MorphologyOp::Dilate,
+                                 MorphologyOp::Erode,
+                                 MorphologyOp::InnerBorder,
+                                 MorphologyOp::OuterBorder }) {
+          const Point dstPos(radius + 1, radius);
+          ImageRef expected(Image::create(IMAGE_BITMAP, w + 2 * radius, h + 2 * radius));
+          ImageRef actual(Image::create(IMAGE_BITMAP, w + 2 * radius, h + 2 * radius));
+          expected->clear(0);
+          actual->clear(0);
+
+          slow_morphology(op, src.get(), expected.get(), dstPos, radius, brush);
+          morphology(op, src.get(), actual.get(), dstPos, radius, brush);
+
+          EXPECT_TRUE(equal_bitmaps(expected.get(), actual.get()))
+            << "op=" << int(op) << " radius=" << radius << " brush=" << int(brush);
+        }
+      }
+    }
+  }
+}
+
+TEST(Morphology, CircleOfRadiusOne)
+{
+  ImageRef src(Image::create(IMAGE_BITMAP, 1, 1));
+  ImageRef dst(Image::create(IMAGE_BITMAP, 3, 3));
+  src->putPixel(0, 0, 1);
+  dst->clear(0);
+
+  morphology(MorphologyOp::Dilate, src.get(), dst.get(), Point(1, 1), 1, kCircleBrushType);
+
+  const int expected[] = { 0, 1, 0, 1, 1, 1, 0, 1, 0 };
+  for (int i = 0; i < 9; ++i)
+    EXPECT_EQ(expected[i], dst->getPixel(i % 3, i / 3)) << "i=" << i;
+}
+
+TEST(Morphology, CircleBrushKernel)
+{
+  for (int radius = 1; radius <= 200; ++radius) {
+    const int size = 2 * radius + 1;
+    ImageRef src(Image::create(IMAGE_BITMAP, 1, 1));
+    ImageRef dst(Image::create(IMAGE_BITMAP, size, size));
+    src->putPixel(0, 0, 1);
+    dst->clear(0);
+
+    morphology(MorphologyOp::Dilate,
+               src.get(),
+               dst.get(),
+               Point(radius, radius),
+               radius,
+               kCircleBrushType);
+
+    const ImageRef kernel = make_kernel(radius, kCircleBrushType);
+    ASSERT_TRUE(equal_bitmaps(kernel.get(), dst.get())) << "radius=" << radius;
+  }
+}
+
+TEST(Morphology, ModifySelection)
+{
+  Mask src;
+  src.replace(Rect(10, 10, 4, 4));
+
+  Mask dst;
+  dst.replace(Rect(5, 5, 14, 14));
+  clear_image(dst.bitmap(), 0);
+
+  modify_selection(SelectionModifier::Expand, &src, &dst, 2, kSquareBrushType);
+  dst.shrink();
+  EXPECT_EQ(Rect(8, 8, 8, 8), dst.bounds());
+
+  Mask border;
+  border.replace(src.bounds());
+  clear_image(border.bitmap(), 0);
+  modify_selection(SelectionModifier::Border, &src, &border, 1, kSquareBrushType);
+  EXPECT_EQ(1, border.bitmap()->getPixel(0, 0));
+  EXPECT_EQ(0, border.bitmap()->getPixel(1, 1));
+  EXPECT_EQ(0, border.bitmap()->getPixel(2, 2));
+  EXPECT_EQ(1, border.bitmap()->getPixel(3, 3));
+
+  Mask contract;
+  contract.replace(src.bounds());
+  clear_image(contract.bitmap(), 0);
+  modify_selection(SelectionModifier::Contract, &src, &contract, 1, kCircleBrushType);
+  contract.shrink();
+  EXPECT_EQ(Rect(11, 11, 2, 2), contract.bounds());
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -9,9 +10,12 @@
 #endif
 
 #include "doc/blend_funcs.h"
+#include "doc/blend_row.h"
 
 #include <benchmark/benchmark.h>
 
+#include <vector>
+
 using namespace doc;
 
 static void CustomArguments(benchmark::internal::Benchmark* b)
@@ -55,4 +59,57 @@ BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_saturation)->Apply(CustomArguments)
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_color)->Apply(CustomArguments);
 BENCHMARK_TEMPLATE(BM_Rgba, rgba_blender_hsl_luminosity)->Apply(CustomArguments);
 
+// Blends a row of pixels, state.range(0) is the row width and
+// state.range(1) is 0 to use the per-pixel BlendFunc or 1 to use the
+// SIMD row blender.
+template<BlendMode M>
+void BM_RgbaRow(benchmark::State& state)
+{
+  const int w = state.range(0);
+  const bool simd = (state.range(1) != 0);
+  const int opacity = 200;
+  const color_t maskColor = 0;
+
+  std::vector<color_t> src(w), dst(w);
+  for (int i = 0; i < w; ++i) {
+    src[i] = rgba(i & 0xff, (i * 3) & 0xff, (i * 7) & 0xff, (i * 5) & 0xff);
+    dst[i] = rgba((i * 11) & 0xff, i & 0xff, (i * 13) & 0xff, 255 - (i & 0xff));
+  }
+
+  BlendFunc func = get_rgba_blender(M, true);
+  BlendRowFunc rowFunc = (simd ? get_rgba_row_blender(M, true) : nullptr);
+  if (simd && !rowFunc) {
+    state.SkipWithError("No SIMD row blender");
+    return;
+  }
+
+  for (auto _ : state) {
+    if (rowFunc) {
+      rowFunc(dst.data(), src.data(), w, opacity, maskColor);
+    }
+    else {
+      for (int i = 0; i < w; ++i) {
+        if (src[i] != maskColor)
+          dst[i] = func(dst[i], src[i], opacity);
+      }
+    }
+    benchmark::DoNotOptimize(dst.data());
+  }
+  state.SetItemsProcessed(state.iterations() * w);
+}
+
+static void RowArguments(benchmark::internal::Benchmark* b)
+{
+  b->Args({ 2048, 0 })->Args({ 2048, 1 });
+}
+
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::NORMAL)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::MULTIPLY)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::SCREEN)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::OVERLAY)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::DARKEN)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::LIGHTEN)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::DIFFERENCE)->Apply(RowArguments);
+BENCHMARK_TEMPLATE(BM_RgbaRow, BlendMode::ADDITION)->Apply(RowArguments);
+
 BENCHMARK_MAIN();
@@ -11,8 +11,11 @@
 #include "doc/blend_image.h"
 
 #include "doc/blend_internals.h"
+#include "doc/blend_row.h"
 #include "doc/image_impl.h"
 
+#include <type_traits>
+
 namespace doc {
 
 template<typename DstTraits, typename SrcTraits>
@@ -29,6 +32,25 @@ void blend_image_templ(Image* dst,
     if (pal == nullptr)
       return;
   }
+
+  // Blend whole rows with a SIMD kernel when it's possible
+  if constexpr (std::is_same_v<DstTraits, RgbTraits> && std::is_same_v<SrcTraits, RgbTraits>) {
+    const BlendRowFunc blendRow =
+      (blendMode != BlendMode::SRC ? get_rgba_row_blender(blendMode, true) : nullptr);
+    if (blendRow) {
+      const gfx::Rect dstBounds = area.dstBounds();
+      const gfx::Rect srcBounds = area.srcBounds();
+      for (int y = 0; y < dstBounds.h; ++y) {
+        blendRow(get_pixel_address_fast<RgbTraits>(dst, dstBounds.x, dstBounds.y + y),
+                 get_pixel_address_fast<RgbTraits>(src, srcBounds.x, srcBounds.y + y),
+                 dstBounds.w,
+                 opacity,
+                 src->maskColor());
+      }
+      return;
+    }
+  }
+
   BlenderHelper<DstTraits, SrcTraits> blender(dst, src, pal, blendMode, true);
   LockImageBits<DstTraits> dstBits(dst);
   const LockImageBits<SrcTraits> srcBits(src);
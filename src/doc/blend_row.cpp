@@ -0,0 +1,80 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/blend_row.h"
+
+#include "doc/blend_row_kernels.h"
+
+#include <atomic>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #include <immintrin.h>
+  #include <intrin.h>
+#endif
+
+namespace doc {
+
+namespace {
+
+std::atomic<bool> g_enabled(true);
+
+bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+
+  // OSXSAVE + AVX, and the OS saves the YMM registers
+  __cpuid(info, 1);
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return false;
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+} // anonymous namespace
+
+BlendRowFunc get_rgba_row_blender(BlendMode blendMode, bool newBlend)
+{
+  if (!g_enabled)
+    return nullptr;
+
+  static const bool avx2 = cpu_supports_avx2();
+  BlendRowFunc func = nullptr;
+  if (avx2)
+    func = simd::get_rgba_row_blender_avx2(blendMode, newBlend);
+  if (!func)
+    func = simd::get_rgba_row_blender_sse2(blendMode, newBlend);
+  if (!func)
+    func = simd::get_rgba_row_blender_neon(blendMode, newBlend);
+  return func;
+}
+
+void set_rgba_row_blenders_enabled(bool state)
+{
+  g_enabled = state;
+}
+
+bool are_rgba_row_blenders_enabled()
+{
+  return g_enabled;
+}
+
+} // namespace doc
@@ -0,0 +1,40 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_BLEND_ROW_H_INCLUDED
+#define DOC_BLEND_ROW_H_INCLUDED
+#pragma once
+
+#include "doc/blend_mode.h"
+#include "doc/color.h"
+
+namespace doc {
+
+// Blends "w" RGBA pixels from "src" into "dst" (in place). Source
+// pixels equal to "maskColor" are skipped (just like BlenderHelper
+// does), so the result is exactly the same as calling the BlendFunc
+// returned by get_rgba_blender() pixel by pixel.
+typedef void (*BlendRowFunc)(color_t* dst,
+                             const color_t* src,
+                             int w,
+                             int opacity,
+                             color_t maskColor);
+
+// Returns a SIMD row blender (SSE2/AVX2/NEON, selected in runtime
+// depending on the CPU) for the given RGBA blend mode, or nullptr if
+// there is no vectorized version of the blend mode, in which case
+// the per-pixel BlendFunc from get_rgba_blender() must be used.
+BlendRowFunc get_rgba_row_blender(BlendMode blendMode, bool newBlend);
+
+// Enables/disables the SIMD row blenders globally (enabled by
+// default). Useful to compare results/performance with the per-pixel
+// path in tests and benchmarks.
+void set_rgba_row_blenders_enabled(bool state);
+bool are_rgba_row_blenders_enabled();
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,115 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+// Include all dependencies of blend_row_kernels.h before enabling
+// AVX2, so their inline functions are not compiled with AVX2
+// instructions in this translation unit.
+#include "doc/blend_mode.h"
+#include "doc/blend_row.h"
+#include "doc/color.h"
+
+#include <cstring>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+  #define DOC_BLEND_ROW_AVX2 1
+  #include <immintrin.h>
+
+  // Compile only the code of this file with AVX2 enabled, the
+  // function returned by get_rgba_row_blender_avx2() is called only
+  // if the CPU supports it (see get_rgba_row_blender()). MSVC doesn't
+  // need any flag to use AVX2 intrinsics.
+  #if defined(__clang__)
+    #pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+  #elif defined(__GNUC__)
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+  #endif
+#endif
+
+#include "doc/blend_row_kernels.h"
+
+namespace doc { namespace simd {
+
+#if DOC_BLEND_ROW_AVX2
+
+namespace {
+
+struct V {
+  using reg = __m256i;
+  enum { lanes = 8 };
+
+  static reg load(const color_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+  static void store(color_t* p, const reg a) { _mm256_storeu_si256((__m256i*)p, a); }
+  static reg set1(const int v) { return _mm256_set1_epi32(v); }
+  static reg add(const reg a, const reg b) { return _mm256_add_epi32(a, b); }
+  static reg sub(const reg a, const reg b) { return _mm256_sub_epi32(a, b); }
+  static reg mul(const reg a, const reg b) { return _mm256_mullo_epi32(a, b); }
+  static reg and_(const reg a, const reg b) { return _mm256_and_si256(a, b); }
+  static reg or_(const reg a, const reg b) { return _mm256_or_si256(a, b); }
+  static reg min(const reg a, const reg b) { return _mm256_min_epi32(a, b); }
+  static reg max(const reg a, const reg b) { return _mm256_max_epi32(a, b); }
+  static reg abs(const reg a) { return _mm256_abs_epi32(a); }
+  static reg cmpeq(const reg a, const reg b) { return _mm256_cmpeq_epi32(a, b); }
+  static reg cmpgt(const reg a, const reg b) { return _mm256_cmpgt_epi32(a, b); }
+
+  template<int n>
+  static reg srai(const reg a)
+  {
+    return _mm256_srai_epi32(a, n);
+  }
+  template<int n>
+  static reg srli(const reg a)
+  {
+    return _mm256_srli_epi32(a, n);
+  }
+  template<int n>
+  static reg slli(const reg a)
+  {
+    return _mm256_slli_epi32(a, n);
+  }
+
+  static reg select(const reg mask, const reg a, const reg b)
+  {
+    return _mm256_blendv_epi8(b, a, mask);
+  }
+
+  // Truncated division (see the SSE2 version)
+  static reg div(const reg a, const reg b)
+  {
+    return _mm256_cvttps_epi32(_mm256_div_ps(_mm256_cvtepi32_ps(a), _mm256_cvtepi32_ps(b)));
+  }
+};
+
+} // anonymous namespace
+
+BlendRowFunc get_rgba_row_blender_avx2(BlendMode blendMode, bool newBlend)
+{
+  return get_rgba_row_blender_templ<V>(blendMode, newBlend);
+}
+
+#else
+
+BlendRowFunc get_rgba_row_blender_avx2(BlendMode blendMode, bool newBlend)
+{
+  return nullptr;
+}
+
+#endif
+
+}} // namespace doc::simd
+
+#if DOC_BLEND_ROW_AVX2
+  #if defined(__clang__)
+    #pragma clang attribute pop
+  #elif defined(__GNUC__)
+    #pragma GCC pop_options
+  #endif
+#endif
@@ -0,0 +1,327 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_BLEND_ROW_KERNELS_H_INCLUDED
+#define DOC_BLEND_ROW_KERNELS_H_INCLUDED
+#pragma once
+
+// Generic SIMD row kernels for RGBA blend modes. This file is
+// included from each blend_row_<isa>.cpp file, which defines a "V"
+// struct (with a file-local type, so each instantiation is private
+// to its translation unit) that wraps the intrinsics of the specific
+// instruction set:
+//
+//   V::reg, V::lanes, V::load(), V::store(), V::set1(), V::add(),
+//   V::sub(), V::mul(), V::and_(), V::or_(), V::srai<n>(),
+//   V::srli<n>(), V::slli<n>(), V::min(), V::max(), V::abs(),
+//   V::cmpeq(), V::cmpgt(), V::select(), V::div()
+//
+// All operations work on 32-bit signed integer lanes, one channel of
+// one pixel per lane, so we can replicate exactly the integer math
+// from blend_funcs.cpp (MUL_UN8, truncated divisions, etc.) and get
+// byte-identical results.
+
+#include "doc/blend_mode.h"
+#include "doc/blend_row.h"
+#include "doc/color.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace doc { namespace simd {
+
+// Implemented in blend_row_<isa>.cpp, return nullptr if the
+// instruction set isn't available for the current platform/compiler.
+BlendRowFunc get_rgba_row_blender_sse2(BlendMode blendMode, bool newBlend);
+BlendRowFunc get_rgba_row_blender_avx2(BlendMode blendMode, bool newBlend);
+BlendRowFunc get_rgba_row_blender_neon(BlendMode blendMode, bool newBlend);
+
+template<typename V>
+struct Pixels {
+  typename V::reg r, g, b, a;
+};
+
+template<typename V>
+inline Pixels<V> unpack(const typename V::reg p)
+{
+  const auto ff = V::set1(0xff);
+  return { V::and_(p, ff),
+           V::and_(V::template srli<rgba_g_shift>(p), ff),
+           V::and_(V::template srli<rgba_b_shift>(p), ff),
+           V::template srli<rgba_a_shift>(p) };
+}
+
+// Channels are truncated to 8 bits as rgba() does with its uint8_t
+// arguments.
+template<typename V>
+inline typename V::reg pack(const Pixels<V>& c)
+{
+  const auto ff = V::set1(0xff);
+  return V::or_(V::or_(V::and_(c.r, ff), V::template slli<rgba_g_shift>(V::and_(c.g, ff))),
+                V::or_(V::template slli<rgba_b_shift>(V::and_(c.b, ff)),
+                       V::template slli<rgba_a_shift>(V::and_(c.a, ff))));
+}
+
+// Same as pixman's MUL_UN8(a, b, t)
+template<typename V>
+inline typename V::reg mul_un8(const typename V::reg a, const typename V::reg b)
+{
+  const auto t = V::add(V::mul(a, b), V::set1(0x80));
+  return V::template srai<8>(V::add(V::template srai<8>(t), t));
+}
+
+// Same as rgba_blender_normal()
+template<typename V>
+inline Pixels<V> blend_normal(const Pixels<V>& B,
+                              const Pixels<V>& S,
+                              const typename V::reg opacity)
+{
+  const auto zero = V::set1(0);
+  const auto Sa = mul_un8<V>(S.a, opacity);
+  const auto Ra = V::sub(V::add(Sa, B.a), mul_un8<V>(B.a, Sa));
+
+  // Ra is zero only when Ba is zero, and that case is replaced below
+  // with the source color, so we can avoid the division by zero.
+  const auto den = V::max(Ra, V::set1(1));
+  Pixels<V> R;
+  R.r = V::add(B.r, V::div(V::mul(V::sub(S.r, B.r), Sa), den));
+  R.g = V::add(B.g, V::div(V::mul(V::sub(S.g, B.g), Sa), den));
+  R.b = V::add(B.b, V::div(V::mul(V::sub(S.b, B.b), Sa), den));
+  R.a = Ra;
+
+  // Transparent source -> backdrop
+  const auto Sz = V::cmpeq(S.a, zero);
+  R.r = V::select(Sz, B.r, R.r);
+  R.g = V::select(Sz, B.g, R.g);
+  R.b = V::select(Sz, B.b, R.b);
+  R.a = V::select(Sz, B.a, R.a);
+
+  // Transparent backdrop -> source with opacity applied
+  const auto Bz = V::cmpeq(B.a, zero);
+  R.r = V::select(Bz, S.r, R.r);
+  R.g = V::select(Bz, S.g, R.g);
+  R.b = V::select(Bz, S.b, R.b);
+  R.a = V::select(Bz, Sa, R.a);
+  return R;
+}
+
+// Same as rgba_blender_merge()
+template<typename V>
+inline Pixels<V> blend_merge(const Pixels<V>& B,
+                             const Pixels<V>& S,
+                             const typename V::reg opacity)
+{
+  const auto zero = V::set1(0);
+  const auto Bz = V::cmpeq(B.a, zero);
+  const auto Sz = V::cmpeq(S.a, zero);
+  Pixels<V> R;
+  R.r = V::add(B.r, mul_un8<V>(V::sub(S.r, B.r), opacity));
+  R.g = V::add(B.g, mul_un8<V>(V::sub(S.g, B.g), opacity));
+  R.b = V::add(B.b, mul_un8<V>(V::sub(S.b, B.b), opacity));
+  R.r = V::select(Bz, S.r, V::select(Sz, B.r, R.r));
+  R.g = V::select(Bz, S.g, V::select(Sz, B.g, R.g));
+  R.b = V::select(Bz, S.b, V::select(Sz, B.b, R.b));
+  R.a = V::add(B.a, mul_un8<V>(V::sub(S.a, B.a), opacity));
+
+  const auto Rz = V::cmpeq(R.a, zero);
+  R.r = V::select(Rz, zero, R.r);
+  R.g = V::select(Rz, zero, R.g);
+  R.b = V::select(Rz, zero, R.b);
+  return R;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Per-channel blend functions (the same macros/functions used in
+// blend_funcs.cpp)
+
+struct BlendNormal {};
+
+struct BlendMultiply {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return mul_un8<V>(b, s);
+  }
+};
+
+struct BlendScreen {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::sub(V::add(b, s), mul_un8<V>(b, s));
+  }
+};
+
+struct BlendHardLight {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    const auto s2 = V::template slli<1>(s);
+    const auto lo = BlendMultiply::apply<V>(b, s2);
+    const auto hi = BlendScreen::apply<V>(b, V::sub(s2, V::set1(255)));
+    return V::select(V::cmpgt(V::set1(128), s), lo, hi);
+  }
+};
+
+struct BlendOverlay {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return BlendHardLight::apply<V>(s, b);
+  }
+};
+
+struct BlendDarken {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::min(b, s);
+  }
+};
+
+struct BlendLighten {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::max(b, s);
+  }
+};
+
+struct BlendDifference {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::abs(V::sub(b, s));
+  }
+};
+
+struct BlendExclusion {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    const auto t = mul_un8<V>(b, s);
+    return V::sub(V::add(b, s), V::add(t, t));
+  }
+};
+
+struct BlendAddition {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::min(V::add(b, s), V::set1(255));
+  }
+};
+
+struct BlendSubtract {
+  template<typename V>
+  static typename V::reg apply(const typename V::reg b, const typename V::reg s)
+  {
+    return V::max(V::sub(b, s), V::set1(0));
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+// Row kernels
+
+template<typename V, typename Op, bool NewBlend>
+inline typename V::reg blend_pixels(const typename V::reg backdrop,
+                                    const typename V::reg src,
+                                    const typename V::reg opacity,
+                                    const typename V::reg maskColor)
+{
+  const Pixels<V> B = unpack<V>(backdrop);
+  const Pixels<V> S = unpack<V>(src);
+  Pixels<V> R;
+
+  if constexpr (std::is_same_v<Op, BlendNormal>) {
+    R = blend_normal<V>(B, S, opacity);
+  }
+  else {
+    // Source color modified by the blend mode (rgba_blender_<name>)
+    const auto ff = V::set1(0xff);
+    Pixels<V> S2;
+    S2.r = V::and_(Op::template apply<V>(B.r, S.r), ff);
+    S2.g = V::and_(Op::template apply<V>(B.g, S.g), ff);
+    S2.b = V::and_(Op::template apply<V>(B.b, S.b), ff);
+    S2.a = S.a;
+    const Pixels<V> blend = blend_normal<V>(B, S2, opacity);
+
+    if constexpr (NewBlend) {
+      // Same as the RGBA_BLENDER_N() macro (rgba_blender_<name>_n)
+      const Pixels<V> normal = blend_normal<V>(B, S, opacity);
+      const Pixels<V> normalToBlendMerge = blend_merge<V>(normal, blend, B.a);
+      const auto srcTotalAlpha = mul_un8<V>(S.a, opacity);
+      const auto compositeAlpha = mul_un8<V>(B.a, srcTotalAlpha);
+      R = blend_merge<V>(normalToBlendMerge, blend, compositeAlpha);
+
+      const auto Bz = V::cmpeq(B.a, V::set1(0));
+      R.r = V::select(Bz, normal.r, R.r);
+      R.g = V::select(Bz, normal.g, R.g);
+      R.b = V::select(Bz, normal.b, R.b);
+      R.a = V::select(Bz, normal.a, R.a);
+    }
+    else {
+      R = blend;
+    }
+  }
+
+  // Skip source pixels with the mask color
+  return V::select(V::cmpeq(src, maskColor), backdrop, pack<V>(R));
+}
+
+template<typename V, typename Op, bool NewBlend>
+void blend_row(color_t* dst, const color_t* src, int w, int opacity, color_t maskColor)
+{
+  const auto op = V::set1(opacity);
+  const auto mask = V::set1(int(maskColor));
+
+  int x = 0;
+  for (; x + V::lanes <= w; x += V::lanes) {
+    V::store(dst + x,
+             blend_pixels<V, Op, NewBlend>(V::load(dst + x), V::load(src + x), op, mask));
+  }
+
+  // Blend the remaining pixels using temporary buffers, so we don't
+  // need a scalar version of each blend mode here.
+  const int n = w - x;
+  if (n > 0) {
+    color_t dstTail[V::lanes] = { 0 };
+    color_t srcTail[V::lanes] = { 0 };
+    std::memcpy(dstTail, dst + x, n * sizeof(color_t));
+    std::memcpy(srcTail, src + x, n * sizeof(color_t));
+    V::store(dstTail, blend_pixels<V, Op, NewBlend>(V::load(dstTail), V::load(srcTail), op, mask));
+    std::memcpy(dst + x, dstTail, n * sizeof(color_t));
+  }
+}
+
+template<typename V>
+BlendRowFunc get_rgba_row_blender_templ(const BlendMode blendMode, const bool newBlend)
+{
+#define BLEND_ROW_CASE(mode, op)                                                                   \
+  case BlendMode::mode: return newBlend ? blend_row<V, op, true> : blend_row<V, op, false>;
+
+  switch (blendMode) {
+    case BlendMode::NORMAL: return blend_row<V, BlendNormal, false>;
+    BLEND_ROW_CASE(MULTIPLY, BlendMultiply)
+    BLEND_ROW_CASE(SCREEN, BlendScreen)
+    BLEND_ROW_CASE(OVERLAY, BlendOverlay)
+    BLEND_ROW_CASE(DARKEN, BlendDarken)
+    BLEND_ROW_CASE(LIGHTEN, BlendLighten)
+    BLEND_ROW_CASE(HARD_LIGHT, BlendHardLight)
+    BLEND_ROW_CASE(DIFFERENCE, BlendDifference)
+    BLEND_ROW_CASE(EXCLUSION, BlendExclusion)
+    BLEND_ROW_CASE(ADDITION, BlendAddition)
+    BLEND_ROW_CASE(SUBTRACT, BlendSubtract)
+    default: break;
+  }
+  return nullptr;
+
+#undef BLEND_ROW_CASE
+}
+
+}} // namespace doc::simd
+
+#endif
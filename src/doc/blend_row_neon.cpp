@@ -0,0 +1,87 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/blend_row_kernels.h"
+
+// We need vdivq_f32() which is available only on AArch64
+#if defined(__aarch64__) || defined(_M_ARM64)
+  #define DOC_BLEND_ROW_NEON 1
+  #include <arm_neon.h>
+#endif
+
+namespace doc { namespace simd {
+
+#if DOC_BLEND_ROW_NEON
+
+namespace {
+
+struct V {
+  using reg = int32x4_t;
+  enum { lanes = 4 };
+
+  static reg load(const color_t* p) { return vreinterpretq_s32_u32(vld1q_u32(p)); }
+  static void store(color_t* p, const reg a) { vst1q_u32(p, vreinterpretq_u32_s32(a)); }
+  static reg set1(const int v) { return vdupq_n_s32(v); }
+  static reg add(const reg a, const reg b) { return vaddq_s32(a, b); }
+  static reg sub(const reg a, const reg b) { return vsubq_s32(a, b); }
+  static reg mul(const reg a, const reg b) { return vmulq_s32(a, b); }
+  static reg and_(const reg a, const reg b) { return vandq_s32(a, b); }
+  static reg or_(const reg a, const reg b) { return vorrq_s32(a, b); }
+  static reg min(const reg a, const reg b) { return vminq_s32(a, b); }
+  static reg max(const reg a, const reg b) { return vmaxq_s32(a, b); }
+  static reg abs(const reg a) { return vabsq_s32(a); }
+  static reg cmpeq(const reg a, const reg b) { return vreinterpretq_s32_u32(vceqq_s32(a, b)); }
+  static reg cmpgt(const reg a, const reg b) { return vreinterpretq_s32_u32(vcgtq_s32(a, b)); }
+
+  template<int n>
+  static reg srai(const reg a)
+  {
+    return vshrq_n_s32(a, n);
+  }
+  template<int n>
+  static reg srli(const reg a)
+  {
+    return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), n));
+  }
+  template<int n>
+  static reg slli(const reg a)
+  {
+    return vshlq_n_s32(a, n);
+  }
+
+  static reg select(const reg mask, const reg a, const reg b)
+  {
+    return vbslq_s32(vreinterpretq_u32_s32(mask), a, b);
+  }
+
+  // Truncated division (see the SSE2 version)
+  static reg div(const reg a, const reg b)
+  {
+    return vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(a), vcvtq_f32_s32(b)));
+  }
+};
+
+} // anonymous namespace
+
+BlendRowFunc get_rgba_row_blender_neon(BlendMode blendMode, bool newBlend)
+{
+  return get_rgba_row_blender_templ<V>(blendMode, newBlend);
+}
+
+#else
+
+BlendRowFunc get_rgba_row_blender_neon(BlendMode blendMode, bool newBlend)
+{
+  return nullptr;
+}
+
+#endif
+
+}} // namespace doc::simd
@@ -0,0 +1,97 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/blend_row_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+  #define DOC_BLEND_ROW_SSE2 1
+  #include <emmintrin.h>
+#endif
+
+namespace doc { namespace simd {
+
+#if DOC_BLEND_ROW_SSE2
+
+namespace {
+
+struct V {
+  using reg = __m128i;
+  enum { lanes = 4 };
+
+  static reg load(const color_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+  static void store(color_t* p, const reg a) { _mm_storeu_si128((__m128i*)p, a); }
+  static reg set1(const int v) { return _mm_set1_epi32(v); }
+  static reg add(const reg a, const reg b) { return _mm_add_epi32(a, b); }
+  static reg sub(const reg a, const reg b) { return _mm_sub_epi32(a, b); }
+  static reg and_(const reg a, const reg b) { return _mm_and_si128(a, b); }
+  static reg or_(const reg a, const reg b) { return _mm_or_si128(a, b); }
+  static reg cmpeq(const reg a, const reg b) { return _mm_cmpeq_epi32(a, b); }
+  static reg cmpgt(const reg a, const reg b) { return _mm_cmpgt_epi32(a, b); }
+
+  template<int n>
+  static reg srai(const reg a)
+  {
+    return _mm_srai_epi32(a, n);
+  }
+  template<int n>
+  static reg srli(const reg a)
+  {
+    return _mm_srli_epi32(a, n);
+  }
+  template<int n>
+  static reg slli(const reg a)
+  {
+    return _mm_slli_epi32(a, n);
+  }
+
+  static reg select(const reg mask, const reg a, const reg b)
+  {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+  }
+
+  // SSE2 doesn't have _mm_mullo_epi32/min/max/abs (SSE4.1/SSSE3)
+  static reg mul(const reg a, const reg b)
+  {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+  }
+  static reg min(const reg a, const reg b) { return select(cmpgt(a, b), b, a); }
+  static reg max(const reg a, const reg b) { return select(cmpgt(a, b), a, b); }
+  static reg abs(const reg a) { return max(a, _mm_sub_epi32(_mm_setzero_si128(), a)); }
+
+  // Truncated division. Numerators/denominators used in the blend
+  // functions are small enough to be represented exactly as floats,
+  // and the quotient is never near enough to an integer to be
+  // rounded up incorrectly.
+  static reg div(const reg a, const reg b)
+  {
+    return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(a), _mm_cvtepi32_ps(b)));
+  }
+};
+
+} // anonymous namespace
+
+BlendRowFunc get_rgba_row_blender_sse2(BlendMode blendMode, bool newBlend)
+{
+  return get_rgba_row_blender_templ<V>(blendMode, newBlend);
+}
+
+#else
+
+BlendRowFunc get_rgba_row_blender_sse2(BlendMode blendMode, bool newBlend)
+{
+  return nullptr;
+}
+
+#endif
+
+}} // namespace doc::simd
@@ -0,0 +1,97 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/blend_row.h"
+
+#include "doc/blend_funcs.h"
+
+#include <random>
+#include <vector>
+
+using namespace doc;
+
+static const BlendMode kRowBlendModes[] = {
+  BlendMode::NORMAL,     BlendMode::MULTIPLY,   BlendMode::SCREEN,
+  BlendMode::OVERLAY,    BlendMode::DARKEN,     BlendMode::LIGHTEN,
+  BlendMode::HARD_LIGHT, BlendMode::DIFFERENCE, BlendMode::EXCLUSION,
+  BlendMode::ADDITION,   BlendMode::SUBTRACT,
+};
+
+static color_t random_color(std::mt19937& rng)
+{
+  color_t c = rng();
+  switch (rng() % 8) {
+    case 0: c &= rgba_rgb_mask; break; // Transparent
+    case 1: c |= rgba_a_mask; break;   // Opaque
+    case 2: c = 0; break;              // Mask color
+  }
+  return c;
+}
+
+TEST(BlendRow, SameResultsAsBlendFuncs)
+{
+  std::mt19937 rng(1);
+
+  // Odd width to test the remaining pixels of each row
+  const int w = 4099;
+  std::vector<color_t> src(w), dst(w), expected(w), result(w);
+
+  for (const BlendMode blendMode : kRowBlendModes) {
+    for (const bool newBlend : { false, true }) {
+      BlendRowFunc blendRow = get_rgba_row_blender(blendMode, newBlend);
+      if (!blendRow) // No SIMD support in this platform
+        continue;
+
+      BlendFunc blendFunc = get_rgba_blender(blendMode, newBlend);
+      for (const int opacity : { 0, 1, 128, 254, 255 }) {
+        for (int i = 0; i < w; ++i) {
+          src[i] = random_color(rng);
+          dst[i] = random_color(rng);
+        }
+
+        const color_t maskColor = 0;
+        for (int i = 0; i < w; ++i)
+          expected[i] = (src[i] != maskColor ? blendFunc(dst[i], src[i], opacity) : dst[i]);
+
+        for (const int n : { 1, 3, 8, w }) {
+          result = dst;
+          blendRow(result.data(), src.data(), n, opacity, maskColor);
+          for (int i = 0; i < w; ++i) {
+            ASSERT_EQ(i < n ? expected[i] : dst[i], result[i])
+              << "blendMode=" << int(blendMode) << " newBlend=" << newBlend
+              << " opacity=" << opacity << " i=" << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(BlendRow, Disabled)
+{
+  set_rgba_row_blenders_enabled(false);
+  EXPECT_EQ(nullptr, get_rgba_row_blender(BlendMode::NORMAL, true));
+  set_rgba_row_blenders_enabled(true);
+}
+
+TEST(BlendRow, UnsupportedModes)
+{
+  EXPECT_EQ(nullptr, get_rgba_row_blender(BlendMode::SRC, true));
+  EXPECT_EQ(nullptr, get_rgba_row_blender(BlendMode::HSL_HUE, true));
+  EXPECT_EQ(nullptr, get_rgba_row_blender(BlendMode::SOFT_LIGHT, false));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
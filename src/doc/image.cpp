@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2020 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -63,4 +63,26 @@ Image* Image::createCopy(const Image* image, const ImageBufferPtr& buffer)
   return crop_image(image, 0, 0, image->width(), image->height(), image->maskColor(), buffer);
 }
 
+// static
+Image* Image::createSnapshot(const Image* image)
+{
+  ASSERT(image);
+
+  // The copy constructor of ImageImpl (only accessible from Image)
+  // shares the pixels buffer.
+  auto share = [image](auto traits) -> Image* {
+    using ImageImplT = ImageImpl<decltype(traits)>;
+    return new ImageImplT(*static_cast<const ImageImplT*>(image));
+  };
+
+  switch (image->colorMode()) {
+    case ColorMode::RGB:       return share(RgbTraits());
+    case ColorMode::GRAYSCALE: return share(GrayscaleTraits());
+    case ColorMode::INDEXED:   return share(IndexedTraits());
+    case ColorMode::BITMAP:    return share(BitmapTraits());
+    case ColorMode::TILEMAP:   return share(TilemapTraits());
+  }
+  return nullptr;
+}
+
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -42,6 +42,13 @@ public:
   static Image* create(const ImageSpec& spec, const ImageBufferPtr& buffer = ImageBufferPtr());
   static Image* createCopy(const Image* image, const ImageBufferPtr& buffer = ImageBufferPtr());
 
+  // Creates a read-only copy of the image that shares its pixels
+  // buffer (the pixels are not copied). The original image must call
+  // unshareBuffer() before its pixels are modified again
+  // (copy-on-write), so the snapshot can be read from other thread
+  // (e.g. to save it) while the original image is being edited.
+  static Image* createSnapshot(const Image* image);
+
   virtual ~Image();
 
   const ImageSpec& spec() const { return m_spec; }
@@ -73,6 +80,21 @@ public:
 
   virtual int getMemSize() const override;
 
+  // Hash of all pixels (see calculate_image_hash()) cached by the
+  // tileset hash table. It's valid while the image version doesn't
+  // change, or until invalidateHash() is called (when pixels are
+  // modified in-place without a new version, see
+  // Tileset::notifyTileContentChange()).
+  bool hasCachedHash() const { return m_hashValid && m_hashVersion == version(); }
+  uint32_t cachedHash() const { return m_hash; }
+  void setCachedHash(uint32_t hash) const
+  {
+    m_hash = hash;
+    m_hashVersion = version();
+    m_hashValid = true;
+  }
+  void invalidateHash() const { m_hashValid = false; }
+
   template<typename ImageTraits>
   ImageBits<ImageTraits> lockBits(LockType lockType, const gfx::Rect& bounds)
   {
@@ -103,6 +125,10 @@ public:
   virtual void fillRect(int x1, int y1, int x2, int y2, color_t color) = 0;
   virtual void blendRect(int x1, int y1, int x2, int y2, color_t color, int opacity) = 0;
 
+  // Copies the pixels to a new buffer if they are shared with a
+  // snapshot (see createSnapshot()).
+  virtual void unshareBuffer() = 0;
+
 protected:
   Image(const ImageSpec& spec);
 
@@ -111,6 +137,10 @@ protected:
 
 private:
   ImageSpec m_spec;
+
+  mutable uint32_t m_hash = 0;
+  mutable ObjectVersion m_hashVersion = 0;
+  mutable bool m_hashValid = false;
 };
 
 } // namespace doc
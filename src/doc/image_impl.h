@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2018-2023  Igara Studio S.A.
+// Copyright (C) 2018-2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -48,6 +48,20 @@ private:
     return m_rows[y];
   }
 
+  friend class Image;
+
+  // Creates an image that shares the pixels buffer with "other". It's
+  // private so images can share their pixels only explicitly with
+  // Image::createSnapshot().
+  ImageImpl(const ImageImpl& other)
+    : Image(other.spec())
+    , m_buffer(other.m_buffer)
+    , m_rows(other.m_rows)
+    , m_bits(other.m_bits)
+  {
+    m_rowBytes = other.m_rowBytes;
+  }
+
 public:
   inline address_t address(int x, int y) const
   {
@@ -76,14 +90,25 @@ public:
 
     std::fill(m_buffer->buffer(), m_buffer->buffer() + required_size, 0);
 
-    m_rows = (address_t*)m_buffer->buffer();
-    m_bits = (address_t)(m_buffer->buffer() + for_rows);
+    setupRows(for_rows);
+  }
 
-    auto addr = (uint8_t*)m_bits;
-    for (int y = 0; y < height(); ++y) {
-      m_rows[y] = (address_t)addr;
-      addr += m_rowBytes;
-    }
+  ImageImpl& operator=(const ImageImpl&) = delete;
+
+  void unshareBuffer() override
+  {
+    if (m_buffer.use_count() <= 1)
+      return;
+
+    const std::size_t for_rows = doc_align_size(sizeof(address_t) * height());
+    const std::size_t for_pixels = m_rowBytes * height();
+    auto buffer = std::make_shared<ImageBuffer>(for_pixels + for_rows);
+    std::copy((const uint8_t*)m_bits,
+              (const uint8_t*)m_bits + for_pixels,
+              buffer->buffer() + for_rows);
+
+    m_buffer = buffer;
+    setupRows(for_rows);
   }
 
   uint8_t* getPixelAddress(int x, int y) const override
@@ -165,6 +190,20 @@ public:
   }
 
 private:
+  // Sets the address of each row, the pixels are after the array of
+  // rows in the buffer.
+  void setupRows(const std::size_t for_rows)
+  {
+    m_rows = (address_t*)m_buffer->buffer();
+    m_bits = (address_t)(m_buffer->buffer() + for_rows);
+
+    auto addr = (uint8_t*)m_bits;
+    for (int y = 0; y < height(); ++y) {
+      m_rows[y] = (address_t)addr;
+      addr += m_rowBytes;
+    }
+  }
+
   bool clip_rects(const Image* src, int& dst_x, int& dst_y, int& src_x, int& src_y, int& w, int& h)
     const
   {
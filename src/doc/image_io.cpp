@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2024  Igara Studio S.A.
+// Copyright (c) 2019-2025  Igara Studio S.A.
 // Copyright (c) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -28,9 +28,18 @@ using namespace base::serialization::little_endian;
 
 // TODO Create a zlib wrapper for iostreams
 
-bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
+bool write_image(std::ostream& os, const Image* image, CancelIO* cancel, int compressionLevel)
 {
-  write32(os, image->id());
+  return write_image(os, image, image->id(), cancel, compressionLevel);
+}
+
+bool write_image(std::ostream& os,
+                 const Image* image,
+                 const ObjectId id,
+                 CancelIO* cancel,
+                 int compressionLevel)
+{
+  write32(os, id);
   write8(os, image->pixelFormat()); // Pixel format
   write16(os, image->width());      // Width
   write16(os, image->height());     // Height
@@ -53,7 +62,7 @@ bool write_image(std::ostream& os, const Image* image, CancelIO* cancel)
     zstream.zalloc = (alloc_func)0;
     zstream.zfree = (free_func)0;
     zstream.opaque = (voidpf)0;
-    int err = deflateInit(&zstream, Z_DEFAULT_COMPRESSION);
+    int err = deflateInit(&zstream, compressionLevel);
     if (err != Z_OK)
       throw base::Exception("ZLib error %d in deflateInit().", err);
 
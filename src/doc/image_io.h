@@ -1,4 +1,5 @@
 // Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -8,6 +9,8 @@
 #define DOC_IMAGE_IO_H_INCLUDED
 #pragma once
 
+#include "doc/object_id.h"
+
 #include <iosfwd>
 
 namespace doc {
@@ -15,7 +18,21 @@ namespace doc {
 class CancelIO;
 class Image;
 
-bool write_image(std::ostream& os, const Image* image, CancelIO* cancel = nullptr);
+// The "compressionLevel" is the zlib compression level (-1 is
+// Z_DEFAULT_COMPRESSION, 1 is the fastest one).
+bool write_image(std::ostream& os,
+                 const Image* image,
+                 CancelIO* cancel = nullptr,
+                 int compressionLevel = -1);
+
+// Writes the image with the given "id" instead of image->id() (e.g.
+// to save a snapshot of an image with the ID of the original image).
+bool write_image(std::ostream& os,
+                 const Image* image,
+                 ObjectId id,
+                 CancelIO* cancel = nullptr,
+                 int compressionLevel = -1);
+
 Image* read_image(std::istream& is, bool setId = true);
 
 } // namespace doc
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -12,9 +12,12 @@
 #include <gtest/gtest.h>
 
 #include "doc/image_impl.h"
+#include "doc/image_io.h"
 #include "doc/primitives.h"
 
 #include <memory>
+#include <sstream>
+#include <type_traits>
 
 using namespace base;
 using namespace doc;
@@ -123,6 +126,63 @@ TYPED_TEST(ImageAllTypes, PutGetAndIterators)
   }
 }
 
+TYPED_TEST(ImageAllTypes, Snapshot)
+{
+  typedef TypeParam ImageTraits;
+
+  // Images can share their pixels only through createSnapshot()
+  static_assert(!std::is_copy_constructible_v<ImageImpl<ImageTraits>>);
+  static_assert(!std::is_copy_assignable_v<ImageImpl<ImageTraits>>);
+
+  std::unique_ptr<Image> image(Image::create(ImageTraits::pixel_format, 13, 7));
+  clear_image(image.get(), 0);
+  put_pixel(image.get(), 2, 3, 1);
+
+  std::unique_ptr<Image> snapshot(Image::createSnapshot(image.get()));
+  EXPECT_EQ(image->spec(), snapshot->spec());
+  EXPECT_EQ(image->getPixelAddress(0, 0), snapshot->getPixelAddress(0, 0));
+  EXPECT_TRUE(is_same_image(image.get(), snapshot.get()));
+
+  // Modify the original image after copying its pixels
+  image->unshareBuffer();
+  EXPECT_NE(image->getPixelAddress(0, 0), snapshot->getPixelAddress(0, 0));
+  EXPECT_TRUE(is_same_image(image.get(), snapshot.get()));
+
+  put_pixel(image.get(), 2, 3, 0);
+  put_pixel(image.get(), 12, 6, 1);
+  EXPECT_EQ(1, get_pixel(snapshot.get(), 2, 3));
+  EXPECT_EQ(0, get_pixel(snapshot.get(), 12, 6));
+  EXPECT_EQ(0, get_pixel(image.get(), 2, 3));
+  EXPECT_EQ(1, get_pixel(image.get(), 12, 6));
+
+  // The pixels are not copied again if they are not shared
+  const uint8_t* address = image->getPixelAddress(0, 0);
+  snapshot.reset();
+  image->unshareBuffer();
+  EXPECT_EQ(address, image->getPixelAddress(0, 0));
+}
+
+TEST(Image, WriteSnapshotWithOriginalId)
+{
+  std::unique_ptr<Image> image(Image::create(IMAGE_RGB, 5, 3));
+  clear_image(image.get(), rgba(1, 2, 3, 4));
+  std::unique_ptr<Image> snapshot(Image::createSnapshot(image.get()));
+  ASSERT_NE(image->id(), snapshot->id());
+
+  std::stringstream s(std::ios::in | std::ios::out | std::ios::binary);
+  EXPECT_TRUE(write_image(s, snapshot.get(), image->id()));
+
+  std::unique_ptr<Image> copy(read_image(s, false));
+  ASSERT_TRUE(copy != nullptr);
+  EXPECT_TRUE(is_same_image(image.get(), copy.get()));
+
+  // The ID is the first field
+  s.seekg(0);
+  uint32_t id = 0;
+  s.read((char*)&id, 4);
+  EXPECT_EQ(image->id(), id);
+}
+
 TEST(Image, DiffRgbImages)
 {
   std::unique_ptr<Image> a(Image::create(IMAGE_RGB, 32, 32));
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2020-2024 Igara Studio S.A.
+// Copyright (c) 2020-2025 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -316,36 +316,12 @@ bool Palette::findExactMatch(color_t color) const
 //////////////////////////////////////////////////////////////////////
 // Based on Allegro's bestfit_color
 
-static std::vector<uint32_t> col_diff;
-static uint32_t* col_diff_g;
-static uint32_t* col_diff_r;
-static uint32_t* col_diff_b;
-static uint32_t* col_diff_a;
-
-void Palette::initBestfit()
-{
-  col_diff.resize(4 * 128, 0);
-  col_diff_g = &col_diff[128 * 0];
-  col_diff_r = &col_diff[128 * 1];
-  col_diff_b = &col_diff[128 * 2];
-  col_diff_a = &col_diff[128 * 3];
-
-  for (int i = 1; i < 64; ++i) {
-    int k = i * i;
-    col_diff_g[i] = col_diff_g[128 - i] = k * 59 * 59;
-    col_diff_r[i] = col_diff_r[128 - i] = k * 30 * 30;
-    col_diff_b[i] = col_diff_b[128 - i] = k * 11 * 11;
-    col_diff_a[i] = col_diff_a[128 - i] = k * 8 * 8;
-  }
-}
-
 int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
 {
   ASSERT(r >= 0 && r <= 255);
   ASSERT(g >= 0 && g <= 255);
   ASSERT(b >= 0 && b <= 255);
   ASSERT(a >= 0 && a <= 255);
-  ASSERT(!col_diff.empty());
 
   r >>= 3;
   g >>= 3;
@@ -356,32 +332,37 @@ int Palette::findBestfit(int r, int g, int b, int a, int mask_index) const
   if (a == 0 && mask_index >= 0)
     return mask_index;
 
-  int bestfit = 0;
-  int lowest = std::numeric_limits<int>::max();
-  int size = std::min(256, int(m_colors.size()));
+  const int size = std::min(256, int(m_colors.size()));
+  const color_t* colors = m_colors.data();
+  constexpr int kMaxDistance = std::numeric_limits<int>::max();
 
+  // Calculate the distance to all entries without branches (so the
+  // compiler can vectorize this loop), and then look for the first
+  // entry with the lowest distance.
+  int dist[256];
   for (int i = 0; i < size; ++i) {
-    color_t rgb = m_colors[i];
-
-    int coldiff = col_diff_g[((rgba_getg(rgb) >> 3) - g) & 127];
-    if (coldiff < lowest) {
-      coldiff += col_diff_r[(((rgba_getr(rgb) >> 3) - r) & 127)];
-      if (coldiff < lowest) {
-        coldiff += col_diff_b[(((rgba_getb(rgb) >> 3) - b) & 127)];
-        if (coldiff < lowest) {
-          coldiff += col_diff_a[(((rgba_geta(rgb) >> 3) - a) & 127)];
-          if (coldiff < lowest && i != mask_index) {
-            if (coldiff == 0)
-              return i;
-
-            bestfit = i;
-            lowest = coldiff;
-          }
-        }
-      }
+    const color_t rgb = colors[i];
+    const int dr = (rgba_getr(rgb) >> 3) - r;
+    const int dg = (rgba_getg(rgb) >> 3) - g;
+    const int db = (rgba_getb(rgb) >> 3) - b;
+    const int da = (rgba_geta(rgb) >> 3) - a;
+    dist[i] = (dg * dg * (59 * 59) + dr * dr * (30 * 30) + db * db * (11 * 11) +
+               da * da * (8 * 8));
+  }
+  if (mask_index >= 0 && mask_index < size)
+    dist[mask_index] = kMaxDistance;
+
+  int lowest = kMaxDistance;
+  for (int i = 0; i < size; ++i)
+    lowest = std::min(lowest, dist[i]);
+
+  if (lowest != kMaxDistance) {
+    for (int i = 0; i < size; ++i) {
+      if (dist[i] == lowest)
+        return i;
     }
   }
-  return bestfit;
+  return 0;
 }
 
 int Palette::findMaskColor() const
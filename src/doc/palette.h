@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (C) 2020-2023  Igara Studio S.A.
+// Copyright (C) 2020-2025  Igara Studio S.A.
 // Copyright (C) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -24,8 +24,6 @@ class Remap;
 
 class Palette : public Object {
 public:
-  static void initBestfit();
-
   Palette();
   Palette(frame_t frame, int ncolors);
   Palette(const Palette& palette);
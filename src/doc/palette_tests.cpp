@@ -0,0 +1,103 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/palette.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+using namespace doc;
+
+// Original implementation of Palette::findBestfit() (based on
+// Allegro's bestfit_color)
+static int slow_findBestfit(const Palette& palette, int r, int g, int b, int a, int mask_index)
+{
+  static const int weights[4] = { 30 * 30, 59 * 59, 11 * 11, 8 * 8 };
+
+  r >>= 3;
+  g >>= 3;
+  b >>= 3;
+  a >>= 3;
+
+  if (a == 0 && mask_index >= 0)
+    return mask_index;
+
+  int bestfit = 0;
+  int lowest = std::numeric_limits<int>::max();
+  for (int i = 0; i < std::min(256, palette.size()); ++i) {
+    const color_t rgb = palette.getEntry(i);
+    const int d[4] = { (rgba_getr(rgb) >> 3) - r,
+                       (rgba_getg(rgb) >> 3) - g,
+                       (rgba_getb(rgb) >> 3) - b,
+                       (rgba_geta(rgb) >> 3) - a };
+    int coldiff = 0;
+    for (int j = 0; j < 4; ++j)
+      coldiff += d[j] * d[j] * weights[j];
+
+    if (coldiff < lowest && i != mask_index) {
+      bestfit = i;
+      lowest = coldiff;
+    }
+  }
+  return bestfit;
+}
+
+TEST(Palette, FindBestfit)
+{
+  std::srand(1);
+
+  for (int size : { 1, 2, 5, 16, 255, 256 }) {
+    Palette palette(frame_t(0), size);
+    for (int i = 0; i < size; ++i) {
+      // Use few different values so there are repeated entries
+      palette.setEntry(i,
+                       rgba(32 * (std::rand() % 8),
+                            32 * (std::rand() % 8),
+                            32 * (std::rand() % 8),
+                            (std::rand() % 4) == 0 ? 0 : 255));
+    }
+
+    for (int mask_index : { -1, 0, size - 1 }) {
+      for (int k = 0; k < 1000; ++k) {
+        const int r = std::rand() % 256;
+        const int g = std::rand() % 256;
+        const int b = std::rand() % 256;
+        const int a = std::rand() % 256;
+        EXPECT_EQ(slow_findBestfit(palette, r, g, b, a, mask_index),
+                  palette.findBestfit(r, g, b, a, mask_index))
+          << "size=" << size << " mask_index=" << mask_index << " rgba=" << r << "," << g << ","
+          << b << "," << a;
+      }
+    }
+  }
+}
+
+TEST(Palette, FindBestfitExactMatch)
+{
+  Palette palette(frame_t(0), 4);
+  palette.setEntry(0, rgba(0, 0, 0, 255));
+  palette.setEntry(1, rgba(255, 0, 0, 255));
+  palette.setEntry(2, rgba(255, 0, 0, 255));
+  palette.setEntry(3, rgba(0, 0, 255, 255));
+
+  EXPECT_EQ(1, palette.findBestfit(255, 0, 0, 255, -1));
+  EXPECT_EQ(2, palette.findBestfit(255, 0, 0, 255, 1));
+  EXPECT_EQ(3, palette.findBestfit(0, 0, 250, 255, -1));
+  EXPECT_EQ(0, palette.findBestfit(0, 0, 250, 0, 0));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
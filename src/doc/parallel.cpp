@@ -0,0 +1,270 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/parallel.h"
+
+#include "base/debug.h"
+#include "base/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace doc {
+
+namespace {
+
+base::thread_pool& shared_thread_pool()
+{
+  static base::thread_pool pool(parallel_threads());
+  return pool;
+}
+
+} // anonymous namespace
+
+int parallel_threads()
+{
+  static const int threads = std::max<int>(1, std::thread::hardware_concurrency());
+  return threads;
+}
+
+bool parallel_for(const int n,
+                  const int threads,
+                  const std::function<void(int i, int worker)>& func,
+                  const std::function<bool(double progress)>& progress)
+{
+  // State shared between the caller thread and the workers. Workers
+  // keep a reference to it, so it's alive until the last worker
+  // finishes (even if the caller thread returns before that).
+  struct State {
+    const std::function<void(int, int)>* func = nullptr;
+    int count = 0;
+    std::atomic<int> next = 0;
+    std::atomic<bool> canceled = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    int done = 0;
+    std::exception_ptr error;
+
+    // Returns false if there are no more items to process.
+    bool processNextItem(const int worker)
+    {
+      const int i = next++;
+      if (i >= count)
+        return false;
+
+      std::exception_ptr itemError;
+      if (!canceled) {
+        try {
+          (*func)(i, worker);
+        }
+        catch (...) {
+          itemError = std::current_exception();
+          canceled = true;
+        }
+      }
+
+      const std::lock_guard lock(mutex);
+      if (itemError && !error)
+        error = itemError;
+      if (++done == count)
+        cv.notify_all();
+      return true;
+    }
+  };
+
+  if (n <= 0)
+    return true;
+
+  auto state = std::make_shared<State>();
+  state->func = &func;
+  state->count = n;
+
+  base::thread_pool& pool = shared_thread_pool();
+  for (int worker = 1; worker < std::min(threads, n); ++worker) {
+    pool.execute([state, worker] {
+      while (state->processNextItem(worker))
+        ;
+    });
+  }
+
+  bool canceled = false;
+  while (state->processNextItem(0)) {
+    if (progress && !canceled) {
+      int done;
+      {
+        const std::lock_guard lock(state->mutex);
+        done = state->done;
+      }
+      if (!progress(double(done) / double(n))) {
+        canceled = true;
+        state->canceled = true;
+      }
+    }
+  }
+
+  std::unique_lock lock(state->mutex);
+  state->cv.wait(lock, [&state] { return state->done == state->count; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+  return !canceled;
+}
+
+//////////////////////////////////////////////////////////////////////
+// ParallelJobs
+
+struct ParallelJobs::Shared {
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+
+class ParallelJobs::Job {
+public:
+  enum class State { Pending, Running, Done };
+
+  std::function<void()> func;
+  State state = State::Pending;
+  std::exception_ptr error;
+};
+
+ParallelJobs::ParallelJobs() : m_shared(std::make_shared<Shared>())
+{
+}
+
+ParallelJobs::~ParallelJobs()
+{
+  for (const JobPtr& job : m_jobs) {
+    try {
+      wait(job);
+    }
+    catch (...) {
+      // Errors should be handled by the owner with wait()/waitAll()
+    }
+  }
+}
+
+ParallelJobs::JobPtr ParallelJobs::start(std::function<void()>&& func)
+{
+  // Forget jobs that were already finished
+  {
+    const std::lock_guard lock(m_shared->mutex);
+    m_jobs.erase(std::remove_if(m_jobs.begin(),
+                                m_jobs.end(),
+                                [](const JobPtr& job) { return job->state == Job::State::Done; }),
+                 m_jobs.end());
+  }
+
+  auto job = std::make_shared<Job>();
+  job->func = std::move(func);
+  m_jobs.push_back(job);
+
+  // The task keeps a reference to the shared state and the job
+  // because it could run after the job was executed in the owner
+  // thread (and even after this ParallelJobs was destroyed).
+  shared_thread_pool().execute([shared = m_shared, job] { run(*shared, *job); });
+  return job;
+}
+
+bool ParallelJobs::isDone(const JobPtr& job) const
+{
+  const std::lock_guard lock(m_shared->mutex);
+  return (job->state == Job::State::Done);
+}
+
+void ParallelJobs::wait(const JobPtr& job)
+{
+  // Execute the job in this thread if it didn't start yet
+  run(*m_shared, *job);
+
+  {
+    std::unique_lock lock(m_shared->mutex);
+    m_shared->cv.wait(lock, [&job] { return job->state == Job::State::Done; });
+  }
+  if (job->error)
+    std::rethrow_exception(job->error);
+}
+
+bool ParallelJobs::waitFor(const JobPtr& job, const std::chrono::milliseconds timeout)
+{
+  bool pending;
+  {
+    std::unique_lock lock(m_shared->mutex);
+    if (m_shared->cv.wait_for(lock, timeout, [&job] { return job->state == Job::State::Done; })) {
+      if (job->error)
+        std::rethrow_exception(job->error);
+      return true;
+    }
+    pending = (job->state == Job::State::Pending);
+  }
+
+  // All the threads of the pool are busy, so we run the job here
+  if (pending) {
+    wait(job);
+    return true;
+  }
+  return false;
+}
+
+void ParallelJobs::waitAll()
+{
+  std::exception_ptr error;
+  for (const JobPtr& job : m_jobs) {
+    try {
+      wait(job);
+    }
+    catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  m_jobs.clear();
+
+  if (error)
+    std::rethrow_exception(error);
+}
+
+int ParallelJobs::pending() const
+{
+  const std::lock_guard lock(m_shared->mutex);
+  return int(std::count_if(m_jobs.begin(), m_jobs.end(), [](const JobPtr& job) {
+    return job->state != Job::State::Done;
+  }));
+}
+
+// static
+void ParallelJobs::run(Shared& shared, Job& job)
+{
+  {
+    const std::lock_guard lock(shared.mutex);
+    if (job.state != Job::State::Pending)
+      return;
+    job.state = Job::State::Running;
+  }
+
+  std::exception_ptr error;
+  try {
+    job.func();
+  }
+  catch (...) {
+    error = std::current_exception();
+  }
+
+  // Release the captured variables before notifying the owner
+  job.func = nullptr;
+
+  const std::lock_guard lock(shared.mutex);
+  job.error = error;
+  job.state = Job::State::Done;
+  shared.cv.notify_all();
+}
+
+} // namespace doc
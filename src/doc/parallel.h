@@ -0,0 +1,91 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_PARALLEL_H_INCLUDED
+#define DOC_PARALLEL_H_INCLUDED
+#pragma once
+
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace doc {
+
+// Number of threads used to process things in parallel (one for each
+// hardware thread). All the functions in this file share the same
+// thread pool with this number of threads.
+int parallel_threads();
+
+// Calls func(i, worker) for each i in [0, n) from the caller thread
+// (worker 0) and from "threads-1" threads of the shared pool (workers
+// 1..threads-1), so func() must be thread-safe. The worker index can
+// be used to keep some state for each thread.
+//
+// The caller thread processes items too, so this can be used from a
+// thread of the pool itself. After each item processed by the caller
+// thread, progress(doneItems/n) is called (if it's not empty) and if
+// it returns false the rest of items are skipped.
+//
+// Returns false if it was canceled by progress(). If func() throws an
+// exception, the rest of items are skipped and the exception is
+// re-thrown in the caller thread.
+bool parallel_for(int n,
+                  int threads,
+                  const std::function<void(int i, int worker)>& func,
+                  const std::function<bool(double progress)>& progress = nullptr);
+
+// Group of jobs that run in the shared thread pool, where the owner
+// (just one thread) waits the result of each job (e.g. to write the
+// results in the same order they were started). The destructor waits
+// all jobs that are still running.
+//
+// If a job didn't start yet when we wait it, it's executed in the
+// caller thread, so we don't deadlock when all the threads of the
+// pool are busy (e.g. when the owner is a job too).
+class ParallelJobs {
+  struct Shared;
+
+public:
+  class Job;
+  using JobPtr = std::shared_ptr<Job>;
+
+  ParallelJobs();
+  ~ParallelJobs();
+
+  ParallelJobs(const ParallelJobs&) = delete;
+  ParallelJobs& operator=(const ParallelJobs&) = delete;
+
+  // Starts running func() in a thread of the pool.
+  JobPtr start(std::function<void()>&& func);
+
+  bool isDone(const JobPtr& job) const;
+
+  // Waits the given job. If the job threw an exception, it's
+  // re-thrown here.
+  void wait(const JobPtr& job);
+
+  // Like wait() but returns false if the job is still running after
+  // the given timeout (e.g. to report progress meanwhile).
+  bool waitFor(const JobPtr& job, const std::chrono::milliseconds timeout);
+
+  // Waits all jobs, re-throwing the first exception found.
+  void waitAll();
+
+  // Number of jobs that are not finished yet.
+  int pending() const;
+
+private:
+  static void run(Shared& shared, Job& job);
+
+  std::shared_ptr<Shared> m_shared;
+  std::vector<JobPtr> m_jobs;
+};
+
+} // namespace doc
+
+#endif
@@ -0,0 +1,109 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/parallel.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+using namespace doc;
+
+TEST(Parallel, ParallelFor)
+{
+  for (int n : { 0, 1, 2, 7, 1000 }) {
+    const int threads = parallel_threads() + 1;
+    std::vector<std::atomic<int>> calls(n);
+    std::vector<int> workers(n, -1);
+    EXPECT_TRUE(parallel_for(n, threads, [&](int i, int worker) {
+      ++calls[i];
+      workers[i] = worker;
+    }));
+    for (int i = 0; i < n; ++i) {
+      EXPECT_EQ(1, calls[i]);
+      EXPECT_GE(workers[i], 0);
+      EXPECT_LT(workers[i], threads);
+    }
+  }
+}
+
+TEST(Parallel, ParallelForCancel)
+{
+  std::atomic<int> calls = 0;
+  EXPECT_FALSE(parallel_for(
+    1000,
+    1,
+    [&calls](int, int) { ++calls; },
+    [](double progress) { return progress < 0.5; }));
+  EXPECT_EQ(500, calls);
+}
+
+TEST(Parallel, ParallelForException)
+{
+  EXPECT_THROW(parallel_for(100,
+                            parallel_threads(),
+                            [](int i, int) {
+                              if (i == 50)
+                                throw std::runtime_error("error");
+                            }),
+               std::runtime_error);
+}
+
+TEST(Parallel, JobsInOrder)
+{
+  ParallelJobs jobs;
+  std::vector<int> results(100, 0);
+  std::vector<ParallelJobs::JobPtr> started;
+  for (int i = 0; i < 100; ++i)
+    started.push_back(jobs.start([&results, i] { results[i] = i * 2; }));
+
+  for (int i = 0; i < 100; ++i) {
+    jobs.wait(started[i]);
+    EXPECT_TRUE(jobs.isDone(started[i]));
+    EXPECT_EQ(i * 2, results[i]);
+  }
+  EXPECT_EQ(0, jobs.pending());
+}
+
+TEST(Parallel, JobsException)
+{
+  ParallelJobs jobs;
+  auto a = jobs.start([] { throw std::runtime_error("error"); });
+  auto b = jobs.start([] {});
+  EXPECT_THROW(jobs.wait(a), std::runtime_error);
+  jobs.wait(b);
+  EXPECT_NO_THROW(jobs.waitAll());
+}
+
+TEST(Parallel, NestedJobs)
+{
+  // Jobs that wait other jobs, more than the threads in the pool
+  const int n = 4 * parallel_threads();
+  std::atomic<int> count = 0;
+  ParallelJobs jobs;
+  for (int i = 0; i < n; ++i) {
+    jobs.start([&count] {
+      ParallelJobs subjobs;
+      for (int j = 0; j < 4; ++j)
+        subjobs.start([&count] { ++count; });
+      subjobs.waitAll();
+    });
+  }
+  jobs.waitAll();
+  EXPECT_EQ(4 * n, count);
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
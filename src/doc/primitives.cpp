@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -546,44 +546,64 @@ void remap_image(Image* image, const Remap& remap)
   }
 }
 
-// TODO test this hash routine and find a better alternative
-
-template<typename ImageTraits, uint32_t Mask>
+// The hash is calculated row by row (each row hash is used as the
+// seed of the next one), so we don't need to copy the pixels when
+// the bounds are a portion of the image, and we get the same hash
+// for the same pixels independently of the image stride/bounds.
+template<typename ImageTraits>
 static uint32_t calculate_image_hash_templ(const Image* image, const gfx::Rect& bounds)
 {
+  const uint32_t widthBytes = ImageTraits::width_bytes(bounds.w);
+
 #if defined(__LP64__) || defined(__x86_64__) || defined(_WIN64)
-  #define CITYHASH(buf, len) (CityHash64(buf, len) & 0xffffffff)
   static_assert(sizeof(void*) == 8, "This CPU is not 64-bit");
+  uint64_t hash = 0;
+  for (int y = 0; y < bounds.h; ++y) {
+    auto row = (const char*)image->getPixelAddress(bounds.x, bounds.y + y);
+    hash = CityHash64WithSeed(row, widthBytes, hash);
+  }
+  return uint32_t(hash & 0xffffffff);
 #else
-  #define CITYHASH(buf, len) CityHash32(buf, len)
   static_assert(sizeof(void*) == 4, "This CPU is not 32-bit");
-#endif
-
-  const uint32_t widthBytes = ImageTraits::bytes_per_pixel * bounds.w;
-  const uint32_t len = widthBytes * bounds.h;
-  if (bounds == image->bounds() && widthBytes == image->rowBytes()) {
-    return CITYHASH((const char*)image->getPixelAddress(0, 0), len);
-  }
-  else {
-    std::vector<uint8_t> buf(len);
-    uint8_t* dst = &buf[0];
-    for (int y = 0; y < bounds.h; ++y, dst += widthBytes) {
-      auto src = (const uint8_t*)image->getPixelAddress(bounds.x, bounds.y + y);
-      std::copy(src, src + widthBytes, dst);
-    }
-    return CITYHASH((const char*)&buf[0], buf.size());
+  uint32_t hash = 0;
+  for (int y = 0; y < bounds.h; ++y) {
+    auto row = (const char*)image->getPixelAddress(bounds.x, bounds.y + y);
+    hash ^= CityHash32(row, widthBytes) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
   }
+  return hash;
+#endif
 }
 
 uint32_t calculate_image_hash(const Image* img, const gfx::Rect& bounds)
 {
-  switch (img->pixelFormat()) {
-    case IMAGE_RGB: return calculate_image_hash_templ<RgbTraits, rgba_rgb_mask>(img, bounds);
-    case IMAGE_GRAYSCALE:
-      return calculate_image_hash_templ<GrayscaleTraits, graya_v_mask>(img, bounds);
-    case IMAGE_INDEXED: return calculate_image_hash_templ<IndexedTraits, 0xff>(img, bounds);
-    case IMAGE_BITMAP:  return calculate_image_hash_templ<BitmapTraits, 1>(img, bounds);
+  ASSERT(img->bounds().contains(bounds));
+  if (bounds.isEmpty())
+    return 0;
+
+  DOC_DISPATCH_BY_COLOR_MODE(img->colorMode(), calculate_image_hash_templ, img, bounds);
+  ASSERT(false);
+  return 0;
+}
+
+template<typename ImageTraits>
+static uint64_t calculate_image_hash64_templ(const Image* image, const gfx::Rect& bounds)
+{
+  const uint32_t widthBytes = ImageTraits::width_bytes(bounds.w);
+  uint64_t hash = 0;
+  for (int y = 0; y < bounds.h; ++y) {
+    auto row = (const char*)image->getPixelAddress(bounds.x, bounds.y + y);
+    hash = CityHash64WithSeed(row, widthBytes, hash);
   }
+  return hash;
+}
+
+uint64_t calculate_image_hash64(const Image* img, const gfx::Rect& bounds)
+{
+  ASSERT(img->bounds().contains(bounds));
+  if (bounds.isEmpty())
+    return 0;
+
+  DOC_DISPATCH_BY_COLOR_MODE(img->colorMode(), calculate_image_hash64_templ, img, bounds);
   ASSERT(false);
   return 0;
 }
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2018-2023 Igara Studio S.A.
+// Copyright (c) 2018-2025 Igara Studio S.A.
 // Copyright (c) 2001-2016 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -73,8 +73,16 @@ bool is_same_image_slow(const Image* i1, const Image* i2);
 
 void remap_image(Image* image, const Remap& remap);
 
+// Returns a hash of the pixels inside the given bounds. The pixels
+// are not copied, and two images (or regions) with the same pixels
+// have the same hash.
 uint32_t calculate_image_hash(const Image* image, const gfx::Rect& bounds);
 
+// Same as calculate_image_hash() with a 64-bit hash, when we need a
+// negligible probability of collisions (e.g. to detect modified
+// regions of an image without keeping a copy of its pixels).
+uint64_t calculate_image_hash64(const Image* image, const gfx::Rect& bounds);
+
 // Sets RGB values to 0 when alpha=0 (to match images with alpha=0
 // in tilesets/calculate_image_hash)
 void preprocess_transparent_pixels(Image* image);
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2023  Igara Studio S.A.
+// Copyright (c) 2023-2025  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -81,6 +81,60 @@ TYPED_TEST(Primitives, IsSameImage)
   }
 }
 
+TYPED_TEST(Primitives, ImageHashOfRegion)
+{
+  using ImageTraits = TypeParam;
+
+  for (int h = 8; h < 80; h += 7) {
+    for (int w = 16; w < 80; w += 7) {
+      ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+      doc::algorithm::random_image(a.get());
+
+      // The hash of a region must be the same as the hash of the
+      // cropped image (the bounds touch the right edge, so bitmaps
+      // don't include pixels outside the region in the last byte).
+      const gfx::Rect bounds(8, 3, w - 8, h - 5);
+      ImageRef b(crop_image(a.get(), bounds, 0));
+      EXPECT_EQ(calculate_image_hash(a.get(), bounds), calculate_image_hash(b.get(), b->bounds()));
+
+      ImageRef c(Image::createCopy(a.get()));
+      EXPECT_EQ(calculate_image_hash(a.get(), a->bounds()),
+                calculate_image_hash(c.get(), c->bounds()));
+    }
+  }
+}
+
+TYPED_TEST(Primitives, ImageHash64OfRegion)
+{
+  using ImageTraits = TypeParam;
+
+  for (int h = 8; h < 80; h += 7) {
+    for (int w = 16; w < 80; w += 7) {
+      ImageRef a(Image::create(ImageTraits::pixel_format, w, h));
+      doc::algorithm::random_image(a.get());
+
+      // The hash of a region must be the same as the hash of the
+      // cropped image (the bounds touch the right edge, so bitmaps
+      // don't include pixels outside the region in the last byte).
+      const gfx::Rect bounds(8, 3, w - 8, h - 5);
+      ImageRef b(crop_image(a.get(), bounds, 0));
+      EXPECT_EQ(calculate_image_hash64(a.get(), bounds),
+                calculate_image_hash64(b.get(), b->bounds()));
+
+      ImageRef c(Image::createCopy(a.get()));
+      EXPECT_EQ(calculate_image_hash64(a.get(), a->bounds()),
+                calculate_image_hash64(c.get(), c->bounds()));
+
+      // Any modified pixel must change the 64-bit hash
+      const int x = w / 2, y = h / 2;
+      const color_t color = get_pixel(c.get(), x, y);
+      put_pixel(c.get(), x, y, color ^ 1);
+      EXPECT_NE(calculate_image_hash64(a.get(), a->bounds()),
+                calculate_image_hash64(c.get(), c->bounds()));
+    }
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -0,0 +1,139 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/shared_image_copies.h"
+
+#include "doc/primitives.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace doc {
+
+namespace {
+
+struct SharedCopy {
+  const Image* ptr;
+  std::weak_ptr<Image> ref;
+};
+
+// Content-addressed table of shared copies (hash -> copies)
+typedef std::unordered_multimap<uint32_t, SharedCopy> SharedCopies;
+
+std::mutex g_mutex;
+SharedCopies g_copies;
+
+// Compares all the bytes of both images (not just visible colors
+// like is_same_image() does), so a shared copy can replace the
+// original image without changes.
+bool has_same_bytes(const Image* a, const Image* b)
+{
+  if (a->spec() != b->spec())
+    return false;
+
+  const int widthBytes = a->widthBytes();
+  for (int y = 0; y < a->height(); ++y) {
+    if (std::memcmp(a->getPixelAddress(0, y), b->getPixelAddress(0, y), widthBytes) != 0)
+      return false;
+  }
+  return true;
+}
+
+// Must be called with g_mutex locked
+void remove_shared_copy(const uint32_t hash, const Image* ptr)
+{
+  auto range = g_copies.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.ptr == ptr) {
+      g_copies.erase(it);
+      break;
+    }
+  }
+}
+
+} // anonymous namespace
+
+ImageRef make_shared_image_copy(const Image* image)
+{
+  ASSERT(image);
+
+  const uint32_t hash = calculate_image_hash(image, image->bounds());
+
+  // Candidates are compared outside the lock (and released outside
+  // of it too, as the last reference removes the copy from the table)
+  std::vector<ImageRef> candidates;
+  {
+    const std::lock_guard lock(g_mutex);
+    auto range = g_copies.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (ImageRef copy = it->second.ref.lock())
+        candidates.push_back(copy);
+    }
+  }
+  for (const ImageRef& copy : candidates) {
+    if (has_same_bytes(copy.get(), image))
+      return copy;
+  }
+
+  // The copy removes itself from the table when the last reference
+  // is released.
+  ImageRef copy(Image::createCopy(image), [hash](Image* ptr) {
+    {
+      const std::lock_guard lock(g_mutex);
+      remove_shared_copy(hash, ptr);
+    }
+    delete ptr;
+  });
+
+  const std::lock_guard lock(g_mutex);
+  g_copies.insert(std::make_pair(hash, SharedCopy{ copy.get(), copy }));
+  return copy;
+}
+
+ImageRef make_writable_image(ImageRef&& image)
+{
+  ASSERT(image);
+
+  ImageRef result = std::move(image);
+  if (result.use_count() > 1)
+    return ImageRef(Image::createCopy(result.get()));
+
+  const uint32_t hash = calculate_image_hash(result.get(), result->bounds());
+  {
+    const std::lock_guard lock(g_mutex);
+
+    // We've the only reference, so nobody else can get this image
+    // from the table if we remove it now.
+    if (result.use_count() == 1) {
+      remove_shared_copy(hash, result.get());
+      return result;
+    }
+  }
+  return ImageRef(Image::createCopy(result.get()));
+}
+
+int get_shared_image_copy_mem_size(const ImageRef& image)
+{
+  if (!image)
+    return 0;
+
+  return int(image->getMemSize() / std::max<long>(1, image.use_count()));
+}
+
+int get_shared_image_copies_count()
+{
+  const std::lock_guard lock(g_mutex);
+  return int(g_copies.size());
+}
+
+} // namespace doc
@@ -0,0 +1,43 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_SHARED_IMAGE_COPIES_H_INCLUDED
+#define DOC_SHARED_IMAGE_COPIES_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+
+namespace doc {
+
+// Returns a read-only copy of the given image. All the copies with
+// the same spec and pixels (found using calculate_image_hash()) are
+// shared, so keeping lots of copies of the same image (e.g. the same
+// background in several frames saved in the undo history) uses the
+// memory of just one copy.
+//
+// The returned image must not be modified, use
+// make_writable_image() when a copy must be modified or added again
+// to a sprite.
+ImageRef make_shared_image_copy(const Image* image);
+
+// Returns an image that can be modified with the same pixels of the
+// given copy: the same image if the caller has the only reference to
+// it, or a new copy if the image is shared with other owners
+// (copy-on-write).
+ImageRef make_writable_image(ImageRef&& image);
+
+// Returns the memory used by the given copy divided between all its
+// owners, so the same shared copy isn't counted several times
+// (e.g. in the total size of the undo history).
+int get_shared_image_copy_mem_size(const ImageRef& image);
+
+// Returns the number of different images that are shared between
+// copies (used for testing purposes).
+int get_shared_image_copies_count();
+
+} // namespace doc
+
+#endif
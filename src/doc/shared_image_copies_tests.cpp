@@ -0,0 +1,86 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/shared_image_copies.h"
+
+#include "doc/image.h"
+#include "doc/primitives.h"
+
+using namespace doc;
+
+TEST(SharedImageCopies, SameContentSharesCopy)
+{
+  ImageRef a(Image::create(IMAGE_RGB, 32, 16));
+  ImageRef b(Image::create(IMAGE_RGB, 32, 16));
+  clear_image(a.get(), rgba(255, 0, 0, 255));
+  clear_image(b.get(), rgba(255, 0, 0, 255));
+
+  ImageRef copyA = make_shared_image_copy(a.get());
+  ImageRef copyB = make_shared_image_copy(b.get());
+  EXPECT_EQ(copyA.get(), copyB.get());
+  EXPECT_EQ(1, get_shared_image_copies_count());
+
+  put_pixel(b.get(), 3, 4, rgba(0, 0, 255, 255));
+  ImageRef copyC = make_shared_image_copy(b.get());
+  EXPECT_NE(copyA.get(), copyC.get());
+  EXPECT_EQ(rgba(0, 0, 255, 255), get_pixel(copyC.get(), 3, 4));
+  EXPECT_EQ(2, get_shared_image_copies_count());
+
+  copyA.reset();
+  copyB.reset();
+  copyC.reset();
+  EXPECT_EQ(0, get_shared_image_copies_count());
+}
+
+TEST(SharedImageCopies, HiddenBytesAreCompared)
+{
+  ImageRef a(Image::create(IMAGE_RGB, 8, 8));
+  ImageRef b(Image::create(IMAGE_RGB, 8, 8));
+  clear_image(a.get(), rgba(0, 0, 0, 0));
+  clear_image(b.get(), rgba(255, 255, 255, 0));
+
+  ImageRef copyA = make_shared_image_copy(a.get());
+  ImageRef copyB = make_shared_image_copy(b.get());
+  EXPECT_NE(copyA.get(), copyB.get());
+}
+
+TEST(SharedImageCopies, CopyOnWrite)
+{
+  ImageRef a(Image::create(IMAGE_INDEXED, 4, 4));
+  clear_image(a.get(), 2);
+
+  ImageRef copy1 = make_shared_image_copy(a.get());
+  ImageRef copy2 = make_shared_image_copy(a.get());
+  const Image* shared = copy1.get();
+  ASSERT_EQ(shared, copy2.get());
+
+  // copy1 is shared with copy2, so we get a new image
+  ImageRef writable1 = make_writable_image(std::move(copy1));
+  EXPECT_NE(shared, writable1.get());
+  EXPECT_EQ(1, get_shared_image_copies_count());
+
+  // copy2 is the only reference, so it's removed from the table
+  ImageRef writable2 = make_writable_image(std::move(copy2));
+  EXPECT_EQ(shared, writable2.get());
+  EXPECT_EQ(0, get_shared_image_copies_count());
+
+  put_pixel(writable2.get(), 0, 0, 5);
+  ImageRef copy3 = make_shared_image_copy(a.get());
+  EXPECT_NE(writable2.get(), copy3.get());
+  EXPECT_EQ(2, get_pixel(copy3.get(), 0, 0));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,195 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "doc/tiled_image.h"
+
+#include "base/exception.h"
+#include "doc/dispatch.h"
+#include "doc/image.h"
+#include "doc/image_impl.h"
+#include "doc/primitives.h"
+#include "doc/primitives_fast.h"
+#include "doc/shared_image_copies.h"
+
+#include <iostream>
+#include <type_traits>
+
+namespace doc {
+
+namespace {
+
+// Returns true if all pixels in the given bounds are the same
+// color, returning that color in "color".
+template<typename ImageTraits>
+bool is_solid_rect_templ(const Image* image, const gfx::Rect& bounds, color_t& color)
+{
+  using pixel_t = typename ImageTraits::pixel_t;
+
+  const pixel_t first = get_pixel_fast<ImageTraits>(image, bounds.x, bounds.y);
+  color = first;
+
+  for (int y = bounds.y; y < bounds.y2(); ++y) {
+    if constexpr (std::is_same_v<ImageTraits, BitmapTraits>) {
+      for (int x = bounds.x; x < bounds.x2(); ++x) {
+        if (get_pixel_fast<ImageTraits>(image, x, y) != first)
+          return false;
+      }
+    }
+    else {
+      auto p = (const pixel_t*)image->getPixelAddress(bounds.x, y);
+      for (int x = 0; x < bounds.w; ++x, ++p) {
+        if (*p != first)
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool is_solid_rect(const Image* image, const gfx::Rect& bounds, color_t& color)
+{
+  DOC_DISPATCH_BY_COLOR_MODE(image->colorMode(), is_solid_rect_templ, image, bounds, color);
+  return false;
+}
+
+} // anonymous namespace
+
+TiledImage::TiledImage(const Image* image, int tileSize)
+  : m_spec(image->spec())
+  , m_tileSize(tileSize)
+  , m_tilesWidth((image->width() + tileSize - 1) / tileSize)
+  , m_tilesHeight((image->height() + tileSize - 1) / tileSize)
+  , m_tiles(m_tilesWidth * m_tilesHeight)
+{
+  ASSERT(tileSize > 0);
+
+  for (int ty = 0; ty < m_tilesHeight; ++ty) {
+    for (int tx = 0; tx < m_tilesWidth; ++tx) {
+      const gfx::Rect bounds = tileBounds(tx, ty);
+      Tile& t = m_tiles[ty * m_tilesWidth + tx];
+
+      color_t color;
+      if (is_solid_rect(image, bounds, color)) {
+        t.type = (color == m_spec.maskColor() ? TileType::Empty : TileType::Solid);
+        t.color = color;
+      }
+      else {
+        ImageRef crop(crop_image(image, bounds, 0));
+        t.type = TileType::Data;
+        t.image = make_shared_image_copy(crop.get());
+      }
+    }
+  }
+}
+
+gfx::Rect TiledImage::tileBounds(int tx, int ty) const
+{
+  return gfx::Rect(tx * m_tileSize, ty * m_tileSize, m_tileSize, m_tileSize) & bounds();
+}
+
+color_t TiledImage::getPixel(int x, int y) const
+{
+  ASSERT(m_hasTilesData);
+  ASSERT(x >= 0 && x < width());
+  ASSERT(y >= 0 && y < height());
+
+  const Tile& t = tile(x / m_tileSize, y / m_tileSize);
+  switch (t.type) {
+    case TileType::Empty: return m_spec.maskColor();
+    case TileType::Solid: return t.color;
+    case TileType::Data:  return t.image->getPixel(x % m_tileSize, y % m_tileSize);
+  }
+  return 0;
+}
+
+void TiledImage::copyToImage(Image* dst) const
+{
+  ASSERT(m_hasTilesData);
+  ASSERT(dst->size() == m_spec.size());
+  ASSERT(dst->colorMode() == m_spec.colorMode());
+
+  for (int ty = 0; ty < m_tilesHeight; ++ty) {
+    for (int tx = 0; tx < m_tilesWidth; ++tx) {
+      const gfx::Rect bounds = tileBounds(tx, ty);
+      const Tile& t = tile(tx, ty);
+      switch (t.type) {
+        case TileType::Empty: fill_rect(dst, bounds, m_spec.maskColor()); break;
+        case TileType::Solid: fill_rect(dst, bounds, t.color); break;
+        case TileType::Data:  copy_image(dst, t.image.get(), bounds.x, bounds.y); break;
+      }
+    }
+  }
+}
+
+Image* TiledImage::createImage() const
+{
+  Image* image = Image::create(m_spec);
+  copyToImage(image);
+  return image;
+}
+
+int TiledImage::getMemSize() const
+{
+  int size = sizeof(TiledImage) + sizeof(Tile) * int(m_tiles.size());
+  for (const Tile& t : m_tiles)
+    size += get_shared_image_copy_mem_size(t.image);
+  return size;
+}
+
+void TiledImage::unloadTilesData(std::ostream& os)
+{
+  ASSERT(m_hasTilesData);
+
+  for (Tile& t : m_tiles) {
+    if (t.type != TileType::Data)
+      continue;
+
+    const Image* image = t.image.get();
+    const int widthBytes = image->widthBytes();
+    for (int y = 0; y < image->height(); ++y)
+      os.write((const char*)image->getPixelAddress(0, y), widthBytes);
+    t.image.reset();
+  }
+  m_hasTilesData = false;
+}
+
+void TiledImage::loadTilesData(std::istream& is)
+{
+  ASSERT(!m_hasTilesData);
+
+  // All tiles are loaded before modifying this image, so if the
+  // data is incomplete we can try again later.
+  std::vector<ImageRef> images(m_tiles.size());
+  for (int i = 0; i < int(m_tiles.size()); ++i) {
+    if (m_tiles[i].type != TileType::Data)
+      continue;
+
+    const gfx::Rect bounds = tileBounds(i % m_tilesWidth, i / m_tilesWidth);
+    ImageSpec spec = m_spec;
+    spec.setSize(bounds.size());
+    ImageRef image(Image::create(spec));
+
+    const int widthBytes = image->widthBytes();
+    for (int y = 0; y < image->height(); ++y)
+      is.read((char*)image->getPixelAddress(0, y), widthBytes);
+    if (!is)
+      throw base::Exception("Error reading the pixels of an image");
+
+    images[i] = make_shared_image_copy(image.get());
+  }
+
+  for (int i = 0; i < int(m_tiles.size()); ++i) {
+    if (images[i])
+      m_tiles[i].image = std::move(images[i]);
+  }
+  m_hasTilesData = true;
+}
+
+} // namespace doc
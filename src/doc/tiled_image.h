@@ -0,0 +1,92 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef DOC_TILED_IMAGE_H_INCLUDED
+#define DOC_TILED_IMAGE_H_INCLUDED
+#pragma once
+
+#include "doc/color.h"
+#include "doc/image_ref.h"
+#include "doc/image_spec.h"
+#include "gfx/rect.h"
+
+#include <iosfwd>
+#include <vector>
+
+namespace doc {
+
+// Sparse storage of pixels in fixed-size tiles. Tiles filled with
+// the mask color (empty tiles) or with just one color (solid tiles)
+// don't use memory for their pixels, and the rest of tiles are
+// shared with other tiles/images with the same pixels (see
+// make_shared_image_copy()). Useful to keep copies of huge images
+// that are mostly transparent (e.g. in the undo history).
+class TiledImage {
+public:
+  static constexpr int kDefaultTileSize = 64;
+
+  enum class TileType {
+    Empty, // All pixels are the mask color
+    Solid, // All pixels are "color"
+    Data,  // Pixels are in "image" (read-only/shared image)
+  };
+
+  struct Tile {
+    TileType type = TileType::Empty;
+    color_t color = 0;
+    ImageRef image;
+  };
+
+  // Creates a sparse copy of the given image.
+  TiledImage(const Image* image, int tileSize = kDefaultTileSize);
+
+  const ImageSpec& spec() const { return m_spec; }
+  int width() const { return m_spec.width(); }
+  int height() const { return m_spec.height(); }
+  gfx::Rect bounds() const { return m_spec.bounds(); }
+  int tileSize() const { return m_tileSize; }
+
+  // Number of tiles in each axis.
+  int tilesWidth() const { return m_tilesWidth; }
+  int tilesHeight() const { return m_tilesHeight; }
+
+  const Tile& tile(int tx, int ty) const { return m_tiles[ty * m_tilesWidth + tx]; }
+
+  // Bounds of the given tile in image coordinates (tiles in the
+  // right/bottom edges can be smaller than tileSize()).
+  gfx::Rect tileBounds(int tx, int ty) const;
+
+  color_t getPixel(int x, int y) const;
+
+  // Copies all pixels to "dst" (which must have the same size).
+  void copyToImage(Image* dst) const;
+
+  // Creates a new (regular) image with the pixels of this one.
+  Image* createImage() const;
+
+  // Memory retained by this image (shared tiles are divided between
+  // all their owners, see get_shared_image_copy_mem_size()).
+  int getMemSize() const;
+
+  // Writes the pixels of the tiles with data in the given stream and
+  // releases them (e.g. to move them to a file). The image cannot be
+  // used until the same data is loaded with loadTilesData().
+  void unloadTilesData(std::ostream& os);
+  void loadTilesData(std::istream& is);
+  bool hasTilesData() const { return m_hasTilesData; }
+
+private:
+  ImageSpec m_spec;
+  int m_tileSize;
+  int m_tilesWidth;
+  int m_tilesHeight;
+  std::vector<Tile> m_tiles;
+  bool m_hasTilesData = true;
+};
+
+} // namespace doc
+
+#endif
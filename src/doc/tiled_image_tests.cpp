@@ -0,0 +1,109 @@
+// Aseprite Document Library
+// Copyright (c) 2025  Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/tiled_image.h"
+
+#include "base/exception.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+
+#include <sstream>
+
+using namespace doc;
+
+TEST(TiledImage, EmptyAndSolidTiles)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 150, 70));
+  clear_image(image.get(), 0);
+  fill_rect(image.get(), gfx::Rect(64, 0, 64, 64), rgba(255, 0, 0, 255));
+  put_pixel(image.get(), 140, 65, rgba(0, 255, 0, 255));
+
+  TiledImage tiled(image.get(), 64);
+  EXPECT_EQ(3, tiled.tilesWidth());
+  EXPECT_EQ(2, tiled.tilesHeight());
+  EXPECT_EQ(gfx::Rect(128, 64, 22, 6), tiled.tileBounds(2, 1));
+
+  EXPECT_EQ(TiledImage::TileType::Empty, tiled.tile(0, 0).type);
+  EXPECT_EQ(TiledImage::TileType::Solid, tiled.tile(1, 0).type);
+  EXPECT_EQ(rgba(255, 0, 0, 255), tiled.tile(1, 0).color);
+  EXPECT_EQ(TiledImage::TileType::Empty, tiled.tile(2, 0).type);
+  EXPECT_EQ(TiledImage::TileType::Data, tiled.tile(2, 1).type);
+  EXPECT_EQ(rgba(0, 255, 0, 255), tiled.getPixel(140, 65));
+
+  ImageRef copy(tiled.createImage());
+  EXPECT_TRUE(is_same_image(image.get(), copy.get()));
+}
+
+TEST(TiledImage, SharedDataTiles)
+{
+  ImageRef image(Image::create(IMAGE_GRAYSCALE, 128, 64));
+  clear_image(image.get(), 0);
+  put_pixel(image.get(), 1, 1, graya(255, 255));
+  put_pixel(image.get(), 65, 1, graya(255, 255));
+
+  TiledImage tiled(image.get(), 64);
+  ASSERT_EQ(TiledImage::TileType::Data, tiled.tile(0, 0).type);
+  EXPECT_EQ(tiled.tile(0, 0).image.get(), tiled.tile(1, 0).image.get());
+  EXPECT_EQ(graya(255, 255), tiled.getPixel(65, 1));
+  EXPECT_EQ(graya(0, 0), tiled.getPixel(66, 2));
+
+  ImageRef copy(Image::create(IMAGE_GRAYSCALE, 128, 64));
+  tiled.copyToImage(copy.get());
+  EXPECT_TRUE(is_same_image(image.get(), copy.get()));
+
+  // The memory of a shared tile is counted only once in total
+  const int dataSize = tiled.tile(0, 0).image->getMemSize();
+  const int overhead = tiled.getMemSize() - dataSize;
+  {
+    TiledImage tiled2(image.get(), 64);
+    EXPECT_EQ(tiled.tile(0, 0).image.get(), tiled2.tile(0, 0).image.get());
+    EXPECT_NEAR(2 * overhead + dataSize, tiled.getMemSize() + tiled2.getMemSize(), 4);
+  }
+  EXPECT_NEAR(overhead + dataSize, tiled.getMemSize(), 2);
+}
+
+TEST(TiledImage, UnloadAndLoadTilesData)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 100, 70));
+  clear_image(image.get(), 0);
+  fill_rect(image.get(), gfx::Rect(64, 0, 36, 64), rgba(0, 0, 255, 255));
+  for (int i = 0; i < 70; ++i)
+    put_pixel(image.get(), i, i, rgba(i, 255 - i, 0, 255));
+
+  TiledImage tiled(image.get(), 32);
+  const int memSize = tiled.getMemSize();
+
+  std::stringstream data;
+  tiled.unloadTilesData(data);
+  EXPECT_FALSE(tiled.hasTilesData());
+  EXPECT_LT(tiled.getMemSize(), memSize);
+
+  // Incomplete data
+  {
+    std::istringstream is(data.str().substr(0, data.str().size() - 1));
+    EXPECT_THROW(tiled.loadTilesData(is), base::Exception);
+    EXPECT_FALSE(tiled.hasTilesData());
+  }
+
+  tiled.loadTilesData(data);
+  EXPECT_TRUE(tiled.hasTilesData());
+  EXPECT_EQ(memSize, tiled.getMemSize());
+
+  ImageRef copy(tiled.createImage());
+  EXPECT_TRUE(is_same_image(image.get(), copy.get()));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
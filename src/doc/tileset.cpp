@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2025  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -18,6 +18,7 @@
 #include "doc/sprite.h"
 #include "doc/tilesets.h"
 
+#include <algorithm>
 #include <memory>
 
 #define TS_TRACE(...) // TRACE(__VA_ARGS__)
@@ -168,6 +169,7 @@ void Tileset::set(const tile_index ti, const ImageRef& image)
   removeFromHash(ti, false);
 
   preprocess_transparent_pixels(image.get());
+  image->invalidateHash();
   m_tiles[ti].image = image;
 
   if (!m_hash.empty())
@@ -181,6 +183,7 @@ tile_index Tileset::add(const ImageRef& image, const UserData& userData)
   ASSERT(image->height() == m_grid.tileSize().h);
 
   preprocess_transparent_pixels(image.get());
+  image->invalidateHash();
   m_tiles.push_back(Tile(image, userData));
 
   const tile_index newIndex = tile_index(m_tiles.size() - 1);
@@ -203,6 +206,7 @@ void Tileset::insert(const tile_index ti, const ImageRef& image, const UserData&
 
   ASSERT(ti >= 0 && ti <= m_tiles.size() + 1);
   preprocess_transparent_pixels(image.get());
+  image->invalidateHash();
   m_tiles.insert(m_tiles.begin() + ti, Tile(image, userData));
 
   if (!m_hash.empty()) {
@@ -263,45 +267,52 @@ bool Tileset::findTileIndex(const ImageRef& tileImage, tile_index& ti)
 
 void Tileset::notifyTileContentChange(const tile_index ti)
 {
-#if 0 // TODO Try to do less work
-
-  ASSERT(ti >= 0 && ti < size());
-
-  // If two or more tiles are exactly the same, they will have the
-  // same hash, so the m_hash table can be smaller than the m_tiles
-  // array.
-  if (m_hash.size() < m_tiles.size()) {
-    // Count how many hash elements are poiting to this tile index
-    int tilesWithSameHash = 0;
-    for (auto item : m_hash)
-      if (item.second == ti)
-        ++tilesWithSameHash;
-
-    // In this case we re-generate the whole hash table because one or
-    // more tiles tile are using the hash of the modified tile.
-    if (tilesWithSameHash >= 2) {
-      rehash();
-      return;
-    }
+  if (ti < 0 || ti >= size() || !m_tiles[ti].image) {
+    rehash();
+    return;
   }
 
-  // In other case we can do a fast-path, just removing and
-  // re-adding the tile to the hash table.
-  removeFromHash(ti, false);
-  if (!m_hash.empty())
-    hashImage(ti, m_tiles[ti]);
-
-#else // Regenerate the whole hash map (at the moment this is the
-      // only way to make it work correctly)
-
-  (void)ti; // unused
+  const ImageRef image = m_tiles[ti].image;
+  preprocess_transparent_pixels(image.get());
+  discardCompressedData();
 
-  if (ti >= 0 && ti < m_tiles.size() && m_tiles[ti].image)
-    preprocess_transparent_pixels(m_tiles[ti].image.get());
+  // The hash table will be re-created from scratch when it's needed
+  if (m_hash.empty()) {
+    image->invalidateHash();
+    return;
+  }
 
-  rehash();
+  // The image was modified in-place, so if it's the key of an element
+  // of the hash table, that element is in the bucket of the old
+  // hash (we cannot calculate it again from the new pixels). To find
+  // it, we set the old hash as the cached hash of the image and look
+  // for the element with this same image pointer in equal_range().
+  // This works only because details::image_hash uses cachedHash()
+  // when it's available (and image_eq is always true for the same
+  // image).
+  const uint32_t oldHash = m_tiles[ti].hash;
+  image->setCachedHash(oldHash);
+  auto range = m_hash.equal_range(image);
+  auto it = std::find_if(range.first, range.second, [&image](const auto& item) {
+    return item.first == image;
+  });
+  const bool removed = (it != range.second);
+  if (removed) {
+    ASSERT(it->second == ti);
+    m_hash.erase(it);
+  }
+  image->invalidateHash();
+
+  // If other tiles had the same old pixels (so they were not in the
+  // hash table as the first one was this tile), we re-add them.
+  if (removed && m_hash.size() + 1 < m_tiles.size()) {
+    for (tile_index tj = 0; tj < size(); ++tj) {
+      if (tj != ti && m_tiles[tj].hash == oldHash)
+        hashImage(tj, m_tiles[tj].image);
+    }
+  }
 
-#endif
+  hashImage(ti, image);
 }
 
 void Tileset::notifyRegenerateEmptyTile()
@@ -310,8 +321,10 @@ void Tileset::notifyRegenerateEmptyTile()
     return;
 
   ImageRef image = get(doc::notile);
-  if (image)
+  if (image) {
     doc::clear_image(image.get(), image->maskColor());
+    image->invalidateHash();
+  }
   rehash();
 }
 
@@ -369,6 +382,13 @@ void Tileset::assertValidHashTable()
 
 void Tileset::hashImage(const tile_index ti, const ImageRef& tileImage)
 {
+  // Cache the hash of the tile image, so we don't need to calculate
+  // it again when the whole hash table is re-created (only tiles
+  // that were modified are re-hashed).
+  if (!tileImage->hasCachedHash())
+    tileImage->setCachedHash(calculate_image_hash(tileImage.get(), tileImage->bounds()));
+  m_tiles[ti].hash = tileImage->cachedHash();
+
   if (m_hash.find(tileImage) == m_hash.end())
     m_hash[tileImage] = ti;
 }
@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2023  Igara Studio S.A.
+// Copyright (c) 2019-2025  Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -28,6 +28,10 @@ class Tileset : public WithUserData {
   struct Tile {
     ImageRef image;
     UserData data;
+    // Hash of the image pixels when the tile was added to the hash
+    // table (used to find the old element when the tile image is
+    // modified in-place, see notifyTileContentChange())
+    uint32_t hash = 0;
     Tile() {}
     Tile(const ImageRef& image, const UserData& data) : image(image), data(data) {}
   };
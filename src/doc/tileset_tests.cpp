@@ -0,0 +1,123 @@
+// Aseprite Document Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/grid.h"
+#include "doc/image.h"
+#include "doc/primitives.h"
+#include "doc/sprite.h"
+#include "doc/tileset.h"
+
+#include <memory>
+
+using namespace doc;
+
+static ImageRef make_tile(const color_t color)
+{
+  ImageRef image(Image::create(IMAGE_RGB, 4, 4));
+  clear_image(image.get(), color);
+  return image;
+}
+
+static tile_index find(Tileset& tileset, const color_t color)
+{
+  tile_index ti;
+  if (!tileset.findTileIndex(make_tile(color), ti))
+    return -1;
+  return ti;
+}
+
+static void modify_tile(Tileset& tileset, const tile_index ti, const color_t color)
+{
+  clear_image(tileset.get(ti).get(), color);
+  tileset.notifyTileContentChange(ti);
+#ifdef _DEBUG
+  tileset.assertValidHashTable();
+#endif
+}
+
+TEST(Tileset, NotifyTileContentChange)
+{
+  const color_t red = rgba(255, 0, 0, 255);
+  const color_t green = rgba(0, 255, 0, 255);
+  const color_t blue = rgba(0, 0, 255, 255);
+
+  auto sprite = std::make_unique<Sprite>(ImageSpec(ColorMode::RGB, 16, 16));
+  Tileset tileset(sprite.get(), Grid(gfx::Size(4, 4)), 1);
+  EXPECT_EQ(1, tileset.add(make_tile(red)));
+  EXPECT_EQ(2, tileset.add(make_tile(red)));
+  EXPECT_EQ(3, tileset.add(make_tile(blue)));
+
+  EXPECT_EQ(0, find(tileset, 0));
+  EXPECT_EQ(1, find(tileset, red));
+  EXPECT_EQ(-1, find(tileset, green));
+  EXPECT_EQ(3, find(tileset, blue));
+
+  // Tile 2 has the same pixels as the modified tile 1
+  modify_tile(tileset, 1, green);
+  EXPECT_EQ(2, find(tileset, red));
+  EXPECT_EQ(1, find(tileset, green));
+  EXPECT_EQ(3, find(tileset, blue));
+
+  modify_tile(tileset, 3, red);
+  EXPECT_EQ(2, find(tileset, red));
+  EXPECT_EQ(-1, find(tileset, blue));
+
+  modify_tile(tileset, 2, blue);
+  EXPECT_EQ(3, find(tileset, red));
+  EXPECT_EQ(2, find(tileset, blue));
+
+  // Same pixels
+  modify_tile(tileset, 2, blue);
+  EXPECT_EQ(3, find(tileset, red));
+  EXPECT_EQ(2, find(tileset, blue));
+  EXPECT_EQ(1, find(tileset, green));
+  EXPECT_EQ(0, find(tileset, 0));
+}
+
+TEST(Tileset, ModifyTileWithSamePixelsAsOtherTile)
+{
+  const color_t red = rgba(255, 0, 0, 255);
+  const color_t green = rgba(0, 255, 0, 255);
+
+  auto sprite = std::make_unique<Sprite>(ImageSpec(ColorMode::RGB, 16, 16));
+  Tileset tileset(sprite.get(), Grid(gfx::Size(4, 4)), 1);
+  EXPECT_EQ(1, tileset.add(make_tile(red)));
+  EXPECT_EQ(2, tileset.add(make_tile(red)));
+  EXPECT_EQ(1, find(tileset, red));
+
+  // Modify the tile that is not in the hash table (its pixels were
+  // found as the first tile)
+  clear_image(tileset.get(2).get(), green);
+  tileset.notifyTileContentChange(2);
+#ifdef _DEBUG
+  tileset.assertValidHashTable();
+#endif
+  EXPECT_EQ(1, find(tileset, red));
+  EXPECT_EQ(2, find(tileset, green));
+
+  // Make both tiles equal again and modify the one in the hash table
+  clear_image(tileset.get(2).get(), red);
+  tileset.notifyTileContentChange(2);
+  clear_image(tileset.get(1).get(), green);
+  tileset.notifyTileContentChange(1);
+#ifdef _DEBUG
+  tileset.assertValidHashTable();
+#endif
+  EXPECT_EQ(2, find(tileset, red));
+  EXPECT_EQ(1, find(tileset, green));
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2022  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -19,107 +19,120 @@
 #include "filters/filter_manager.h"
 #include "filters/neighboring_pixels.h"
 
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
 namespace filters {
 
 using namespace doc;
 
 namespace {
 
-struct GetPixelsDelegate {
-  int div;
-  const int* matrixData;
-
-  void reset(const ConvolutionMatrix* matrix)
-  {
-    div = matrix->getDiv();
-    matrixData = &matrix->value(0, 0);
-  }
-};
-
-struct GetPixelsDelegateRgba : public GetPixelsDelegate {
-  int r, g, b, a;
-
-  void reset(const ConvolutionMatrix* matrix)
-  {
-    GetPixelsDelegate::reset(matrix);
-    r = g = b = a = 0;
-  }
-
-  void operator()(RgbTraits::pixel_t color)
-  {
-    if (*matrixData) {
-      if (rgba_geta(color) == 0)
-        div -= *matrixData;
-      else {
-        r += rgba_getr(color) * (*matrixData);
-        g += rgba_getg(color) * (*matrixData);
-        b += rgba_getb(color) * (*matrixData);
-        a += rgba_geta(color) * (*matrixData);
+// Maximum number of planes used to split a pixel (RGBA + index + a
+// plane to count transparent pixels).
+const int kMaxPlanes = 6;
+
+// Returns true if the matrix is the outer product of two vectors of
+// integers, i.e. value(x, y) == hkernel[x] * vkernel[y] for all the
+// matrix values. In that case we can apply the matrix as two 1D
+// convolutions (one horizontal and one vertical) with exactly the
+// same result.
+bool get_separable_kernels(const ConvolutionMatrix* matrix,
+                           std::vector<int>& hkernel,
+                           std::vector<int>& vkernel)
+{
+  const int w = matrix->getWidth();
+  const int h = matrix->getHeight();
+
+  // Find the first non-zero value of the matrix
+  int px = -1, py = -1;
+  for (int y = 0; y < h && py < 0; ++y) {
+    for (int x = 0; x < w; ++x) {
+      if (matrix->value(x, y) != 0) {
+        px = x;
+        py = y;
+        break;
       }
     }
-    matrixData++;
-  }
-};
-
-struct GetPixelsDelegateGrayscale : public GetPixelsDelegate {
-  int v, a;
-
-  void reset(const ConvolutionMatrix* matrix)
-  {
-    GetPixelsDelegate::reset(matrix);
-    v = a = 0;
   }
-
-  void operator()(GrayscaleTraits::pixel_t color)
-  {
-    if (*matrixData) {
-      if (graya_geta(color) == 0)
-        div -= *matrixData;
-      else {
-        v += graya_getv(color) * (*matrixData);
-        a += graya_geta(color) * (*matrixData);
-      }
-    }
-    matrixData++;
+  if (py < 0)
+    return false;
+
+  // The vertical kernel is the "px" column divided by the GCD of its
+  // values, and the horizontal kernel is the "py" row divided by the
+  // vertical kernel value in that row.
+  int gcd = 0;
+  for (int y = 0; y < h; ++y)
+    gcd = std::gcd(gcd, matrix->value(px, y));
+
+  vkernel.resize(h);
+  for (int y = 0; y < h; ++y)
+    vkernel[y] = matrix->value(px, y) / gcd;
+
+  hkernel.resize(w);
+  for (int x = 0; x < w; ++x) {
+    if (matrix->value(x, py) % vkernel[py] != 0)
+      return false;
+    hkernel[x] = matrix->value(x, py) / vkernel[py];
   }
-};
 
-struct GetPixelsDelegateIndexed : public GetPixelsDelegate {
-  const Palette* pal;
-  int r, g, b, a, index;
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      if (hkernel[x] * vkernel[y] != matrix->value(x, y))
+        return false;
 
-  GetPixelsDelegateIndexed(const Palette* pal) : pal(pal) {}
+  return true;
+}
 
-  void reset(const ConvolutionMatrix* matrix)
-  {
-    GetPixelsDelegate::reset(matrix);
-    r = g = b = a = index = 0;
-  }
+} // namespace
 
-  void operator()(IndexedTraits::pixel_t color)
-  {
-    if (*matrixData) {
-      index += color * (*matrixData);
-      color_t rgba = pal->getEntry(color);
-      if (rgba_geta(rgba) == 0)
-        div -= *matrixData;
-      else {
-        r += rgba_getr(rgba) * (*matrixData);
-        g += rgba_getg(rgba) * (*matrixData);
-        b += rgba_getb(rgba) * (*matrixData);
-        a += rgba_geta(rgba) * (*matrixData);
-      }
-    }
-    matrixData++;
-  }
+// Rows of the source image split in planes of ints (one plane for
+// each channel, plus one plane to count transparent pixels), so the
+// convolution is calculated with simple loops over contiguous
+// memory that the compiler can vectorize. Each source row is split
+// (and filtered horizontally for separable matrices) just one time
+// and then reused by all the output rows that need it.
+struct ConvolutionMatrixFilter::Rows {
+  struct Row {
+    int y = -1; // Source row, or -1 if this row is free
+    std::vector<int> data;
+  };
+
+  // Parameters used to calculate the rows
+  const Image* src = nullptr;
+  gfx::Size srcSize;
+  const ConvolutionMatrix* matrix = nullptr;
+  TiledMode tiledMode = TiledMode::NONE;
+  int x = 0;     // First output column
+  int width = 0; // Number of output columns
+  int nplanes = 0;
+
+  // Horizontal/vertical kernels when the matrix is separable
+  bool separable = false;
+  std::vector<int> hkernel;
+  std::vector<int> vkernel;
+
+  std::vector<Row> rows;
+  std::vector<int> sourceRows;
+  std::vector<int> padded; // Source row + pixels needed on each side
+  std::vector<int> acc;    // Convolution of the current output row
+
+  // Width of each plane in a padded row (output width + matrix width)
+  int paddedWidth() const { return width + matrix->getWidth() - 1; }
+
+  // Width of each plane in the cached rows
+  int rowStride() const { return (separable ? width : paddedWidth()); }
 };
 
-} // namespace
-
 ConvolutionMatrixFilter::ConvolutionMatrixFilter() : m_matrix(NULL), m_tiledMode(TiledMode::NONE)
 {
 }
 
+ConvolutionMatrixFilter::~ConvolutionMatrixFilter()
+{
+}
+
 void ConvolutionMatrixFilter::setMatrix(const std::shared_ptr<ConvolutionMatrix>& matrix)
 {
   m_matrix = matrix;
@@ -135,185 +148,306 @@ const char* ConvolutionMatrixFilter::getName()
   return "Convolution Matrix";
 }
 
-void ConvolutionMatrixFilter::applyToRgba(FilterManager* filterMgr)
+// Applies the matrix to one row. "splitPixel(pixel, planes)" must
+// split the pixel in "nplanes" integers, the last plane must be 1 for
+// transparent pixels (0 in other case). "makePixel(pixel, sums)"
+// returns the final pixel from the convolution of each plane.
+template<typename Traits, typename SplitPixel, typename MakePixel>
+void ConvolutionMatrixFilter::applyConvolution(FilterManager* filterMgr,
+                                               const int nplanes,
+                                               SplitPixel splitPixel,
+                                               MakePixel makePixel)
 {
-  if (!m_matrix)
-    return;
+  using pixel_t = typename Traits::pixel_t;
 
   const Image* src = filterMgr->getSourceImage();
-  uint32_t color;
-  GetPixelsDelegateRgba delegate;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t)
-  {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<RgbTraits>(src,
-                                      x,
-                                      y,
-                                      m_matrix->getWidth(),
-                                      m_matrix->getHeight(),
-                                      m_matrix->getCenterX(),
-                                      m_matrix->getCenterY(),
-                                      m_tiledMode,
-                                      delegate);
-
-    color = get_pixel_fast<RgbTraits>(src, x, y);
-    if (delegate.div == 0) {
-      *dst_address = color;
-      continue;
+  const ConvolutionMatrix* matrix = m_matrix.get();
+  const int srcW = src->width();
+  const int srcH = src->height();
+  const bool tiledX = (int(m_tiledMode) & int(TiledMode::X_AXIS));
+  const bool tiledY = (int(m_tiledMode) & int(TiledMode::Y_AXIS));
+  const int matrixW = matrix->getWidth();
+  const int matrixH = matrix->getHeight();
+  const int x1 = filterMgr->x();
+  const int n = filterMgr->getWidth();
+  const int y = filterMgr->y();
+
+  if (!m_rows)
+    m_rows = std::make_unique<Rows>();
+  Rows& r = *m_rows;
+
+  // Discard all cached rows when we start a new image
+  if (filterMgr->isFirstRow() || r.src != src || r.srcSize != src->size() || r.matrix != matrix ||
+      r.tiledMode != m_tiledMode || r.x != x1 || r.width != n || r.nplanes != nplanes) {
+    r.src = src;
+    r.srcSize = src->size();
+    r.matrix = matrix;
+    r.tiledMode = m_tiledMode;
+    r.x = x1;
+    r.width = n;
+    r.nplanes = nplanes;
+    r.separable = (matrixW > 1 && matrixH > 1 &&
+                   get_separable_kernels(matrix, r.hkernel, r.vkernel));
+    r.rows.resize(matrixH);
+    for (auto& row : r.rows) {
+      row.y = -1;
+      row.data.resize(std::size_t(nplanes) * r.rowStride());
     }
+    r.padded.resize(std::size_t(nplanes) * r.paddedWidth());
+    r.acc.resize(std::size_t(nplanes) * n);
+  }
 
-    if (target & TARGET_RED_CHANNEL) {
-      delegate.r = delegate.r / delegate.div + m_matrix->getBias();
-      delegate.r = std::clamp(delegate.r, 0, 255);
-    }
-    else
-      delegate.r = rgba_getr(color);
+  // Source rows needed for this output row
+  r.sourceRows.resize(matrixH);
+  int* sy = r.sourceRows.data();
+  for (int ky = 0; ky < matrixH; ++ky)
+    sy[ky] = get_neighboring_coord(y - matrix->getCenterY() + ky, srcH, tiledY);
+
+  // Free cached rows that are not needed anymore
+  for (auto& row : r.rows) {
+    if (row.y >= 0 && std::find(sy, sy + matrixH, row.y) == sy + matrixH)
+      row.y = -1;
+  }
 
-    if (target & TARGET_GREEN_CHANNEL) {
-      delegate.g = delegate.g / delegate.div + m_matrix->getBias();
-      delegate.g = std::clamp(delegate.g, 0, 255);
+  const int pw = r.paddedWidth();
+  const int stride = r.rowStride();
+
+  auto getRow = [&](const int rowY) -> const int* {
+    for (const auto& row : r.rows) {
+      if (row.y == rowY)
+        return row.data.data();
     }
-    else
-      delegate.g = rgba_getg(color);
 
-    if (target & TARGET_BLUE_CHANNEL) {
-      delegate.b = delegate.b / delegate.div + m_matrix->getBias();
-      delegate.b = std::clamp(delegate.b, 0, 255);
+    auto it = std::find_if(r.rows.begin(), r.rows.end(), [](const Rows::Row& row) {
+      return row.y < 0;
+    });
+    ASSERT(it != r.rows.end());
+    it->y = rowY;
+
+    // Split the source row (with the pixels needed at both sides)
+    auto srcRow = (const pixel_t*)src->getPixelAddress(0, rowY);
+    int* padded = (r.separable ? r.padded.data() : it->data.data());
+    int planes[kMaxPlanes];
+    for (int i = 0; i < pw; ++i) {
+      splitPixel(srcRow[get_neighboring_coord(x1 - matrix->getCenterX() + i, srcW, tiledX)],
+                 planes);
+      for (int c = 0; c < nplanes; ++c)
+        padded[c * pw + i] = planes[c];
     }
-    else
-      delegate.b = rgba_getb(color);
 
-    if (target & TARGET_ALPHA_CHANNEL) {
-      delegate.a = delegate.a / m_matrix->getDiv() + m_matrix->getBias();
-      delegate.a = std::clamp(delegate.a, 0, 255);
+    // Apply the horizontal kernel
+    if (r.separable) {
+      int* out = it->data.data();
+      std::fill(it->data.begin(), it->data.end(), 0);
+      for (int kx = 0; kx < matrixW; ++kx) {
+        const int k = r.hkernel[kx];
+        if (k == 0)
+          continue;
+        for (int c = 0; c < nplanes; ++c) {
+          const int* p = padded + c * pw + kx;
+          int* o = out + c * n;
+          for (int i = 0; i < n; ++i)
+            o[i] += k * p[i];
+        }
+      }
+    }
+    return it->data.data();
+  };
+
+  // Calculate the convolution of the whole row for each plane
+  int* acc = r.acc.data();
+  std::fill(r.acc.begin(), r.acc.end(), 0);
+  for (int ky = 0; ky < matrixH; ++ky) {
+    if (r.separable) {
+      const int k = r.vkernel[ky];
+      if (k == 0)
+        continue;
+      const int* row = getRow(sy[ky]);
+      for (int c = 0; c < nplanes; ++c) {
+        const int* p = row + c * stride;
+        int* a = acc + c * n;
+        for (int i = 0; i < n; ++i)
+          a[i] += k * p[i];
+      }
+    }
+    else {
+      const int* row = getRow(sy[ky]);
+      for (int kx = 0; kx < matrixW; ++kx) {
+        const int k = matrix->value(kx, ky);
+        if (k == 0)
+          continue;
+        for (int c = 0; c < nplanes; ++c) {
+          const int* p = row + c * stride + kx;
+          int* a = acc + c * n;
+          for (int i = 0; i < n; ++i)
+            a[i] += k * p[i];
+        }
+      }
     }
-    else
-      delegate.a = rgba_geta(color);
+  }
+
+  auto src_address = (const pixel_t*)filterMgr->getSourceAddress();
+  auto dst_address = (pixel_t*)filterMgr->getDestinationAddress();
+  auto& token = filterMgr->taskToken();
+  int sums[kMaxPlanes];
+
+  for (int i = 0; i < n && !token.canceled(); ++i, ++src_address, ++dst_address) {
+    if (filterMgr->skipPixel())
+      continue;
 
-    *dst_address = rgba(delegate.r, delegate.g, delegate.b, delegate.a);
+    for (int c = 0; c < nplanes; ++c)
+      sums[c] = acc[c * n + i];
+    *dst_address = makePixel(*src_address, sums);
   }
-  FILTER_LOOP_THROUGH_ROW_END()
 }
 
-void ConvolutionMatrixFilter::applyToGrayscale(FilterManager* filterMgr)
+void ConvolutionMatrixFilter::applyToRgba(FilterManager* filterMgr)
 {
   if (!m_matrix)
     return;
 
-  const Image* src = filterMgr->getSourceImage();
-  uint16_t color;
-  GetPixelsDelegateGrayscale delegate;
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t)
-  {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<GrayscaleTraits>(src,
-                                            x,
-                                            y,
-                                            m_matrix->getWidth(),
-                                            m_matrix->getHeight(),
-                                            m_matrix->getCenterX(),
-                                            m_matrix->getCenterY(),
-                                            m_tiledMode,
-                                            delegate);
-
-    color = get_pixel_fast<GrayscaleTraits>(src, x, y);
-    if (delegate.div == 0) {
-      *dst_address = color;
-      continue;
-    }
+  const Target target = filterMgr->getTarget();
+  const int matrixDiv = m_matrix->getDiv();
+  const int bias = m_matrix->getBias();
+
+  applyConvolution<RgbTraits>(
+    filterMgr,
+    5,
+    [](const color_t color, int* planes) {
+      const int a = rgba_geta(color);
+      planes[0] = (a ? rgba_getr(color) : 0);
+      planes[1] = (a ? rgba_getg(color) : 0);
+      planes[2] = (a ? rgba_getb(color) : 0);
+      planes[3] = a;
+      planes[4] = (a ? 0 : 1);
+    },
+    [target, matrixDiv, bias](const color_t color, const int* sums) -> color_t {
+      const int div = matrixDiv - sums[4];
+      if (div == 0)
+        return color;
+
+      int r, g, b, a;
+
+      if (target & TARGET_RED_CHANNEL)
+        r = std::clamp(sums[0] / div + bias, 0, 255);
+      else
+        r = rgba_getr(color);
 
-    if (target & TARGET_GRAY_CHANNEL) {
-      delegate.v = delegate.v / delegate.div + m_matrix->getBias();
-      delegate.v = std::clamp(delegate.v, 0, 255);
-    }
-    else
-      delegate.v = graya_getv(color);
+      if (target & TARGET_GREEN_CHANNEL)
+        g = std::clamp(sums[1] / div + bias, 0, 255);
+      else
+        g = rgba_getg(color);
 
-    if (target & TARGET_ALPHA_CHANNEL) {
-      delegate.a = delegate.a / m_matrix->getDiv() + m_matrix->getBias();
-      delegate.a = std::clamp(delegate.a, 0, 255);
-    }
-    else
-      delegate.a = graya_geta(color);
+      if (target & TARGET_BLUE_CHANNEL)
+        b = std::clamp(sums[2] / div + bias, 0, 255);
+      else
+        b = rgba_getb(color);
 
-    *dst_address = graya(delegate.v, delegate.a);
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+      if (target & TARGET_ALPHA_CHANNEL)
+        a = std::clamp(sums[3] / matrixDiv + bias, 0, 255);
+      else
+        a = rgba_geta(color);
+
+      return rgba(r, g, b, a);
+    });
 }
 
-void ConvolutionMatrixFilter::applyToIndexed(FilterManager* filterMgr)
+void ConvolutionMatrixFilter::applyToGrayscale(FilterManager* filterMgr)
 {
   if (!m_matrix)
     return;
 
-  const Image* src = filterMgr->getSourceImage();
-  const Palette* pal = filterMgr->getIndexedData()->getPalette();
-  const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
-  uint8_t color;
-  GetPixelsDelegateIndexed delegate(pal);
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t)
-  {
-    delegate.reset(m_matrix.get());
-    get_neighboring_pixels<IndexedTraits>(src,
-                                          x,
-                                          y,
-                                          m_matrix->getWidth(),
-                                          m_matrix->getHeight(),
-                                          m_matrix->getCenterX(),
-                                          m_matrix->getCenterY(),
-                                          m_tiledMode,
-                                          delegate);
-
-    color = get_pixel_fast<IndexedTraits>(src, x, y);
-    if (delegate.div == 0) {
-      *dst_address = color;
-      continue;
-    }
+  const Target target = filterMgr->getTarget();
+  const int matrixDiv = m_matrix->getDiv();
+  const int bias = m_matrix->getBias();
+
+  applyConvolution<GrayscaleTraits>(
+    filterMgr,
+    3,
+    [](const color_t color, int* planes) {
+      const int a = graya_geta(color);
+      planes[0] = (a ? graya_getv(color) : 0);
+      planes[1] = a;
+      planes[2] = (a ? 0 : 1);
+    },
+    [target, matrixDiv, bias](const color_t color, const int* sums) -> uint16_t {
+      const int div = matrixDiv - sums[2];
+      if (div == 0)
+        return color;
+
+      int v, a;
+
+      if (target & TARGET_GRAY_CHANNEL)
+        v = std::clamp(sums[0] / div + bias, 0, 255);
+      else
+        v = graya_getv(color);
 
-    if (target & TARGET_INDEX_CHANNEL) {
-      delegate.index = delegate.index / m_matrix->getDiv() + m_matrix->getBias();
-      delegate.index = std::clamp(delegate.index, 0, 255);
+      if (target & TARGET_ALPHA_CHANNEL)
+        a = std::clamp(sums[1] / matrixDiv + bias, 0, 255);
+      else
+        a = graya_geta(color);
 
-      *dst_address = delegate.index;
-    }
-    else {
-      color = pal->getEntry(color);
+      return graya(v, a);
+    });
+}
 
-      if (target & TARGET_RED_CHANNEL) {
-        delegate.r = delegate.r / delegate.div + m_matrix->getBias();
-        delegate.r = std::clamp(delegate.r, 0, 255);
-      }
+void ConvolutionMatrixFilter::applyToIndexed(FilterManager* filterMgr)
+{
+  if (!m_matrix)
+    return;
+
+  const Palette* pal = filterMgr->getIndexedData()->getPalette();
+  const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
+  const Target target = filterMgr->getTarget();
+  const int matrixDiv = m_matrix->getDiv();
+  const int bias = m_matrix->getBias();
+
+  applyConvolution<IndexedTraits>(
+    filterMgr,
+    6,
+    [pal](const color_t index, int* planes) {
+      const color_t color = pal->getEntry(index);
+      const int a = rgba_geta(color);
+      planes[0] = index;
+      planes[1] = (a ? rgba_getr(color) : 0);
+      planes[2] = (a ? rgba_getg(color) : 0);
+      planes[3] = (a ? rgba_getb(color) : 0);
+      planes[4] = a;
+      planes[5] = (a ? 0 : 1);
+    },
+    [pal, rgbmap, target, matrixDiv, bias](const color_t index, const int* sums) -> uint8_t {
+      const int div = matrixDiv - sums[5];
+      if (div == 0)
+        return index;
+
+      if (target & TARGET_INDEX_CHANNEL)
+        return std::clamp(sums[0] / matrixDiv + bias, 0, 255);
+
+      const color_t color = pal->getEntry(index);
+      int r, g, b, a;
+
+      if (target & TARGET_RED_CHANNEL)
+        r = std::clamp(sums[1] / div + bias, 0, 255);
       else
-        delegate.r = rgba_getr(color);
+        r = rgba_getr(color);
 
-      if (target & TARGET_GREEN_CHANNEL) {
-        delegate.g = delegate.g / delegate.div + m_matrix->getBias();
-        delegate.g = std::clamp(delegate.g, 0, 255);
-      }
+      if (target & TARGET_GREEN_CHANNEL)
+        g = std::clamp(sums[2] / div + bias, 0, 255);
       else
-        delegate.g = rgba_getg(color);
+        g = rgba_getg(color);
 
-      if (target & TARGET_BLUE_CHANNEL) {
-        delegate.b = delegate.b / delegate.div + m_matrix->getBias();
-        delegate.b = std::clamp(delegate.b, 0, 255);
-      }
+      if (target & TARGET_BLUE_CHANNEL)
+        b = std::clamp(sums[3] / div + bias, 0, 255);
       else
-        delegate.b = rgba_getb(color);
+        b = rgba_getb(color);
 
-      if (target & TARGET_ALPHA_CHANNEL) {
-        delegate.a = delegate.a / delegate.div + m_matrix->getBias();
-        delegate.a = std::clamp(delegate.a, 0, 255);
-      }
+      if (target & TARGET_ALPHA_CHANNEL)
+        a = std::clamp(sums[4] / div + bias, 0, 255);
       else
-        delegate.a = rgba_geta(color);
+        a = rgba_geta(color);
 
-      *dst_address = rgbmap->mapColor(delegate.r, delegate.g, delegate.b, delegate.a);
-    }
-  }
-  FILTER_LOOP_THROUGH_ROW_END()
+      return rgbmap->mapColor(r, g, b, a);
+    });
 }
 
 } // namespace filters
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -21,6 +21,7 @@ class ConvolutionMatrix;
 class ConvolutionMatrixFilter : public Filter {
 public:
   ConvolutionMatrixFilter();
+  ~ConvolutionMatrixFilter();
 
   void setMatrix(const std::shared_ptr<ConvolutionMatrix>& matrix);
   void setTiledMode(TiledMode tiledMode);
@@ -35,8 +36,20 @@ public:
   void applyToIndexed(FilterManager* filterMgr);
 
 private:
+  struct Rows;
+
+  template<typename Traits, typename SplitPixel, typename MakePixel>
+  void applyConvolution(FilterManager* filterMgr,
+                        int nplanes,
+                        SplitPixel splitPixel,
+                        MakePixel makePixel);
+
   std::shared_ptr<ConvolutionMatrix> m_matrix;
   TiledMode m_tiledMode;
+
+  // Source rows (or partial results) used by the last processed row,
+  // reused by the next rows.
+  std::unique_ptr<Rows> m_rows;
 };
 
 } // namespace filters
@@ -0,0 +1,368 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_impl.h"
+#include "doc/image_ref.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/rgbmap_rgb5a3.h"
+#include "filters/convolution_matrix.h"
+#include "filters/convolution_matrix_filter.h"
+#include "filters/neighboring_pixels.h"
+#include "filters/test_filter_manager.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace doc;
+using namespace filters;
+
+namespace {
+
+const TiledMode kTiledModes[] = { TiledMode::NONE,
+                                  TiledMode::X_AXIS,
+                                  TiledMode::Y_AXIS,
+                                  TiledMode::BOTH };
+
+std::shared_ptr<ConvolutionMatrix> create_matrix(const int w,
+                                                 const int h,
+                                                 const std::vector<int>& values,
+                                                 const int bias = 0)
+{
+  auto matrix = std::make_shared<ConvolutionMatrix>(w, h);
+  matrix->setCenterX(w / 2);
+  matrix->setCenterY(h / 2);
+  matrix->setBias(bias);
+
+  int div = 0;
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      matrix->value(x, y) = values[y * w + x];
+      div += values[y * w + x];
+    }
+  }
+  matrix->setDiv(div > 0 ? div : 1);
+  return matrix;
+}
+
+// Matrix calculated as the outer product of two vectors
+std::shared_ptr<ConvolutionMatrix> create_separable_matrix(const std::vector<int>& hkernel,
+                                                           const std::vector<int>& vkernel,
+                                                           const int bias = 0)
+{
+  const int w = int(hkernel.size());
+  const int h = int(vkernel.size());
+  std::vector<int> values(w * h);
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      values[y * w + x] = hkernel[x] * vkernel[y];
+  return create_matrix(w, h, values, bias);
+}
+
+std::vector<std::shared_ptr<ConvolutionMatrix>> create_matrices()
+{
+  std::vector<std::shared_ptr<ConvolutionMatrix>> matrices;
+
+  // Separable
+  matrices.push_back(create_separable_matrix({ 1, 2, 1 }, { 1, 2, 1 }));
+  matrices.push_back(create_separable_matrix({ 1, 4, 6, 4, 1 }, { 1, 4, 6, 4, 1 }));
+  matrices.push_back(create_separable_matrix({ -1, 0, 1 }, { 1, 2, 1 }, 128));
+  matrices.push_back(create_separable_matrix({ 1, 1, 1, 1, 1, 1, 1 }, { 2, 0, 3 }));
+  matrices.push_back(create_separable_matrix({ 3, 1 }, { 1, 1, 1, 1 }));
+
+  // Non-separable
+  matrices.push_back(create_matrix(3, 3, { 0, -1, 0, -1, 4, -1, 0, -1, 0 }, 128));
+  matrices.push_back(create_matrix(3, 3, { 0, -1, 0, -1, 5, -1, 0, -1, 0 }));
+  matrices.push_back(create_matrix(3, 3, { 1, 1, 1, 1, 0, 1, 1, 1, 1 }));
+  matrices.push_back(create_matrix(5, 3, { 1, 0, 2, 0, 1, 0, 3, 0, 3, 0, 1, 0, 2, 0, 1 }));
+
+  // One row or one column
+  matrices.push_back(create_matrix(5, 1, { 1, 2, 3, 2, 1 }));
+  matrices.push_back(create_matrix(1, 5, { 1, 2, 3, 2, 1 }));
+
+  // Centers that are not in the middle of the matrix
+  auto matrix = create_separable_matrix({ 1, 2, 1 }, { 1, 2, 1 });
+  matrix->setCenterX(0);
+  matrix->setCenterY(2);
+  matrices.push_back(matrix);
+
+  matrix = create_matrix(3, 2, { 1, -2, 1, 2, 1, 2 });
+  matrix->setCenterX(2);
+  matrix->setCenterY(0);
+  matrices.push_back(matrix);
+
+  return matrices;
+}
+
+// Few different values to get transparent pixels and edges
+int random_channel(std::mt19937& rng)
+{
+  static const int values[] = { 0, 0, 1, 64, 127, 128, 200, 255, 255 };
+  return values[rng() % std::size(values)];
+}
+
+ImageRef create_random_image(const PixelFormat format, const int w, const int h, std::mt19937& rng)
+{
+  ImageRef image(Image::create(format, w, h));
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      color_t c = 0;
+      switch (format) {
+        case IMAGE_RGB:
+          c = rgba(random_channel(rng),
+                   random_channel(rng),
+                   random_channel(rng),
+                   random_channel(rng));
+          break;
+        case IMAGE_GRAYSCALE: c = graya(random_channel(rng), random_channel(rng)); break;
+        case IMAGE_INDEXED:   c = rng() % 16; break;
+        default:              break;
+      }
+      put_pixel(image.get(), x, y, c);
+    }
+  }
+  return image;
+}
+
+ImageRef create_random_mask(const int w, const int h, std::mt19937& rng)
+{
+  ImageRef mask(Image::create(IMAGE_BITMAP, w, h));
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      put_pixel(mask.get(), x, y, (rng() % 3) != 0);
+  return mask;
+}
+
+// Weighted sum of the RGBA/index values of the pixels around (x,y)
+// using the 2D matrix (the original implementation of the
+// ConvolutionMatrixFilter).
+struct ReferenceSums {
+  int div;
+  int r = 0, g = 0, b = 0, a = 0, v = 0, index = 0;
+};
+
+template<typename Traits>
+ReferenceSums reference_sums(const Image* src,
+                             const int x,
+                             const int y,
+                             const ConvolutionMatrix* matrix,
+                             const TiledMode tiledMode,
+                             const Palette* palette)
+{
+  ReferenceSums s;
+  s.div = matrix->getDiv();
+  const int* matrixData = &matrix->value(0, 0);
+
+  auto delegate = [&](const typename Traits::pixel_t pixel) {
+    const int k = *(matrixData++);
+    if (k == 0)
+      return;
+
+    color_t c = pixel;
+    if (src->pixelFormat() == IMAGE_INDEXED) {
+      s.index += pixel * k;
+      c = palette->getEntry(pixel);
+    }
+
+    int a;
+    if (src->pixelFormat() == IMAGE_GRAYSCALE) {
+      a = graya_geta(c);
+      if (a)
+        s.v += graya_getv(c) * k;
+    }
+    else {
+      a = rgba_geta(c);
+      if (a) {
+        s.r += rgba_getr(c) * k;
+        s.g += rgba_getg(c) * k;
+        s.b += rgba_getb(c) * k;
+      }
+    }
+
+    if (a)
+      s.a += a * k;
+    else
+      s.div -= k;
+  };
+
+  get_neighboring_pixels<Traits>(src,
+                                 x,
+                                 y,
+                                 matrix->getWidth(),
+                                 matrix->getHeight(),
+                                 matrix->getCenterX(),
+                                 matrix->getCenterY(),
+                                 tiledMode,
+                                 delegate);
+  return s;
+}
+
+color_t reference_pixel(const Image* src,
+                        const int x,
+                        const int y,
+                        const ConvolutionMatrix* matrix,
+                        const TiledMode tiledMode,
+                        const Target target,
+                        const Palette* palette,
+                        const RgbMap* rgbmap)
+{
+  const color_t c = get_pixel(src, x, y);
+  const int bias = matrix->getBias();
+
+  auto value = [bias](const int sum, const int div) { return std::clamp(sum / div + bias, 0, 255); };
+
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB: {
+      const auto s = reference_sums<RgbTraits>(src, x, y, matrix, tiledMode, palette);
+      if (s.div == 0)
+        return c;
+      return rgba((target & TARGET_RED_CHANNEL) ? value(s.r, s.div) : rgba_getr(c),
+                  (target & TARGET_GREEN_CHANNEL) ? value(s.g, s.div) : rgba_getg(c),
+                  (target & TARGET_BLUE_CHANNEL) ? value(s.b, s.div) : rgba_getb(c),
+                  (target & TARGET_ALPHA_CHANNEL) ? value(s.a, matrix->getDiv()) : rgba_geta(c));
+    }
+
+    case IMAGE_GRAYSCALE: {
+      const auto s = reference_sums<GrayscaleTraits>(src, x, y, matrix, tiledMode, palette);
+      if (s.div == 0)
+        return c;
+      return graya((target & TARGET_GRAY_CHANNEL) ? value(s.v, s.div) : graya_getv(c),
+                   (target & TARGET_ALPHA_CHANNEL) ? value(s.a, matrix->getDiv()) : graya_geta(c));
+    }
+
+    case IMAGE_INDEXED: {
+      const auto s = reference_sums<IndexedTraits>(src, x, y, matrix, tiledMode, palette);
+      if (s.div == 0)
+        return c;
+      if (target & TARGET_INDEX_CHANNEL)
+        return value(s.index, matrix->getDiv());
+
+      const color_t rgb = palette->getEntry(c);
+      return rgbmap->mapColor((target & TARGET_RED_CHANNEL) ? value(s.r, s.div) : rgba_getr(rgb),
+                              (target & TARGET_GREEN_CHANNEL) ? value(s.g, s.div) : rgba_getg(rgb),
+                              (target & TARGET_BLUE_CHANNEL) ? value(s.b, s.div) : rgba_getb(rgb),
+                              (target & TARGET_ALPHA_CHANNEL) ? value(s.a, s.div) : rgba_geta(rgb));
+    }
+
+    default: break;
+  }
+  return c;
+}
+
+void test_convolution_filter(const Image* src,
+                             const Target target,
+                             const gfx::Rect& bounds,
+                             const Image* mask,
+                             const Palette* palette = nullptr,
+                             const RgbMap* rgbmap = nullptr)
+{
+  for (const TiledMode tiledMode : kTiledModes) {
+    for (const auto& matrix : create_matrices()) {
+      ConvolutionMatrixFilter filter;
+      filter.setMatrix(matrix);
+      filter.setTiledMode(tiledMode);
+
+      ImageRef dst(Image::createCopy(src));
+      ImageRef expected(Image::createCopy(src));
+      TestFilterIndexedData indexedData(palette, rgbmap);
+      TestFilterManager filterMgr(src, dst.get(), target, bounds, mask, &indexedData);
+      filterMgr.apply(&filter);
+
+      for (int y = bounds.y; y < bounds.y2(); ++y) {
+        for (int x = bounds.x; x < bounds.x2(); ++x) {
+          if (!mask || get_pixel(mask, x, y))
+            put_pixel(
+              expected.get(),
+              x,
+              y,
+              reference_pixel(src, x, y, matrix.get(), tiledMode, target, palette, rgbmap));
+        }
+      }
+
+      EXPECT_EQ(0, count_diff_between_images(expected.get(), dst.get()))
+        << "Target " << target << " Tiled mode " << int(tiledMode) << " Matrix "
+        << matrix->getWidth() << "x" << matrix->getHeight() << " Bounds " << bounds.x << ","
+        << bounds.y << "," << bounds.w << "," << bounds.h;
+    }
+  }
+}
+
+} // anonymous namespace
+
+TEST(ConvolutionMatrixFilter, Rgb)
+{
+  std::mt19937 rng(1);
+  const ImageRef src = create_random_image(IMAGE_RGB, 23, 19, rng);
+
+  for (Target target = 1; target <= TARGET_ALPHA_CHANNEL * 2 - 1; ++target)
+    test_convolution_filter(src.get(), target, src->bounds(), nullptr);
+}
+
+TEST(ConvolutionMatrixFilter, Grayscale)
+{
+  std::mt19937 rng(2);
+  const ImageRef src = create_random_image(IMAGE_GRAYSCALE, 21, 17, rng);
+
+  for (Target target : { TARGET_GRAY_CHANNEL,
+                         TARGET_ALPHA_CHANNEL,
+                         TARGET_GRAY_CHANNEL | TARGET_ALPHA_CHANNEL })
+    test_convolution_filter(src.get(), target, src->bounds(), nullptr);
+}
+
+TEST(ConvolutionMatrixFilter, Indexed)
+{
+  std::mt19937 rng(3);
+  const ImageRef src = create_random_image(IMAGE_INDEXED, 19, 23, rng);
+
+  // The first entry is transparent
+  Palette palette(0, 16);
+  palette.setEntry(0, rgba(0, 0, 0, 0));
+  for (int i = 1; i < 16; ++i)
+    palette.setEntry(i, rgba(random_channel(rng), random_channel(rng), random_channel(rng), 255));
+  RgbMapRGB5A3 rgbmap;
+  rgbmap.regenerateMap(&palette, 0);
+
+  test_convolution_filter(src.get(), TARGET_INDEX_CHANNEL, src->bounds(), nullptr, &palette, &rgbmap);
+  for (Target target = 1; target <= TARGET_ALPHA_CHANNEL * 2 - 1; ++target)
+    test_convolution_filter(src.get(), target, src->bounds(), nullptr, &palette, &rgbmap);
+}
+
+TEST(ConvolutionMatrixFilter, MaskAndBounds)
+{
+  std::mt19937 rng(4);
+  const ImageRef src = create_random_image(IMAGE_RGB, 29, 25, rng);
+  const ImageRef mask = create_random_mask(29, 25, rng);
+
+  for (const gfx::Rect& bounds :
+       { src->bounds(), gfx::Rect(0, 0, 1, 1), gfx::Rect(3, 5, 11, 7), gfx::Rect(28, 0, 1, 25) }) {
+    test_convolution_filter(src.get(), TARGET_ALL_CHANNELS, bounds, mask.get());
+    test_convolution_filter(src.get(), TARGET_GREEN_CHANNEL | TARGET_ALPHA_CHANNEL, bounds, nullptr);
+  }
+}
+
+TEST(ConvolutionMatrixFilter, SmallImages)
+{
+  // Matrices bigger than the image
+  std::mt19937 rng(5);
+  for (const gfx::Size& size : { gfx::Size(1, 1), gfx::Size(1, 7), gfx::Size(2, 3) }) {
+    const ImageRef src = create_random_image(IMAGE_RGB, size.w, size.h, rng);
+    test_convolution_filter(src.get(), TARGET_ALL_CHANNELS, src->bounds(), nullptr);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -44,6 +44,12 @@ public:
 
   // Applies the filter to the color palette.
   virtual void applyToPalette(FilterManager* filterMgr) {}
+
+  // Returns true if the applyToRgba/Grayscale/Indexed() functions
+  // can be called from several threads at the same time (each one
+  // with its own FilterManager), i.e. the filter doesn't modify its
+  // own state when it's applied to a row.
+  virtual bool isThreadSafe() const { return false; }
 };
 
 // Filter that support applying it only to palette colors.
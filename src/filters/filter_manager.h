@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019-2023  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -10,8 +10,11 @@
 #pragma once
 
 #include "base/task.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
 #include "doc/pixel_format.h"
 #include "filters/target.h"
+#include "gfx/rect.h"
 
 // Creates src_address, dst_address, x, x2, and y variables to iterate
 // through a row of the target. Skips non-selected areas.
@@ -38,6 +41,22 @@ namespace filters {
 
 class FilterIndexedData;
 
+// Identifies the pixels of the source image of a FilterManager, which
+// can be a temporary copy of a part of other image (e.g. the cel
+// image cropped to the sprite bounds).
+struct SourceImageKey {
+  doc::ObjectId imageId = 0;
+  doc::ObjectVersion imageVersion = 0;
+  gfx::Rect bounds; // Bounds of the source image inside the original image
+
+  bool operator==(const SourceImageKey& other) const
+  {
+    return (imageId == other.imageId && imageVersion == other.imageVersion &&
+            bounds == other.bounds);
+  }
+  bool operator!=(const SourceImageKey& other) const { return !operator==(other); }
+};
+
 // Information given to a filter (Filter interface) to apply it to a
 // single row. Basically an Filter implementation has to obtain
 // colors from getSourceAddress(), applies some kind of transformation
@@ -85,6 +104,12 @@ public:
   // Returns the source image.
   virtual const doc::Image* getSourceImage() = 0;
 
+  // Returns the original image of getSourceImage(), so a filter can
+  // cache data calculated from the source image between different
+  // calls (e.g. when the preview is updated, or the filter is
+  // applied after the preview).
+  virtual SourceImageKey getSourceImageKey() = 0;
+
   // Returns the first X coordinate of the row to apply the filter.
   virtual int x() const = 0;
 
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2020  Igara Studio S.A.
+// Copyright (C) 2020-2025  Igara Studio S.A.
 // Copyright (C) 2001-2017  David Capello
 //
 // This program is distributed under the terms of
@@ -21,86 +21,213 @@
 #include "filters/tiled_mode.h"
 
 #include <algorithm>
+#include <functional>
+#include <vector>
 
 namespace filters {
 
 using namespace doc;
 
 namespace {
-struct GetPixelsDelegateRgba {
-  std::vector<std::vector<uint8_t>>& channel;
-  int c;
 
-  GetPixelsDelegateRgba(std::vector<std::vector<uint8_t>>& channel) : channel(channel) {}
+const int kBins = 256;
+const int kCoarseBins = 16;
+const int kCoarseShift = 4;
+const int kFineBinsPerCoarse = kBins / kCoarseBins;
 
-  void reset() { c = 0; }
+// Filters with this number of pixels or less are applied sorting the
+// pixels of each window (the histograms are slower for them).
+const int kMaxSmallFilterSize = 9;
 
-  void operator()(RgbTraits::pixel_t color)
+inline void sort2(uint8_t& a, uint8_t& b)
+{
+  if (a > b)
+    std::swap(a, b);
+}
+
+// Median of 9 values using a sorting network (e.g. the default 3x3
+// filter), "p" is modified.
+inline int median9(uint8_t* p)
+{
+  sort2(p[1], p[2]);
+  sort2(p[4], p[5]);
+  sort2(p[7], p[8]);
+  sort2(p[0], p[1]);
+  sort2(p[3], p[4]);
+  sort2(p[6], p[7]);
+  sort2(p[1], p[2]);
+  sort2(p[4], p[5]);
+  sort2(p[7], p[8]);
+  sort2(p[0], p[3]);
+  sort2(p[5], p[8]);
+  sort2(p[4], p[7]);
+  sort2(p[3], p[6]);
+  sort2(p[1], p[4]);
+  sort2(p[2], p[5]);
+  sort2(p[4], p[7]);
+  sort2(p[4], p[2]);
+  sort2(p[6], p[4]);
+  sort2(p[4], p[2]);
+  return p[4];
+}
+
+} // anonymous namespace
+
+// Histograms for the "Median Filtering in Constant Time" algorithm
+// (Perreault & Hebert): each column of the image has the histogram
+// of the pixels inside the filter height, so moving the filter one
+// pixel to the right costs one addition and one subtraction of column
+// histograms, and moving to the next row costs one pixel per column,
+// independently of the filter size.
+//
+// Only the coarse histogram (16 bins) of the filter window is moved
+// for each pixel. Each segment of 16 bins of the fine histogram is
+// updated lazily, when the median falls in that segment.
+struct MedianFilter::Histograms {
+  // Parameters used to calculate the column histograms
+  const Image* src = nullptr;
+  gfx::Size srcSize;
+  gfx::Size filterSize;
+  TiledMode tiledMode = TiledMode::NONE;
+  int nchannels = 0;
+  int channelsMask = 0;
+  int lastY = -1;
+
+  std::vector<uint16_t> colFine;   // [channel][x][kBins]
+  std::vector<uint16_t> colCoarse; // [channel][x][kCoarseBins]
+  std::vector<uint32_t> fine;      // [channel][kBins]
+  std::vector<uint32_t> coarse;    // [channel][kCoarseBins]
+
+  // Window position (x) of the last update of each segment of "fine"
+  // (or -1 if it must be calculated from scratch)
+  std::vector<int> fineX; // [channel][kCoarseBins]
+
+  // Column of the image used in the given window position (x) and
+  // filter column (dx).
+  std::function<int(int x, int dx)> column;
+
+  uint16_t* colFineAt(int c, int x) { return &colFine[(c * srcSize.w + x) * kBins]; }
+  uint16_t* colCoarseAt(int c, int x) { return &colCoarse[(c * srcSize.w + x) * kCoarseBins]; }
+
+  // Calculates the coarse histogram of the filter window in the given
+  // position (the fine histogram will be calculated when needed).
+  void resetWindow(const int x)
   {
-    channel[0][c] = rgba_getr(color);
-    channel[1][c] = rgba_getg(color);
-    channel[2][c] = rgba_getb(color);
-    channel[3][c] = rgba_geta(color);
-    c++;
+    std::fill(coarse.begin(), coarse.end(), 0);
+    std::fill(fineX.begin(), fineX.end(), -1);
+    for (int dx = 0; dx < filterSize.w; ++dx) {
+      const int col = column(x, dx);
+      for (int c = 0; c < nchannels; ++c) {
+        if (channelsMask & (1 << c))
+          addCoarse(c, col, true);
+      }
+    }
   }
-};
 
-struct GetPixelsDelegateGrayscale {
-  std::vector<std::vector<uint8_t>>& channel;
-  int c;
+  // Moves the coarse histograms of the filter window from position
+  // "x" to "x+1".
+  void moveWindow(const int x)
+  {
+    const int colOut = column(x, 0);
+    const int colIn = column(x + 1, filterSize.w - 1);
+    if (colOut == colIn)
+      return;
+
+    for (int c = 0; c < nchannels; ++c) {
+      if (channelsMask & (1 << c)) {
+        addCoarse(c, colOut, false);
+        addCoarse(c, colIn, true);
+      }
+    }
+  }
 
-  GetPixelsDelegateGrayscale(std::vector<std::vector<uint8_t>>& channel) : channel(channel) {}
+  // Returns the median of the filter window in position "x".
+  int findMedian(const int c, const int x, const uint32_t rank)
+  {
+    const uint32_t* k = &coarse[c * kCoarseBins];
+    uint32_t acc = 0;
+    int i = 0;
+    for (; i < kCoarseBins - 1; ++i) {
+      if (acc + k[i] > rank)
+        break;
+      acc += k[i];
+    }
 
-  void reset() { c = 0; }
+    updateFineSegment(c, i, x);
 
-  void operator()(GrayscaleTraits::pixel_t color)
-  {
-    channel[0][c] = graya_getv(color);
-    channel[1][c] = graya_geta(color);
-    c++;
+    const uint32_t* f = &fine[c * kBins];
+    int v = (i << kCoarseShift);
+    const int vEnd = v + kFineBinsPerCoarse - 1;
+    for (; v < vEnd; ++v) {
+      if (acc + f[v] > rank)
+        break;
+      acc += f[v];
+    }
+    return v;
   }
-};
 
-struct GetPixelsDelegateIndexed {
-  const Palette* pal;
-  std::vector<std::vector<uint8_t>>& channel;
-  Target target;
-  int c;
-
-  GetPixelsDelegateIndexed(const Palette* pal,
-                           std::vector<std::vector<uint8_t>>& channel,
-                           Target target)
-    : pal(pal)
-    , channel(channel)
-    , target(target)
+private:
+  void addCoarse(const int c, const int col, const bool add)
   {
+    uint32_t* k = &coarse[c * kCoarseBins];
+    const uint16_t* ck = colCoarseAt(c, col);
+    if (add) {
+      for (int i = 0; i < kCoarseBins; ++i)
+        k[i] += ck[i];
+    }
+    else {
+      for (int i = 0; i < kCoarseBins; ++i)
+        k[i] -= ck[i];
+    }
   }
 
-  void reset() { c = 0; }
+  void addFineSegment(const int c, const int i, const int col, const bool add)
+  {
+    uint32_t* f = &fine[c * kBins + i * kFineBinsPerCoarse];
+    const uint16_t* cf = colFineAt(c, col) + i * kFineBinsPerCoarse;
+    if (add) {
+      for (int j = 0; j < kFineBinsPerCoarse; ++j)
+        f[j] += cf[j];
+    }
+    else {
+      for (int j = 0; j < kFineBinsPerCoarse; ++j)
+        f[j] -= cf[j];
+    }
+  }
 
-  void operator()(IndexedTraits::pixel_t color)
+  // Updates the segment "i" of the fine histogram to the window
+  // position "x", moving it from its last position if it's near, or
+  // calculating it again from the column histograms.
+  void updateFineSegment(const int c, const int i, const int x)
   {
-    if (target & TARGET_INDEX_CHANNEL) {
-      channel[0][c] = color;
+    int& lastX = fineX[c * kCoarseBins + i];
+    if (lastX == x)
+      return;
+
+    if (lastX >= 0 && lastX < x && x - lastX < filterSize.w) {
+      for (int x0 = lastX; x0 < x; ++x0) {
+        const int colOut = column(x0, 0);
+        const int colIn = column(x0 + 1, filterSize.w - 1);
+        if (colOut != colIn) {
+          addFineSegment(c, i, colOut, false);
+          addFineSegment(c, i, colIn, true);
+        }
+      }
     }
     else {
-      color_t rgb = pal->getEntry(color);
-      channel[0][c] = rgba_getr(rgb);
-      channel[1][c] = rgba_getg(rgb);
-      channel[2][c] = rgba_getb(rgb);
-      channel[3][c] = rgba_geta(rgb);
+      std::fill_n(&fine[c * kBins + i * kFineBinsPerCoarse], kFineBinsPerCoarse, 0);
+      for (int dx = 0; dx < filterSize.w; ++dx)
+        addFineSegment(c, i, column(x, dx), true);
     }
-    c++;
+    lastX = x;
   }
 };
-}; // namespace
-
-MedianFilter::MedianFilter()
-  : m_tiledMode(TiledMode::NONE)
-  , m_width(1)
-  , m_height(1)
-  , m_ncolors(0)
-  , m_channel(4)
+
+MedianFilter::MedianFilter() : m_tiledMode(TiledMode::NONE), m_width(1), m_height(1)
+{
+}
+
+MedianFilter::~MedianFilter()
 {
 }
 
@@ -116,10 +243,6 @@ void MedianFilter::setSize(int width, int height)
 
   m_width = std::max(1, width);
   m_height = std::max(1, height);
-  m_ncolors = width * height;
-
-  for (int c = 0; c < 4; ++c)
-    m_channel[c].resize(m_ncolors);
 }
 
 const char* MedianFilter::getName()
@@ -127,161 +250,265 @@ const char* MedianFilter::getName()
   return "Median Blur";
 }
 
-void MedianFilter::applyToRgba(FilterManager* filterMgr)
+// Applies the filter to one row. "getChannels(pixel, channels)" must
+// split the pixel in "nchannels" 8-bit values, and
+// "makePixel(pixel, medians)" returns the final pixel using the
+// median of each channel in "channelsMask".
+template<typename Traits, typename GetChannels, typename MakePixel>
+void MedianFilter::applyMedian(FilterManager* filterMgr,
+                               const int nchannels,
+                               const int channelsMask,
+                               GetChannels getChannels,
+                               MakePixel makePixel)
 {
-  const Image* src = filterMgr->getSourceImage();
-  int color, r, g, b, a;
-  GetPixelsDelegateRgba delegate(m_channel);
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t)
-  {
-    delegate.reset();
-    get_neighboring_pixels<RgbTraits>(src,
-                                      x,
-                                      y,
-                                      m_width,
-                                      m_height,
-                                      m_width / 2,
-                                      m_height / 2,
-                                      m_tiledMode,
-                                      delegate);
-
-    color = get_pixel_fast<RgbTraits>(src, x, y);
-
-    if (target & TARGET_RED_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      r = m_channel[0][m_ncolors / 2];
-    }
-    else
-      r = rgba_getr(color);
-
-    if (target & TARGET_GREEN_CHANNEL) {
-      std::sort(m_channel[1].begin(), m_channel[1].end());
-      g = m_channel[1][m_ncolors / 2];
-    }
-    else
-      g = rgba_getg(color);
+  if (m_width * m_height <= kMaxSmallFilterSize)
+    applySmallMedian<Traits>(filterMgr, nchannels, channelsMask, getChannels, makePixel);
+  else
+    applyHistogramMedian<Traits>(filterMgr, nchannels, channelsMask, getChannels, makePixel);
+}
 
-    if (target & TARGET_BLUE_CHANNEL) {
-      std::sort(m_channel[2].begin(), m_channel[2].end());
-      b = m_channel[2][m_ncolors / 2];
-    }
-    else
-      b = rgba_getb(color);
+template<typename Traits, typename GetChannels, typename MakePixel>
+void MedianFilter::applySmallMedian(FilterManager* filterMgr,
+                                    const int nchannels,
+                                    const int channelsMask,
+                                    GetChannels getChannels,
+                                    MakePixel makePixel)
+{
+  using pixel_t = typename Traits::pixel_t;
 
-    if (target & TARGET_ALPHA_CHANNEL) {
-      std::sort(m_channel[3].begin(), m_channel[3].end());
-      a = m_channel[3][m_ncolors / 2];
+  const Image* src = filterMgr->getSourceImage();
+  const int n = m_width * m_height;
+  uint8_t values[4][kMaxSmallFilterSize];
+  int medians[4] = { 0, 0, 0, 0 };
+  int i;
+
+  auto delegate = [&values, &i, nchannels, &getChannels](const pixel_t pixel) {
+    uint8_t ch[4];
+    getChannels(pixel, ch);
+    for (int c = 0; c < nchannels; ++c)
+      values[c][i] = ch[c];
+    ++i;
+  };
+
+  FILTER_LOOP_THROUGH_ROW_BEGIN(pixel_t)
+  {
+    i = 0;
+    get_neighboring_pixels<Traits>(src,
+                                   x,
+                                   y,
+                                   m_width,
+                                   m_height,
+                                   m_width / 2,
+                                   m_height / 2,
+                                   m_tiledMode,
+                                   delegate);
+
+    for (int c = 0; c < nchannels; ++c) {
+      if ((channelsMask & (1 << c)) == 0)
+        continue;
+
+      uint8_t* v = values[c];
+      if (n == 9) {
+        medians[c] = median9(v);
+      }
+      else {
+        std::nth_element(v, v + n / 2, v + n);
+        medians[c] = v[n / 2];
+      }
     }
-    else
-      a = rgba_geta(color);
-
-    *dst_address = rgba(r, g, b, a);
+    *dst_address = makePixel(*src_address, medians);
   }
   FILTER_LOOP_THROUGH_ROW_END()
 }
 
-void MedianFilter::applyToGrayscale(FilterManager* filterMgr)
+template<typename Traits, typename GetChannels, typename MakePixel>
+void MedianFilter::applyHistogramMedian(FilterManager* filterMgr,
+                                        const int nchannels,
+                                        const int channelsMask,
+                                        GetChannels getChannels,
+                                        MakePixel makePixel)
 {
-  const Image* src = filterMgr->getSourceImage();
-  int color, k, a;
-  GetPixelsDelegateGrayscale delegate(m_channel);
+  using pixel_t = typename Traits::pixel_t;
 
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t)
-  {
-    delegate.reset();
-    get_neighboring_pixels<GrayscaleTraits>(src,
-                                            x,
-                                            y,
-                                            m_width,
-                                            m_height,
-                                            m_width / 2,
-                                            m_height / 2,
-                                            m_tiledMode,
-                                            delegate);
-
-    color = get_pixel_fast<GrayscaleTraits>(src, x, y);
-
-    if (target & TARGET_GRAY_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      k = m_channel[0][m_ncolors / 2];
+  const Image* src = filterMgr->getSourceImage();
+  const int srcW = src->width();
+  const int srcH = src->height();
+  const bool tiledX = (int(m_tiledMode) & int(TiledMode::X_AXIS));
+  const bool tiledY = (int(m_tiledMode) & int(TiledMode::Y_AXIS));
+  const int centerX = m_width / 2;
+  const int centerY = m_height / 2;
+  const int y = filterMgr->y();
+
+  if (!m_hist)
+    m_hist = std::make_unique<Histograms>();
+  Histograms& h = *m_hist;
+
+  auto updateRow = [&h, src, srcW, nchannels, channelsMask, &getChannels](const int row,
+                                                                           const bool add) {
+    auto p = (const pixel_t*)src->getPixelAddress(0, row);
+    uint8_t ch[4];
+    for (int x = 0; x < srcW; ++x, ++p) {
+      getChannels(*p, ch);
+      for (int c = 0; c < nchannels; ++c) {
+        if ((channelsMask & (1 << c)) == 0)
+          continue;
+        if (add) {
+          ++h.colFineAt(c, x)[ch[c]];
+          ++h.colCoarseAt(c, x)[ch[c] >> kCoarseShift];
+        }
+        else {
+          --h.colFineAt(c, x)[ch[c]];
+          --h.colCoarseAt(c, x)[ch[c] >> kCoarseShift];
+        }
+      }
     }
-    else
-      k = graya_getv(color);
-
-    if (target & TARGET_ALPHA_CHANNEL) {
-      std::sort(m_channel[1].begin(), m_channel[1].end());
-      a = m_channel[1][m_ncolors / 2];
+  };
+
+  // Re-create the column histograms when we start a new image (or
+  // rows are not consecutive), in other case we just move them one
+  // row down.
+  if (filterMgr->isFirstRow() || h.src != src || h.srcSize != src->size() ||
+      h.filterSize != gfx::Size(m_width, m_height) || h.tiledMode != m_tiledMode ||
+      h.nchannels != nchannels || h.channelsMask != channelsMask || h.lastY + 1 != y) {
+    h.src = src;
+    h.srcSize = src->size();
+    h.filterSize = gfx::Size(m_width, m_height);
+    h.tiledMode = m_tiledMode;
+    h.nchannels = nchannels;
+    h.channelsMask = channelsMask;
+    h.colFine.assign(std::size_t(nchannels) * srcW * kBins, 0);
+    h.colCoarse.assign(std::size_t(nchannels) * srcW * kCoarseBins, 0);
+    h.fine.resize(nchannels * kBins);
+    h.coarse.resize(nchannels * kCoarseBins);
+    h.fineX.resize(nchannels * kCoarseBins);
+    h.column = [srcW, tiledX, centerX](const int x, const int dx) {
+      return get_neighboring_coord(x - centerX + dx, srcW, tiledX);
+    };
+
+    for (int dy = 0; dy < m_height; ++dy)
+      updateRow(get_neighboring_coord(y - centerY + dy, srcH, tiledY), true);
+  }
+  else {
+    const int rowOut = get_neighboring_coord(y - 1 - centerY, srcH, tiledY);
+    const int rowIn = get_neighboring_coord(y - centerY + m_height - 1, srcH, tiledY);
+    if (rowOut != rowIn) {
+      updateRow(rowOut, false);
+      updateRow(rowIn, true);
+    }
+  }
+  h.lastY = y;
+
+  // Histogram of the filter window for the first pixel of the row
+  int x = filterMgr->x();
+  const int x2 = x + filterMgr->getWidth();
+  h.resetWindow(x);
+
+  const uint32_t rank = uint32_t(m_width * m_height / 2);
+  auto src_address = (const pixel_t*)filterMgr->getSourceAddress();
+  auto dst_address = (pixel_t*)filterMgr->getDestinationAddress();
+  auto& token = filterMgr->taskToken();
+  int medians[4] = { 0, 0, 0, 0 };
+
+  for (; x < x2 && !token.canceled(); ++x, ++src_address, ++dst_address) {
+    // The histograms must be moved even for skipped pixels
+    if (!filterMgr->skipPixel()) {
+      for (int c = 0; c < nchannels; ++c) {
+        if (channelsMask & (1 << c))
+          medians[c] = h.findMedian(c, x, rank);
+      }
+      *dst_address = makePixel(*src_address, medians);
     }
-    else
-      a = graya_geta(color);
 
-    *dst_address = graya(k, a);
+    // Move the filter window one pixel to the right
+    if (x + 1 < x2)
+      h.moveWindow(x);
   }
-  FILTER_LOOP_THROUGH_ROW_END()
+}
+
+void MedianFilter::applyToRgba(FilterManager* filterMgr)
+{
+  const Target target = filterMgr->getTarget();
+  const int mask = ((target & TARGET_RED_CHANNEL) ? 1 : 0) |
+                   ((target & TARGET_GREEN_CHANNEL) ? 2 : 0) |
+                   ((target & TARGET_BLUE_CHANNEL) ? 4 : 0) |
+                   ((target & TARGET_ALPHA_CHANNEL) ? 8 : 0);
+
+  applyMedian<RgbTraits>(
+    filterMgr,
+    4,
+    mask,
+    [](const color_t color, uint8_t* ch) {
+      ch[0] = rgba_getr(color);
+      ch[1] = rgba_getg(color);
+      ch[2] = rgba_getb(color);
+      ch[3] = rgba_geta(color);
+    },
+    [mask](const color_t color, const int* m) -> color_t {
+      return rgba((mask & 1) ? m[0] : rgba_getr(color),
+                  (mask & 2) ? m[1] : rgba_getg(color),
+                  (mask & 4) ? m[2] : rgba_getb(color),
+                  (mask & 8) ? m[3] : rgba_geta(color));
+    });
+}
+
+void MedianFilter::applyToGrayscale(FilterManager* filterMgr)
+{
+  const Target target = filterMgr->getTarget();
+  const int mask = ((target & TARGET_GRAY_CHANNEL) ? 1 : 0) |
+                   ((target & TARGET_ALPHA_CHANNEL) ? 2 : 0);
+
+  applyMedian<GrayscaleTraits>(
+    filterMgr,
+    2,
+    mask,
+    [](const color_t color, uint8_t* ch) {
+      ch[0] = graya_getv(color);
+      ch[1] = graya_geta(color);
+    },
+    [mask](const color_t color, const int* m) -> uint16_t {
+      return graya((mask & 1) ? m[0] : graya_getv(color), (mask & 2) ? m[1] : graya_geta(color));
+    });
 }
 
 void MedianFilter::applyToIndexed(FilterManager* filterMgr)
 {
-  const Image* src = filterMgr->getSourceImage();
   const Palette* pal = filterMgr->getIndexedData()->getPalette();
   const RgbMap* rgbmap = filterMgr->getIndexedData()->getRgbMap();
-  int color, r, g, b, a;
-  GetPixelsDelegateIndexed delegate(pal, m_channel, filterMgr->getTarget());
-
-  FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t)
-  {
-    delegate.reset();
-    get_neighboring_pixels<IndexedTraits>(src,
-                                          x,
-                                          y,
-                                          m_width,
-                                          m_height,
-                                          m_width / 2,
-                                          m_height / 2,
-                                          m_tiledMode,
-                                          delegate);
-
-    if (target & TARGET_INDEX_CHANNEL) {
-      std::sort(m_channel[0].begin(), m_channel[0].end());
-      *dst_address = m_channel[0][m_ncolors / 2];
-    }
-    else {
-      color = get_pixel_fast<IndexedTraits>(src, x, y);
-      color = pal->getEntry(color);
-
-      if (target & TARGET_RED_CHANNEL) {
-        std::sort(m_channel[0].begin(), m_channel[0].end());
-        r = m_channel[0][m_ncolors / 2];
-      }
-      else
-        r = rgba_getr(color);
-
-      if (target & TARGET_GREEN_CHANNEL) {
-        std::sort(m_channel[1].begin(), m_channel[1].end());
-        g = m_channel[1][m_ncolors / 2];
-      }
-      else
-        g = rgba_getg(pal->getEntry(color));
-
-      if (target & TARGET_BLUE_CHANNEL) {
-        std::sort(m_channel[2].begin(), m_channel[2].end());
-        b = m_channel[2][m_ncolors / 2];
-      }
-      else
-        b = rgba_getb(color);
-
-      if (target & TARGET_ALPHA_CHANNEL) {
-        std::sort(m_channel[3].begin(), m_channel[3].end());
-        a = m_channel[3][m_ncolors / 2];
-      }
-      else
-        a = rgba_geta(color);
-
-      *dst_address = rgbmap->mapColor(r, g, b, a);
-    }
+  const Target target = filterMgr->getTarget();
+
+  if (target & TARGET_INDEX_CHANNEL) {
+    applyMedian<IndexedTraits>(
+      filterMgr,
+      1,
+      1,
+      [](const color_t index, uint8_t* ch) { ch[0] = index; },
+      [](const color_t, const int* m) -> uint8_t { return m[0]; });
+    return;
   }
-  FILTER_LOOP_THROUGH_ROW_END()
+
+  const int mask = ((target & TARGET_RED_CHANNEL) ? 1 : 0) |
+                   ((target & TARGET_GREEN_CHANNEL) ? 2 : 0) |
+                   ((target & TARGET_BLUE_CHANNEL) ? 4 : 0) |
+                   ((target & TARGET_ALPHA_CHANNEL) ? 8 : 0);
+
+  applyMedian<IndexedTraits>(
+    filterMgr,
+    4,
+    mask,
+    [pal](const color_t index, uint8_t* ch) {
+      const color_t color = pal->getEntry(index);
+      ch[0] = rgba_getr(color);
+      ch[1] = rgba_getg(color);
+      ch[2] = rgba_getb(color);
+      ch[3] = rgba_geta(color);
+    },
+    [pal, rgbmap, mask](const color_t index, const int* m) -> uint8_t {
+      const color_t color = pal->getEntry(index);
+      return rgbmap->mapColor((mask & 1) ? m[0] : rgba_getr(color),
+                              (mask & 2) ? m[1] : rgba_getg(color),
+                              (mask & 4) ? m[2] : rgba_getb(color),
+                              (mask & 8) ? m[3] : rgba_geta(color));
+    });
 }
 
 } // namespace filters
@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2016  David Capello
 //
 // This program is distributed under the terms of
@@ -12,13 +13,14 @@
 #include "filters/filter.h"
 #include "filters/tiled_mode.h"
 
-#include <vector>
+#include <memory>
 
 namespace filters {
 
 class MedianFilter : public Filter {
 public:
   MedianFilter();
+  ~MedianFilter();
 
   void setTiledMode(TiledMode tiled);
   void setSize(int width, int height);
@@ -34,11 +36,36 @@ public:
   void applyToIndexed(FilterManager* filterMgr);
 
 private:
+  struct Histograms;
+
+  template<typename Traits, typename GetChannels, typename MakePixel>
+  void applyMedian(FilterManager* filterMgr,
+                   int nchannels,
+                   int channelsMask,
+                   GetChannels getChannels,
+                   MakePixel makePixel);
+
+  template<typename Traits, typename GetChannels, typename MakePixel>
+  void applySmallMedian(FilterManager* filterMgr,
+                        int nchannels,
+                        int channelsMask,
+                        GetChannels getChannels,
+                        MakePixel makePixel);
+
+  template<typename Traits, typename GetChannels, typename MakePixel>
+  void applyHistogramMedian(FilterManager* filterMgr,
+                            int nchannels,
+                            int channelsMask,
+                            GetChannels getChannels,
+                            MakePixel makePixel);
+
   TiledMode m_tiledMode;
   int m_width;
   int m_height;
-  int m_ncolors;
-  std::vector<std::vector<uint8_t>> m_channel;
+
+  // Histograms of the columns of the last processed row (they are
+  // updated incrementally from one row to the next one).
+  std::unique_ptr<Histograms> m_hist;
 };
 
 } // namespace filters
@@ -0,0 +1,299 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_impl.h"
+#include "doc/image_ref.h"
+#include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/rgbmap_rgb5a3.h"
+#include "filters/median_filter.h"
+#include "filters/neighboring_pixels.h"
+#include "filters/test_filter_manager.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace doc;
+using namespace filters;
+
+namespace {
+
+const TiledMode kTiledModes[] = { TiledMode::NONE,
+                                  TiledMode::X_AXIS,
+                                  TiledMode::Y_AXIS,
+                                  TiledMode::BOTH };
+
+const gfx::Size kFilterSizes[] = {
+  { 1, 1 }, { 2, 1 }, { 1, 3 }, { 3, 3 }, { 2, 4 }, { 4, 3 },
+  { 5, 5 }, { 7, 5 }, { 3, 9 }, { 9, 9 }, { 17, 3 }
+};
+
+// Few different values to test repeated values in the histograms
+int random_channel(std::mt19937& rng)
+{
+  static const int values[] = { 0, 1, 15, 16, 17, 127, 128, 200, 254, 255 };
+  return values[rng() % std::size(values)];
+}
+
+ImageRef create_random_image(const PixelFormat format, const int w, const int h, std::mt19937& rng)
+{
+  ImageRef image(Image::create(format, w, h));
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      color_t c = 0;
+      switch (format) {
+        case IMAGE_RGB:
+          c = rgba(random_channel(rng),
+                   random_channel(rng),
+                   random_channel(rng),
+                   random_channel(rng));
+          break;
+        case IMAGE_GRAYSCALE: c = graya(random_channel(rng), random_channel(rng)); break;
+        case IMAGE_INDEXED:   c = rng() % 16; break;
+        default:              break;
+      }
+      put_pixel(image.get(), x, y, c);
+    }
+  }
+  return image;
+}
+
+ImageRef create_random_mask(const int w, const int h, std::mt19937& rng)
+{
+  ImageRef mask(Image::create(IMAGE_BITMAP, w, h));
+  for (int y = 0; y < h; ++y)
+    for (int x = 0; x < w; ++x)
+      put_pixel(mask.get(), x, y, (rng() % 3) != 0);
+  return mask;
+}
+
+// Median of the channels of each pixel in the filter area, sorting all
+// the values (the original implementation of the MedianFilter).
+template<typename Traits, typename GetChannel>
+std::vector<int> reference_medians(const Image* src,
+                                   const int x,
+                                   const int y,
+                                   const gfx::Size& size,
+                                   const TiledMode tiledMode,
+                                   const int nchannels,
+                                   GetChannel getChannel)
+{
+  std::vector<std::vector<int>> values(nchannels);
+  auto delegate = [&](const typename Traits::pixel_t pixel) {
+    for (int c = 0; c < nchannels; ++c)
+      values[c].push_back(getChannel(pixel, c));
+  };
+  get_neighboring_pixels<Traits>(src,
+                                 x,
+                                 y,
+                                 size.w,
+                                 size.h,
+                                 size.w / 2,
+                                 size.h / 2,
+                                 tiledMode,
+                                 delegate);
+
+  std::vector<int> medians(nchannels);
+  for (int c = 0; c < nchannels; ++c) {
+    std::sort(values[c].begin(), values[c].end());
+    medians[c] = values[c][values[c].size() / 2];
+  }
+  return medians;
+}
+
+int rgba_channel(const color_t c, const int i)
+{
+  switch (i) {
+    case 0: return rgba_getr(c);
+    case 1: return rgba_getg(c);
+    case 2: return rgba_getb(c);
+    case 3: return rgba_geta(c);
+  }
+  return 0;
+}
+
+color_t reference_pixel(const Image* src,
+                        const int x,
+                        const int y,
+                        const gfx::Size& size,
+                        const TiledMode tiledMode,
+                        const Target target,
+                        const Palette* palette,
+                        const RgbMap* rgbmap)
+{
+  const color_t c = get_pixel(src, x, y);
+
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB: {
+      const auto m = reference_medians<RgbTraits>(src, x, y, size, tiledMode, 4, rgba_channel);
+      return rgba((target & TARGET_RED_CHANNEL) ? m[0] : rgba_getr(c),
+                  (target & TARGET_GREEN_CHANNEL) ? m[1] : rgba_getg(c),
+                  (target & TARGET_BLUE_CHANNEL) ? m[2] : rgba_getb(c),
+                  (target & TARGET_ALPHA_CHANNEL) ? m[3] : rgba_geta(c));
+    }
+
+    case IMAGE_GRAYSCALE: {
+      const auto m =
+        reference_medians<GrayscaleTraits>(src,
+                                           x,
+                                           y,
+                                           size,
+                                           tiledMode,
+                                           2,
+                                           [](const color_t c, const int i) {
+                                             return (i == 0 ? graya_getv(c) : graya_geta(c));
+                                           });
+      return graya((target & TARGET_GRAY_CHANNEL) ? m[0] : graya_getv(c),
+                   (target & TARGET_ALPHA_CHANNEL) ? m[1] : graya_geta(c));
+    }
+
+    case IMAGE_INDEXED: {
+      if (target & TARGET_INDEX_CHANNEL) {
+        return reference_medians<IndexedTraits>(src,
+                                                x,
+                                                y,
+                                                size,
+                                                tiledMode,
+                                                1,
+                                                [](const color_t c, int) { return int(c); })[0];
+      }
+
+      const auto m = reference_medians<IndexedTraits>(
+        src,
+        x,
+        y,
+        size,
+        tiledMode,
+        4,
+        [palette](const color_t c, const int i) { return rgba_channel(palette->getEntry(c), i); });
+      const color_t rgb = palette->getEntry(c);
+      return rgbmap->mapColor((target & TARGET_RED_CHANNEL) ? m[0] : rgba_getr(rgb),
+                              (target & TARGET_GREEN_CHANNEL) ? m[1] : rgba_getg(rgb),
+                              (target & TARGET_BLUE_CHANNEL) ? m[2] : rgba_getb(rgb),
+                              (target & TARGET_ALPHA_CHANNEL) ? m[3] : rgba_geta(rgb));
+    }
+
+    default: break;
+  }
+  return c;
+}
+
+void test_median_filter(const Image* src,
+                        const Target target,
+                        const gfx::Rect& bounds,
+                        const Image* mask,
+                        const Palette* palette = nullptr,
+                        const RgbMap* rgbmap = nullptr)
+{
+  for (const TiledMode tiledMode : kTiledModes) {
+    for (const gfx::Size& size : kFilterSizes) {
+      MedianFilter filter;
+      filter.setTiledMode(tiledMode);
+      filter.setSize(size.w, size.h);
+
+      ImageRef dst(Image::createCopy(src));
+      ImageRef expected(Image::createCopy(src));
+      TestFilterIndexedData indexedData(palette, rgbmap);
+      TestFilterManager filterMgr(src, dst.get(), target, bounds, mask, &indexedData);
+      filterMgr.apply(&filter);
+
+      for (int y = bounds.y; y < bounds.y2(); ++y) {
+        for (int x = bounds.x; x < bounds.x2(); ++x) {
+          if (!mask || get_pixel(mask, x, y))
+            put_pixel(
+              expected.get(),
+              x,
+              y,
+              reference_pixel(src, x, y, size, tiledMode, target, palette, rgbmap));
+        }
+      }
+
+      EXPECT_EQ(0, count_diff_between_images(expected.get(), dst.get()))
+        << "Target " << target << " Tiled mode " << int(tiledMode) << " Size " << size.w << "x"
+        << size.h << " Bounds " << bounds.x << "," << bounds.y << "," << bounds.w << ","
+        << bounds.h;
+    }
+  }
+}
+
+} // anonymous namespace
+
+TEST(MedianFilter, Rgb)
+{
+  std::mt19937 rng(1);
+  const ImageRef src = create_random_image(IMAGE_RGB, 23, 19, rng);
+  const gfx::Rect bounds = src->bounds();
+
+  for (Target target = 1; target <= TARGET_ALPHA_CHANNEL * 2 - 1; ++target)
+    test_median_filter(src.get(), target, bounds, nullptr);
+}
+
+TEST(MedianFilter, Grayscale)
+{
+  std::mt19937 rng(2);
+  const ImageRef src = create_random_image(IMAGE_GRAYSCALE, 21, 17, rng);
+  const gfx::Rect bounds = src->bounds();
+
+  for (Target target : { TARGET_GRAY_CHANNEL,
+                         TARGET_ALPHA_CHANNEL,
+                         TARGET_GRAY_CHANNEL | TARGET_ALPHA_CHANNEL })
+    test_median_filter(src.get(), target, bounds, nullptr);
+}
+
+TEST(MedianFilter, Indexed)
+{
+  std::mt19937 rng(3);
+  const ImageRef src = create_random_image(IMAGE_INDEXED, 19, 23, rng);
+  const gfx::Rect bounds = src->bounds();
+
+  Palette palette(0, 16);
+  for (int i = 0; i < 16; ++i)
+    palette.setEntry(i, rgba(random_channel(rng), random_channel(rng), random_channel(rng), 255));
+  RgbMapRGB5A3 rgbmap;
+  rgbmap.regenerateMap(&palette, -1);
+
+  for (Target target : { TARGET_INDEX_CHANNEL,
+                         TARGET_RED_CHANNEL | TARGET_GREEN_CHANNEL | TARGET_BLUE_CHANNEL,
+                         TARGET_GREEN_CHANNEL | TARGET_ALPHA_CHANNEL })
+    test_median_filter(src.get(), target, bounds, nullptr, &palette, &rgbmap);
+}
+
+TEST(MedianFilter, MaskAndBounds)
+{
+  std::mt19937 rng(4);
+  const ImageRef src = create_random_image(IMAGE_RGB, 29, 25, rng);
+  const ImageRef mask = create_random_mask(29, 25, rng);
+
+  for (const gfx::Rect& bounds :
+       { src->bounds(), gfx::Rect(0, 0, 1, 1), gfx::Rect(3, 5, 11, 7), gfx::Rect(28, 0, 1, 25) }) {
+    test_median_filter(src.get(), TARGET_ALL_CHANNELS, bounds, mask.get());
+    test_median_filter(src.get(), TARGET_RED_CHANNEL | TARGET_ALPHA_CHANNEL, bounds, nullptr);
+  }
+}
+
+TEST(MedianFilter, SmallImages)
+{
+  // Filters bigger than the image
+  std::mt19937 rng(5);
+  for (const gfx::Size& size : { gfx::Size(1, 1), gfx::Size(1, 7), gfx::Size(2, 3) }) {
+    const ImageRef src = create_random_image(IMAGE_RGB, size.w, size.h, rng);
+    test_median_filter(src.get(), TARGET_ALL_CHANNELS, src->bounds(), nullptr);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
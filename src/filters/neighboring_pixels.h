@@ -1,4 +1,5 @@
 // Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
 // Copyright (C) 2001-2015  David Capello
 //
 // This program is distributed under the terms of
@@ -12,11 +13,25 @@
 #include "doc/image_traits.h"
 #include "filters/tiled_mode.h"
 
+#include <algorithm>
 #include <vector>
 
 namespace filters {
 using namespace doc;
 
+// Returns the coordinate of the pixel used for the position "v" in
+// an axis of the given "size", repeating the image in tiled mode
+// ("tiled" = true), or repeating the pixels of the edge in other
+// case (the same as get_neighboring_pixels() does).
+inline int get_neighboring_coord(int v, const int size, const bool tiled)
+{
+  if (tiled) {
+    v %= size;
+    return (v < 0 ? v + size : v);
+  }
+  return std::clamp(v, 0, size - 1);
+}
+
 // Calls the specified "delegate" for all neighboring pixels in a 2D
 // (width*height) matrix located in (x,y) where its center is the
 // (centerX,centerY) element of the matrix.
@@ -76,12 +91,12 @@ inline void get_neighboring_pixels(const doc::Image* sourceImage,
       delegate(*srcAddress);
 
       // Update X position to get pixel.
-      if (getx < sourceImage->width() - 1) {
+      if (addx > 0) {
+        --addx;
+      }
+      else if (getx < sourceImage->width() - 1) {
         ++getx;
-        if (addx == 0)
-          ++srcAddress;
-        else
-          --addx;
+        ++srcAddress;
       }
       else if (int(tiledMode) & int(TiledMode::X_AXIS)) {
         getx = 0;
@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -10,8 +10,12 @@
 
 #include "filters/outline_filter.h"
 
+#include "doc/algorithm/morphology.h"
 #include "doc/image.h"
+#include "doc/image_impl.h"
 #include "doc/palette.h"
+#include "doc/primitives.h"
+#include "doc/primitives_fast.h"
 #include "doc/rgbmap.h"
 #include "filters/filter_indexed_data.h"
 #include "filters/filter_manager.h"
@@ -83,6 +87,52 @@ struct GetPixelsDelegateIndexed : public GetPixelsDelegate {
   }
 };
 
+// Maximum number of source images with a cached thick mask
+const int kMaxThickMasks = 32;
+
+// Creates a bitmap with the pixels of the source image where the
+// outline must be painted (with the given thickness). Pixels outside
+// the image are the pixels of the edges, or the pixels of the other
+// side in tiled mode (as in get_neighboring_pixels()).
+template<typename Traits, typename IsOpaque>
+ImageRef create_thick_mask(const Image* src,
+                           const OutlineFilter::Place place,
+                           const OutlineFilter::Matrix matrix,
+                           const int thickness,
+                           const TiledMode tiledMode,
+                           IsOpaque isOpaque)
+{
+  const int w = src->width();
+  const int h = src->height();
+  const bool tiledX = (int(tiledMode) & int(TiledMode::X_AXIS));
+  const bool tiledY = (int(tiledMode) & int(TiledMode::Y_AXIS));
+
+  ImageRef opaque(Image::create(IMAGE_BITMAP, w + 2 * thickness, h + 2 * thickness));
+  for (int y = 0; y < opaque->height(); ++y) {
+    const int v = get_neighboring_coord(y - thickness, h, tiledY);
+    for (int x = 0; x < opaque->width(); ++x) {
+      const int u = get_neighboring_coord(x - thickness, w, tiledX);
+      put_pixel_fast<BitmapTraits>(opaque.get(),
+                                   x,
+                                   y,
+                                   isOpaque(get_pixel_fast<Traits>(src, u, v)) ? 1 : 0);
+    }
+  }
+
+  ImageRef mask(Image::create(IMAGE_BITMAP, w, h));
+  clear_image(mask.get(), 0);
+  algorithm::morphology(place == OutlineFilter::Place::Outside ?
+                          algorithm::MorphologyOp::Dilate :
+                          algorithm::MorphologyOp::InnerBorder,
+                        opaque.get(),
+                        mask.get(),
+                        gfx::Point(-thickness, -thickness),
+                        thickness,
+                        matrix == OutlineFilter::Matrix::Circle ? kCircleBrushType :
+                                                                  kSquareBrushType);
+  return mask;
+}
+
 } // namespace
 
 OutlineFilter::OutlineFilter()
@@ -91,7 +141,107 @@ OutlineFilter::OutlineFilter()
   , m_tiledMode(TiledMode::NONE)
   , m_color(0)
   , m_bgColor(0)
+  , m_thickness(1)
+{
+}
+
+bool OutlineFilter::useThickMask() const
+{
+  return (m_thickness > 1 && (m_matrix == Matrix::Circle || m_matrix == Matrix::Square));
+}
+
+// Returns the pixels of the source image of the given FilterManager
+// where the outline must be painted. It's used instead of the 3x3
+// matrix when useThickMask() is true.
+ImageRef OutlineFilter::getThickMask(FilterManager* filterMgr)
+{
+  const Image* src = filterMgr->getSourceImage();
+  const SourceImageKey source = filterMgr->getSourceImageKey();
+  const Palette* pal = nullptr;
+  if (src->pixelFormat() == IMAGE_INDEXED)
+    pal = filterMgr->getIndexedData()->getPalette();
+  const int paletteModifications = (pal ? pal->getModifications() : 0);
+
+  std::shared_ptr<ThickMask> thickMask;
+  {
+    const std::lock_guard lock(m_thickMasksMutex);
+
+    auto it = std::find_if(m_thickMasks.begin(), m_thickMasks.end(), [&](const auto& m) {
+      return m->source == source && m->paletteModifications == paletteModifications &&
+             m->place == m_place && m->matrix == m_matrix && m->thickness == m_thickness &&
+             m->tiledMode == m_tiledMode && m->bgColor == m_bgColor;
+    });
+    if (it != m_thickMasks.end()) {
+      thickMask = *it;
+    }
+    else {
+      // Discard masks of old versions of the same image
+      m_thickMasks.erase(std::remove_if(m_thickMasks.begin(),
+                                        m_thickMasks.end(),
+                                        [&source](const auto& m) {
+                                          return m->source.imageId == source.imageId &&
+                                                 m->source.imageVersion != source.imageVersion;
+                                        }),
+                         m_thickMasks.end());
+      if (int(m_thickMasks.size()) >= kMaxThickMasks)
+        m_thickMasks.erase(m_thickMasks.begin());
+
+      thickMask = std::make_shared<ThickMask>();
+      thickMask->source = source;
+      thickMask->paletteModifications = paletteModifications;
+      thickMask->place = m_place;
+      thickMask->matrix = m_matrix;
+      thickMask->thickness = m_thickness;
+      thickMask->tiledMode = m_tiledMode;
+      thickMask->bgColor = m_bgColor;
+      m_thickMasks.push_back(thickMask);
+    }
+  }
+
+  // The mask is created by the first row that needs it, other rows of
+  // the same image wait it, but rows of other images don't.
+  const std::lock_guard lock(thickMask->mutex);
+  if (!thickMask->mask)
+    thickMask->mask = createThickMask(src, pal);
+  return thickMask->mask;
+}
+
+ImageRef OutlineFilter::createThickMask(const Image* src, const Palette* pal) const
 {
+  // The same rules as the GetPixelsDelegate* to know if a pixel is
+  // transparent.
+  const color_t bgColor = m_bgColor;
+  switch (src->pixelFormat()) {
+    case IMAGE_RGB:
+      return create_thick_mask<RgbTraits>(src,
+                                          m_place,
+                                          m_matrix,
+                                          m_thickness,
+                                          m_tiledMode,
+                                          [bgColor](RgbTraits::pixel_t c) {
+                                            return !(rgba_geta(c) == 0 || c == bgColor);
+                                          });
+    case IMAGE_GRAYSCALE:
+      return create_thick_mask<GrayscaleTraits>(src,
+                                                m_place,
+                                                m_matrix,
+                                                m_thickness,
+                                                m_tiledMode,
+                                                [bgColor](GrayscaleTraits::pixel_t c) {
+                                                  return !(graya_geta(c) == 0 || c == bgColor);
+                                                });
+    case IMAGE_INDEXED:
+      return create_thick_mask<IndexedTraits>(
+        src,
+        m_place,
+        m_matrix,
+        m_thickness,
+        m_tiledMode,
+        [bgColor, pal](IndexedTraits::pixel_t c) {
+          return !(rgba_geta(pal->getEntry(c)) == 0 || c == bgColor);
+        });
+    default: return nullptr;
+  }
 }
 
 const char* OutlineFilter::getName()
@@ -106,16 +256,23 @@ void OutlineFilter::applyToRgba(FilterManager* filterMgr)
   color_t c;
   bool isTransparent;
 
+  const ImageRef thickMask = (useThickMask() ? getThickMask(filterMgr) : nullptr);
+
   GetPixelsDelegateRgba delegate;
   delegate.init(m_bgColor, m_matrix);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint32_t)
   {
-    delegate.reset();
-    get_neighboring_pixels<RgbTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (thickMask) {
+      n = get_pixel_fast<BitmapTraits>(thickMask.get(), x, y);
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<RgbTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
     isTransparent = (rgba_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) && ((m_place == Place::Outside && isTransparent) ||
@@ -139,16 +296,23 @@ void OutlineFilter::applyToGrayscale(FilterManager* filterMgr)
   color_t c;
   bool isTransparent;
 
+  const ImageRef thickMask = (useThickMask() ? getThickMask(filterMgr) : nullptr);
+
   GetPixelsDelegateGrayscale delegate;
   delegate.init(m_bgColor, m_matrix);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint16_t)
   {
-    delegate.reset();
-    get_neighboring_pixels<GrayscaleTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (thickMask) {
+      n = get_pixel_fast<BitmapTraits>(thickMask.get(), x, y);
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<GrayscaleTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
     isTransparent = (graya_geta(c) == 0 || c == m_bgColor);
 
     if ((n >= 1) && ((m_place == Place::Outside && isTransparent) ||
@@ -172,16 +336,23 @@ void OutlineFilter::applyToIndexed(FilterManager* filterMgr)
   color_t c;
   bool isTransparent;
 
+  const ImageRef thickMask = (useThickMask() ? getThickMask(filterMgr) : nullptr);
+
   GetPixelsDelegateIndexed delegate(pal);
   delegate.init(m_bgColor, m_matrix);
 
   FILTER_LOOP_THROUGH_ROW_BEGIN(uint8_t)
   {
-    delegate.reset();
-    get_neighboring_pixels<IndexedTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+    if (thickMask) {
+      n = get_pixel_fast<BitmapTraits>(thickMask.get(), x, y);
+    }
+    else {
+      delegate.reset();
+      get_neighboring_pixels<IndexedTraits>(src, x, y, 3, 3, 1, 1, m_tiledMode, delegate);
+      n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
+    }
 
     c = *src_address;
-    n = (m_place == Place::Outside ? delegate.opaque : delegate.transparent);
 
     if (target & TARGET_INDEX_CHANNEL) {
       isTransparent = (c == m_bgColor);
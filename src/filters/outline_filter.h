@@ -1,5 +1,5 @@
 // Aseprite
-// Copyright (C) 2019  Igara Studio S.A.
+// Copyright (C) 2019-2025  Igara Studio S.A.
 //
 // This program is distributed under the terms of
 // the End-User License Agreement for Aseprite.
@@ -9,9 +9,19 @@
 #pragma once
 
 #include "doc/color.h"
+#include "doc/image_ref.h"
 #include "filters/filter.h"
+#include "filters/filter_manager.h"
 #include "filters/tiled_mode.h"
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace doc {
+class Palette;
+}
+
 namespace filters {
 
 class OutlineFilter : public Filter {
@@ -33,24 +43,55 @@ public:
   void color(const doc::color_t color) { m_color = color; }
   void bgColor(const doc::color_t color) { m_bgColor = color; }
 
+  // Thickness of the outline in pixels. A thickness bigger than 1 is
+  // only used with the Circle and Square matrices.
+  void thickness(const int thickness) { m_thickness = thickness; }
+
   Place place() const { return m_place; }
   Matrix matrix() const { return m_matrix; }
   TiledMode tiledMode() const { return m_tiledMode; }
   doc::color_t color() const { return m_color; }
   doc::color_t bgColor() const { return m_bgColor; }
+  int thickness() const { return m_thickness; }
 
   // Filter implementation
   const char* getName();
   void applyToRgba(FilterManager* filterMgr);
   void applyToGrayscale(FilterManager* filterMgr);
   void applyToIndexed(FilterManager* filterMgr);
+  bool isThreadSafe() const { return true; }
 
 private:
+  // Outline pixels of a whole source image for thick outlines
+  struct ThickMask {
+    SourceImageKey source;
+    int paletteModifications;
+    Place place;
+    Matrix matrix;
+    int thickness;
+    TiledMode tiledMode;
+    doc::color_t bgColor;
+
+    // Locked while the mask is created
+    std::mutex mutex;
+    doc::ImageRef mask;
+  };
+
+  bool useThickMask() const;
+  doc::ImageRef getThickMask(FilterManager* filterMgr);
+  doc::ImageRef createThickMask(const doc::Image* src, const doc::Palette* pal) const;
+
   Place m_place;
   Matrix m_matrix;
   TiledMode m_tiledMode;
   doc::color_t m_color;
   doc::color_t m_bgColor;
+  int m_thickness;
+
+  // Thick masks are calculated by the first row that needs them (rows
+  // can be processed from several threads).
+  std::mutex m_thickMasksMutex;
+  std::vector<std::shared_ptr<ThickMask>> m_thickMasks;
 };
 
 } // namespace filters
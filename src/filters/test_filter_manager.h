@@ -0,0 +1,108 @@
+// Aseprite
+// Copyright (C) 2025  Igara Studio S.A.
+//
+// This program is distributed under the terms of
+// the End-User License Agreement for Aseprite.
+
+#ifndef FILTERS_TEST_FILTER_MANAGER_H_INCLUDED
+#define FILTERS_TEST_FILTER_MANAGER_H_INCLUDED
+#pragma once
+
+#include "base/task.h"
+#include "doc/image.h"
+#include "doc/palette.h"
+#include "doc/palette_picks.h"
+#include "doc/rgbmap.h"
+#include "filters/filter.h"
+#include "filters/filter_indexed_data.h"
+#include "filters/filter_manager.h"
+#include "gfx/rect.h"
+
+namespace filters {
+
+class TestFilterIndexedData : public FilterIndexedData {
+public:
+  TestFilterIndexedData(const doc::Palette* palette, const doc::RgbMap* rgbmap)
+    : m_palette(palette)
+    , m_rgbmap(rgbmap)
+  {
+  }
+
+  const doc::Palette* getPalette() const override { return m_palette; }
+  const doc::RgbMap* getRgbMap() const override { return m_rgbmap; }
+  doc::Palette* getNewPalette() override { return nullptr; }
+  doc::PalettePicks getPalettePicks() override { return doc::PalettePicks(); }
+
+private:
+  const doc::Palette* m_palette;
+  const doc::RgbMap* m_rgbmap;
+};
+
+// Applies a filter to the "bounds" of the "src" image row by row
+// (like FilterManagerImpl does), saving the result in "dst". The
+// optional "mask" is a bitmap of the same size of "src" with the
+// pixels that must be modified.
+class TestFilterManager : public FilterManager {
+public:
+  TestFilterManager(const doc::Image* src,
+                    doc::Image* dst,
+                    const Target target,
+                    const gfx::Rect& bounds,
+                    const doc::Image* mask = nullptr,
+                    FilterIndexedData* indexedData = nullptr)
+    : m_src(src)
+    , m_dst(dst)
+    , m_target(target)
+    , m_bounds(bounds)
+    , m_mask(mask)
+    , m_indexedData(indexedData)
+  {
+  }
+
+  void apply(Filter* filter)
+  {
+    for (m_row = 0; m_row < m_bounds.h; ++m_row) {
+      m_maskX = m_bounds.x;
+      switch (m_src->pixelFormat()) {
+        case doc::IMAGE_RGB:       filter->applyToRgba(this); break;
+        case doc::IMAGE_GRAYSCALE: filter->applyToGrayscale(this); break;
+        case doc::IMAGE_INDEXED:   filter->applyToIndexed(this); break;
+        default:                   break;
+      }
+    }
+  }
+
+  // FilterManager implementation
+  doc::PixelFormat pixelFormat() const override { return m_src->pixelFormat(); }
+  const void* getSourceAddress() override { return m_src->getPixelAddress(m_bounds.x, y()); }
+  void* getDestinationAddress() override { return m_dst->getPixelAddress(m_bounds.x, y()); }
+  int getWidth() override { return m_bounds.w; }
+  Target getTarget() override { return m_target; }
+  FilterIndexedData* getIndexedData() override { return m_indexedData; }
+  bool skipPixel() override { return (m_mask && !m_mask->getPixel(m_maskX++, y())); }
+  const doc::Image* getSourceImage() override { return m_src; }
+  SourceImageKey getSourceImageKey() override
+  {
+    return { m_src->id(), m_src->version(), m_src->bounds() };
+  }
+  int x() const override { return m_bounds.x; }
+  int y() const override { return m_bounds.y + m_row; }
+  bool isFirstRow() const override { return m_row == 0; }
+  bool isMaskActive() const override { return m_mask != nullptr; }
+  base::task_token& taskToken() const override { return m_token; }
+
+private:
+  const doc::Image* m_src;
+  doc::Image* m_dst;
+  Target m_target;
+  gfx::Rect m_bounds;
+  const doc::Image* m_mask;
+  FilterIndexedData* m_indexedData;
+  int m_row = 0;
+  int m_maskX = 0;
+  mutable base::task_token m_token;
+};
+
+} // namespace filters
+
+#endif
@@ -0,0 +1,64 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "render/layer_stack_cache.h"
+
+#include "doc/image.h"
+
+#include <algorithm>
+
+namespace render {
+
+LayerStackCache::LayerStackCache(const int maxPlanePixels, const int maxPlanes)
+  : m_maxPlanePixels(maxPlanePixels)
+  , m_maxPlanes(std::max(1, maxPlanes))
+{
+}
+
+LayerStackCache::Plane& LayerStackCache::getPlane(const Signature& signature,
+                                                  const doc::ImageSpec& spec)
+{
+  auto it = std::find_if(m_planes.begin(), m_planes.end(), [&signature](const auto& plane) {
+    return plane->signature == signature;
+  });
+  if (it != m_planes.end()) {
+    // Move the plane to the front (most recently used)
+    std::rotate(m_planes.begin(), it, it + 1);
+    return *m_planes.front();
+  }
+
+  // Reuse the least recently used plane (and its image if it has the
+  // same spec) when we reach the limit.
+  std::unique_ptr<Plane> plane;
+  if (int(m_planes.size()) >= m_maxPlanes) {
+    plane = std::move(m_planes.back());
+    m_planes.pop_back();
+    plane->valid.clear();
+    if (plane->image && plane->image->spec() != spec)
+      plane->image.reset();
+  }
+  else {
+    plane = std::make_unique<Plane>();
+  }
+
+  plane->signature = signature;
+  if (!plane->image)
+    plane->image.reset(doc::Image::create(spec));
+
+  m_planes.insert(m_planes.begin(), std::move(plane));
+  return *m_planes.front();
+}
+
+void LayerStackCache::clear()
+{
+  m_planes.clear();
+}
+
+} // namespace render
@@ -0,0 +1,72 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_LAYER_STACK_CACHE_H_INCLUDED
+#define RENDER_LAYER_STACK_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/image_spec.h"
+#include "gfx/region.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace render {
+
+// Keeps the layers below the active layer of a sprite frame already
+// composited (see Render::setLayerStackCache()), so when only the
+// active layer changes (e.g. while the user paints with a brush) we
+// just blend that layer (and the layers above it) over this plane
+// instead of compositing the whole layer stack again.
+//
+// Each plane is identified by a signature with all the objects and
+// properties used to render it (sprite, frame, projection, layers,
+// cels, image versions, etc.), so a plane is discarded when any of
+// them changes. Planes are filled lazily: only the areas that were
+// already requested are rendered and marked as valid.
+class LayerStackCache {
+public:
+  using Signature = std::vector<uint64_t>;
+
+  struct Plane {
+    Signature signature;
+    doc::ImageRef image;
+    gfx::Region valid;
+  };
+
+  // Sprites that are bigger than this number of pixels (with the
+  // projection applied) are rendered without cache.
+  static constexpr int kDefaultMaxPlanePixels = 2048 * 2048;
+
+  // One plane for the current sprite/zoom and other one to switch
+  // back and forth (e.g. between two frames).
+  static constexpr int kDefaultMaxPlanes = 2;
+
+  LayerStackCache(const int maxPlanePixels = kDefaultMaxPlanePixels,
+                  const int maxPlanes = kDefaultMaxPlanes);
+
+  int maxPlanePixels() const { return m_maxPlanePixels; }
+
+  // Returns the plane with the given signature. If it doesn't exist,
+  // a new plane (without valid areas) is created with the given
+  // spec, discarding the least recently used plane if needed.
+  Plane& getPlane(const Signature& signature, const doc::ImageSpec& spec);
+
+  // Discards all planes (e.g. to release memory).
+  void clear();
+
+private:
+  int m_maxPlanePixels;
+  int m_maxPlanes;
+  // Most recently used planes first
+  std::vector<std::unique_ptr<Plane>> m_planes;
+};
+
+} // namespace render
+
+#endif
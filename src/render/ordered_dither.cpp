@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2025  Igara Studio S.A.
 // Copyright (c) 2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,9 +13,12 @@
 
 #include "render/dithering.h"
 #include "render/dithering_matrix.h"
+#include "render/row_bands.h"
 
 #include <algorithm>
 #include <limits>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 namespace render {
@@ -44,7 +47,7 @@ doc::color_t OrderedDither::ditherRgbPixelToIndex(const DitheringMatrix& matrix,
                                                   const doc::color_t color,
                                                   const int x,
                                                   const int y,
-                                                  const doc::RgbMap* rgbmap,
+                                                  const RgbMapReader* rgbmap,
                                                   const doc::Palette* palette)
 {
   // Alpha=0, output transparent color
@@ -127,7 +130,7 @@ doc::color_t OrderedDither2::ditherRgbPixelToIndex(const DitheringMatrix& matrix
                                                    const doc::color_t color,
                                                    const int x,
                                                    const int y,
-                                                   const doc::RgbMap* rgbmap,
+                                                   const RgbMapReader* rgbmap,
                                                    const doc::Palette* palette)
 {
   // Alpha=0, output transparent color
@@ -230,29 +233,30 @@ void dither_rgb_image_to_indexed(DitheringAlgorithmBase& algorithm,
   algorithm.start(srcImage, dstImage, dithering.factor());
 
   if (algorithm.dimensions() == 1) {
-    const doc::LockImageBits<doc::RgbTraits> srcBits(srcImage);
-    doc::LockImageBits<doc::IndexedTraits> dstBits(dstImage);
-    auto srcIt = srcBits.begin();
-    auto dstIt = dstBits.begin();
-
-    for (int y = 0; y < h; ++y) {
-      for (int x = 0; x < w; ++x, ++srcIt, ++dstIt) {
-        ASSERT(srcIt != srcBits.end());
-        ASSERT(dstIt != dstBits.end());
-        *dstIt = algorithm.ditherRgbPixelToIndex(dithering.matrix(), *srcIt, x, y, rgbmap, palette);
-
-        if (delegate) {
-          if (!delegate->continueTask())
-            return;
+    // Each pixel depends only on its source color and position, so
+    // bands of rows are converted in parallel.
+    const DitheringMatrix matrix = dithering.matrix();
+    std::mutex rgbmapMutex;
+    const bool completed = for_each_row_band(w, h, delegate, [&](const int y1, const int y2) {
+      std::optional<SharedRgbMap> sharedRgbmap;
+      if (rgbmap)
+        sharedRgbmap.emplace(rgbmap, rgbmapMutex);
+      const RgbMapReader* bandRgbmap = (sharedRgbmap ? &*sharedRgbmap : nullptr);
+
+      for (int y = y1; y < y2; ++y) {
+        auto srcIt = doc::get_pixel_address_fast<doc::RgbTraits>(srcImage, 0, y);
+        auto dstIt = doc::get_pixel_address_fast<doc::IndexedTraits>(dstImage, 0, y);
+        for (int x = 0; x < w; ++x, ++srcIt, ++dstIt) {
+          *dstIt = algorithm.ditherRgbPixelToIndex(matrix, *srcIt, x, y, bandRgbmap, palette);
         }
       }
-
-      if (delegate) {
-        delegate->notifyTaskProgress(double(y + 1) / double(h));
-      }
-    }
+    });
+    if (!completed)
+      return;
   }
   else {
+    // 2D algorithms (error diffusion) are serial, each row uses a
+    // zig-zag scan and depends on the errors of the whole previous row.
     auto dstIt = doc::get_pixel_address_fast<doc::IndexedTraits>(dstImage, 0, 0);
     const bool zigZag = algorithm.zigZag();
 
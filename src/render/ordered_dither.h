@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019 Igara Studio S.A.
+// Copyright (c) 2019-2025 Igara Studio S.A.
 // Copyright (c) 2001-2017 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -21,6 +21,7 @@ namespace render {
 
 class Dithering;
 class DitheringMatrix;
+class RgbMapReader;
 
 class DitheringAlgorithmBase {
 public:
@@ -33,11 +34,14 @@ public:
 
   virtual void finish() {}
 
+  // Used by 1D algorithms. It's called from several threads at the
+  // same time by dither_rgb_image_to_indexed() (each one with its own
+  // RgbMapReader), so it must not modify the state of the algorithm.
   virtual doc::color_t ditherRgbPixelToIndex(const DitheringMatrix& matrix,
                                              const doc::color_t color,
                                              const int x,
                                              const int y,
-                                             const doc::RgbMap* rgbmap,
+                                             const RgbMapReader* rgbmap,
                                              const doc::Palette* palette)
   {
     return 0;
@@ -59,7 +63,7 @@ public:
                                      const doc::color_t color,
                                      const int x,
                                      const int y,
-                                     const doc::RgbMap* rgbmap,
+                                     const RgbMapReader* rgbmap,
                                      const doc::Palette* palette) override;
 
 private:
@@ -73,7 +77,7 @@ public:
                                      const doc::color_t color,
                                      const int x,
                                      const int y,
-                                     const doc::RgbMap* rgbmap,
+                                     const RgbMapReader* rgbmap,
                                      const doc::Palette* palette) override;
 
 private:
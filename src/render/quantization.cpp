@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2022  Igara Studio S.A.
+// Copyright (c) 2019-2025  Igara Studio S.A.
 // Copyright (c) 2001-2018  David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -22,12 +22,15 @@
 #include "render/error_diffusion.h"
 #include "render/ordered_dither.h"
 #include "render/render.h"
+#include "render/row_bands.h"
 #include "render/task_delegate.h"
 
 #include <algorithm>
 #include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <vector>
 
 namespace render {
@@ -205,29 +208,40 @@ Image* convert_pixel_format(const Image* image,
 
         // RGB -> Indexed
         case IMAGE_INDEXED: {
-          LockImageBits<IndexedTraits> dstBits(new_image, Image::WriteLock);
-          auto dst_it = dstBits.begin();
-#ifdef _DEBUG
-          auto dst_end = dstBits.end();
-#endif
-
-          for (; src_it != src_end; ++src_it, ++dst_it) {
-            ASSERT(dst_it != dst_end);
-            c = *src_it;
-
-            r = rgba_getr(c);
-            g = rgba_getg(c);
-            b = rgba_getb(c);
-            a = rgba_geta(c);
-
-            if (a == 0)
-              *dst_it = new_mask_color0;
-            else if (rgbmap)
-              *dst_it = rgbmap->mapColor(c);
-            else
-              *dst_it = palette->findBestfit(r, g, b, a, new_mask_color);
-          }
-          ASSERT(dst_it == dst_end);
+          // Rows are converted in parallel, each band of rows uses
+          // its own SharedRgbMap to access the rgbmap.
+          std::mutex rgbmapMutex;
+          for_each_row_band(
+            image->width(),
+            image->height(),
+            delegate,
+            [image, new_image, rgbmap, palette, new_mask_color, new_mask_color0, &rgbmapMutex](
+              const int y1,
+              const int y2) {
+              std::optional<SharedRgbMap> sharedRgbmap;
+              if (rgbmap)
+                sharedRgbmap.emplace(rgbmap, rgbmapMutex);
+
+              const int w = image->width();
+              for (int y = y1; y < y2; ++y) {
+                auto src = get_pixel_address_fast<RgbTraits>(image, 0, y);
+                auto dst = get_pixel_address_fast<IndexedTraits>(new_image, 0, y);
+                for (int x = 0; x < w; ++x, ++src, ++dst) {
+                  const color_t c = *src;
+                  const int a = rgba_geta(c);
+                  if (a == 0)
+                    *dst = new_mask_color0;
+                  else if (sharedRgbmap)
+                    *dst = sharedRgbmap->mapColor(c);
+                  else
+                    *dst = palette->findBestfit(rgba_getr(c),
+                                                rgba_getg(c),
+                                                rgba_getb(c),
+                                                a,
+                                                new_mask_color);
+                }
+              }
+            });
           break;
         }
       }
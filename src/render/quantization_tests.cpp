@@ -0,0 +1,157 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include <gtest/gtest.h>
+
+#include "doc/image_impl.h"
+#include "doc/image_ref.h"
+#include "doc/octree_map.h"
+#include "doc/palette.h"
+#include "doc/rgbmap_rgb5a3.h"
+#include "render/dithering.h"
+#include "render/dithering_matrix.h"
+#include "render/ordered_dither.h"
+#include "render/quantization.h"
+#include "render/row_bands.h"
+
+#include <cstdlib>
+#include <memory>
+
+using namespace doc;
+using namespace render;
+
+namespace {
+
+ImageRef make_random_rgb_image(int w, int h)
+{
+  ImageRef image(Image::create(IMAGE_RGB, w, h));
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      image->putPixel(x,
+                      y,
+                      rgba(std::rand() % 256,
+                           std::rand() % 256,
+                           std::rand() % 256,
+                           (std::rand() % 8) == 0 ? 0 : 255));
+    }
+  }
+  return image;
+}
+
+Palette make_random_palette(int size)
+{
+  Palette palette(frame_t(0), size);
+  palette.setEntry(0, rgba(0, 0, 0, 0));
+  for (int i = 1; i < size; ++i)
+    palette.setEntry(i, rgba(std::rand() % 256, std::rand() % 256, std::rand() % 256, 255));
+  return palette;
+}
+
+// Converts the image pixel by pixel (in just one thread)
+ImageRef slow_convert_to_indexed(const Image* image,
+                                 const Dithering& dithering,
+                                 const RgbMap* rgbmap,
+                                 const Palette* palette,
+                                 const int maskIndex)
+{
+  ImageRef dst(Image::create(IMAGE_INDEXED, image->width(), image->height()));
+  std::unique_ptr<DitheringAlgorithmBase> dither;
+  if (dithering.algorithm() == DitheringAlgorithm::Ordered)
+    dither.reset(new OrderedDither2(maskIndex));
+  else if (dithering.algorithm() == DitheringAlgorithm::Old)
+    dither.reset(new OrderedDither(maskIndex));
+
+  const RgbMapReader rgbmapReader(rgbmap);
+  for (int y = 0; y < image->height(); ++y) {
+    for (int x = 0; x < image->width(); ++x) {
+      const color_t c = image->getPixel(x, y);
+      color_t index;
+      if (dither)
+        index = dither->ditherRgbPixelToIndex(dithering.matrix(),
+                                              c,
+                                              x,
+                                              y,
+                                              rgbmap ? &rgbmapReader : nullptr,
+                                              palette);
+      else if (rgba_geta(c) == 0)
+        index = maskIndex;
+      else if (rgbmap)
+        index = rgbmap->mapColor(c);
+      else
+        index = palette->findBestfit(rgba_getr(c),
+                                     rgba_getg(c),
+                                     rgba_getb(c),
+                                     rgba_geta(c),
+                                     maskIndex);
+      dst->putPixel(x, y, index);
+    }
+  }
+  return dst;
+}
+
+::testing::AssertionResult equal_images(const Image* expected, const Image* actual)
+{
+  for (int y = 0; y < expected->height(); ++y) {
+    for (int x = 0; x < expected->width(); ++x) {
+      if (expected->getPixel(x, y) != actual->getPixel(x, y)) {
+        return ::testing::AssertionFailure()
+               << "Expected=" << expected->getPixel(x, y) << " Actual=" << actual->getPixel(x, y)
+               << " x=" << x << " y=" << y;
+      }
+    }
+  }
+  return ::testing::AssertionSuccess();
+}
+
+} // anonymous namespace
+
+// Converting rows in parallel must give the same result as
+// converting the image pixel by pixel.
+TEST(Quantization, RgbToIndexedInBands)
+{
+  std::srand(1);
+
+  const Palette palette = make_random_palette(32);
+  const ImageRef image = make_random_rgb_image(300, 211);
+
+  OctreeMap octree;
+  octree.regenerateMap(&palette, 0);
+  RgbMapRGB5A3 rgb5a3;
+  rgb5a3.regenerateMap(&palette, 0);
+
+  const RgbMap* rgbmaps[] = { nullptr, &octree, &rgb5a3 };
+
+  for (const RgbMap* rgbmap : rgbmaps) {
+    for (DitheringAlgorithm algorithm :
+         { DitheringAlgorithm::None, DitheringAlgorithm::Ordered, DitheringAlgorithm::Old }) {
+      const Dithering dithering(algorithm, BayerMatrix(4));
+
+      ImageRef expected = slow_convert_to_indexed(image.get(), dithering, rgbmap, &palette, 0);
+      ImageRef actual(convert_pixel_format(image.get(),
+                                           nullptr,
+                                           IMAGE_INDEXED,
+                                           dithering,
+                                           rgbmap,
+                                           &palette,
+                                           false,
+                                           0));
+
+      EXPECT_TRUE(equal_images(expected.get(), actual.get()))
+        << "algorithm=" << int(algorithm)
+        << " rgbmap=" << (rgbmap ? int(rgbmap->rgbmapAlgorithm()) : -1);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -14,17 +14,24 @@
 #include "base/gcd.h"
 #include "doc/blend_internals.h"
 #include "doc/blend_mode.h"
+#include "doc/blend_row.h"
 #include "doc/doc.h"
 #include "doc/image_impl.h"
 #include "doc/layer_tilemap.h"
+#include "doc/parallel.h"
 #include "doc/playback.h"
 #include "doc/render_plan.h"
 #include "doc/tileset.h"
 #include "doc/tilesets.h"
 #include "gfx/clip.h"
 #include "gfx/region.h"
+#include "render/tile_cache.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <memory>
+#include <type_traits>
 
 #define TRACE_RENDER_CEL(...) // TRACE
 
@@ -64,6 +71,25 @@ void composite_image_without_scale(Image* dst,
 
   ASSERT(!srcBounds.isEmpty());
 
+  // Blend whole rows with a SIMD kernel (if it's available for this
+  // blend mode) instead of calling the BlendFunc for each pixel.
+  if constexpr (std::is_same_v<DstTraits, RgbTraits> && std::is_same_v<SrcTraits, RgbTraits>) {
+    const BlendRowFunc blendRow =
+      (blendMode != BlendMode::SRC ? get_rgba_row_blender(blendMode, newBlend) : nullptr);
+    if (blendRow) {
+      const color_t maskColor = src->maskColor();
+      const int h = std::min(srcBounds.h, bottom - dstBounds.y + 1);
+      for (int y = 0; y < h; ++y) {
+        blendRow(get_pixel_address_fast<RgbTraits>(dst, dstBounds.x, dstBounds.y + y),
+                 get_pixel_address_fast<RgbTraits>(src, srcBounds.x, srcBounds.y + y),
+                 srcBounds.w,
+                 opacity,
+                 maskColor);
+      }
+      return;
+    }
+  }
+
   // Lock all necessary bits
   const LockImageBits<SrcTraits> srcBits(src, srcBounds);
   LockImageBits<DstTraits> dstBits(dst, dstBounds);
@@ -513,6 +539,51 @@ CompositeImageFunc get_fastest_composition_path(const Projection& proj,
   }
 }
 
+// Copies the pixels of an RGB image without transparent pixels (the
+// result of blending it with the NORMAL mode and full opacity).
+void copy_opaque_rgb_image(Image* dst,
+                           const Image* src,
+                           const Palette* pal,
+                           const gfx::ClipF& areaF,
+                           const int opacity,
+                           const BlendMode blendMode,
+                           const double sx,
+                           const double sy,
+                           const bool newBlend,
+                           const tile_flags)
+{
+  ASSERT(dst->pixelFormat() == IMAGE_RGB);
+  ASSERT(src->pixelFormat() == IMAGE_RGB);
+
+  gfx::Clip area(areaF);
+  if (!area.clip(dst->width(), dst->height(), src->width(), src->height()))
+    return;
+
+  for (int y = 0; y < area.size.h; ++y) {
+    const auto* srcPtr = get_pixel_address_fast<RgbTraits>(src, area.src.x, area.src.y + y);
+    std::copy(srcPtr,
+              srcPtr + area.size.w,
+              get_pixel_address_fast<RgbTraits>(dst, area.dst.x, area.dst.y + y));
+  }
+}
+
+// Returns the function to draw cached tiles (which are already
+// scaled) in an RGB image.
+CompositeImageFunc get_rgb_composition_without_scale(const PixelFormat srcFormat)
+{
+  switch (srcFormat) {
+    case IMAGE_RGB:       return composite_image_without_scale<RgbTraits, RgbTraits>;
+    case IMAGE_GRAYSCALE: return composite_image_without_scale<RgbTraits, GrayscaleTraits>;
+    case IMAGE_INDEXED:   return composite_image_without_scale<RgbTraits, IndexedTraits>;
+  }
+  return nullptr;
+}
+
+// Minimum number of pixels/rows to render a sprite in parallel
+// (see Render::renderSpriteInBands())
+const int kMinPixelsForBands = 256 * 256;
+const int kMinBandHeight = 16;
+
 bool has_visible_reference_layers(const LayerGroup* group)
 {
   for (const Layer* child : group->layers()) {
@@ -528,10 +599,60 @@ bool has_visible_reference_layers(const LayerGroup* group)
   return false;
 }
 
+uint64_t double_bits(const double value)
+{
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// Adds to the signature of a LayerStackCache plane all the
+// properties used by Render::renderPlan() to render the given items.
+void add_plan_items_signature(LayerStackCache::Signature& sig,
+                              const RenderPlan::Items& items,
+                              const frame_t frame)
+{
+  for (const auto& item : items) {
+    const auto* layer = static_cast<const LayerImage*>(item.layer);
+    const Cel* cel = (item.cel ? item.cel : layer->cel(frame));
+
+    sig.push_back(layer->id());
+    sig.push_back(layer->version());
+    sig.push_back(uint64_t(layer->flags()));
+    sig.push_back(uint64_t(layer->blendMode()));
+    sig.push_back(layer->opacity());
+    if (!cel) {
+      sig.push_back(0);
+      continue;
+    }
+
+    const gfx::RectF& boundsF = cel->boundsF();
+    sig.push_back(cel->id());
+    sig.push_back(cel->version());
+    sig.push_back(cel->opacity());
+    sig.push_back(double_bits(boundsF.x));
+    sig.push_back(double_bits(boundsF.y));
+    sig.push_back(double_bits(boundsF.w));
+    sig.push_back(double_bits(boundsF.h));
+
+    if (const Image* image = cel->image()) {
+      sig.push_back(image->id());
+      sig.push_back(image->version());
+    }
+    if (layer->isTilemap()) {
+      if (const Tileset* tileset = static_cast<const LayerTilemap*>(layer)->tileset()) {
+        sig.push_back(tileset->id());
+        sig.push_back(tileset->version());
+      }
+    }
+  }
+}
+
 } // anonymous namespace
 
 Render::Render()
   : m_flags(0)
+  , m_threads(1)
   , m_nonactiveLayersOpacity(255)
   , m_sprite(nullptr)
   , m_currentLayer(nullptr)
@@ -559,6 +680,21 @@ void Render::setRefLayersVisiblity(const bool visible)
     m_flags &= ~Flags::ShowRefLayers;
 }
 
+void Render::setThreads(const int threads)
+{
+  m_threads = threads;
+}
+
+void Render::setLayerStackCache(const std::shared_ptr<LayerStackCache>& cache)
+{
+  m_layerStackCache = cache;
+}
+
+void Render::setTileCache(const std::shared_ptr<TileCache>& cache)
+{
+  m_tileCache = cache;
+}
+
 void Render::setNonactiveLayersOpacity(const int opacity)
 {
   m_nonactiveLayersOpacity = opacity;
@@ -665,7 +801,7 @@ void Render::renderLayer(Image* dstImage,
 
   doc::RenderPlan plan;
   plan.addLayer(layer, frame);
-  renderPlan(plan, dstImage, area, frame, compositeImage, true, true, blendMode);
+  renderPlan(plan.items(), dstImage, area, frame, compositeImage, true, true, blendMode);
 }
 
 void Render::renderSprite(Image* dstImage,
@@ -673,6 +809,9 @@ void Render::renderSprite(Image* dstImage,
                           frame_t frame,
                           const gfx::ClipF& area)
 {
+  if (m_threads != 1 && renderSpriteInBands(dstImage, sprite, frame, area))
+    return;
+
   m_sprite = sprite;
 
   CompositeImageFunc compositeImage =
@@ -701,24 +840,44 @@ void Render::renderSprite(Image* dstImage,
     fill_rect(dstImage, area.dstBounds(), bg_color);
 
     // Draw the Background layer - Onion skin behind the sprite - Transparent Layers
-    renderSpriteLayers(dstImage, area, frame, compositeImage);
+    if (!m_layerStackCache ||
+        !renderSpriteLayersWithCache(dstImage, area, frame, compositeImage, bg_color)) {
+      renderSpriteLayers(dstImage, area, frame, compositeImage);
+    }
 
     // In case that we need a special background (e.g. like the
     // checkered pattern), we can draw the background in a temporal
     // image and then merge this temporal image with the dstImage.
-    if (!isSolidBackground(bgLayer, bg_color)) {
+    //
+    // The temporal image covers only the destination area (and not
+    // the whole dstImage), so pixels outside the area are not
+    // touched (this is required to render different bands of the
+    // same dstImage in parallel, see renderSpriteInBands()).
+    const gfx::Rect bgBounds = gfx::Rect(area.dstBounds()) & dstImage->bounds();
+    if (!isSolidBackground(bgLayer, bg_color) && !bgBounds.isEmpty()) {
       if (!m_tmpBuf)
         m_tmpBuf.reset(new doc::ImageBuffer);
-      ImageRef tmpBackground(Image::create(dstImage->spec(), m_tmpBuf));
-      renderBackground(tmpBackground.get(), bgLayer, bg_color, area);
+
+      ImageSpec bgSpec = dstImage->spec();
+      bgSpec.setSize(bgBounds.size());
+      ImageRef tmpBackground(Image::create(bgSpec, m_tmpBuf));
+      renderBackground(tmpBackground.get(),
+                       bgLayer,
+                       bg_color,
+                       gfx::ClipF(area.dst.x - bgBounds.x,
+                                  area.dst.y - bgBounds.y,
+                                  area.src.x,
+                                  area.src.y,
+                                  area.size.w,
+                                  area.size.h));
 
       // Draws dstImage over the background on each pixel of dstImage
       // with opacity is < 255 (the result is left on dstImage itself)
       composite_image(dstImage,
                       tmpBackground.get(),
                       sprite->palette(frame),
-                      0,
-                      0,
+                      bgBounds.x,
+                      bgBounds.y,
                       255,
                       BlendMode::DST_OVER);
     }
@@ -747,6 +906,46 @@ void Render::renderSprite(Image* dstImage,
   }
 }
 
+bool Render::renderSpriteInBands(Image* dstImage,
+                                 const Sprite* sprite,
+                                 frame_t frame,
+                                 const gfx::ClipF& area)
+{
+  const int threads = (m_threads > 0 ? m_threads : doc::parallel_threads());
+  const int areaHeight = int(area.size.h);
+  if (threads < 2 || m_layerStackCache || dstImage->pixelFormat() == IMAGE_TILEMAP ||
+      area.size.w * area.size.h < kMinPixelsForBands) {
+    return false;
+  }
+
+  // Use more bands than threads so a thread that finishes earlier
+  // (e.g. a band with fewer visible cels) can take the next band.
+  const int nbands = std::min(2 * threads, areaHeight / kMinBandHeight);
+  if (nbands < 2)
+    return false;
+
+  // Each band is rendered with its own copy of this Render instance
+  // (m_globalOpacity, m_tmpBuf, etc. are modified while rendering)
+  // and writes only the rows of dstImage inside its band.
+  Render render(*this);
+  render.m_threads = 1;
+  render.m_tmpBuf.reset();
+
+  const int bandHeight = areaHeight / nbands;
+  doc::parallel_for(nbands, threads, [&](const int i, int) {
+    const int y = i * bandHeight;
+    const double h = (i == nbands - 1 ? area.size.h - y : bandHeight);
+
+    Render band(render);
+    band.renderSprite(
+      dstImage,
+      sprite,
+      frame,
+      gfx::ClipF(area.dst.x, area.dst.y + y, area.src.x, area.src.y + y, area.size.w, h));
+  });
+  return true;
+}
+
 void Render::renderSpriteLayers(Image* dstImage,
                                 const gfx::ClipF& area,
                                 frame_t frame,
@@ -757,7 +956,14 @@ void Render::renderSpriteLayers(Image* dstImage,
 
   // Draw the background layer.
   m_globalOpacity = 255;
-  renderPlan(plan, dstImage, area, frame, compositeImage, true, false, BlendMode::UNSPECIFIED);
+  renderPlan(plan.items(),
+             dstImage,
+             area,
+             frame,
+             compositeImage,
+             true,
+             false,
+             BlendMode::UNSPECIFIED);
 
   // Draw onion skin behind the sprite.
   if (m_onionskin.position() == OnionskinPosition::BEHIND)
@@ -765,7 +971,145 @@ void Render::renderSpriteLayers(Image* dstImage,
 
   // Draw the transparent layers.
   m_globalOpacity = 255;
-  renderPlan(plan, dstImage, area, frame, compositeImage, false, true, BlendMode::UNSPECIFIED);
+  renderPlan(plan.items(),
+             dstImage,
+             area,
+             frame,
+             compositeImage,
+             false,
+             true,
+             BlendMode::UNSPECIFIED);
+}
+
+bool Render::renderSpriteLayersWithCache(Image* dstImage,
+                                         const gfx::ClipF& area,
+                                         frame_t frame,
+                                         CompositeImageFunc compositeImage,
+                                         color_t bg_color)
+{
+  const Layer* activeLayer = m_selectedLayerForOpacity;
+  if (!activeLayer || activeLayer->isGroup() || dstImage->pixelFormat() != IMAGE_RGB ||
+      // The onion skin is rendered between the background and the
+      // transparent layers
+      (m_onionskin.type() != OnionskinType::NONE &&
+       m_onionskin.position() == OnionskinPosition::BEHIND) ||
+      // The extra cel must be drawn on the active layer
+      (m_extraCel && m_extraImage && m_currentLayer != activeLayer)) {
+    return false;
+  }
+
+  // The area must be inside the sprite bounds (with the projection
+  // applied) and aligned to pixels.
+  const gfx::Rect srcBounds(area.srcBounds());
+  const gfx::Rect planeBounds(0,
+                              0,
+                              m_proj.applyX(m_sprite->width()),
+                              m_proj.applyY(m_sprite->height()));
+  if (gfx::RectF(srcBounds) != area.srcBounds() || !planeBounds.contains(srcBounds) ||
+      planeBounds.w * planeBounds.h > m_layerStackCache->maxPlanePixels()) {
+    return false;
+  }
+
+  doc::RenderPlan plan;
+  plan.addLayer(m_sprite->root(), frame);
+  const RenderPlan::Items& items = plan.items();
+
+  // Split the plan in the layers below, the active layer, and the
+  // layers above.
+  int active = -1;
+  for (int i = 0; i < int(items.size()); ++i) {
+    const RenderPlan::Item& item = items[i];
+
+    // The background layer is always rendered first, so we cannot
+    // split the plan if a cel is moved below it with its z-index.
+    if (item.layer->isBackground() && i > 0)
+      return false;
+
+    if (item.layer == activeLayer) {
+      active = i;
+      continue;
+    }
+
+    // The preview image replaces the cel of other layer
+    if (m_previewImage && m_selectedLayer && item.layer == m_selectedLayer)
+      return false;
+  }
+  if (active < 0)
+    return false;
+
+  const RenderPlan::Items below(items.begin(), items.begin() + active);
+  const RenderPlan::Items current(items.begin() + active, items.begin() + active + 1);
+  const RenderPlan::Items above(items.begin() + active + 1, items.end());
+
+  LayerStackCache::Signature sig;
+  sig.push_back(m_sprite->id());
+  sig.push_back(m_sprite->pixelFormat());
+  sig.push_back(m_sprite->transparentColor());
+  sig.push_back(m_sprite->palette(frame)->id());
+  sig.push_back(m_sprite->palette(frame)->getModifications());
+  sig.push_back(frame);
+  sig.push_back(double_bits(m_proj.scaleX()));
+  sig.push_back(double_bits(m_proj.scaleY()));
+  sig.push_back(m_flags);
+  sig.push_back(m_nonactiveLayersOpacity);
+  sig.push_back(activeLayer->id());
+  sig.push_back(bg_color);
+
+  ImageSpec planeSpec = dstImage->spec();
+  planeSpec.setSize(planeBounds.size());
+
+  const gfx::Clip planeArea(int(area.dst.x), int(area.dst.y), srcBounds);
+
+  // Copy the layers below from the cache
+  {
+    add_plan_items_signature(sig, below, frame);
+
+    LayerStackCache::Plane& plane = m_layerStackCache->getPlane(sig, planeSpec);
+    renderCachedPlane(plane, below, srcBounds, frame, compositeImage, bg_color);
+    dstImage->copy(plane.image.get(), planeArea);
+  }
+
+  // Draw the active layer
+  m_globalOpacity = 255;
+  renderPlan(current, dstImage, area, frame, compositeImage, true, false, BlendMode::UNSPECIFIED);
+  m_globalOpacity = 255;
+  renderPlan(current, dstImage, area, frame, compositeImage, false, true, BlendMode::UNSPECIFIED);
+
+  // Draw the layers above directly. They are not cached in a
+  // transparent plane because compositing them first and then
+  // blending the plane over the active layer doesn't give exactly the
+  // same result (with 8-bit math) when there are semi-transparent
+  // pixels over other layers.
+  if (!above.empty()) {
+    m_globalOpacity = 255;
+    renderPlan(above, dstImage, area, frame, compositeImage, false, true, BlendMode::UNSPECIFIED);
+  }
+  return true;
+}
+
+void Render::renderCachedPlane(LayerStackCache::Plane& plane,
+                               const RenderPlan::Items& items,
+                               const gfx::Rect& bounds,
+                               frame_t frame,
+                               CompositeImageFunc compositeImage,
+                               color_t bg_color)
+{
+  gfx::Region missing(bounds);
+  missing.createSubtraction(missing, plane.valid);
+  if (missing.isEmpty())
+    return;
+
+  Image* image = plane.image.get();
+  for (const gfx::Rect& rc : missing) {
+    const gfx::Clip area(rc.x, rc.y, rc);
+
+    fill_rect(image, rc, bg_color);
+    m_globalOpacity = 255;
+    renderPlan(items, image, area, frame, compositeImage, true, false, BlendMode::UNSPECIFIED);
+    m_globalOpacity = 255;
+    renderPlan(items, image, area, frame, compositeImage, false, true, BlendMode::UNSPECIFIED);
+  }
+  plane.valid.createUnion(plane.valid, missing);
 }
 
 void Render::renderBackground(Image* image,
@@ -856,7 +1200,7 @@ void Render::renderOnionskin(Image* dstImage,
 
         doc::RenderPlan plan;
         plan.addLayer(onionLayer, frameIn);
-        renderPlan(plan,
+        renderPlan(plan.items(),
                    dstImage,
                    area,
                    frameIn,
@@ -958,7 +1302,7 @@ void Render::renderImage(Image* dst_image,
     tileFlags);
 }
 
-void Render::renderPlan(RenderPlan& plan,
+void Render::renderPlan(const RenderPlan::Items& items,
                         Image* image,
                         const gfx::Clip& area,
                         const frame_t frame,
@@ -967,7 +1311,7 @@ void Render::renderPlan(RenderPlan& plan,
                         const bool render_transparent,
                         const BlendMode blendMode)
 {
-  for (const auto& item : plan.items()) {
+  for (const auto& item : items) {
     const Cel* cel = item.cel;
     const Layer* layer = item.layer;
 
@@ -1247,6 +1591,12 @@ void Render::renderCel(Image* dst_image,
                      tilesToDraw.w,
                      tilesToDraw.h);
 
+    // Tiles from the cache are already flipped and scaled, so they
+    // can be blended (or just copied) without scaling.
+    const bool useTileCache = (m_tileCache && dst_image->pixelFormat() == IMAGE_RGB &&
+                               TileCache::isSupported(grid, m_proj));
+    const bool copyOpaqueTiles = (opacity == 255 && blendMode == BlendMode::NORMAL);
+
     for (int v = tilesToDraw.y; v < tilesToDraw.y2(); ++v) {
       for (int u = tilesToDraw.x; u < tilesToDraw.x2(); ++u) {
         auto tileBoundsOnCanvas = grid.tileToCanvas(gfx::Rect(u, v, 1, 1));
@@ -1272,6 +1622,29 @@ void Render::renderCel(Image* dst_image,
             if (!tile_image)
               continue;
 
+            if (useTileCache) {
+              bool opaque = false;
+              const ImageRef cached =
+                m_tileCache->getTile(tileset, i, tile_image.get(), tile_getf(t), m_proj, opaque);
+              CompositeImageFunc compositeTile = nullptr;
+              if (cached) {
+                compositeTile = (opaque && copyOpaqueTiles ?
+                                   copy_opaque_rgb_image :
+                                   get_rgb_composition_without_scale(cached->pixelFormat()));
+              }
+              if (compositeTile) {
+                renderImage(dst_image,
+                            cached.get(),
+                            pal,
+                            tileBoundsOnCanvas,
+                            area,
+                            compositeTile,
+                            opacity,
+                            blendMode);
+                continue;
+              }
+            }
+
             renderImage(dst_image,
                         tile_image.get(),
                         pal,
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2025 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -15,21 +15,23 @@
 #include "doc/doc.h"
 #include "doc/frame.h"
 #include "doc/pixel_format.h"
+#include "doc/render_plan.h"
 #include "doc/tile.h"
 #include "gfx/clip.h"
 #include "gfx/point.h"
 #include "gfx/size.h"
 #include "render/bg_options.h"
 #include "render/extra_type.h"
+#include "render/layer_stack_cache.h"
 #include "render/onionskin_options.h"
 #include "render/projection.h"
+#include "render/tile_cache.h"
 
 namespace doc {
 class Cel;
 class Image;
 class Layer;
 class Palette;
-class RenderPlan;
 class Sprite;
 class Tileset;
 } // namespace doc
@@ -63,6 +65,27 @@ public:
   void setBgOptions(const BgOptions& bg);
   void setSelectedLayer(const Layer* layer);
 
+  // Number of threads used to render a sprite with renderSprite().
+  // The destination area is split in horizontal bands which are
+  // composited in parallel using a worker pool. By default it's 1
+  // (render in the caller thread), 0 means one thread per CPU core.
+  void setThreads(const int threads);
+
+  // Keeps the layers below the selected layer (see
+  // setSelectedLayer()) composited in the given cache between
+  // renderSprite() calls, so if only the selected layer changes
+  // (or the preview/extra image drawn on it), just that layer and
+  // the layers above it are blended again. The cache is used only with the new blending
+  // method, RGB destination images, and when the render is not
+  // split in bands (see setThreads()).
+  void setLayerStackCache(const std::shared_ptr<LayerStackCache>& cache);
+
+  // Draws the tiles of tilemaps from the given cache of flipped and
+  // scaled tiles (when the projection allows it, see
+  // TileCache::isSupported()) instead of scaling each tile every
+  // time. Only used to render tilemaps in RGB images.
+  void setTileCache(const std::shared_ptr<TileCache>& cache);
+
   // Sets the preview image. This preview image is an alternative
   // image to be used for the given layer/frame.
   void setPreviewImage(const Layer* layer,
@@ -124,11 +147,29 @@ public:
                  const BlendMode blendMode);
 
 private:
+  bool renderSpriteInBands(Image* dstImage,
+                           const Sprite* sprite,
+                           frame_t frame,
+                           const gfx::ClipF& area);
+
   void renderSpriteLayers(Image* dstImage,
                           const gfx::ClipF& area,
                           frame_t frame,
                           CompositeImageFunc compositeImage);
 
+  bool renderSpriteLayersWithCache(Image* dstImage,
+                                   const gfx::ClipF& area,
+                                   frame_t frame,
+                                   CompositeImageFunc compositeImage,
+                                   color_t bg_color);
+
+  void renderCachedPlane(LayerStackCache::Plane& plane,
+                         const doc::RenderPlan::Items& items,
+                         const gfx::Rect& bounds,
+                         frame_t frame,
+                         CompositeImageFunc compositeImage,
+                         color_t bg_color);
+
   void renderBackground(Image* image,
                         const Layer* bgLayer,
                         const color_t bg_color,
@@ -141,7 +182,7 @@ private:
                        const frame_t frame,
                        const CompositeImageFunc compositeImage);
 
-  void renderPlan(doc::RenderPlan& plan,
+  void renderPlan(const doc::RenderPlan::Items& items,
                   Image* image,
                   const gfx::Clip& area,
                   const frame_t frame,
@@ -179,6 +220,7 @@ private:
   bool checkIfWeShouldUsePreview(const Cel* cel) const;
 
   int m_flags;
+  int m_threads;
   int m_nonactiveLayersOpacity;
   const Sprite* m_sprite;
   const Layer* m_currentLayer;
@@ -200,6 +242,8 @@ private:
   BlendMode m_previewBlendMode;
   OnionskinOptions m_onionskin;
   ImageBufferPtr m_tmpBuf;
+  std::shared_ptr<LayerStackCache> m_layerStackCache;
+  std::shared_ptr<TileCache> m_tileCache;
 };
 
 void composite_image(Image* dst,
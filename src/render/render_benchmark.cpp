@@ -1,5 +1,5 @@
 // Aseprite Document Library
-// Copyright (c) 2019-2022 Igara Studio S.A.
+// Copyright (c) 2019-2025 Igara Studio S.A.
 //
 // This file is released under the terms of the MIT license.
 // Read LICENSE.txt for more information.
@@ -10,6 +10,7 @@
 
 #include "render/render.h"
 
+#include "doc/blend_row.h"
 #include "doc/cel.h"
 #include "doc/image.h"
 #include "doc/layer.h"
@@ -77,4 +78,46 @@ BENCHMARK(Bm_Render)
   ->Args({ 4096, 4096 })
   ->Unit(benchmark::kMicrosecond);
 
+// Renders a sprite with state.range(2) layers (with different blend
+// modes), state.range(3) is 0 to disable the SIMD row blenders (to
+// compare with the per-pixel path) or 1 to enable them.
+static void Bm_RenderLayers(benchmark::State& state)
+{
+  const int w = state.range(0);
+  const int h = state.range(1);
+  const int nlayers = state.range(2);
+  const bool simd = (state.range(3) != 0);
+
+  static const BlendMode blendModes[] = { BlendMode::NORMAL, BlendMode::MULTIPLY,
+                                          BlendMode::SCREEN, BlendMode::OVERLAY };
+
+  std::unique_ptr<Sprite> spr(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, w, h)));
+  for (int i = 1; i < nlayers; ++i) {
+    LayerImage* lay = new LayerImage(spr.get());
+    lay->setBlendMode(blendModes[i % 4]);
+    spr->root()->addLayer(lay);
+
+    ImageRef img(Image::create(spr->pixelFormat(), w, h));
+    clear_image(img.get(), 0);
+    fill_rect(img.get(), i, i, w - 2 * i, h - 2 * i, rgba(i * 37, i * 91, i * 13, 128 + i));
+    lay->addCel(new Cel(frame_t(0), img));
+  }
+
+  std::unique_ptr<Image> dst(Image::create(spr->pixelFormat(), w, h));
+  const bool oldState = are_rgba_row_blenders_enabled();
+  set_rgba_row_blenders_enabled(simd);
+
+  while (state.KeepRunning()) {
+    Render render;
+    render.renderSprite(dst.get(), spr.get(), frame_t(0));
+  }
+
+  set_rgba_row_blenders_enabled(oldState);
+}
+
+BENCHMARK(Bm_RenderLayers)
+  ->Args({ 2048, 2048, 40, 0 })
+  ->Args({ 2048, 2048, 40, 1 })
+  ->Unit(benchmark::kMillisecond);
+
 BENCHMARK_MAIN();
@@ -1,5 +1,5 @@
 // Aseprite Render Library
-// Copyright (c) 2019-2023 Igara Studio S.A.
+// Copyright (c) 2019-2025 Igara Studio S.A.
 // Copyright (c) 2001-2018 David Capello
 //
 // This file is released under the terms of the MIT license.
@@ -13,14 +13,21 @@
 
 #include "render/render.h"
 
+#include "doc/algorithm/random_image.h"
 #include "doc/cel.h"
 #include "doc/document.h"
 #include "doc/image.h"
 #include "doc/layer.h"
+#include "doc/layer_tilemap.h"
 #include "doc/palette.h"
 #include "doc/primitives.h"
+#include "doc/tileset.h"
+#include "doc/tilesets.h"
 
+#include <algorithm>
 #include <memory>
+#include <random>
+#include <vector>
 
 using namespace doc;
 using namespace render;
@@ -251,6 +258,250 @@ TEST(Render, BugWithMultiplesOf3ZoomFactors)
   }
 }
 
+TEST(Render, RenderInBands)
+{
+  const int w = 301;
+  const int h = 517;
+
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, w, h)));
+  Sprite* spr = doc->sprite();
+
+  static const BlendMode blendModes[] = { BlendMode::NORMAL,
+                                          BlendMode::MULTIPLY,
+                                          BlendMode::HSL_HUE };
+  for (int i = 0; i < 3; ++i) {
+    LayerImage* lay = (i == 0 ? static_cast<LayerImage*>(spr->root()->firstLayer()) :
+                                new LayerImage(spr));
+    if (i > 0) {
+      spr->root()->addLayer(lay);
+      lay->addCel(new Cel(frame_t(0), ImageRef(Image::create(IMAGE_RGB, w - i, h - i))));
+    }
+    lay->setBlendMode(blendModes[i]);
+    algorithm::random_image(lay->cel(0)->image());
+  }
+
+  BgOptions bg;
+  bg.type = BgType::CHECKERED;
+  bg.zoom = true;
+  bg.colorPixelFormat = IMAGE_RGB;
+  bg.color1 = rgba(128, 128, 128, 255);
+  bg.color2 = rgba(64, 64, 64, 255);
+  bg.stripeSize = gfx::Size(8, 8);
+
+  for (int zoom : { 1, 2, 3 }) {
+    Render render;
+    render.setBgOptions(bg);
+    render.setProjection(Projection(PixelRatio(1, 1), Zoom(zoom, 1)));
+
+    std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, w * zoom, h * zoom));
+    std::unique_ptr<Image> result(Image::create(IMAGE_RGB, w * zoom, h * zoom));
+    const gfx::Clip area(0, 0, 0, 0, w * zoom, h * zoom);
+
+    render.setThreads(1);
+    render.renderSprite(expected.get(), spr, frame_t(0), area);
+
+    render.setThreads(4);
+    render.renderSprite(result.get(), spr, frame_t(0), area);
+
+    EXPECT_TRUE(is_same_image(expected.get(), result.get())) << " zoom=" << zoom;
+  }
+}
+
+TEST(Render, LayerStackCache)
+{
+  const int w = 67;
+  const int h = 45;
+
+  std::shared_ptr<Document> doc = std::make_shared<Document>();
+  doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(ColorMode::RGB, w, h)));
+  Sprite* spr = doc->sprite();
+
+  // Random alpha values (including fully transparent/opaque pixels)
+  std::mt19937 rng(1);
+  auto random_alpha = [&rng](Image* image) {
+    for (int y = 0; y < image->height(); ++y) {
+      for (int x = 0; x < image->width(); ++x) {
+        const int r = rng() % 300;
+        put_pixel(image, x, y, rgba_seta(get_pixel(image, x, y), r < 20 ? 0 : std::min(r, 255)));
+      }
+    }
+  };
+
+  // Layers 1-3 are below the active layer (4), and 5-6 are above it
+  static const BlendMode blendModes[] = {
+    BlendMode::NORMAL, BlendMode::MULTIPLY, BlendMode::SCREEN,
+    BlendMode::NORMAL, BlendMode::NORMAL,   BlendMode::NORMAL,
+  };
+  std::vector<LayerImage*> layers;
+  for (int i = 0; i < 6; ++i) {
+    LayerImage* lay = (i == 0 ? static_cast<LayerImage*>(spr->root()->firstLayer()) :
+                                new LayerImage(spr));
+    if (i > 0) {
+      spr->root()->addLayer(lay);
+      lay->addCel(new Cel(frame_t(0), ImageRef(Image::create(IMAGE_RGB, w - i, h - 2 * i))));
+      lay->cel(0)->setPosition(i, i / 2);
+    }
+    lay->setBlendMode(blendModes[i]);
+    algorithm::random_image(lay->cel(0)->image());
+    if (i > 0)
+      random_alpha(lay->cel(0)->image());
+    layers.push_back(lay);
+  }
+
+  LayerImage* active = layers[3];
+  auto cache = std::make_shared<LayerStackCache>();
+
+  auto compare = [&](const int zoom, const char* step) {
+    Render expectedRender;
+    expectedRender.setSelectedLayer(active);
+    expectedRender.setProjection(Projection(PixelRatio(1, 1), Zoom(zoom, 1)));
+
+    Render cachedRender(expectedRender);
+    cachedRender.setLayerStackCache(cache);
+
+    // Render some part of the sprite, then the whole sprite (which
+    // uses the area that was already cached), and then other part.
+    for (const gfx::Rect& rc : { gfx::Rect(3, 5, 20, 11),
+                                 gfx::Rect(0, 0, w * zoom, h * zoom),
+                                 gfx::Rect(w * zoom / 2, 7, w * zoom / 2, 30) }) {
+      std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, rc.w, rc.h));
+      std::unique_ptr<Image> result(Image::create(IMAGE_RGB, rc.w, rc.h));
+      const gfx::Clip area(0, 0, rc);
+
+      expectedRender.renderSprite(expected.get(), spr, frame_t(0), area);
+      cachedRender.renderSprite(result.get(), spr, frame_t(0), area);
+      EXPECT_TRUE(is_same_image(expected.get(), result.get())) << step << " zoom=" << zoom;
+    }
+  };
+
+  for (int zoom : { 1, 2 }) {
+    compare(zoom, "initial");
+
+    // Changing the active layer doesn't require a new version
+    algorithm::random_image(active->cel(0)->image());
+    random_alpha(active->cel(0)->image());
+    compare(zoom, "active changed");
+
+    // Modify the layers below/above
+    algorithm::random_image(layers[1]->cel(0)->image());
+    layers[1]->cel(0)->image()->incrementVersion();
+    compare(zoom, "below changed");
+
+    layers[5]->setOpacity(128);
+    compare(zoom, "above changed");
+    layers[5]->setOpacity(255);
+
+    layers[4]->setBlendMode(BlendMode::DIFFERENCE);
+    compare(zoom, "above with other blend mode");
+    layers[4]->setBlendMode(BlendMode::NORMAL);
+
+    layers[2]->setVisible(false);
+    compare(zoom, "hidden layer");
+    layers[2]->setVisible(true);
+  }
+}
+
+TEST(Render, TileCache)
+{
+  const int w = 60;
+  const int h = 48;
+  const gfx::Size tileSize(6, 6);
+
+  for (ColorMode colorMode : { ColorMode::RGB, ColorMode::INDEXED }) {
+    std::shared_ptr<Document> doc = std::make_shared<Document>();
+    doc->sprites().add(Sprite::MakeStdSprite(ImageSpec(colorMode, w, h)));
+    Sprite* spr = doc->sprite();
+    algorithm::random_image(static_cast<LayerImage*>(spr->root()->firstLayer())->cel(0)->image());
+
+    // Tiles 1-2 are opaque, tiles 3-4 have transparent pixels
+    Tileset* tileset = new Tileset(spr, Grid(tileSize), 5);
+    for (tile_index i = 1; i < 5; ++i) {
+      ImageRef tileImage = tileset->makeEmptyTile();
+      algorithm::random_image(tileImage.get());
+      if (colorMode == ColorMode::RGB && i < 3) {
+        for (int y = 0; y < tileSize.h; ++y)
+          for (int x = 0; x < tileSize.w; ++x)
+            put_pixel(tileImage.get(), x, y, get_pixel(tileImage.get(), x, y) | rgba_a_mask);
+      }
+      tileset->set(i, tileImage);
+    }
+    spr->tilesets()->add(tileset);
+
+    // Tilemap with all tiles and flips
+    auto* layer = new LayerTilemap(spr, 0);
+    spr->root()->addLayer(layer);
+    ImageRef tilemap(Image::create(IMAGE_TILEMAP, 9, 7));
+    for (int y = 0; y < tilemap->height(); ++y) {
+      for (int x = 0; x < tilemap->width(); ++x) {
+        const int i = x + y * tilemap->width();
+        put_pixel(tilemap.get(), x, y, tile(i % 5, ((i / 5) % 8) << 29));
+      }
+    }
+    Cel* cel = new Cel(frame_t(0), tilemap);
+    layer->addCel(cel);
+
+    auto cache = std::make_shared<TileCache>();
+
+    // Tilemaps aligned to the tiles of the sprite, to the pixels of
+    // the scaled down image (1/2 or 1/3) only, or not aligned
+    for (const gfx::Point& celPos :
+         { gfx::Point(6, 12), gfx::Point(4, -2), gfx::Point(3, 9), gfx::Point(-5, 1) }) {
+      cel->setPosition(celPos);
+
+      for (const int opacity : { 255, 128 }) {
+        layer->setOpacity(opacity);
+
+        for (const Projection& proj : { Projection(PixelRatio(1, 1), Zoom(1, 1)),
+                                        Projection(PixelRatio(1, 1), Zoom(2, 1)),
+                                        Projection(PixelRatio(1, 1), Zoom(3, 1)),
+                                        Projection(PixelRatio(1, 1), Zoom(1, 2)),
+                                        Projection(PixelRatio(1, 1), Zoom(1, 3)),
+                                        Projection(PixelRatio(2, 1), Zoom(1, 2)) }) {
+          Render expectedRender;
+          expectedRender.setProjection(proj);
+
+          Render cachedRender(expectedRender);
+          cachedRender.setTileCache(cache);
+
+          const int zw = proj.applyX(w);
+          const int zh = proj.applyY(h);
+          // Areas that start in a pixel of the sprite, and in the
+          // middle of a pixel of the sprite (with zoom) or a tile
+          for (const gfx::Rect& rc : { gfx::Rect(0, 0, zw, zh),
+                                       gfx::Rect(6, 12, zw / 2, zh / 3),
+                                       gfx::Rect(7, 13, zw / 2, zh / 3),
+                                       gfx::Rect(1, 5, zw - 3, zh - 7) }) {
+            std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, rc.w, rc.h));
+            std::unique_ptr<Image> result(Image::create(IMAGE_RGB, rc.w, rc.h));
+            const gfx::Clip area(0, 0, rc);
+
+            expectedRender.renderSprite(expected.get(), spr, frame_t(0), area);
+            cachedRender.renderSprite(result.get(), spr, frame_t(0), area);
+            EXPECT_TRUE(is_same_image(expected.get(), result.get()))
+              << "colorMode=" << int(colorMode) << " celPos=" << celPos.x << "," << celPos.y
+              << " opacity=" << opacity << " scale=" << proj.scaleX() << "," << proj.scaleY();
+          }
+        }
+      }
+    }
+
+    // Modified tiles are transformed again
+    algorithm::random_image(tileset->get(3).get());
+    tileset->get(3)->incrementVersion();
+    Render expectedRender;
+    expectedRender.setProjection(Projection(PixelRatio(1, 1), Zoom(2, 1)));
+    Render cachedRender(expectedRender);
+    cachedRender.setTileCache(cache);
+    const gfx::Clip area(0, 0, 0, 0, 2 * w, 2 * h);
+    std::unique_ptr<Image> expected(Image::create(IMAGE_RGB, 2 * w, 2 * h));
+    std::unique_ptr<Image> result(Image::create(IMAGE_RGB, 2 * w, 2 * h));
+    expectedRender.renderSprite(expected.get(), spr, frame_t(0), area);
+    cachedRender.renderSprite(result.get(), spr, frame_t(0), area);
+    EXPECT_TRUE(is_same_image(expected.get(), result.get())) << "colorMode=" << int(colorMode);
+  }
+}
+
 int main(int argc, char** argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
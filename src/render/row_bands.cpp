@@ -0,0 +1,79 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "render/row_bands.h"
+
+#include "base/debug.h"
+#include "doc/parallel.h"
+#include "render/task_delegate.h"
+
+#include <algorithm>
+
+namespace render {
+
+namespace {
+
+// Minimum number of pixels to process an image in parallel, and
+// minimum number of rows of each band.
+const int kMinPixelsForThreads = 128 * 128;
+const int kMinBandHeight = 8;
+
+// Number of entries of the SharedRgbMap cache (must be a power of 2)
+const int kCacheSize = 4096;
+
+} // anonymous namespace
+
+bool for_each_row_band(const int width,
+                       const int height,
+                       TaskDelegate* delegate,
+                       const std::function<void(int y1, int y2)>& func)
+{
+  const int threads = (width * height >= kMinPixelsForThreads ? doc::parallel_threads() : 1);
+
+  // Use more bands than threads so a thread that finishes earlier can
+  // take the next band, and to report the progress more frequently.
+  const int nbands = std::clamp(height / kMinBandHeight, 1, 4 * threads);
+
+  return doc::parallel_for(
+    nbands,
+    threads,
+    [height, nbands, &func](const int i, int) {
+      func(height * i / nbands, height * (i + 1) / nbands);
+    },
+    [delegate](const double progress) {
+      if (!delegate)
+        return true;
+      if (!delegate->continueTask())
+        return false;
+      delegate->notifyTaskProgress(progress);
+      return true;
+    });
+}
+
+SharedRgbMap::SharedRgbMap(const doc::RgbMap* rgbmap, std::mutex& mutex)
+  : RgbMapReader(rgbmap)
+  , m_mutex(mutex)
+  , m_cache(kCacheSize)
+{
+  ASSERT(m_rgbmap);
+}
+
+int SharedRgbMap::mapColor(const doc::color_t rgba) const
+{
+  Entry& entry = m_cache[((rgba * 2654435761u) >> 20) & (kCacheSize - 1)];
+  if (entry.index < 0 || entry.color != rgba) {
+    const std::lock_guard lock(m_mutex);
+    entry.color = rgba;
+    entry.index = m_rgbmap->mapColor(rgba);
+  }
+  return entry.index;
+}
+
+} // namespace render
@@ -0,0 +1,79 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_ROW_BANDS_H_INCLUDED
+#define RENDER_ROW_BANDS_H_INCLUDED
+#pragma once
+
+#include "doc/color.h"
+#include "doc/rgbmap.h"
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace render {
+
+class TaskDelegate;
+
+// Calls func(y1, y2) to process the rows [y1, y2) of an image with
+// the given size. Rows are split in bands, and bands are processed in
+// parallel when the image is big enough, so func() must be
+// thread-safe and write only the rows of its band.
+//
+// The delegate is used only from the caller thread (between bands).
+// Returns false if the task was canceled (in that case some bands
+// weren't processed).
+bool for_each_row_band(const int width,
+                       const int height,
+                       TaskDelegate* delegate,
+                       const std::function<void(int y1, int y2)>& func);
+
+// Read-only access to the colors of a RgbMap (the only thing that
+// the conversion to indexed needs from it). This implementation calls
+// the RgbMap directly, so it can be used only from one thread.
+class RgbMapReader {
+public:
+  RgbMapReader(const doc::RgbMap* rgbmap) : m_rgbmap(rgbmap) {}
+  virtual ~RgbMapReader() {}
+
+  // Returns the best index in the palette for the given RGBA color.
+  virtual int mapColor(const doc::color_t rgba) const { return m_rgbmap->mapColor(rgba); }
+
+  int mapColor(const int r, const int g, const int b, const int a) const
+  {
+    return mapColor(doc::rgba(r, g, b, a));
+  }
+
+protected:
+  const doc::RgbMap* m_rgbmap;
+};
+
+// Reads a RgbMap from several threads at the same time. RgbMap
+// implementations calculate their entries lazily in mapColor(), so
+// calls to the wrapped map are serialized with the given mutex, and
+// the results are cached in a small table of this reader (so we
+// should use one reader for each thread).
+class SharedRgbMap : public RgbMapReader {
+public:
+  SharedRgbMap(const doc::RgbMap* rgbmap, std::mutex& mutex);
+
+  using RgbMapReader::mapColor;
+  int mapColor(const doc::color_t rgba) const override;
+
+private:
+  struct Entry {
+    doc::color_t color = 0;
+    int index = -1;
+  };
+
+  std::mutex& m_mutex;
+  mutable std::vector<Entry> m_cache;
+};
+
+} // namespace render
+
+#endif
@@ -0,0 +1,213 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifdef HAVE_CONFIG_H
+  #include "config.h"
+#endif
+
+#include "render/tile_cache.h"
+
+#include "doc/grid.h"
+#include "doc/image.h"
+#include "doc/image_impl.h"
+#include "doc/primitives_fast.h"
+#include "doc/tileset.h"
+#include "render/projection.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace render {
+
+using namespace doc;
+
+namespace {
+
+// Gets the scale of one axis as a multiplier (scale >= 1) or a
+// divisor (scale < 1). Returns false if the scale (or its inverse)
+// is not an integer.
+bool get_axis_scale(const double scale, int& mul, int& div)
+{
+  if (scale >= 1.0) {
+    mul = int(scale);
+    div = 1;
+    return (double(mul) == scale);
+  }
+  else if (scale > 0.0 && std::fmod(1.0 / scale, 1.0) == 0.0) {
+    mul = 1;
+    div = int(1.0 / scale);
+    return true;
+  }
+  return false;
+}
+
+bool get_scale(const Projection& proj, int scale[4])
+{
+  return (get_axis_scale(proj.scaleX(), scale[0], scale[1]) &&
+          get_axis_scale(proj.scaleY(), scale[2], scale[3]));
+}
+
+// Flips and scales the tile in the same way as the general
+// composite function with tile flags (so the result is exactly the
+// same when the tile is drawn without scale).
+template<typename ImageTraits>
+void transform_tile(const Image* src, Image* dst, const tile_flags flags, const int scale[4])
+{
+  const int w = dst->width();
+  const int h = dst->height();
+  for (int y = 0; y < h; ++y) {
+    auto dstPtr = get_pixel_address_fast<ImageTraits>(dst, 0, y);
+    for (int x = 0; x < w; ++x, ++dstPtr) {
+      int u = (flags & tile_f_xflip ? w - 1 - x : x) * scale[1] / scale[0];
+      int v = (flags & tile_f_yflip ? h - 1 - y : y) * scale[3] / scale[2];
+      if (flags & tile_f_dflip)
+        std::swap(u, v);
+      *dstPtr = get_pixel_fast<ImageTraits>(src, u, v);
+    }
+  }
+}
+
+bool is_opaque_rgb_image(const Image* image)
+{
+  const color_t maskColor = image->maskColor();
+  for (int y = 0; y < image->height(); ++y) {
+    auto ptr = get_pixel_address_fast<RgbTraits>(image, 0, y);
+    for (int x = 0; x < image->width(); ++x, ++ptr) {
+      if (rgba_geta(*ptr) < 255 || *ptr == maskColor)
+        return false;
+    }
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+TileCache::TileCache(const int maxPixels) : m_maxPixels(maxPixels), m_pixels(0)
+{
+}
+
+// static
+bool TileCache::isSupported(const Grid& grid, const Projection& proj)
+{
+  int scale[4];
+  if (!get_scale(proj, scale))
+    return false;
+
+  // With scales like 1/2, 1/3, etc. each tile must start and end in
+  // a pixel of the destination image.
+  return (grid.origin().x % scale[1] == 0 && grid.tileSize().w % scale[1] == 0 &&
+          grid.origin().y % scale[3] == 0 && grid.tileSize().h % scale[3] == 0);
+}
+
+ImageRef TileCache::getTile(const Tileset* tileset,
+                            const tile_index ti,
+                            const Image* tileImage,
+                            const tile_flags flags,
+                            const Projection& proj,
+                            bool& opaque)
+{
+  int scale[4];
+  if (!get_scale(proj, scale))
+    return nullptr;
+
+  // Diagonal flips of non-square tiles are not supported
+  const int srcW = tileImage->width();
+  const int srcH = tileImage->height();
+  if (srcW % scale[1] != 0 || srcH % scale[3] != 0 || ((flags & tile_f_dflip) && srcW != srcH))
+    return nullptr;
+
+  const std::lock_guard lock(m_mutex);
+  Entry& entry = getEntry(tileset->id(), scale);
+
+  const size_t i = size_t(ti) * 8 + (flags >> 29);
+  if (i >= entry.tiles.size())
+    entry.tiles.resize(std::max<size_t>(i + 1, size_t(tileset->size()) * 8));
+
+  Tile& tile = entry.tiles[i];
+  if (tile.image) {
+    if (tile.imageId == tileImage->id() && tile.imageVersion == tileImage->version()) {
+      opaque = tile.opaque;
+      return tile.image;
+    }
+
+    // Discard the old version of this tile
+    const int pixels = tile.image->width() * tile.image->height();
+    entry.pixels -= pixels;
+    m_pixels -= pixels;
+    tile.image.reset();
+  }
+
+  const int w = srcW * scale[0] / scale[1];
+  const int h = srcH * scale[2] / scale[3];
+  if (!makeRoom(w * h))
+    return nullptr;
+
+  ImageSpec spec = tileImage->spec();
+  spec.setSize(w, h);
+  ImageRef image(Image::create(spec));
+
+  switch (image->pixelFormat()) {
+    case IMAGE_RGB:
+      transform_tile<RgbTraits>(tileImage, image.get(), flags, scale);
+      break;
+    case IMAGE_GRAYSCALE:
+      transform_tile<GrayscaleTraits>(tileImage, image.get(), flags, scale);
+      break;
+    case IMAGE_INDEXED:
+      transform_tile<IndexedTraits>(tileImage, image.get(), flags, scale);
+      break;
+    default: return nullptr;
+  }
+
+  tile.imageId = tileImage->id();
+  tile.imageVersion = tileImage->version();
+  tile.image = image;
+  tile.opaque = (image->pixelFormat() == IMAGE_RGB && is_opaque_rgb_image(image.get()));
+  entry.pixels += w * h;
+  m_pixels += w * h;
+
+  opaque = tile.opaque;
+  return image;
+}
+
+void TileCache::clear()
+{
+  const std::lock_guard lock(m_mutex);
+  m_entries.clear();
+  m_pixels = 0;
+}
+
+TileCache::Entry& TileCache::getEntry(const ObjectId tilesetId, const int scale[4])
+{
+  auto it = std::find_if(m_entries.begin(), m_entries.end(), [tilesetId, scale](const auto& entry) {
+    return (entry->tilesetId == tilesetId && std::equal(scale, scale + 4, entry->scale));
+  });
+  if (it != m_entries.end()) {
+    // Move the entry to the front (most recently used)
+    std::rotate(m_entries.begin(), it, it + 1);
+    return *m_entries.front();
+  }
+
+  auto entry = std::make_unique<Entry>();
+  entry->tilesetId = tilesetId;
+  std::copy(scale, scale + 4, entry->scale);
+  m_entries.insert(m_entries.begin(), std::move(entry));
+  return *m_entries.front();
+}
+
+// Discards the least recently used entries (except the first one,
+// which is the one being used) until the given number of pixels
+// fits in the cache.
+bool TileCache::makeRoom(const int pixels)
+{
+  while (m_pixels + pixels > m_maxPixels && m_entries.size() > 1) {
+    m_pixels -= m_entries.back()->pixels;
+    m_entries.pop_back();
+  }
+  return (m_pixels + pixels <= m_maxPixels);
+}
+
+} // namespace render
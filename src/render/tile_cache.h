@@ -0,0 +1,96 @@
+// Aseprite Render Library
+// Copyright (c) 2025 Igara Studio S.A.
+//
+// This file is released under the terms of the MIT license.
+// Read LICENSE.txt for more information.
+
+#ifndef RENDER_TILE_CACHE_H_INCLUDED
+#define RENDER_TILE_CACHE_H_INCLUDED
+#pragma once
+
+#include "doc/image_ref.h"
+#include "doc/object_id.h"
+#include "doc/object_version.h"
+#include "doc/tile.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace doc {
+class Grid;
+class Image;
+class Tileset;
+} // namespace doc
+
+namespace render {
+
+class Projection;
+
+// Keeps the tiles of tilesets already flipped (with the tile flags)
+// and scaled (with the render projection), so a tilemap can be
+// rendered blitting each tile without scaling it (see
+// Render::setTileCache()).
+//
+// Each tile remembers the id/version of its original image, so it's
+// transformed again when the tile is modified. When the cache is
+// full, the tiles of the least recently used tileset/scale are
+// discarded.
+class TileCache {
+public:
+  // Maximum number of pixels of all transformed tiles.
+  static constexpr int kDefaultMaxPixels = 4096 * 4096;
+
+  TileCache(const int maxPixels = kDefaultMaxPixels);
+
+  // Returns true if the tiles of the given grid can be transformed
+  // and drawn without scaling using the given projection, i.e. the
+  // scale is an integer (or 1/integer) and each tile is aligned to
+  // the pixels of the destination.
+  static bool isSupported(const doc::Grid& grid, const Projection& proj);
+
+  // Returns the "tileImage" (which is the "ti" tile of "tileset")
+  // with the given flips and the projection applied. "opaque" is set
+  // to true if it's an RGB tile without transparent pixels. Returns
+  // nullptr if the tile cannot be transformed or it doesn't fit in
+  // the cache.
+  doc::ImageRef getTile(const doc::Tileset* tileset,
+                        const doc::tile_index ti,
+                        const doc::Image* tileImage,
+                        const doc::tile_flags flags,
+                        const Projection& proj,
+                        bool& opaque);
+
+  // Discards all tiles (e.g. to release memory).
+  void clear();
+
+private:
+  struct Tile {
+    doc::ObjectId imageId = doc::NullId;
+    doc::ObjectVersion imageVersion = 0;
+    doc::ImageRef image;
+    bool opaque = false;
+  };
+
+  // Transformed tiles of a tileset with a specific scale.
+  struct Entry {
+    doc::ObjectId tilesetId;
+    int scale[4]; // Multiplier/divisor for X and Y axes
+    int pixels = 0;
+    // Eight variants (flips) for each tile
+    std::vector<Tile> tiles;
+  };
+
+  Entry& getEntry(const doc::ObjectId tilesetId, const int scale[4]);
+  bool makeRoom(const int pixels);
+
+  int m_maxPixels;
+  int m_pixels;
+  std::mutex m_mutex;
+  // Most recently used entries first
+  std::vector<std::unique_ptr<Entry>> m_entries;
+};
+
+} // namespace render
+
+#endif
@@ -1,8 +1,11 @@
+-- Copyright (C) 2025  Igara Studio S.A.
 -- Copyright (C) 2018  David Capello
 --
 -- This file is released under the terms of the MIT license.
 -- Read LICENSE.txt for more information.
 
+dofile('./test_utils.lua')
+
 local s = Sprite(16, 32)
 assert(s.width == 16)
 assert(s.height == 32)
@@ -38,3 +41,47 @@ assert(s.height == 32)
 app.redo()
 assert(s.width == 20)
 assert(s.height == 40)
+
+-- Image modifications inside a transaction are undone in one step
+do
+  local spr = Sprite(2, 2, ColorMode.INDEXED)
+  local img = spr.cels[1].image
+  local one = Image(1, 1, ColorMode.INDEXED)
+  one:clear(3)
+
+  app.transaction(
+    function()
+      img:drawPixel(0, 0, 1)
+      img:drawPixel(1, 0, 2)
+      img:drawImage(one, 0, 1)
+      spr:newLayer()          -- Other commands in the same transaction
+      img:putPixels(Rectangle(1, 1, 1, 1), { 4 })
+    end)
+  expect_img(img, { 1, 2,
+                    3, 4 })
+  assert(#spr.layers == 2)
+
+  app.undo()
+  expect_img(img, { 0, 0,
+                    0, 0 })
+  assert(#spr.layers == 1)
+
+  app.redo()
+  expect_img(img, { 1, 2,
+                    3, 4 })
+  assert(#spr.layers == 2)
+
+  -- Modifications are restored if the transaction fails
+  local ok = pcall(
+    function()
+      app.transaction(
+        function()
+          img:drawPixel(0, 0, 5)
+          img:clear(6)
+          error("fail")
+        end)
+    end)
+  assert(not ok)
+  expect_img(img, { 1, 2,
+                    3, 4 })
+end
@@ -561,3 +561,122 @@ do
                     2, 3 })
 
 end
+
+-- Image:putPixels(), Image:fill(), and Image:drawImages()
+do
+  local img = Image(3, 2, ColorMode.INDEXED)
+  img:putPixels({ 1, 2, 3,
+                  4, 5, 6 })
+  expect_img(img, { 1, 2, 3,
+                    4, 5, 6 })
+
+  img:putPixels(Rectangle(1, 1, 2, 1), { 7, 8 })
+  expect_img(img, { 1, 2, 3,
+                    4, 7, 8 })
+
+  -- From a string of bytes (partially outside the image)
+  img:putPixels(Rectangle(-1, 0, 2, 2), string.char(9, 10, 11, 12))
+  expect_img(img, { 10, 2, 3,
+                    12, 7, 8 })
+
+  local ok = pcall(function() img:putPixels({ 1, 2 }) end)
+  assert(not ok)
+
+  img:fill(Rectangle(0, 0, 2, 1), 13)
+  expect_img(img, { 13, 13, 3,
+                    12, 7, 8 })
+  img:fill(0)
+  assert(img:isPlain(0))
+
+  local a = Image(1, 1, ColorMode.INDEXED)
+  local b = Image(2, 1, ColorMode.INDEXED)
+  a:clear(1)
+  b:clear(2)
+  img:drawImages{ { image=a },
+                  { image=b, position=Point(1, 1) },
+                  { image=a, position={ 2, 0 } } }
+  expect_img(img, { 1, 0, 1,
+                    0, 2, 2 })
+
+  -- Undoable modifications in a cel image
+  local spr = Sprite(3, 2, ColorMode.INDEXED)
+  local cel = spr.cels[1]
+  cel.image:fill(4)
+  assert(cel.image:isPlain(4))
+  cel.image:putPixels(Rectangle(0, 0, 2, 1), { 5, 6 })
+  expect_img(cel.image, { 5, 6, 4,
+                          4, 4, 4 })
+  cel.image:drawImages{ { image=a, position=Point(2, 1) } }
+  expect_img(cel.image, { 5, 6, 4,
+                          4, 4, 1 })
+  app.undo()
+  expect_img(cel.image, { 5, 6, 4,
+                          4, 4, 4 })
+  app.undo()
+  assert(cel.image:isPlain(4))
+  app.redo()
+  app.redo()
+  expect_img(cel.image, { 5, 6, 4,
+                          4, 4, 1 })
+end
+
+-- Image:view()
+do
+  local img = Image(4, 3, ColorMode.INDEXED)
+  array_to_pixels({ 0, 1, 2, 3,
+                    4, 5, 6, 7,
+                    8, 9, 10, 11 }, img)
+
+  local view = img:view()
+  assert(view.width == 4)
+  assert(view.height == 3)
+  assert(view.bytesPerPixel == 1)
+  assert(view.rowStride == 4)
+  assert(#view == 12)
+  assert(view:getPixel(1, 2) == 9)
+  assert(view:getU8(5) == 5)
+  assert(view:getU16(0) == 0x0100)
+  assert(view:getU32(8) == 0x0B0A0908)
+  assert(not pcall(function() view:getPixel(4, 0) end))
+  assert(not pcall(function() view:getU32(2) end)) -- Crosses a row
+  assert(not pcall(function() view:getU8(12) end))
+
+  -- Slices are relative to the view
+  local slice = view:slice(Rectangle(1, 1, 2, 2))
+  assert(slice.bounds == Rectangle(1, 1, 2, 2))
+  assert(slice:getBytes() == string.char(5, 6, 9, 10))
+  local subslice = slice:slice(Rectangle(1, 0, 4, 4))
+  assert(subslice.bounds == Rectangle(2, 1, 1, 2))
+  assert(subslice:getPixel(0, 1) == 10)
+
+  slice:setPixel(0, 0, 20)
+  slice:setU8(3, 21)
+  expect_img(img, { 0, 1, 2, 3,
+                    4, 20, 6, 7,
+                    8, 9, 21, 11 })
+
+  slice:setBytes(string.char(1, 2, 3, 4))
+  expect_img(img, { 0, 1, 2, 3,
+                    4, 1, 2, 7,
+                    8, 3, 4, 11 })
+  assert(not pcall(function() slice:setBytes(string.char(1)) end))
+
+  assert(img:view(Rectangle(1, 1, 1, 1)):isEqual(img:view(Rectangle(0, 1, 1, 1))) == false)
+  assert(img:view(Rectangle(1, 0, 1, 1)):isEqual(img:view(Rectangle(1, 1, 1, 1))))
+
+  -- RGB images
+  local rgb = Image(2, 2, ColorMode.RGB)
+  local rgbView = rgb:view()
+  rgbView:setPixel(1, 1, rgba(1, 2, 3, 4))
+  assert(rgb:getPixel(1, 1) == rgba(1, 2, 3, 4))
+  assert(rgbView:getU8(12) == 1)
+  assert(rgbView:getU8(15) == 4)
+  rgbView:setU32(0, rgba(5, 6, 7, 8))
+  assert(rgb:getPixel(0, 0) == rgba(5, 6, 7, 8))
+
+  -- The view keeps the image alive
+  local orphan = Image(1, 1, ColorMode.GRAYSCALE):view()
+  collectgarbage()
+  assert(orphan:getPixel(0, 0) == 0)
+  assert(orphan.bytesPerPixel == 2)
+end